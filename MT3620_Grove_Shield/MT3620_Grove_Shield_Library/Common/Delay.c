@@ -13,4 +13,12 @@ void usleep(long usec)
 		req.tv_sec = rem.tv_sec;
 		req.tv_nsec = rem.tv_nsec;
 	}
+}
+
+int64_t GetMonotonicMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
 }
\ No newline at end of file
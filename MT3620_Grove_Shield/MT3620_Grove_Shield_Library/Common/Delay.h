@@ -1,5 +1,9 @@
 #pragma once
 
 #include <time.h>
+#include <stdint.h>
 
-void usleep(long usec);
\ No newline at end of file
+void usleep(long usec);
+
+// Milliseconds since an arbitrary fixed point, for deadlines
+int64_t GetMonotonicMs(void);
\ No newline at end of file
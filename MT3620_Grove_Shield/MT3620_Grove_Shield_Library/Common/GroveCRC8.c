@@ -0,0 +1,68 @@
+#include "GroveCRC8.h"
+
+// The CRC is linear, so the remainder of any byte is the XOR of the remainders of its set bits.
+// Each table below is expanded at compile time from the remainders of the 8 single bit bytes.
+#define CRC8_COMBINE(x, b0, b1, b2, b3, b4, b5, b6, b7) \
+	(uint8_t)(((x) & 0x01 ? b0 : 0) ^ ((x) & 0x02 ? b1 : 0) ^ ((x) & 0x04 ? b2 : 0) ^ ((x) & 0x08 ? b3 : 0) ^ \
+			  ((x) & 0x10 ? b4 : 0) ^ ((x) & 0x20 ? b5 : 0) ^ ((x) & 0x40 ? b6 : 0) ^ ((x) & 0x80 ? b7 : 0))
+
+// Remainder of x followed by 0, 1, 2 and 3 zero bytes
+#define CRC8_SHIFT1(x)	CRC8_COMBINE(x, 0x31, 0x62, 0xc4, 0xb9, 0x43, 0x86, 0x3d, 0x7a)
+#define CRC8_SHIFT2(x)	CRC8_COMBINE(x, 0xf4, 0xd9, 0x83, 0x37, 0x6e, 0xdc, 0x89, 0x23)
+#define CRC8_SHIFT3(x)	CRC8_COMBINE(x, 0x46, 0x8c, 0x29, 0x52, 0xa4, 0x79, 0xf2, 0xd5)
+#define CRC8_SHIFT4(x)	CRC8_COMBINE(x, 0x9b, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0, 0xf1)
+
+#define CRC8_ROW(f, n) \
+	f(n + 0x0), f(n + 0x1), f(n + 0x2), f(n + 0x3), f(n + 0x4), f(n + 0x5), f(n + 0x6), f(n + 0x7), \
+	f(n + 0x8), f(n + 0x9), f(n + 0xa), f(n + 0xb), f(n + 0xc), f(n + 0xd), f(n + 0xe), f(n + 0xf)
+#define CRC8_TABLE(f) \
+	{ \
+		CRC8_ROW(f, 0x00), CRC8_ROW(f, 0x10), CRC8_ROW(f, 0x20), CRC8_ROW(f, 0x30), \
+		CRC8_ROW(f, 0x40), CRC8_ROW(f, 0x50), CRC8_ROW(f, 0x60), CRC8_ROW(f, 0x70), \
+		CRC8_ROW(f, 0x80), CRC8_ROW(f, 0x90), CRC8_ROW(f, 0xa0), CRC8_ROW(f, 0xb0), \
+		CRC8_ROW(f, 0xc0), CRC8_ROW(f, 0xd0), CRC8_ROW(f, 0xe0), CRC8_ROW(f, 0xf0) \
+	}
+
+// Slice by 4: crcTable[k] advances the CRC over a byte followed by k more
+static const uint8_t crcTable[4][256] =
+{
+	CRC8_TABLE(CRC8_SHIFT1),
+	CRC8_TABLE(CRC8_SHIFT2),
+	CRC8_TABLE(CRC8_SHIFT3),
+	CRC8_TABLE(CRC8_SHIFT4)
+};
+
+uint8_t GroveCRC8_Update(uint8_t crc, const uint8_t* data, int dataSize)
+{
+	while (dataSize >= 4)
+	{
+		crc = crcTable[3][crc ^ data[0]] ^ crcTable[2][data[1]] ^ crcTable[1][data[2]] ^ crcTable[0][data[3]];
+		data += 4;
+		dataSize -= 4;
+	}
+
+	while (dataSize-- > 0)
+	{
+		crc = crcTable[0][crc ^ *data++];
+	}
+
+	return crc;
+}
+
+uint8_t GroveCRC8_Calc(const uint8_t* data, int dataSize)
+{
+	return GroveCRC8_Update(GROVE_CRC8_INIT, data, dataSize);
+}
+
+bool GroveCRC8_CheckWords(const uint8_t* data, int wordCount)
+{
+	// Every word starts from the initial value, so its CRC is two independent lookups
+	uint8_t mismatch = 0;
+
+	for (int i = 0; i < wordCount; i++, data += 3)
+	{
+		mismatch |= crcTable[1][GROVE_CRC8_INIT ^ data[0]] ^ crcTable[0][data[1]] ^ data[2];
+	}
+
+	return mismatch == 0;
+}
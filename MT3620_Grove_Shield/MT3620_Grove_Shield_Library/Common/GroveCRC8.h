@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CRC-8 with polynomial 0x31 and initial value 0xff, used by Sensirion sensors
+#define GROVE_CRC8_INIT		(0xff)
+
+uint8_t GroveCRC8_Calc(const uint8_t* data, int dataSize);
+uint8_t GroveCRC8_Update(uint8_t crc, const uint8_t* data, int dataSize);
+
+// Checks a burst of wordCount words as Sensirion sensors return them, each 2 data bytes
+// followed by their CRC
+bool GroveCRC8_CheckWords(const uint8_t* data, int wordCount);
@@ -3,56 +3,154 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
 #include "GroveUART.h"
+#include "../Common/Delay.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // SC18IM700
 
-static void wait_for_i2cState_ok(int fd)
+// Stop and status read appended to every transaction on execute
+#define COMMAND_TAIL_SIZE	4
+
+static bool HasRoom(GroveI2CTransaction* tx, int size)
+{
+	if (tx->CommandSize + size + COMMAND_TAIL_SIZE > GROVE_I2C_TRANSACTION_COMMAND_SIZE)
+	{
+		tx->Overflow = true;
+		return false;
+	}
+	return true;
+}
+
+static GroveI2CStats i2cStats;
+
+static bool IsFinalI2cState(uint8_t i2cState)
+{
+	return i2cState == I2C_OK || i2cState == I2C_NACK_ON_ADDRESS || i2cState == I2C_NACK_ON_DATA || i2cState == I2C_TIME_OUT;
+}
+
+static GroveI2CResult ResultOfI2cState(uint8_t i2cState)
+{
+	switch (i2cState)
+	{
+	case I2C_OK:
+		return GroveI2CResult_Ok;
+	case I2C_NACK_ON_ADDRESS:
+		i2cStats.Nacks++;
+		return GroveI2CResult_NackOnAddress;
+	case I2C_NACK_ON_DATA:
+		i2cStats.Nacks++;
+		return GroveI2CResult_NackOnData;
+	default:
+		return GroveI2CResult_BusTimeout;
+	}
+}
+
+static GroveI2CResult UartFailure(void)
+{
+	if (errno != ETIMEDOUT) return GroveI2CResult_UartError;
+
+	i2cStats.Timeouts++;
+	return GroveI2CResult_NoResponse;
+}
+
+static GroveI2CResult SC18IM700_I2cPollState(int fd, GroveI2CPoll* poll)
 {
 	uint8_t i2cState;
-	SC18IM700_ReadReg(fd, 0x0A, &i2cState);
-	while (i2cState != I2C_OK)
+
+	i2cStats.Retries++;
+	if (!SC18IM700_ReadReg(fd, 0x0A, &i2cState)) return UartFailure();
+	if (IsFinalI2cState(i2cState)) return ResultOfI2cState(i2cState);
+
+	if (GetMonotonicMs() >= poll->Deadline)
 	{
-		SC18IM700_ReadReg(fd, 0x0A, &i2cState);
+		i2cStats.Timeouts++;
+		return GroveI2CResult_NoResponse;
 	}
+
+	poll->DelayUs = poll->DelayUs * 2 < GROVE_I2C_POLL_BACKOFF_MAX_US ? poll->DelayUs * 2 : GROVE_I2C_POLL_BACKOFF_MAX_US;
+	return GroveI2CResult_Busy;
 }
 
-static void SC18IM700_I2cWrite(int fd, uint8_t address, const uint8_t* data, int dataSize)
-{	
-	// Send
-	uint8_t send[3 + dataSize + 1];
+static GroveI2CResult SC18IM700_I2cExecuteAsync(int fd, GroveI2CTransaction* tx, GroveI2CPoll* poll)
+{
+	if (tx->Overflow) return GroveI2CResult_TooLarge;
+
+	// Queue a read of the I2C status behind the stop, the bridge answers it once the bus is idle
+	if (tx->Started) tx->Command[tx->CommandSize++] = 'P';
+	tx->Command[tx->CommandSize++] = 'R';
+	tx->Command[tx->CommandSize++] = 0x0A;
+	tx->Command[tx->CommandSize++] = 'P';
+
+	// Drop a late answer to an earlier transaction that timed out, it would be taken for this one's
+	GroveUART_Flush(fd);
+
+	i2cStats.Transactions++;
+	if (!GroveUART_Write(fd, tx->Command, tx->CommandSize, GROVE_I2C_RESPONSE_TIMEOUT_MS)) return UartFailure();
+
+	// Receive the data of every read and the status together
+	uint8_t recv[tx->ReadTotal + 1];
+	if (!GroveUART_Read(fd, recv, (int)sizeof(recv), GROVE_I2C_RESPONSE_TIMEOUT_MS))
+	{
+		if (errno != ETIMEDOUT) return GroveI2CResult_UartError;
+
+		// A read that was not acknowledged returns no data, ask the bridge why it went quiet
+		uint8_t i2cState;
+		GroveUART_Flush(fd);
+		if (SC18IM700_ReadReg(fd, 0x0A, &i2cState) && IsFinalI2cState(i2cState) && i2cState != I2C_OK) return ResultOfI2cState(i2cState);
 
-	send[0] = 'S';
-	send[1] = address & 0xfe;
-	send[2] = (uint8_t)dataSize;
-	memcpy(&send[3], data, (size_t)dataSize);
-	send[3 + dataSize] = 'P';
+		i2cStats.Timeouts++;
+		return GroveI2CResult_NoResponse;
+	}
 
-	GroveUART_Write(fd, send, (int)sizeof(send));
+	int offset = 0;
+	for (int i = 0; i < tx->ReadCount; i++)
+	{
+		memcpy(tx->ReadData[i], &recv[offset], (size_t)tx->ReadSize[i]);
+		offset += tx->ReadSize[i];
+	}
 
-	// wait for I2C state OK
-	wait_for_i2cState_ok(fd);
+	uint8_t i2cState = recv[tx->ReadTotal];
+	if (IsFinalI2cState(i2cState)) return ResultOfI2cState(i2cState);
+
+	// The bridge answered before the bus went idle, leave polling to the caller for at most
+	// GROVE_I2C_STATE_TIMEOUT_MS
+	poll->Deadline = GetMonotonicMs() + GROVE_I2C_STATE_TIMEOUT_MS;
+	poll->DelayUs = GROVE_I2C_POLL_BACKOFF_MIN_US;
+	return GroveI2CResult_Busy;
 }
 
-static bool SC18IM700_I2cRead(int fd, uint8_t address, uint8_t* data, int dataSize)
+static GroveI2CResult SC18IM700_I2cExecute(int fd, GroveI2CTransaction* tx)
 {
-	// Send
+	GroveI2CPoll poll;
+	GroveI2CResult result = SC18IM700_I2cExecuteAsync(fd, tx, &poll);
 
-	uint8_t send[4];
+	while (result == GroveI2CResult_Busy)
+	{
+		usleep(poll.DelayUs);
+		result = SC18IM700_I2cPollState(fd, &poll);
+	}
 
-	send[0] = 'S';
-	send[1] = address | 0x01;
-	send[2] = (uint8_t)dataSize;
-	send[3] = 'P';
+	return result;
+}
 
-	GroveUART_Write(fd, send, sizeof(send));
+static GroveI2CResult SC18IM700_I2cWrite(int fd, uint8_t address, const uint8_t* data, int dataSize)
+{
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	GroveI2C_AddWrite(&tx, address, data, dataSize);
 
-	// Receive
+	return SC18IM700_I2cExecute(fd, &tx);
+}
 
-	if (!GroveUART_Read(fd, data, dataSize)) return false;
+static GroveI2CResult SC18IM700_I2cRead(int fd, uint8_t address, uint8_t* data, int dataSize)
+{
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	GroveI2C_AddRead(&tx, address, data, dataSize);
 
-	return true;
+	return SC18IM700_I2cExecute(fd, &tx);
 }
 
 bool SC18IM700_ReadReg(int fd, uint8_t reg, uint8_t* data)
@@ -65,11 +163,11 @@ bool SC18IM700_ReadReg(int fd, uint8_t reg, uint8_t* data)
 	send[1] = reg;
 	send[2] = 'P';
 	
-	GroveUART_Write(fd, send, 3);
+	if (!GroveUART_Write(fd, send, 3, GROVE_I2C_RESPONSE_TIMEOUT_MS)) return false;
 
 	// Receive
 
-	if (!GroveUART_Read(fd, data, 1)) return false;
+	if (!GroveUART_Read(fd, data, 1, GROVE_I2C_RESPONSE_TIMEOUT_MS)) return false;
 
 	return true;
 }
@@ -84,7 +182,7 @@ void SC18IM700_WriteReg(int fd, uint8_t reg, uint8_t data)
 	send[2] = data;
 	send[3] = 'P';
 
-	GroveUART_Write(fd, send, (int)sizeof(send));
+	GroveUART_Write(fd, send, (int)sizeof(send), GROVE_I2C_RESPONSE_TIMEOUT_MS);
 }
 
 void SC18IM700_WriteRegBytes(int fd, uint8_t *data, uint8_t dataSize)
@@ -97,66 +195,139 @@ void SC18IM700_WriteRegBytes(int fd, uint8_t *data, uint8_t dataSize)
 	memcpy(&send[1], data, (uint8_t)dataSize);
 	send[dataSize+1] = 'P';
 
-	GroveUART_Write(fd, send, (uint8_t)(dataSize+2));
+	GroveUART_Write(fd, send, (uint8_t)(dataSize+2), GROVE_I2C_RESPONSE_TIMEOUT_MS);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // GroveI2C
 
-void(*GroveI2C_Write)(int fd, uint8_t address, const uint8_t* data, int dataSize) = SC18IM700_I2cWrite;
-bool(*GroveI2C_Read)(int fd, uint8_t address, uint8_t* data, int dataSize) = SC18IM700_I2cRead;
+GroveI2CResult(*GroveI2C_Write)(int fd, uint8_t address, const uint8_t* data, int dataSize) = SC18IM700_I2cWrite;
+GroveI2CResult(*GroveI2C_Read)(int fd, uint8_t address, uint8_t* data, int dataSize) = SC18IM700_I2cRead;
+GroveI2CResult(*GroveI2C_Execute)(int fd, GroveI2CTransaction* tx) = SC18IM700_I2cExecute;
+GroveI2CResult(*GroveI2C_ExecuteAsync)(int fd, GroveI2CTransaction* tx, GroveI2CPoll* poll) = SC18IM700_I2cExecuteAsync;
+GroveI2CResult(*GroveI2C_PollState)(int fd, GroveI2CPoll* poll) = SC18IM700_I2cPollState;
+
+int GroveI2C_PollDelayMs(const GroveI2CPoll* poll)
+{
+	return (int)((poll->DelayUs + 999) / 1000);
+}
+
+void GroveI2C_BeginTransaction(GroveI2CTransaction* tx)
+{
+	tx->CommandSize = 0;
+	tx->ReadCount = 0;
+	tx->ReadTotal = 0;
+	tx->Started = false;
+	tx->Overflow = false;
+}
 
-void GroveI2C_WriteReg8(int fd, uint8_t address, uint8_t reg, uint8_t val)
+void GroveI2C_AddWrite(GroveI2CTransaction* tx, uint8_t address, const uint8_t* data, int dataSize)
+{
+	if (dataSize > 255 || !HasRoom(tx, 3 + dataSize))
+	{
+		tx->Overflow = true;
+		return;
+	}
+
+	tx->Command[tx->CommandSize++] = 'S';
+	tx->Command[tx->CommandSize++] = address & 0xfe;
+	tx->Command[tx->CommandSize++] = (uint8_t)dataSize;
+	memcpy(&tx->Command[tx->CommandSize], data, (size_t)dataSize);
+	tx->CommandSize += dataSize;
+	tx->Started = true;
+}
+
+void GroveI2C_AddRead(GroveI2CTransaction* tx, uint8_t address, uint8_t* data, int dataSize)
+{
+	if (dataSize > 255 || tx->ReadCount == GROVE_I2C_TRANSACTION_MAX_READS || !HasRoom(tx, 3))
+	{
+		tx->Overflow = true;
+		return;
+	}
+
+	tx->Command[tx->CommandSize++] = 'S';
+	tx->Command[tx->CommandSize++] = address | 0x01;
+	tx->Command[tx->CommandSize++] = (uint8_t)dataSize;
+
+	tx->ReadData[tx->ReadCount] = data;
+	tx->ReadSize[tx->ReadCount] = dataSize;
+	tx->ReadCount++;
+	tx->ReadTotal += dataSize;
+	tx->Started = true;
+}
+
+void GroveI2C_AddStop(GroveI2CTransaction* tx)
+{
+	if (!tx->Started || !HasRoom(tx, 1)) return;
+
+	tx->Command[tx->CommandSize++] = 'P';
+	tx->Started = false;
+}
+
+static GroveI2CResult ReadRegBytes(int fd, uint8_t address, uint8_t reg, uint8_t* data, int dataSize)
+{
+	// Register write and read joined by a repeated start, one round trip
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	GroveI2C_AddWrite(&tx, address, &reg, 1);
+	GroveI2C_AddRead(&tx, address, data, dataSize);
+
+	return GroveI2C_Execute(fd, &tx);
+}
+
+GroveI2CResult GroveI2C_WriteReg8(int fd, uint8_t address, uint8_t reg, uint8_t val)
 {
 	uint8_t send[2];
 	send[0] = reg;
 	send[1] = val;
-	GroveI2C_Write(fd, address, send, sizeof(send));
+	return GroveI2C_Write(fd, address, send, sizeof(send));
 }
 
-void GroveI2C_WriteBytes(int fd, uint8_t address, uint8_t *data, uint8_t dataSize)
+GroveI2CResult GroveI2C_WriteBytes(int fd, uint8_t address, uint8_t *data, uint8_t dataSize)
 {
 	uint8_t send[dataSize];
 	memcpy(send, data, dataSize);
 
-	GroveI2C_Write(fd, address, send, (int)sizeof(send));
+	return GroveI2C_Write(fd, address, send, (int)sizeof(send));
 }
 
-bool GroveI2C_ReadReg8(int fd, uint8_t address, uint8_t reg, uint8_t* val)
+GroveI2CResult GroveI2C_ReadReg8(int fd, uint8_t address, uint8_t reg, uint8_t* val)
 {
-	GroveI2C_Write(fd, address, &reg, 1);
-
 	uint8_t recv[1];
-	if (!GroveI2C_Read(fd, address, recv, sizeof(recv))) return false;
+	GroveI2CResult result = ReadRegBytes(fd, address, reg, recv, sizeof(recv));
+	if (result != GroveI2CResult_Ok) return result;
 
 	*val = recv[0];
 
-	return true;
+	return GroveI2CResult_Ok;
 }
 
-bool GroveI2C_ReadReg16(int fd, uint8_t address, uint8_t reg, uint16_t* val)
+GroveI2CResult GroveI2C_ReadReg16(int fd, uint8_t address, uint8_t reg, uint16_t* val)
 {
-	GroveI2C_Write(fd, address, &reg, 1);
-
 	uint8_t recv[2];
-	if (!GroveI2C_Read(fd, address, recv, sizeof(recv))) return false;
+	GroveI2CResult result = ReadRegBytes(fd, address, reg, recv, sizeof(recv));
+	if (result != GroveI2CResult_Ok) return result;
 
 	*val = (uint16_t)(recv[1] << 8 | recv[0]);
 
-	return true;
+	return GroveI2CResult_Ok;
 }
 
-bool GroveI2C_ReadReg24BE(int fd, uint8_t address, uint8_t reg, uint32_t* val)
+GroveI2CResult GroveI2C_ReadReg24BE(int fd, uint8_t address, uint8_t reg, uint32_t* val)
 {
-	GroveI2C_Write(fd, address, &reg, 1);
-
 	uint8_t recv[3];
-	if (!GroveI2C_Read(fd, address, recv, sizeof(recv))) return false;
+	GroveI2CResult result = ReadRegBytes(fd, address, reg, recv, sizeof(recv));
+	if (result != GroveI2CResult_Ok) return result;
 
 	*val = (uint32_t)(recv[0] << 16 | recv[1] << 8 | recv[2]);
 
-	return true;
+	return GroveI2CResult_Ok;
+}
+
+const GroveI2CStats* GroveI2C_GetStats(void)
+{
+	return &i2cStats;
 }
 
 
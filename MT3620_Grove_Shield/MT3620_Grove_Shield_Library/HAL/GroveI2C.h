@@ -10,16 +10,98 @@
 #define I2C_NACK_ON_DATA			0xF2
 #define I2C_TIME_OUT					0xF8
 
+// How long the bridge has to answer a command stream
+#ifndef GROVE_I2C_RESPONSE_TIMEOUT_MS
+#define GROVE_I2C_RESPONSE_TIMEOUT_MS		100
+#endif
+// How long to keep polling the I2C status for the bus to go idle
+#ifndef GROVE_I2C_STATE_TIMEOUT_MS
+#define GROVE_I2C_STATE_TIMEOUT_MS			100
+#endif
+// Delay before the first status poll, doubled before each further poll up to the maximum
+#ifndef GROVE_I2C_POLL_BACKOFF_MIN_US
+#define GROVE_I2C_POLL_BACKOFF_MIN_US		200
+#endif
+#ifndef GROVE_I2C_POLL_BACKOFF_MAX_US
+#define GROVE_I2C_POLL_BACKOFF_MAX_US		10000
+#endif
+
+typedef enum
+{
+	GroveI2CResult_Ok,
+	GroveI2CResult_NackOnAddress,	// no device answered at the address
+	GroveI2CResult_NackOnData,		// the device refused a byte written to it
+	GroveI2CResult_BusTimeout,		// the bridge gave up on the bus, a device held SCL low
+	GroveI2CResult_NoResponse,		// the bridge did not answer before the deadline
+	GroveI2CResult_UartError,		// writing to or reading from the bridge failed
+	GroveI2CResult_TooLarge,		// the transaction does not fit in GroveI2CTransaction
+	GroveI2CResult_Busy				// from ExecuteAsync and PollState: the bus is not idle yet
+}
+GroveI2CResult;
+
+typedef struct
+{
+	uint32_t Transactions;	// command streams sent to the bridge
+	uint32_t Retries;		// status polls after a pipelined status that was not final
+	uint32_t Timeouts;		// bridge answers or idle buses not seen before the deadline
+	uint32_t Nacks;			// addresses or data not acknowledged
+}
+GroveI2CStats;
+
+// Room for the command stream and read results of one transaction
+#define GROVE_I2C_TRANSACTION_COMMAND_SIZE	64
+#define GROVE_I2C_TRANSACTION_MAX_READS		4
+
+// A sequence of I2C operations sent to the SC18IM700 as one command stream. Every write and
+// read begins with a start, a repeated start when no stop came before it. The bridge returns
+// the data of all reads followed by the final I2C status, collected in a single UART read.
+typedef struct
+{
+	uint8_t Command[GROVE_I2C_TRANSACTION_COMMAND_SIZE];
+	int CommandSize;
+	uint8_t* ReadData[GROVE_I2C_TRANSACTION_MAX_READS];
+	int ReadSize[GROVE_I2C_TRANSACTION_MAX_READS];
+	int ReadCount;
+	int ReadTotal;
+	bool Started;	// a start not yet followed by a stop
+	bool Overflow;
+}
+GroveI2CTransaction;
+
+// Progress of a transaction whose I2C status was not final when the bridge answered
+typedef struct
+{
+	int64_t Deadline;
+	long DelayUs;	// backoff before the next PollState
+}
+GroveI2CPoll;
+
 bool SC18IM700_ReadReg(int fd, uint8_t reg, uint8_t* data);
 void SC18IM700_WriteReg(int fd, uint8_t reg, uint8_t data);
 void SC18IM700_WriteRegBytes(int fd, uint8_t *data, uint8_t dataSize);
 
-void(*GroveI2C_Write)(int fd, uint8_t address, const uint8_t* data, int dataSize);
-bool(*GroveI2C_Read)(int fd, uint8_t address, uint8_t* data, int dataSize);
+extern GroveI2CResult(*GroveI2C_Write)(int fd, uint8_t address, const uint8_t* data, int dataSize);
+extern GroveI2CResult(*GroveI2C_Read)(int fd, uint8_t address, uint8_t* data, int dataSize);
+extern GroveI2CResult(*GroveI2C_Execute)(int fd, GroveI2CTransaction* tx);
+
+// Execute without sleeping: the read data is in place once the bridge answers, but a status
+// that is not yet final returns GroveI2CResult_Busy instead of being polled. The caller then
+// calls PollState from its own timer, GroveI2C_PollDelayMs later, until it returns anything
+// else. Both still wait for the bridge's UART answer, at most GROVE_I2C_RESPONSE_TIMEOUT_MS.
+extern GroveI2CResult(*GroveI2C_ExecuteAsync)(int fd, GroveI2CTransaction* tx, GroveI2CPoll* poll);
+extern GroveI2CResult(*GroveI2C_PollState)(int fd, GroveI2CPoll* poll);
+int GroveI2C_PollDelayMs(const GroveI2CPoll* poll);
+
+void GroveI2C_BeginTransaction(GroveI2CTransaction* tx);
+void GroveI2C_AddWrite(GroveI2CTransaction* tx, uint8_t address, const uint8_t* data, int dataSize);
+void GroveI2C_AddRead(GroveI2CTransaction* tx, uint8_t address, uint8_t* data, int dataSize);
+void GroveI2C_AddStop(GroveI2CTransaction* tx);
+
+GroveI2CResult GroveI2C_WriteReg8(int fd, uint8_t address, uint8_t reg, uint8_t val);
+GroveI2CResult GroveI2C_WriteBytes(int fd, uint8_t address, uint8_t *data, uint8_t dataSize);
 
-void GroveI2C_WriteReg8(int fd, uint8_t address, uint8_t reg, uint8_t val);
-void GroveI2C_WriteBytes(int fd, uint8_t address, uint8_t *data, uint8_t dataSize);
+GroveI2CResult GroveI2C_ReadReg8(int fd, uint8_t address, uint8_t reg, uint8_t* val);
+GroveI2CResult GroveI2C_ReadReg16(int fd, uint8_t address, uint8_t reg, uint16_t* val);
+GroveI2CResult GroveI2C_ReadReg24BE(int fd, uint8_t address, uint8_t reg, uint32_t* val);
 
-bool GroveI2C_ReadReg8(int fd, uint8_t address, uint8_t reg, uint8_t* val);
-bool GroveI2C_ReadReg16(int fd, uint8_t address, uint8_t reg, uint16_t* val);
-bool GroveI2C_ReadReg24BE(int fd, uint8_t address, uint8_t reg, uint32_t* val);
+const GroveI2CStats* GroveI2C_GetStats(void);
@@ -2,6 +2,10 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "../Common/Delay.h"
 
 #include <applibs/uart.h>
 
@@ -11,23 +15,76 @@ int GroveUART_Open(UART_Id id, UART_BaudRate_Type baudRate)
 	UART_InitConfig(&uartConfig);
 	uartConfig.baudRate = baudRate;
 
-	return UART_Open(id, &uartConfig);
+	int fd = UART_Open(id, &uartConfig);
+
+	// Reads and writes wait in poll, so they can give up at a deadline
+	if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
 }
 
-void GroveUART_Write(int fd, const uint8_t* data, int dataSize)
-{	
-	write(fd, data, (size_t)dataSize);
+static bool WaitForFd(int fd, short events, int64_t deadline)
+{
+	int remainingMs = (int)(deadline - GetMonotonicMs());
+	if (remainingMs <= 0)
+	{
+		errno = ETIMEDOUT;
+		return false;
+	}
+
+	struct pollfd pollFd = { .fd = fd, .events = events };
+	int result = poll(&pollFd, 1, remainingMs);
+	if (result == 0)
+	{
+		errno = ETIMEDOUT;
+		return false;
+	}
+
+	return result > 0 || errno == EINTR;
 }
 
-bool GroveUART_Read(int fd, uint8_t* data, int dataSize)
+bool GroveUART_Write(int fd, const uint8_t* data, int dataSize, int timeoutMs)
 {
+	int64_t deadline = GetMonotonicMs() + timeoutMs;
+	int totalWriteSize = 0;
+	while (totalWriteSize < dataSize)
+	{
+		ssize_t writeSize = write(fd, &data[totalWriteSize], (size_t)(dataSize - totalWriteSize));
+		if (writeSize > 0)
+		{
+			totalWriteSize += (int)writeSize;
+			continue;
+		}
+		if (writeSize < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+		if (!WaitForFd(fd, POLLOUT, deadline)) return false;
+	}
+
+	return true;
+}
+
+bool GroveUART_Read(int fd, uint8_t* data, int dataSize, int timeoutMs)
+{
+	int64_t deadline = GetMonotonicMs() + timeoutMs;
 	int totalReadSize = 0;
-	do
+	while (totalReadSize < dataSize)
 	{
-		int readSize = read(fd, &data[totalReadSize], (size_t)(dataSize - totalReadSize));
-		if (readSize < 0) return false;
-		totalReadSize += readSize;
-	} while (totalReadSize < dataSize);
+		ssize_t readSize = read(fd, &data[totalReadSize], (size_t)(dataSize - totalReadSize));
+		if (readSize > 0)
+		{
+			totalReadSize += (int)readSize;
+			continue;
+		}
+		if (readSize < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return false;
+		if (!WaitForFd(fd, POLLIN, deadline)) return false;
+	}
 
 	return true;
 }
+
+void GroveUART_Flush(int fd)
+{
+	uint8_t discard[16];
+	while (read(fd, discard, sizeof(discard)) > 0)
+	{
+	}
+}
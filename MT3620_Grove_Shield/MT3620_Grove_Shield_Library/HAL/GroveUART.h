@@ -6,6 +6,10 @@
 #include <applibs/uart.h>
 
 
+// Opens the UART non-blocking. Reads and writes wait for at most timeoutMs and fail with
+// errno set to ETIMEDOUT when the deadline passes.
 int GroveUART_Open(UART_Id id, uint32_t baudRate);
-void GroveUART_Write(int fd, const uint8_t* data, int dataSize);
-bool GroveUART_Read(int fd, uint8_t* data, int dataSize);
+bool GroveUART_Write(int fd, const uint8_t* data, int dataSize, int timeoutMs);
+bool GroveUART_Read(int fd, uint8_t* data, int dataSize, int timeoutMs);
+// Discards any bytes already received
+void GroveUART_Flush(int fd);
@@ -2,7 +2,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#include <math.h>
 #include "../HAL/GroveI2C.h"
+#include "../Common/Delay.h"
 
 #include <applibs/gpio.h>
 
@@ -16,11 +18,24 @@
 
 #define REF_VOL  3300
 
+typedef enum
+{
+	ReadPhase_Idle,
+	ReadPhase_Configuring,	// waiting for the bus after the channel select
+	ReadPhase_Converting,	// CONVST held low, the result not yet requested
+	ReadPhase_Reading		// waiting for the bus after the result read
+}
+ReadPhase;
+
 typedef struct
 {
 	int I2cFd;
 	int ConvstFd;
 	int AlertFd;
+	ReadPhase Phase;
+	GroveI2CPoll Poll;
+	uint8_t ReadData[2];
+	float Value;
 }
 GroveAD7992Instance;
 
@@ -31,35 +46,113 @@ void* GroveAD7992_Open(int i2cFd)
 	this->I2cFd = i2cFd;
 	this->ConvstFd = GPIO_OpenAsOutput(CONVST_PIN, GPIO_OutputMode_PushPull, GPIO_Value_High);
 	this->AlertFd = GPIO_OpenAsInput(ALART_PIN);
+	this->Phase = ReadPhase_Idle;
+	this->Value = NAN;
 
 	return this;
 }
 
 float GroveAD7992_Read(void* inst, int channel)
+{
+	int waitMs = GroveAD7992_StartRead(inst, channel);
+	if (waitMs < 0) return NAN;
+
+	do
+	{
+		usleep(waitMs * 1000L);
+		waitMs = GroveAD7992_FinishRead(inst);
+	} while (waitMs > 0);
+
+	return GroveAD7992_GetValue(inst);
+}
+
+int GroveAD7992_StartRead(void* inst, int channel)
 {
 	GroveAD7992Instance* this = (GroveAD7992Instance*)inst;
 
-	// Select channel
-	GroveI2C_WriteReg8(this->I2cFd, AD7992_ADDRESS, AD7992_REG_CONFIGURATION, (channel == 0 ? 0x10 : 0x20) | 0x08);
+	this->Value = NAN;
 
-	// Start conversion
+	// Select channel
+	const uint8_t config[2] = { AD7992_REG_CONFIGURATION, (uint8_t)((channel == 0 ? 0x10 : 0x20) | 0x08) };
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	GroveI2C_AddWrite(&tx, AD7992_ADDRESS, config, sizeof(config));
+
+	GroveI2CResult result = GroveI2C_ExecuteAsync(this->I2cFd, &tx, &this->Poll);
+	if (result == GroveI2CResult_Busy)
+	{
+		this->Phase = ReadPhase_Configuring;
+		return GroveI2C_PollDelayMs(&this->Poll);
+	}
+	if (result != GroveI2CResult_Ok)
+	{
+		this->Phase = ReadPhase_Idle;
+		return -1;
+	}
+
+	// Start conversion. It takes 2 us, less than the bridge takes to receive the read command.
 	GPIO_SetValue(this->ConvstFd, GPIO_Value_Low);
+	this->Phase = ReadPhase_Converting;
+	return 0;
+}
 
-	// Wait for converted
-	const struct timespec t_convert = { 0, 2000 };
-	nanosleep(&t_convert, NULL);
-
-	// Read value
-	uint16_t val;
-	GroveI2C_ReadReg16(this->I2cFd, AD7992_ADDRESS, AD7992_REG_CONVERSION_RESULT, &val);
+int GroveAD7992_FinishRead(void* inst)
+{
+	GroveAD7992Instance* this = (GroveAD7992Instance*)inst;
+	GroveI2CResult result;
+
+	if (this->Phase == ReadPhase_Configuring)
+	{
+		result = GroveI2C_PollState(this->I2cFd, &this->Poll);
+		if (result == GroveI2CResult_Busy) return GroveI2C_PollDelayMs(&this->Poll);
+		if (result != GroveI2CResult_Ok)
+		{
+			this->Phase = ReadPhase_Idle;
+			return 0;
+		}
+
+		GPIO_SetValue(this->ConvstFd, GPIO_Value_Low);
+		this->Phase = ReadPhase_Converting;
+	}
+
+	if (this->Phase == ReadPhase_Converting)
+	{
+		static const uint8_t reg = AD7992_REG_CONVERSION_RESULT;
+		GroveI2CTransaction tx;
+		GroveI2C_BeginTransaction(&tx);
+		GroveI2C_AddWrite(&tx, AD7992_ADDRESS, &reg, 1);
+		GroveI2C_AddRead(&tx, AD7992_ADDRESS, this->ReadData, sizeof(this->ReadData));
+		result = GroveI2C_ExecuteAsync(this->I2cFd, &tx, &this->Poll);
+		this->Phase = ReadPhase_Reading;
+	}
+	else if (this->Phase == ReadPhase_Reading)
+	{
+		result = GroveI2C_PollState(this->I2cFd, &this->Poll);
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (result == GroveI2CResult_Busy) return GroveI2C_PollDelayMs(&this->Poll);
 
 	// Stop conversion
 	GPIO_SetValue(this->ConvstFd, GPIO_Value_High);
+	this->Phase = ReadPhase_Idle;
+
+	if (result != GroveI2CResult_Ok) return 0;
 
-	val = (uint16_t)((val & 0x00ff) << 8 | (val & 0xff00) >> 8);
-	val &= 0x0fff;
+	// The result is big endian, 12 bits
+	uint16_t val = (uint16_t)((this->ReadData[0] << 8 | this->ReadData[1]) & 0x0fff);
+	this->Value = (float)val / 0x0fff;
+	return 0;
+}
+
+float GroveAD7992_GetValue(void* inst)
+{
+	GroveAD7992Instance* this = (GroveAD7992Instance*)inst;
 
-	return (float)val / 0x0fff;
+	return this->Value;
 }
 
 float GroveAD7992_ConvertToMillisVolt(float value)
@@ -5,4 +5,9 @@
 
 void* GroveAD7992_Open(int i2cFd);
 float GroveAD7992_Read(void* inst, int channel);
+// Read without sleeping, as GroveTempHumiSHT31_StartRead and FinishRead. GetValue returns the
+// result, or NAN if the read failed.
+int GroveAD7992_StartRead(void* inst, int channel);
+int GroveAD7992_FinishRead(void* inst);
+float GroveAD7992_GetValue(void* inst);
 float GroveAD7992_ConvertToMillisVolt(float value);
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "../HAL/GroveI2C.h"
+#include "../Common/Delay.h"
 
 #define BME280_ADDRESS				(0x76 << 1)
 
@@ -17,6 +18,12 @@ typedef struct
 {
 	int I2cFd;
 	float Temperature;
+	uint16_t dig_T1;
+	int16_t dig_T2;
+	int16_t dig_T3;
+	bool Polling;		// FinishRead waits for the bus to go idle after its read
+	GroveI2CPoll Poll;
+	uint8_t ReadData[3];
 }
 GroveTempHumiBaroBME280Instance;
 
@@ -26,11 +33,17 @@ void* GroveTempHumiBaroBME280_Open(int i2cFd)
 
 	this->I2cFd = i2cFd;
 	this->Temperature = NAN;
+	this->Polling = false;
 
 	uint8_t val8;
-	if (!GroveI2C_ReadReg8(this->I2cFd, BME280_ADDRESS, BME280_REG_CHIPID, &val8)) return NULL;
+	if (GroveI2C_ReadReg8(this->I2cFd, BME280_ADDRESS, BME280_REG_CHIPID, &val8) != GroveI2CResult_Ok) return NULL;
 	if (val8 != 0x60) return NULL;
 
+	// The calibration is fixed at manufacture, so reads only fetch the measurement
+	if (GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T1, &this->dig_T1) != GroveI2CResult_Ok) return NULL;
+	if (GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T2, (uint16_t*)&this->dig_T2) != GroveI2CResult_Ok) return NULL;
+	if (GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T3, (uint16_t*)&this->dig_T3) != GroveI2CResult_Ok) return NULL;
+
 	GroveI2C_WriteReg8(this->I2cFd, BME280_ADDRESS, BME280_REG_CONTROLHUMID, 0x05);
 	GroveI2C_WriteReg8(this->I2cFd, BME280_ADDRESS, BME280_REG_CONTROL, 0xb7);
 
@@ -38,20 +51,54 @@ void* GroveTempHumiBaroBME280_Open(int i2cFd)
 }
 
 void GroveTempHumiBaroBME280_Read(void* inst)
+{
+	int waitMs = GroveTempHumiBaroBME280_StartRead(inst);
+	if (waitMs < 0) return;
+
+	do
+	{
+		usleep(waitMs * 1000L);
+		waitMs = GroveTempHumiBaroBME280_FinishRead(inst);
+	} while (waitMs > 0);
+}
+
+int GroveTempHumiBaroBME280_StartRead(void* inst)
 {
 	GroveTempHumiBaroBME280Instance* this = (GroveTempHumiBaroBME280Instance*)inst;
 
+	// In normal mode the sensor converts on its own, the latest result is read at once
 	this->Temperature = NAN;
+	this->Polling = false;
+	return 0;
+}
 
-	uint16_t dig_T1;
-	int16_t dig_T2;
-	int16_t dig_T3;
-	if (!GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T1, &dig_T1)) return;
-	if (!GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T2, (uint16_t*)&dig_T2)) return;
-	if (!GroveI2C_ReadReg16(this->I2cFd, BME280_ADDRESS, BME280_REG_DIG_T3, (uint16_t*)&dig_T3)) return;
-
-	int32_t adc_T;
-	if (!GroveI2C_ReadReg24BE(this->I2cFd, BME280_ADDRESS, BME280_REG_TEMPDATA, &adc_T)) return;
+int GroveTempHumiBaroBME280_FinishRead(void* inst)
+{
+	GroveTempHumiBaroBME280Instance* this = (GroveTempHumiBaroBME280Instance*)inst;
+	GroveI2CResult result;
+
+	if (this->Polling)
+	{
+		result = GroveI2C_PollState(this->I2cFd, &this->Poll);
+	}
+	else
+	{
+		static const uint8_t reg = BME280_REG_TEMPDATA;
+		GroveI2CTransaction tx;
+		GroveI2C_BeginTransaction(&tx);
+		GroveI2C_AddWrite(&tx, BME280_ADDRESS, &reg, 1);
+		GroveI2C_AddRead(&tx, BME280_ADDRESS, this->ReadData, sizeof(this->ReadData));
+		result = GroveI2C_ExecuteAsync(this->I2cFd, &tx, &this->Poll);
+	}
+
+	this->Polling = result == GroveI2CResult_Busy;
+	if (this->Polling) return GroveI2C_PollDelayMs(&this->Poll);
+	if (result != GroveI2CResult_Ok) return 0;
+
+	int32_t adc_T = (int32_t)(this->ReadData[0] << 16 | this->ReadData[1] << 8 | this->ReadData[2]);
+	uint16_t dig_T1 = this->dig_T1;
+	int16_t dig_T2 = this->dig_T2;
+	int16_t dig_T3 = this->dig_T3;
 
 	adc_T >>= 4;
 	int32_t var1 = (((adc_T >> 3) - ((int32_t)(dig_T1 << 1))) * ((int32_t)dig_T2)) >> 11;
@@ -59,6 +106,7 @@ void GroveTempHumiBaroBME280_Read(void* inst)
 
 	int32_t t_fine = var1 + var2;
 	this->Temperature = (float)((t_fine * 5 + 128) >> 8) / 100;
+	return 0;
 }
 
 float GroveTempHumiBaroBME280_GetTemperature(void* inst)
@@ -6,4 +6,8 @@
 #include "../applibs_versions.h"
 void* GroveTempHumiBaroBME280_Open(int i2cFd);
 void GroveTempHumiBaroBME280_Read(void* inst);
+// Read without sleeping, as GroveTempHumiSHT31_StartRead and FinishRead. The sensor runs in
+// normal mode, so StartRead always returns 0.
+int GroveTempHumiBaroBME280_StartRead(void* inst);
+int GroveTempHumiBaroBME280_FinishRead(void* inst);
 float GroveTempHumiBaroBME280_GetTemperature(void* inst);
@@ -5,49 +5,115 @@
 #include <math.h>
 #include "../HAL/GroveI2C.h"
 #include "../Common/Delay.h"
+#include "../Common/GroveCRC8.h"
 
 
 #define SHT31_ADDRESS		(0x44 << 1)
 
-#define POLYNOMIAL			(0x31)
-
 #define CMD_SOFT_RESET		(0x30a2)
 #define CMD_SINGLE_HIGH		(0x2400)
 #define CMD_HEATER_ENABLE	(0x306d)
 #define CMD_HEATER_DISABLE	(0x3066)
+#define CMD_FETCH_DATA		(0xe000)
+#define CMD_BREAK			(0x3093)
+
+// Periodic acquisition at high repeatability and its measurement period, indexed by
+// GroveTempHumiSHT31_PeriodicMode
+static const uint16_t CMD_PERIODIC[] = { 0x2032, 0x2130, 0x2236, 0x2334, 0x2737, 0x2b32 };
+static const int PERIODIC_PERIOD_MS[] = { 2000, 1000, 500, 250, 100, 250 };
+
+// A fetch that is not acknowledged means no new conversion, or that the sensor is gone: the two
+// NACK alike. The previous reading is kept until it is this many periods old.
+#define PERIODIC_STALE_PERIODS	(3)
+
+// Wait for a high repeatability single shot conversion, 15.5 ms at most
+#define SINGLE_HIGH_WAIT_MS	(20)
+
+// The transaction whose I2C status FinishRead is still polling
+typedef enum
+{
+	PendingStatus_None,
+	PendingStatus_Command,	// the single shot command
+	PendingStatus_Reading	// the result read
+}
+PendingStatus;
 
 typedef struct
 {
 	int I2cFd;
 	float Temperature;
 	float Humidity;
+	bool Periodic;
+	int PeriodMs;
+	int64_t LastReadingMs;	// periodic mode: when a fetch last returned a conversion
+	PendingStatus Pending;
+	GroveI2CPoll Poll;
+	uint8_t ReadData[6];
 }
 GroveTempHumiSHT31Instance;
 
 
-static void SendCommand(GroveTempHumiSHT31Instance* this, uint16_t cmd)
+static GroveI2CResult SendCommand(GroveTempHumiSHT31Instance* this, uint16_t cmd)
 {
 	uint8_t writeData[2];
 	writeData[0] = (uint8_t)(cmd >> 8);
 	writeData[1] = (uint8_t)(cmd & 0xff);
-	GroveI2C_Write(this->I2cFd, SHT31_ADDRESS, writeData, sizeof(writeData));
+	return GroveI2C_Write(this->I2cFd, SHT31_ADDRESS, writeData, sizeof(writeData));
 }
 
-static uint8_t CalcCRC8(const uint8_t* data, int dataSize)
+static void ConvertReading(GroveTempHumiSHT31Instance* this, const uint8_t* readData)
 {
-	uint8_t crc = 0xff;
-
-	for (int j = dataSize; j > 0; j--)
+	if (!GroveCRC8_CheckWords(readData, 2))
 	{
-		crc ^= *data++;
+		this->Temperature = NAN;
+		this->Humidity = NAN;
+		return;
+	}
 
-		for (int i = 8; i > 0; i--)
-		{
-			crc = (crc & 0x80) != 0 ? (uint8_t)(crc << 1 ^ POLYNOMIAL) : (uint8_t)(crc << 1);
-		}
+	uint16_t ST;
+	ST = readData[0];
+	ST = (uint16_t)(ST << 8);
+	ST = (uint16_t)(ST | readData[1]);
+
+	uint16_t SRH;
+	SRH = readData[3];
+	SRH = (uint16_t)(SRH << 8);
+	SRH = (uint16_t)(SRH | readData[4]);
+
+	this->Temperature = (float)ST * 175 / 0xffff - 45;
+	this->Humidity = (float)SRH * 100 / 0xffff;
+}
+
+// Sends the result read, in periodic mode behind the fetch command in the same command stream
+static GroveI2CResult BeginReading(GroveTempHumiSHT31Instance* this)
+{
+	static const uint8_t fetch[2] = { CMD_FETCH_DATA >> 8, CMD_FETCH_DATA & 0xff };
+
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	if (this->Periodic)
+	{
+		GroveI2C_AddWrite(&tx, SHT31_ADDRESS, fetch, sizeof(fetch));
+		GroveI2C_AddStop(&tx);
 	}
+	GroveI2C_AddRead(&tx, SHT31_ADDRESS, this->ReadData, sizeof(this->ReadData));
+
+	return GroveI2C_ExecuteAsync(this->I2cFd, &tx, &this->Poll);
+}
 
-	return crc;
+static void CompleteReading(GroveTempHumiSHT31Instance* this, GroveI2CResult result)
+{
+	if (result == GroveI2CResult_Ok)
+	{
+		ConvertReading(this, this->ReadData);
+		this->LastReadingMs = GetMonotonicMs();
+	}
+	else if (!this->Periodic || result != GroveI2CResult_NackOnAddress ||
+		GetMonotonicMs() - this->LastReadingMs > (int64_t)PERIODIC_STALE_PERIODS * this->PeriodMs)
+	{
+		this->Temperature = NAN;
+		this->Humidity = NAN;
+	}
 }
 
 void* GroveTempHumiSHT31_Open(int i2cFd)
@@ -57,7 +123,14 @@ void* GroveTempHumiSHT31_Open(int i2cFd)
 	this->I2cFd = i2cFd;
 	this->Temperature = NAN;
 	this->Humidity = NAN;
+	this->Periodic = false;
+	this->PeriodMs = 0;
+	this->LastReadingMs = 0;
+	this->Pending = PendingStatus_None;
 
+	// A sensor left in periodic mode ignores the reset until it is stopped
+	SendCommand(this, CMD_BREAK);
+	usleep(1000);
 	SendCommand(this, CMD_SOFT_RESET);
 	usleep(1000);
 
@@ -65,32 +138,95 @@ void* GroveTempHumiSHT31_Open(int i2cFd)
 }
 
 void GroveTempHumiSHT31_Read(void* inst)
+{
+	int waitMs = GroveTempHumiSHT31_StartRead(inst);
+	if (waitMs < 0) return;
+
+	do
+	{
+		usleep(waitMs * 1000L);
+		waitMs = GroveTempHumiSHT31_FinishRead(inst);
+	} while (waitMs > 0);
+}
+
+int GroveTempHumiSHT31_StartRead(void* inst)
 {
 	GroveTempHumiSHT31Instance* this = (GroveTempHumiSHT31Instance*)inst;
 
+	this->Pending = PendingStatus_None;
+	if (this->Periodic) return 0;
+
 	this->Temperature = NAN;
+	this->Humidity = NAN;
 
-	SendCommand(this, CMD_SINGLE_HIGH);
-	usleep(20000);
+	static const uint8_t command[2] = { CMD_SINGLE_HIGH >> 8, CMD_SINGLE_HIGH & 0xff };
+	GroveI2CTransaction tx;
+	GroveI2C_BeginTransaction(&tx);
+	GroveI2C_AddWrite(&tx, SHT31_ADDRESS, command, sizeof(command));
 
-	uint8_t readData[6];
-	if (!GroveI2C_Read(this->I2cFd, SHT31_ADDRESS, readData, sizeof(readData))) return;
+	// On a busy bus FinishRead polls for the command before reading, the conversion has begun
+	// by the time the bus is idle
+	GroveI2CResult result = GroveI2C_ExecuteAsync(this->I2cFd, &tx, &this->Poll);
+	if (result == GroveI2CResult_Busy) this->Pending = PendingStatus_Command;
+	else if (result != GroveI2CResult_Ok) return -1;
 
-	if (readData[2] != CalcCRC8(&readData[0], 2)) return;
-	if (readData[5] != CalcCRC8(&readData[3], 2)) return;
+	return SINGLE_HIGH_WAIT_MS;
+}
 
-	uint16_t ST;
-	ST = readData[0];
-	ST = (uint16_t)(ST << 8);
-	ST = (uint16_t)(ST | readData[1]);
+int GroveTempHumiSHT31_FinishRead(void* inst)
+{
+	GroveTempHumiSHT31Instance* this = (GroveTempHumiSHT31Instance*)inst;
 
-	uint16_t SRH;
-	SRH = readData[3];
-	SRH = (uint16_t)(SRH << 8);
-	SRH = (uint16_t)(SRH | readData[4]);
+	GroveI2CResult result;
 
-	this->Temperature = (float)ST * 175 / 0xffff - 45;
-	this->Humidity = (float)SRH * 100 / 0xffff;
+	if (this->Pending == PendingStatus_Command)
+	{
+		result = GroveI2C_PollState(this->I2cFd, &this->Poll);
+		if (result == GroveI2CResult_Busy) return GroveI2C_PollDelayMs(&this->Poll);
+
+		this->Pending = PendingStatus_None;
+		if (result != GroveI2CResult_Ok)
+		{
+			CompleteReading(this, result);
+			return 0;
+		}
+	}
+
+	result = this->Pending == PendingStatus_Reading ? GroveI2C_PollState(this->I2cFd, &this->Poll) : BeginReading(this);
+	if (result == GroveI2CResult_Busy)
+	{
+		this->Pending = PendingStatus_Reading;
+		return GroveI2C_PollDelayMs(&this->Poll);
+	}
+
+	this->Pending = PendingStatus_None;
+	CompleteReading(this, result);
+	return 0;
+}
+
+bool GroveTempHumiSHT31_StartPeriodic(void* inst, GroveTempHumiSHT31_PeriodicMode mode)
+{
+	GroveTempHumiSHT31Instance* this = (GroveTempHumiSHT31Instance*)inst;
+
+	if ((unsigned)mode >= sizeof(CMD_PERIODIC) / sizeof(CMD_PERIODIC[0])) return false;
+
+	// Changing rate takes a break first
+	if (this->Periodic) GroveTempHumiSHT31_StopPeriodic(inst);
+
+	this->Periodic = SendCommand(this, CMD_PERIODIC[mode]) == GroveI2CResult_Ok;
+	this->PeriodMs = PERIODIC_PERIOD_MS[mode];
+	this->LastReadingMs = GetMonotonicMs();
+
+	return this->Periodic;
+}
+
+void GroveTempHumiSHT31_StopPeriodic(void* inst)
+{
+	GroveTempHumiSHT31Instance* this = (GroveTempHumiSHT31Instance*)inst;
+
+	SendCommand(this, CMD_BREAK);
+	usleep(1000);
+	this->Periodic = false;
 }
 
 void GroveTempHumiSHT31_EnableHeater(void* inst)
@@ -3,8 +3,35 @@
 //WIKI_URL          http://wiki.seeedstudio.com/Grove-TempAndHumi_Sensor-SHT31/
 
 #pragma once
+#include <stdbool.h>
+
+// Measurements per second in periodic acquisition mode, at high repeatability. ART samples at
+// 4 mps with accelerated response time.
+typedef enum
+{
+	GroveTempHumiSHT31_Periodic_0_5Mps,
+	GroveTempHumiSHT31_Periodic_1Mps,
+	GroveTempHumiSHT31_Periodic_2Mps,
+	GroveTempHumiSHT31_Periodic_4Mps,
+	GroveTempHumiSHT31_Periodic_10Mps,
+	GroveTempHumiSHT31_Periodic_Art
+}
+GroveTempHumiSHT31_PeriodicMode;
+
 void* GroveTempHumiSHT31_Open(int i2cFd);
 void GroveTempHumiSHT31_Read(void* inst);
+// Read without sleeping, for a caller that waits on its own timer: StartRead begins a
+// conversion and returns the milliseconds to wait before FinishRead, or -1 if the sensor did not
+// accept the command. FinishRead returns 0 once the reading is complete, or the milliseconds to
+// wait before calling it again while the I2C bus is busy.
+int GroveTempHumiSHT31_StartRead(void* inst);
+int GroveTempHumiSHT31_FinishRead(void* inst);
+// In periodic mode the sensor converts on its own and a read fetches the latest result in one
+// short I2C transaction, without a wait. StartRead then returns 0, and a read that finds no new
+// conversion since the last one keeps the previous values, until they are three measurement
+// periods old. A sensor that stops answering then reads NAN.
+bool GroveTempHumiSHT31_StartPeriodic(void* inst, GroveTempHumiSHT31_PeriodicMode mode);
+void GroveTempHumiSHT31_StopPeriodic(void* inst);
 void GroveTempHumiSHT31_EnableHeater(void* inst);
 void GroveTempHumiSHT31_DisableHeater(void* inst);
 float GroveTempHumiSHT31_GetTemperature(void* inst);
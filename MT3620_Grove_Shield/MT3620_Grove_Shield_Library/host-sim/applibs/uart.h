@@ -0,0 +1,8 @@
+/* Host stand-in for the Azure Sphere applibs UART types, used by the host-sim build only. */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef int UART_Id;
+typedef uint32_t UART_BaudRate_Type;
@@ -0,0 +1,83 @@
+// Compares the bitwise CRC-8 with the table driven GroveCRC8: nanoseconds per byte over buffers
+// of several sizes, and per call for the two-word check of an SHT31 reading.
+//
+// Usage: crc8_bench [iterations]
+
+#include "../Common/GroveCRC8.h"
+#include "crc8_reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 200000
+
+// Keeps the compiler from dropping the loops being timed
+static volatile uint8_t sink;
+
+static uint64_t NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+	long iterations = argc > 1 ? strtol(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+	static const int sizes[] = { 2, 6, 16, 64, 256, 1024 };
+	static uint8_t data[1024];
+
+	if (iterations <= 0) return EXIT_FAILURE;
+
+	for (size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)rand();
+	}
+
+	printf("%8s %14s %14s\n", "bytes", "bitwise ns/B", "table ns/B");
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		int size = sizes[s];
+		long passes = iterations * 64 / size + 1;
+
+		uint64_t start = NowNs();
+		for (long i = 0; i < passes; i++)
+		{
+			sink = Crc8Reference(GROVE_CRC8_INIT, data, size);
+		}
+		uint64_t bitwiseNs = NowNs() - start;
+
+		start = NowNs();
+		for (long i = 0; i < passes; i++)
+		{
+			sink = GroveCRC8_Calc(data, size);
+		}
+		uint64_t tableNs = NowNs() - start;
+
+		printf("%8d %14.2f %14.2f\n", size, (double)bitwiseNs / passes / size, (double)tableNs / passes / size);
+	}
+
+	// An SHT31 reading: two words, each followed by its CRC
+	uint8_t reading[6] = { 0x66, 0x24, 0, 0x9a, 0x3b, 0 };
+	reading[2] = Crc8Reference(GROVE_CRC8_INIT, &reading[0], 2);
+	reading[5] = Crc8Reference(GROVE_CRC8_INIT, &reading[3], 2);
+
+	uint64_t start = NowNs();
+	for (long i = 0; i < iterations; i++)
+	{
+		reading[0] ^= (uint8_t)i & 0x80; // vary the input so the check is not hoisted
+		sink = Crc8Reference(GROVE_CRC8_INIT, &reading[0], 2) == reading[2] && Crc8Reference(GROVE_CRC8_INIT, &reading[3], 2) == reading[5];
+	}
+	uint64_t bitwiseNs = NowNs() - start;
+
+	start = NowNs();
+	for (long i = 0; i < iterations; i++)
+	{
+		reading[0] ^= (uint8_t)i & 0x80;
+		sink = GroveCRC8_CheckWords(reading, 2);
+	}
+	uint64_t tableNs = NowNs() - start;
+
+	printf("SHT31 reading check: bitwise %.1f ns, table %.1f ns\n", (double)bitwiseNs / iterations, (double)tableNs / iterations);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bit by bit CRC-8 with polynomial 0x31, as in the Sensirion datasheets, to check and time the
+// table driven GroveCRC8 against
+static inline uint8_t Crc8Reference(uint8_t crc, const uint8_t* data, int dataSize)
+{
+	for (int i = 0; i < dataSize; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1);
+		}
+	}
+	return crc;
+}
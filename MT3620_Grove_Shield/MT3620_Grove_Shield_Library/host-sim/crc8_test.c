@@ -0,0 +1,80 @@
+// Checks GroveCRC8 against the datasheet vector and a bitwise CRC over random buffers of every
+// length the slice by 4 loop and its tail handle, and that CheckWords catches a corrupted word.
+
+#include "../Common/GroveCRC8.h"
+#include "crc8_reference.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RANDOM_BUFFERS 100000
+#define MAX_BUFFER_SIZE 64
+
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static void CheckVectors(void)
+{
+	// SHT3x datasheet, section 4.12
+	static const uint8_t beef[] = { 0xbe, 0xef };
+	CHECK(GroveCRC8_Calc(beef, sizeof(beef)) == 0x92, "CRC of 0xBEEF is 0x%02x, not 0x92", GroveCRC8_Calc(beef, sizeof(beef)));
+	CHECK(GroveCRC8_Calc(beef, 0) == GROVE_CRC8_INIT, "CRC of nothing is not the initial value");
+
+	// Updating in pieces gives the same CRC as one call
+	static const uint8_t text[] = "123456789";
+	uint8_t whole = GroveCRC8_Calc(text, 9);
+	uint8_t pieces = GroveCRC8_Update(GroveCRC8_Update(GROVE_CRC8_INIT, text, 5), text + 5, 4);
+	CHECK(whole == pieces, "CRC in pieces 0x%02x, in one call 0x%02x", pieces, whole);
+	CHECK(whole == 0xf7, "CRC of \"123456789\" is 0x%02x, not 0xf7", whole);
+}
+
+static void CheckRandomBuffers(void)
+{
+	uint8_t data[MAX_BUFFER_SIZE];
+
+	srand(1);
+	for (int i = 0; i < RANDOM_BUFFERS; i++)
+	{
+		int size = rand() % (MAX_BUFFER_SIZE + 1);
+		for (int j = 0; j < size; j++)
+		{
+			data[j] = (uint8_t)rand();
+		}
+
+		uint8_t expected = Crc8Reference(GROVE_CRC8_INIT, data, size);
+		uint8_t actual = GroveCRC8_Calc(data, size);
+		if (actual != expected)
+		{
+			CHECK(false, "buffer %d of %d bytes: CRC 0x%02x, bitwise 0x%02x", i, size, actual, expected);
+			return;
+		}
+	}
+}
+
+static void CheckWords(void)
+{
+	// Two words as an SHT31 returns them, temperature then humidity
+	uint8_t reading[6] = { 0xbe, 0xef, 0x92, 0x61, 0x3c, 0 };
+	reading[5] = Crc8Reference(GROVE_CRC8_INIT, &reading[3], 2);
+	CHECK(GroveCRC8_CheckWords(reading, 2), "valid reading rejected");
+
+	for (int byte = 0; byte < (int)sizeof(reading); byte++)
+	{
+		for (int bit = 0; bit < 8; bit++)
+		{
+			reading[byte] ^= (uint8_t)(1 << bit);
+			CHECK(!GroveCRC8_CheckWords(reading, 2), "flipped bit %d of byte %d not caught", bit, byte);
+			reading[byte] ^= (uint8_t)(1 << bit);
+		}
+	}
+}
+
+int main(void)
+{
+	CheckVectors();
+	CheckRandomBuffers();
+	CheckWords();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+// Reads the SHT31 and BME280 drivers through the SC18IM700 emulator and checks the UART round
+// trips and writes each read takes, the cost the pipelined I2C transactions are meant to cut,
+// and that the non-blocking reads hand I2C status polls back to the caller instead of sleeping.
+
+#include "../Sensors/GroveTempHumiSHT31.h"
+#include "../Sensors/GroveTempHumiBaroBME280.h"
+#include "../HAL/GroveI2C.h"
+#include "../Common/Delay.h"
+#include "sc18im700_emulator.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define I2C_FD 3
+
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static bool Near(float value, float expected)
+{
+	return fabsf(value - expected) < 0.01f;
+}
+
+// Checks and prints the bridge traffic since the stats were last reset
+static void CheckTraffic(const char* name, uint32_t roundTrips, uint32_t writes)
+{
+	const SC18IM700EmulatorStats* stats = SC18IM700Emulator_GetStats();
+
+	printf("%-28s %3u round trips %3u writes %4u bytes out %4u bytes in\n", name, stats->RoundTrips, stats->UartWrites,
+		stats->BytesWritten, stats->BytesRead);
+	CHECK(stats->RoundTrips == roundTrips, "%s: %u round trips, expected %u", name, stats->RoundTrips, roundTrips);
+	CHECK(stats->UartWrites == writes, "%s: %u UART writes, expected %u", name, stats->UartWrites, writes);
+	SC18IM700Emulator_ResetStats();
+}
+
+static void CheckBme280(void)
+{
+	void* bme280 = GroveTempHumiBaroBME280_Open(I2C_FD);
+	CHECK(bme280 != NULL, "BME280 not found");
+	if (bme280 == NULL) return;
+	SC18IM700Emulator_ResetStats();
+
+	// The calibration is read on open, a reading is one register write and read in one stream
+	GroveTempHumiBaroBME280_Read(bme280);
+	CHECK(Near(GroveTempHumiBaroBME280_GetTemperature(bme280), SC18IM700_EMULATOR_BME280_TEMPERATURE),
+		"BME280 read %.2f C", GroveTempHumiBaroBME280_GetTemperature(bme280));
+	CheckTraffic("BME280 temperature", 1, 1);
+
+	// The blocking read still polls a busy bus itself
+	SC18IM700Emulator_SetBusyStatusReads(2);
+	GroveTempHumiBaroBME280_Read(bme280);
+	CHECK(Near(GroveTempHumiBaroBME280_GetTemperature(bme280), SC18IM700_EMULATOR_BME280_TEMPERATURE),
+		"BME280 read %.2f C on a busy bus", GroveTempHumiBaroBME280_GetTemperature(bme280));
+	CheckTraffic("BME280 temperature, busy", 3, 3);
+	free(bme280);
+}
+
+static void CheckSht31(void)
+{
+	void* sht31 = GroveTempHumiSHT31_Open(I2C_FD);
+	SC18IM700Emulator_ResetStats();
+
+	// The conversion wait sits between the command and the read
+	GroveTempHumiSHT31_StartRead(sht31);
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE) &&
+		Near(GroveTempHumiSHT31_GetHumidity(sht31), SC18IM700_EMULATOR_SHT31_HUMIDITY),
+		"SHT31 single shot read %.2f C %.2f %%RH", GroveTempHumiSHT31_GetTemperature(sht31), GroveTempHumiSHT31_GetHumidity(sht31));
+	CheckTraffic("SHT31 single shot", 2, 2);
+
+	// A busy bus: FinishRead returns the poll delay rather than waiting, once per busy status
+	uint32_t retries = GroveI2C_GetStats()->Retries;
+	GroveTempHumiSHT31_StartRead(sht31);
+	SC18IM700Emulator_SetBusyStatusReads(2);
+	int finishes = 1;
+	int waitMs;
+	while ((waitMs = GroveTempHumiSHT31_FinishRead(sht31)) > 0 && finishes < 10)
+	{
+		CHECK(waitMs == GroveI2C_PollDelayMs(&(GroveI2CPoll){ .DelayUs = GROVE_I2C_POLL_BACKOFF_MIN_US << (finishes - 1) }),
+			"SHT31 poll %d after %d ms", finishes, waitMs);
+		finishes++;
+	}
+	CHECK(finishes == 3, "SHT31 finished after %d calls on a busy bus, expected 3", finishes);
+	CHECK(GroveI2C_GetStats()->Retries - retries == 2, "%u status polls", GroveI2C_GetStats()->Retries - retries);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 read %.2f C on a busy bus", GroveTempHumiSHT31_GetTemperature(sht31));
+	CheckTraffic("SHT31 single shot, busy", 4, 4);
+
+	// The same when the command is still on the bus as the bridge answers
+	SC18IM700Emulator_SetBusyStatusReads(1);
+	CHECK(GroveTempHumiSHT31_StartRead(sht31) > 0, "SHT31 command on a busy bus not accepted");
+	CHECK(GroveTempHumiSHT31_FinishRead(sht31) == 0, "SHT31 read after a busy command not finished");
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 read %.2f C after a busy command", GroveTempHumiSHT31_GetTemperature(sht31));
+	CheckTraffic("SHT31 single shot, busy cmd", 3, 3);
+
+	// Periodic mode: the fetch and the read in one stream
+	CHECK(GroveTempHumiSHT31_StartPeriodic(sht31, GroveTempHumiSHT31_Periodic_1Mps), "SHT31 periodic mode not started");
+	SC18IM700Emulator_CompleteSht31Conversion();
+	SC18IM700Emulator_ResetStats();
+	CHECK(GroveTempHumiSHT31_StartRead(sht31) == 0, "SHT31 periodic read waits");
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 periodic read %.2f C", GroveTempHumiSHT31_GetTemperature(sht31));
+	CheckTraffic("SHT31 periodic fetch", 1, 1);
+
+	// No new conversion: the read header is not acknowledged and the bridge is asked why
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 reading dropped when there was no new conversion");
+	CheckTraffic("SHT31 periodic, no new data", 2, 2);
+
+	// An unplugged sensor NACKs the same way, its last reading is dropped once three periods old
+	CHECK(GroveTempHumiSHT31_StartPeriodic(sht31, GroveTempHumiSHT31_Periodic_10Mps), "SHT31 10 mps mode not started");
+	SC18IM700Emulator_CompleteSht31Conversion();
+	GroveTempHumiSHT31_FinishRead(sht31);
+	SC18IM700Emulator_SetSht31Present(false);
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 reading dropped within its first period");
+	usleep(350 * 1000L);
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(isnan(GroveTempHumiSHT31_GetTemperature(sht31)) && isnan(GroveTempHumiSHT31_GetHumidity(sht31)),
+		"unplugged SHT31 still reads %.2f C after three periods", GroveTempHumiSHT31_GetTemperature(sht31));
+
+	// Plugged back in, it reads again
+	SC18IM700Emulator_SetSht31Present(true);
+	CHECK(GroveTempHumiSHT31_StartPeriodic(sht31, GroveTempHumiSHT31_Periodic_10Mps), "SHT31 periodic mode not restarted");
+	SC18IM700Emulator_CompleteSht31Conversion();
+	GroveTempHumiSHT31_FinishRead(sht31);
+	CHECK(Near(GroveTempHumiSHT31_GetTemperature(sht31), SC18IM700_EMULATOR_SHT31_TEMPERATURE),
+		"SHT31 read %.2f C after it came back", GroveTempHumiSHT31_GetTemperature(sht31));
+
+	GroveTempHumiSHT31_StopPeriodic(sht31);
+	free(sht31);
+}
+
+int main(void)
+{
+	SC18IM700Emulator_Reset();
+	CheckBme280();
+	CheckSht31();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
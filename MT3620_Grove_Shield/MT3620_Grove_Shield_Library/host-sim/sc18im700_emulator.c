@@ -0,0 +1,321 @@
+#include "sc18im700_emulator.h"
+#include "../HAL/GroveI2C.h"
+#include "../HAL/GroveUART.h"
+#include <errno.h>
+#include <string.h>
+
+#define SHT31_ADDRESS		0x44
+#define BME280_ADDRESS		0x76
+#define BRIDGE_REG_I2CSTAT	0x0A
+#define I2C_BUSY			0x00	// any status that is not final
+
+////////////////////////////////////////////////////////////////////////////////
+// SHT31
+
+// Raw words for 25 C and 50 %RH, each followed by its CRC
+static const uint8_t sht31Reading[6] = { 0x66, 0x66, 0x93, 0x80, 0x00, 0xa2 };
+
+static struct
+{
+	bool Present;
+	bool Periodic;
+	bool ConversionReady;	// a conversion not yet read
+	bool Fetched;			// periodic mode: a fetch found a conversion for the next read
+}
+sht31;
+
+static bool Sht31Write(const uint8_t* data, int dataSize)
+{
+	if (!sht31.Present) return false;
+	if (dataSize != 2) return true;
+
+	uint16_t command = (uint16_t)(data[0] << 8 | data[1]);
+	switch (command)
+	{
+	case 0x2400:	// single shot, high repeatability
+		if (!sht31.Periodic) sht31.ConversionReady = true;
+		break;
+	case 0x2032: case 0x2130: case 0x2236: case 0x2334: case 0x2737: case 0x2b32:
+		sht31.Periodic = true;
+		sht31.ConversionReady = false;
+		break;
+	case 0x3093:	// break
+		sht31.Periodic = false;
+		sht31.ConversionReady = false;
+		break;
+	case 0xe000:	// fetch
+		sht31.Fetched = sht31.Periodic && sht31.ConversionReady;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static bool Sht31Read(uint8_t* data, int dataSize)
+{
+	// With no conversion to return the read header is not acknowledged
+	bool ready = sht31.Periodic ? sht31.Fetched : sht31.ConversionReady;
+	if (!sht31.Present || !ready) return false;
+
+	for (int i = 0; i < dataSize; i++)
+	{
+		data[i] = i < (int)sizeof(sht31Reading) ? sht31Reading[i] : 0xff;
+	}
+	sht31.ConversionReady = false;
+	sht31.Fetched = false;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BME280
+
+static struct
+{
+	uint8_t Regs[256];
+	uint8_t Pointer;
+}
+bme280;
+
+static void Bme280Reset(void)
+{
+	// Calibration and reading of the datasheet's compensation example, 25.08 C
+	static const uint8_t calibration[6] = { 0x70, 0x6b, 0x43, 0x67, 0x18, 0xfc };
+	static const uint8_t temperature[3] = { 0x7e, 0xed, 0x00 };
+
+	memset(&bme280, 0, sizeof(bme280));
+	memcpy(&bme280.Regs[0x88], calibration, sizeof(calibration));
+	memcpy(&bme280.Regs[0xfa], temperature, sizeof(temperature));
+	bme280.Regs[0xd0] = 0x60;
+}
+
+static bool Bme280Write(const uint8_t* data, int dataSize)
+{
+	// The first byte sets the register pointer, any more are written from there
+	if (dataSize > 0) bme280.Pointer = data[0];
+	for (int i = 1; i < dataSize; i++)
+	{
+		bme280.Regs[bme280.Pointer++] = data[i];
+	}
+	return true;
+}
+
+static bool Bme280Read(uint8_t* data, int dataSize)
+{
+	for (int i = 0; i < dataSize; i++)
+	{
+		data[i] = bme280.Regs[bme280.Pointer++];
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SC18IM700
+
+static struct
+{
+	uint8_t Regs[BRIDGE_REG_I2CSTAT + 1];
+	bool Aborted;	// a transfer not acknowledged, the bridge skips to its stop
+	uint8_t Rx[512];
+	int RxHead;
+	int RxTail;
+	bool Answering;	// written to since the last read
+	int BusyStatusReads;
+}
+bridge;
+
+static SC18IM700EmulatorStats stats;
+
+static void Answer(const uint8_t* data, int dataSize)
+{
+	if (bridge.RxTail + dataSize > (int)sizeof(bridge.Rx)) return;
+
+	memcpy(&bridge.Rx[bridge.RxTail], data, (size_t)dataSize);
+	bridge.RxTail += dataSize;
+}
+
+static bool DeviceWrite(uint8_t address, const uint8_t* data, int dataSize)
+{
+	switch (address)
+	{
+	case SHT31_ADDRESS:
+		return Sht31Write(data, dataSize);
+	case BME280_ADDRESS:
+		return Bme280Write(data, dataSize);
+	default:
+		return false;
+	}
+}
+
+static bool DeviceRead(uint8_t address, uint8_t* data, int dataSize)
+{
+	switch (address)
+	{
+	case SHT31_ADDRESS:
+		return Sht31Read(data, dataSize);
+	case BME280_ADDRESS:
+		return Bme280Read(data, dataSize);
+	default:
+		return false;
+	}
+}
+
+// One I2C start: address, length and for a write the data
+static int ExecuteStart(const uint8_t* command, int commandSize)
+{
+	if (commandSize < 2) return commandSize;
+
+	uint8_t address = command[0];
+	int length = command[1];
+	bool read = (address & 0x01) != 0;
+	int used = 2 + (read ? 0 : length);
+	if (used > commandSize) return commandSize;
+	if (bridge.Aborted) return used;
+
+	bool acknowledged;
+	if (read)
+	{
+		uint8_t data[256];
+		acknowledged = DeviceRead(address >> 1, data, length);
+		if (acknowledged) Answer(data, length);
+	}
+	else
+	{
+		acknowledged = DeviceWrite(address >> 1, &command[2], length);
+	}
+
+	bridge.Regs[BRIDGE_REG_I2CSTAT] = acknowledged ? I2C_OK : I2C_NACK_ON_ADDRESS;
+	bridge.Aborted = !acknowledged;
+	return used;
+}
+
+static void ExecuteCommands(const uint8_t* command, int commandSize)
+{
+	int i = 0;
+	while (i < commandSize)
+	{
+		switch (command[i++])
+		{
+		case 'S':
+			i += ExecuteStart(&command[i], commandSize - i);
+			break;
+		case 'P':
+			bridge.Aborted = false;
+			break;
+		case 'R':
+			while (i < commandSize && command[i] != 'P')
+			{
+				uint8_t reg = command[i++];
+				uint8_t value = reg < sizeof(bridge.Regs) ? bridge.Regs[reg] : 0;
+				if (reg == BRIDGE_REG_I2CSTAT && bridge.BusyStatusReads > 0)
+				{
+					bridge.BusyStatusReads--;
+					value = I2C_BUSY;
+				}
+				Answer(&value, 1);
+			}
+			break;
+		case 'W':
+			while (i + 1 < commandSize && command[i] != 'P')
+			{
+				if (command[i] < sizeof(bridge.Regs)) bridge.Regs[command[i]] = command[i + 1];
+				i += 2;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void SC18IM700Emulator_Reset(void)
+{
+	memset(&bridge, 0, sizeof(bridge));
+	bridge.Regs[0x00] = 0xf0;	// 9600 baud
+	bridge.Regs[0x01] = 0x02;
+	bridge.Regs[BRIDGE_REG_I2CSTAT] = I2C_OK;
+
+	memset(&sht31, 0, sizeof(sht31));
+	sht31.Present = true;
+	Bme280Reset();
+
+	SC18IM700Emulator_ResetStats();
+}
+
+void SC18IM700Emulator_ResetStats(void)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+const SC18IM700EmulatorStats* SC18IM700Emulator_GetStats(void)
+{
+	return &stats;
+}
+
+void SC18IM700Emulator_SetSht31Present(bool present)
+{
+	sht31.Present = present;
+}
+
+void SC18IM700Emulator_SetBusyStatusReads(int reads)
+{
+	bridge.BusyStatusReads = reads;
+}
+
+void SC18IM700Emulator_CompleteSht31Conversion(void)
+{
+	if (sht31.Periodic) sht31.ConversionReady = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GroveUART
+
+int GroveUART_Open(UART_Id id, uint32_t baudRate)
+{
+	(void)id;
+	(void)baudRate;
+	return 3;
+}
+
+bool GroveUART_Write(int fd, const uint8_t* data, int dataSize, int timeoutMs)
+{
+	(void)fd;
+	(void)timeoutMs;
+
+	stats.UartWrites++;
+	stats.BytesWritten += (uint32_t)dataSize;
+	bridge.Answering = true;
+	ExecuteCommands(data, dataSize);
+	return true;
+}
+
+bool GroveUART_Read(int fd, uint8_t* data, int dataSize, int timeoutMs)
+{
+	(void)fd;
+	(void)timeoutMs;
+
+	stats.UartReads++;
+	if (bridge.Answering) stats.RoundTrips++;
+	bridge.Answering = false;
+
+	int available = bridge.RxTail - bridge.RxHead;
+	int size = available < dataSize ? available : dataSize;
+	memcpy(data, &bridge.Rx[bridge.RxHead], (size_t)size);
+	bridge.RxHead += size;
+	stats.BytesRead += (uint32_t)size;
+	if (bridge.RxHead == bridge.RxTail) bridge.RxHead = bridge.RxTail = 0;
+
+	if (size < dataSize)
+	{
+		stats.Timeouts++;
+		errno = ETIMEDOUT;
+		return false;
+	}
+	return true;
+}
+
+void GroveUART_Flush(int fd)
+{
+	(void)fd;
+	bridge.RxHead = bridge.RxTail = 0;
+}
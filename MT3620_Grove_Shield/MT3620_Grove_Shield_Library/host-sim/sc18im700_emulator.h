@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host emulation of the SC18IM700 UART to I2C bridge, with an SHT31 and a BME280 on its bus.
+// It replaces HAL/GroveUART.c: every GroveUART_Write is decoded as bridge commands at once,
+// and the answers are queued for GroveUART_Read. A write must hold whole commands, as the
+// library always sends them.
+
+typedef struct
+{
+	uint32_t UartWrites;
+	uint32_t UartReads;
+	uint32_t RoundTrips;	// reads that wait on the bridge to answer writes since the previous read
+	uint32_t Timeouts;		// reads that found fewer bytes than asked for, a real UART would wait them out
+	uint32_t BytesWritten;
+	uint32_t BytesRead;
+}
+SC18IM700EmulatorStats;
+
+// Powers up the bridge and both sensors, and clears the stats
+void SC18IM700Emulator_Reset(void);
+void SC18IM700Emulator_ResetStats(void);
+const SC18IM700EmulatorStats* SC18IM700Emulator_GetStats(void);
+
+// An absent SHT31 does not acknowledge its address, as when it is unplugged
+void SC18IM700Emulator_SetSht31Present(bool present);
+// In periodic mode, makes a new conversion available to the next fetch
+void SC18IM700Emulator_CompleteSht31Conversion(void);
+// The next reads of the I2C status find the bus still busy, as when the bridge answers before
+// a slow transfer ends
+void SC18IM700Emulator_SetBusyStatusReads(int reads);
+
+// Raw values the sensors return: the SHT31 reads 25 C and 50 %RH, the BME280 25.08 C
+#define SC18IM700_EMULATOR_SHT31_TEMPERATURE	25.0f
+#define SC18IM700_EMULATOR_SHT31_HUMIDITY		50.0f
+#define SC18IM700_EMULATOR_BME280_TEMPERATURE	25.08f
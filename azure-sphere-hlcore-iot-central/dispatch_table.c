@@ -0,0 +1,80 @@
+#include "dispatch_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a
+static uint32_t HashName(const char* name, size_t length) {
+	uint32_t hash = 2166136261u;
+	while (length-- > 0) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int InitDispatchTable(DispatchTable* table, size_t capacity) {
+	size_t slotCount = 4;
+	while (slotCount < capacity * 2) {
+		slotCount <<= 1;
+	}
+
+	table->slots = calloc(slotCount, sizeof(DispatchEntry));
+	table->mask = slotCount - 1;
+	table->count = 0;
+
+	return table->slots == NULL ? -1 : 0;
+}
+
+bool AddDispatchEntry(DispatchTable* table, const char* name, void* target) {
+	if (table->slots == NULL || (table->count + 1) * 2 > table->mask + 1) {
+		return false;
+	}
+
+	uint32_t hash = HashName(name, strlen(name));
+	size_t index = hash & table->mask;
+
+	while (table->slots[index].name != NULL) {
+		if (table->slots[index].hash == hash && strcmp(table->slots[index].name, name) == 0) {
+			return false;
+		}
+		index = (index + 1) & table->mask;
+	}
+
+	table->slots[index].name = name;
+	table->slots[index].hash = hash;
+	table->slots[index].target = target;
+	table->count++;
+
+	return true;
+}
+
+void* FindDispatchEntry(const DispatchTable* table, const char* name) {
+	return name == NULL ? NULL : FindDispatchEntryN(table, name, strlen(name));
+}
+
+void* FindDispatchEntryN(const DispatchTable* table, const char* name, size_t length) {
+	if (table->slots == NULL || name == NULL) {
+		return NULL;
+	}
+
+	uint32_t hash = HashName(name, length);
+	size_t index = hash & table->mask;
+
+	// The table is never more than half full, so the probe always reaches an empty slot
+	while (table->slots[index].name != NULL) {
+		const char* slotName = table->slots[index].name;
+		if (table->slots[index].hash == hash && strncmp(slotName, name, length) == 0 && slotName[length] == 0) {
+			return table->slots[index].target;
+		}
+		index = (index + 1) & table->mask;
+	}
+
+	return NULL;
+}
+
+void FreeDispatchTable(DispatchTable* table) {
+	free(table->slots);
+	table->slots = NULL;
+	table->mask = 0;
+	table->count = 0;
+}
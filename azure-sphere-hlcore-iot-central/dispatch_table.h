@@ -0,0 +1,49 @@
+#ifndef dispatch_table_h
+#define dispatch_table_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	const char* name;
+	uint32_t hash;
+	void* target;
+} DispatchEntry;
+
+/// <summary>
+///     Maps names (twin properties, method names) to targets. Built once at init as an open
+///     addressed hash table at most half full, so a lookup costs one hash of the name and
+///     usually a single compare, however many names are registered.
+/// </summary>
+typedef struct {
+	DispatchEntry* slots;
+	size_t mask;
+	size_t count;
+} DispatchTable;
+
+/// <summary>
+///     Allocates a table for up to capacity names.
+/// </summary>
+/// <returns>0 on success, or -1 if out of memory</returns>
+int InitDispatchTable(DispatchTable* table, size_t capacity);
+
+/// <summary>
+///     Registers target under name. The name is not copied and must outlive the table.
+/// </summary>
+/// <returns>false if the table is full or name is already registered</returns>
+bool AddDispatchEntry(DispatchTable* table, const char* name, void* target);
+
+/// <summary>
+///     Returns the target registered under name, or NULL.
+/// </summary>
+void* FindDispatchEntry(const DispatchTable* table, const char* name);
+
+/// <summary>
+///     As FindDispatchEntry, for a name of length characters that need not be NUL terminated.
+/// </summary>
+void* FindDispatchEntryN(const DispatchTable* table, const char* name, size_t length);
+
+void FreeDispatchTable(DispatchTable* table);
+
+#endif
@@ -8,6 +8,10 @@
 #include <applibs/log.h>
 #include "epoll_timerfd_utilities.h"
 
+// Bumped whenever an fd may have left the epoll set, so that a batch being dispatched by
+// WaitForEventAndCallHandler can tell that its remaining events may be stale.
+static unsigned int epollRemovalGeneration = 0;
+
 int CreateEpollFd(void)
 {
     int epollFd = -1;
@@ -46,6 +50,7 @@ int RegisterEventHandlerToEpoll(int epollFd, int eventFd, EventData *persistentE
 int UnregisterEventHandlerFromEpoll(int epollFd, int eventFd)
 {
     int res = 0;
+    epollRemovalGeneration++;
     // Unregister the eventFd on the epoll instance referred by epollFd.
     if ((res = epoll_ctl(epollFd, EPOLL_CTL_DEL, eventFd, NULL)) == -1) {
         if (res == -1 && errno != EBADF) { // Ignore EBADF errors
@@ -121,8 +126,11 @@ int CreateTimerFdAndAddToEpoll(int epollFd, const struct timespec *period,
 
 int WaitForEventAndCallHandler(int epollFd)
 {
-    struct epoll_event event;
-    int numEventsOccurred = epoll_wait(epollFd, &event, 1, -1);
+    // Drain up to EPOLL_EVENT_BATCH_SIZE ready events per epoll_wait. The kernel hands back
+    // level-triggered fds that are still ready at the tail of its ready list, so a busy fd
+    // cannot starve the others across successive waits.
+    struct epoll_event events[EPOLL_EVENT_BATCH_SIZE];
+    int numEventsOccurred = epoll_wait(epollFd, events, EPOLL_EVENT_BATCH_SIZE, -1);
 
     if (numEventsOccurred == -1) {
         if (errno == EINTR) {
@@ -133,9 +141,16 @@ int WaitForEventAndCallHandler(int epollFd)
         return -1;
     }
 
-    if (numEventsOccurred == 1 && event.data.ptr != NULL) {
-        EventData *eventData = event.data.ptr;
-        eventData->eventHandler(eventData);
+    // A handler may close or unregister an fd whose event is later in this batch, and the fd
+    // number may even be reused before we get there. Stop dispatching once that happens; the
+    // remaining fds are level-triggered, so any that are still ready are reported again by the
+    // next epoll_wait.
+    unsigned int generation = epollRemovalGeneration;
+    for (int i = 0; i < numEventsOccurred && generation == epollRemovalGeneration; i++) {
+        EventData *eventData = events[i].data.ptr;
+        if (eventData != NULL && eventData->eventHandler != NULL) {
+            eventData->eventHandler(eventData);
+        }
     }
 
     return 0;
@@ -144,6 +159,7 @@ int WaitForEventAndCallHandler(int epollFd)
 void CloseFdAndPrintError(int fd, const char *fdName)
 {
     if (fd >= 0) {
+        epollRemovalGeneration++;
         int result = close(fd);
         if (result != 0) {
             Log_Debug("ERROR: Could not close fd %s: %s (%d).\n", fdName, strerror(errno), errno);
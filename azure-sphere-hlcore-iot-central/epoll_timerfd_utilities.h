@@ -6,6 +6,14 @@
 #include <sys/epoll.h>
 #include <unistd.h>
 
+/// <summary>
+///     Maximum number of ready events dispatched by a single call to
+///     <see cref="WaitForEventAndCallHandler" />. Define before including this header to override.
+/// </summary>
+#ifndef EPOLL_EVENT_BATCH_SIZE
+#define EPOLL_EVENT_BATCH_SIZE 16
+#endif
+
 /// Forward declaration of the data type passed to the handlers.
 struct EventData;
 
@@ -97,7 +105,11 @@ int CreateTimerFdAndAddToEpoll(int epollFd, const struct timespec *period,
                                EventData *persistentEventData, const uint32_t epollEventMask);
 
 /// <summary>
-///     Waits for an event on an epoll instance and triggers the handler.
+///     Waits for events on an epoll instance and triggers the handler of each ready event,
+///     dispatching up to EPOLL_EVENT_BATCH_SIZE events per wait. If a handler removes an fd
+///     with <see cref="UnregisterEventHandlerFromEpoll" /> or <see cref="CloseFdAndPrintError" />,
+///     the rest of the batch is left for the next wait. Handlers must use those functions,
+///     not close() directly, so that no handler runs with a stale EventData.
 /// </summary>
 /// <param name="epollFd">
 ///     Epoll file descriptor which was created with <see cref="CreateEpollFd" />.
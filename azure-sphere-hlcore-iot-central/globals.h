@@ -5,6 +5,7 @@
 #include <applibs/gpio.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "parson.h"
 
 #define SCOPEID_LENGTH 20
@@ -14,7 +15,7 @@
 #define OPEN_PERIPHERAL_SET(x) 	for (int i = 0; i < NELEMS(x); i++) {if (x[i]->peripheral.initialise != NULL) { x[i]->peripheral.initialise(&x[i]->peripheral);}}
 #define CLOSE_PERIPHERAL_SET(x) for (int i = 0; i < NELEMS(x); i++) { CloseFdAndPrintError(x[i]->peripheral.fd, x[i]->peripheral.name); }
 #define START_TIMER_SET(x) for (int i = 0; i < NELEMS(x); i++) { StartTimer(x[i]); }
-#define STOP_TIMER_SET(x) for (int i = 0; i < NELEMS(x); i++) { CloseFdAndPrintError(x[i]->fd, x[i]->name); }
+#define STOP_TIMER_SET(x) for (int i = 0; i < NELEMS(x); i++) { StopTimer(x[i]); }
 #define GPIO_ON(x) GPIO_SetValue(x.fd, x.invertPin ? GPIO_Value_Low : GPIO_Value_High)
 #define GPIO_OFF(x) GPIO_SetValue(x.fd, x.invertPin ? GPIO_Value_High : GPIO_Value_Low)
 
@@ -38,6 +39,11 @@ struct _deviceTwinPeripheral {
 	bool twinState;
 	const char* twinProperty;
 	void (*handler)(JSON_Object* json, struct _deviceTwinPeripheral* deviceTwinPeripheral);
+	// Reported state cache, owned by iot_hub.c
+	bool reportedState; // last value reported and not rejected by IoT Hub
+	bool reportedValid;
+	bool reportPending; // pendingState waits for the next DoWork
+	bool pendingState;
 } ;
 
 typedef struct _deviceTwinPeripheral DeviceTwinPeripheral;
@@ -52,11 +58,17 @@ typedef struct {
 	Peripheral peripheral;
 } ActuatorPeripheral;
 
-typedef struct {
+struct _timer {
 	EventData eventData;
 	struct timespec period;
-	int fd;
 	const char* name;
-} Timer;
+	// Timer wheel bookkeeping, owned by timer_wheel.c
+	uint64_t expiry;
+	int level;
+	struct _timer* next;
+	struct _timer** pprev;
+};
+
+typedef struct _timer Timer;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+/* Host stand-in for the Azure Sphere applibs GPIO types, used by the host-sim build only. */
+
+#pragma once
+
+typedef int GPIO_Id;
+
+typedef enum {
+	GPIO_Value_Low = 0,
+	GPIO_Value_High = 1
+} GPIO_Value;
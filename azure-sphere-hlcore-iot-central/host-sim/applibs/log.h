@@ -0,0 +1,15 @@
+/* Host stand-in for the Azure Sphere applibs logging API, used by the host-sim build only. */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static inline int Log_Debug(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int result = vfprintf(stderr, format, args);
+	va_end(args);
+	return result;
+}
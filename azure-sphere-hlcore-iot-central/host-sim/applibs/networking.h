@@ -0,0 +1,12 @@
+/* Host stand-in for the Azure Sphere applibs networking API, used by the host-sim build only.
+   The host network is always reported ready. */
+
+#pragma once
+
+#include <stdbool.h>
+
+static inline int Networking_IsNetworkingReady(bool* outIsNetworkingReady)
+{
+	*outIsNetworkingReady = true;
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Measures WaitForEventAndCallHandler with thousands of ready eventfd and timerfd sources:
+// epoll_wait calls and syscalls per dispatched event, and the latency from an event becoming
+// ready to its handler running. Built once with the default EPOLL_EVENT_BATCH_SIZE and once
+// with a batch of 1, the one event per wait loop it replaced.
+
+#include "../epoll_timerfd_utilities.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#define EVENT_SOURCES 2000
+#define TIMER_SOURCES 2000
+#define ROUNDS 20
+#define TIMER_DELAY_NS (1000 * 1000)
+
+typedef struct {
+	EventData eventData;
+	int64_t readyNs;
+} Source;
+
+typedef struct {
+	uint64_t events;
+	uint64_t waits;
+	uint64_t handlerSyscalls;
+	int64_t latencySumNs;
+	int64_t latencyMaxNs;
+	int64_t loopNs;
+} Totals;
+
+static Source sources[EVENT_SOURCES + TIMER_SOURCES];
+static Totals totals;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void Dispatched(Source* source) {
+	int64_t latencyNs = NowNs() - source->readyNs;
+	totals.events++;
+	totals.handlerSyscalls++;
+	totals.latencySumNs += latencyNs;
+	if (latencyNs > totals.latencyMaxNs) {
+		totals.latencyMaxNs = latencyNs;
+	}
+}
+
+static void EventFdEventHandler(EventData* eventData) {
+	uint64_t count;
+	if (read(eventData->fd, &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+		Dispatched((Source*)eventData);
+	}
+}
+
+static void TimerFdEventHandler(EventData* eventData) {
+	if (ConsumeTimerFdEvent(eventData->fd) == 0) {
+		Dispatched((Source*)eventData);
+	}
+}
+
+/// <summary>
+///     Runs the loop until count more events have been dispatched.
+/// </summary>
+static int Dispatch(int epollFd, uint64_t count) {
+	uint64_t target = totals.events + count;
+	int64_t startNs = NowNs();
+
+	while (totals.events < target) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			return -1;
+		}
+		totals.waits++;
+	}
+
+	totals.loopNs += NowNs() - startNs;
+	return 0;
+}
+
+static void Report(const char* name, const Totals* run) {
+	printf("%-8s %8llu events  %6.3f waits/event  %6.3f syscalls/event  %7.1f ns/event  latency mean %8.1f us  max %8.1f us\n",
+		name, (unsigned long long)run->events, (double)run->waits / (double)run->events,
+		(double)(run->waits + run->handlerSyscalls) / (double)run->events, (double)run->loopNs / (double)run->events,
+		(double)run->latencySumNs / (double)run->events / 1000.0, (double)run->latencyMaxNs / 1000.0);
+}
+
+int main(void) {
+	// Every source is an fd, make room for them
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < EVENT_SOURCES + TIMER_SOURCES + 16) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	int epollFd = CreateEpollFd();
+	if (epollFd < 0) {
+		return EXIT_FAILURE;
+	}
+
+	static const struct timespec disarmed = { 0, 0 };
+	for (int i = 0; i < EVENT_SOURCES + TIMER_SOURCES; i++) {
+		Source* source = &sources[i];
+		if (i < EVENT_SOURCES) {
+			source->eventData.eventHandler = &EventFdEventHandler;
+			source->eventData.fd = eventfd(0, EFD_NONBLOCK);
+			if (source->eventData.fd < 0 ||
+				RegisterEventHandlerToEpoll(epollFd, source->eventData.fd, &source->eventData, EPOLLIN) != 0) {
+				fprintf(stderr, "Could not create %d eventfds, raise the open file limit\n", EVENT_SOURCES);
+				return EXIT_FAILURE;
+			}
+		}
+		else {
+			source->eventData.eventHandler = &TimerFdEventHandler;
+			source->eventData.fd = CreateTimerFdAndAddToEpoll(epollFd, &disarmed, &source->eventData, EPOLLIN);
+			if (source->eventData.fd < 0) {
+				fprintf(stderr, "Could not create %d timerfds, raise the open file limit\n", TIMER_SOURCES);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	printf("EPOLL_EVENT_BATCH_SIZE %d, %d eventfds, %d timerfds, %d rounds\n", EPOLL_EVENT_BATCH_SIZE, EVENT_SOURCES,
+		TIMER_SOURCES, ROUNDS);
+
+	Totals eventRun = { 0 };
+	Totals timerRun = { 0 };
+	const struct timespec delay = { 0, TIMER_DELAY_NS };
+
+	for (int round = 0; round < ROUNDS; round++) {
+		// Every eventfd becomes ready at once, as after a burst of inter-core or socket traffic
+		memset(&totals, 0, sizeof(totals));
+		for (int i = 0; i < EVENT_SOURCES; i++) {
+			uint64_t one = 1;
+			sources[i].readyNs = NowNs();
+			if (write(sources[i].eventData.fd, &one, sizeof(one)) != (ssize_t)sizeof(one)) {
+				return EXIT_FAILURE;
+			}
+		}
+		if (Dispatch(epollFd, EVENT_SOURCES) != 0) {
+			return EXIT_FAILURE;
+		}
+		eventRun.events += totals.events;
+		eventRun.waits += totals.waits;
+		eventRun.handlerSyscalls += totals.handlerSyscalls;
+		eventRun.latencySumNs += totals.latencySumNs;
+		eventRun.loopNs += totals.loopNs;
+		if (totals.latencyMaxNs > eventRun.latencyMaxNs) {
+			eventRun.latencyMaxNs = totals.latencyMaxNs;
+		}
+
+		// Every timer expires within the same millisecond, as timers sharing a period do
+		memset(&totals, 0, sizeof(totals));
+		for (int i = EVENT_SOURCES; i < EVENT_SOURCES + TIMER_SOURCES; i++) {
+			sources[i].readyNs = NowNs() + TIMER_DELAY_NS;
+			SetTimerFdToSingleExpiry(sources[i].eventData.fd, &delay);
+		}
+		// The last timer is armed last, wait for it so every timer is already due
+		nanosleep(&delay, NULL);
+		if (Dispatch(epollFd, TIMER_SOURCES) != 0) {
+			return EXIT_FAILURE;
+		}
+		timerRun.events += totals.events;
+		timerRun.waits += totals.waits;
+		timerRun.handlerSyscalls += totals.handlerSyscalls;
+		timerRun.latencySumNs += totals.latencySumNs;
+		timerRun.loopNs += totals.loopNs;
+		if (totals.latencyMaxNs > timerRun.latencyMaxNs) {
+			timerRun.latencyMaxNs = totals.latencyMaxNs;
+		}
+	}
+
+	Report("eventfd", &eventRun);
+	Report("timerfd", &timerRun);
+
+	for (int i = 0; i < EVENT_SOURCES + TIMER_SOURCES; i++) {
+		CloseFdAndPrintError(sources[i].eventData.fd, "source");
+	}
+	CloseFdAndPrintError(epollFd, "Epoll");
+	return EXIT_SUCCESS;
+}
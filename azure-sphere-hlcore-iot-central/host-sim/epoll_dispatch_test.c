@@ -0,0 +1,107 @@
+// Checks that WaitForEventAndCallHandler stops dispatching a batch once a handler closes an fd:
+// two ready eventfds whose handlers each close the other must not both run, and a third ready
+// fd in the same batch is still dispatched by a later wait.
+
+#include "../epoll_timerfd_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+
+#define MAX_WAITS 16
+
+typedef struct {
+	EventData eventData;
+	bool closed;
+	uint32_t calls;
+} Source;
+
+static void CloseOtherEventHandler(EventData* eventData);
+static void ReadEventHandler(EventData* eventData);
+
+static Source pair[2] = {
+	{.eventData = {.eventHandler = &CloseOtherEventHandler, .fd = -1 } },
+	{.eventData = {.eventHandler = &CloseOtherEventHandler, .fd = -1 } }
+};
+static Source bystander = { .eventData = {.eventHandler = &ReadEventHandler, .fd = -1 } };
+static uint32_t staleCalls = 0;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static Source* SourceOf(EventData* eventData) {
+	// eventData is the first member of Source
+	return (Source*)eventData;
+}
+
+static bool Consume(Source* source) {
+	uint64_t count;
+	if (source->closed) {
+		staleCalls++;
+		return false;
+	}
+	source->calls++;
+	return read(source->eventData.fd, &count, sizeof(count)) == (ssize_t)sizeof(count);
+}
+
+/// <summary>
+///     Consumes this fd and closes the other of the pair, whose event may be later in the batch.
+///     A new eventfd is opened straight away so the closed fd number is likely reused.
+/// </summary>
+static void CloseOtherEventHandler(EventData* eventData) {
+	Source* self = SourceOf(eventData);
+	Source* other = self == &pair[0] ? &pair[1] : &pair[0];
+
+	if (!Consume(self) || other->closed) {
+		return;
+	}
+
+	CloseFdAndPrintError(other->eventData.fd, "pair");
+	other->closed = true;
+	other->eventData.fd = eventfd(0, EFD_NONBLOCK);
+}
+
+static void ReadEventHandler(EventData* eventData) {
+	Consume(SourceOf(eventData));
+}
+
+static int OpenReadySource(int epollFd, Source* source) {
+	source->eventData.fd = eventfd(1, EFD_NONBLOCK);
+	if (source->eventData.fd < 0) {
+		return -1;
+	}
+	return RegisterEventHandlerToEpoll(epollFd, source->eventData.fd, &source->eventData, EPOLLIN);
+}
+
+int main(void) {
+	int epollFd = CreateEpollFd();
+	if (epollFd < 0 || OpenReadySource(epollFd, &pair[0]) != 0 || OpenReadySource(epollFd, &pair[1]) != 0 ||
+		OpenReadySource(epollFd, &bystander) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	// All three are ready before the first wait, so they arrive in one batch
+	uint32_t waits = 0;
+	while (waits < MAX_WAITS && (bystander.calls == 0 || pair[0].calls + pair[1].calls == 0)) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			return EXIT_FAILURE;
+		}
+		waits++;
+	}
+
+	CHECK(staleCalls == 0, "%u handlers ran for an fd closed earlier in the batch", staleCalls);
+	CHECK(pair[0].calls + pair[1].calls == 1, "%u handlers of the pair ran, expected 1", pair[0].calls + pair[1].calls);
+	CHECK(bystander.calls == 1, "bystander handled %u times, a stopped batch must leave it for the next wait",
+		bystander.calls);
+	printf("%u waits, %u stale calls\n", waits, staleCalls);
+
+	for (int i = 0; i < 2; i++) {
+		CloseFdAndPrintError(pair[i].eventData.fd, "pair");
+	}
+	CloseFdAndPrintError(bystander.eventData.fd, "bystander");
+	CloseFdAndPrintError(epollFd, "Epoll");
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,416 @@
+// Drives iot_hub.c against a stub IoT Hub LL client and checks how DoWork is scheduled: the kick
+// after a send or a report, the fast rate while anything is in flight, doubling up to the cap when
+// idle, and that only confirmed sends and accepted reports count as delivered.
+
+#include "../iot_hub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PENDING 16
+#define MAX_DELIVERIES 16
+// A kicked DoWork runs on the next timer wheel tick, far sooner than the idle interval
+#define KICK_LIMIT_MS 100
+#define CONNECT_TIMEOUT_MS 5000
+
+typedef struct {
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK sendCallback; // set for a send
+	IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportCallback;   // set for a report
+	void* context;
+	bool answered; // result is passed to the callback by the next DoWork
+	int result;    // confirmation result of a send, HTTP status of a report
+} StubCompletion;
+
+struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG {
+	StubCompletion pending[MAX_PENDING];
+	size_t pendingCount;
+	uint32_t sends;
+	uint32_t reports;
+	uint32_t doWorkCalls;
+	int keepaliveSeconds;
+	bool refuseSends;
+	bool destroyed;
+};
+
+struct IOTHUB_MESSAGE_HANDLE_DATA_TAG {
+	size_t length;
+};
+
+typedef struct {
+	uint32_t id;
+	bool delivered;
+} Delivery;
+
+static struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG stubClient;
+static Delivery deliveries[MAX_DELIVERIES];
+static uint32_t deliveryCount = 0;
+static uint32_t idleMaxMs = 0;
+static int failedChecks = 0;
+
+static DeviceTwinPeripheral relay = { .twinProperty = "relay1" };
+static DeviceTwinPeripheral* deviceTwins[] = { &relay };
+
+static Timer doWorkTimer = {
+	.eventData = {.eventHandler = &AzureDoWorkTimerEventHandler },
+	.period = { 0, IOT_HUB_DOWORK_FAST_MS * 1000 * 1000 },
+	.name = "DoWork"
+};
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+#pragma region Stub LL client
+
+AZURE_SPHERE_PROV_RETURN_VALUE IoTHubDeviceClient_LL_CreateWithAzureSphereDeviceAuthProvisioning(const char* idScope,
+	unsigned int timeout, IOTHUB_DEVICE_CLIENT_LL_HANDLE* handle) {
+	AZURE_SPHERE_PROV_RETURN_VALUE result = { .result = AZURE_SPHERE_PROV_RESULT_OK };
+	*handle = &stubClient;
+	return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetOption(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, const char* optionName,
+	const void* value) {
+	if (strcmp(optionName, OPTION_KEEP_ALIVE) == 0) {
+		handle->keepaliveSeconds = *(const int*)value;
+	}
+	return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceTwinCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle,
+	IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK callback, void* context) {
+	return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceMethodCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle,
+	IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback, void* context) {
+	return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetConnectionStatusCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle,
+	IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK callback, void* context) {
+	return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_HANDLE message,
+	IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback, void* context) {
+	if (handle->refuseSends || handle->pendingCount == MAX_PENDING) {
+		return IOTHUB_CLIENT_ERROR;
+	}
+	handle->pending[handle->pendingCount++] = (StubCompletion){ .sendCallback = callback, .context = context };
+	handle->sends++;
+	return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle,
+	const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback, void* context) {
+	if (handle->pendingCount == MAX_PENDING) {
+		return IOTHUB_CLIENT_ERROR;
+	}
+	handle->pending[handle->pendingCount++] = (StubCompletion){ .reportCallback = callback, .context = context };
+	handle->reports++;
+	return IOTHUB_CLIENT_OK;
+}
+
+/// <summary>
+///     Passes the answered sends and reports to their callbacks, as the SDK does from DoWork.
+/// </summary>
+void IoTHubDeviceClient_LL_DoWork(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle) {
+	StubCompletion answered[MAX_PENDING];
+	size_t answeredCount = 0;
+	size_t kept = 0;
+
+	handle->doWorkCalls++;
+	for (size_t i = 0; i < handle->pendingCount; i++) {
+		if (handle->pending[i].answered) {
+			answered[answeredCount++] = handle->pending[i];
+		}
+		else {
+			handle->pending[kept++] = handle->pending[i];
+		}
+	}
+	handle->pendingCount = kept;
+
+	for (size_t i = 0; i < answeredCount; i++) {
+		if (answered[i].sendCallback != NULL) {
+			answered[i].sendCallback((IOTHUB_CLIENT_CONFIRMATION_RESULT)answered[i].result, answered[i].context);
+		}
+		else {
+			answered[i].reportCallback(answered[i].result, answered[i].context);
+		}
+	}
+}
+
+/// <summary>
+///     Abandons the sends still pending, as the SDK does. The test leaves no report pending.
+/// </summary>
+void IoTHubDeviceClient_LL_Destroy(IOTHUB_DEVICE_CLIENT_LL_HANDLE handle) {
+	CHECK(!handle->destroyed, "client destroyed twice");
+	handle->destroyed = true;
+	for (size_t i = 0; i < handle->pendingCount; i++) {
+		CHECK(handle->pending[i].sendCallback != NULL, "report pending when the client was destroyed");
+		if (handle->pending[i].sendCallback != NULL) {
+			handle->pending[i].sendCallback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, handle->pending[i].context);
+		}
+	}
+	handle->pendingCount = 0;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size) {
+	IOTHUB_MESSAGE_HANDLE message = malloc(sizeof(*message));
+	if (message != NULL) {
+		message->length = size;
+	}
+	return message;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE message, const char* contentType) {
+	return IOTHUB_MESSAGE_OK;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE message, const char* contentEncoding) {
+	return IOTHUB_MESSAGE_OK;
+}
+
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE message) {
+	free(message);
+}
+
+/// <summary>
+///     Answers the oldest unanswered send or report, for the next DoWork to pass on.
+/// </summary>
+static void Answer(int result) {
+	for (size_t i = 0; i < stubClient.pendingCount; i++) {
+		if (!stubClient.pending[i].answered) {
+			stubClient.pending[i].answered = true;
+			stubClient.pending[i].result = result;
+			return;
+		}
+	}
+	CHECK(false, "nothing pending to answer with %d", result);
+}
+
+#pragma endregion
+
+static uint32_t NowMs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static void Delivered(bool delivered, void* context) {
+	if (deliveryCount < MAX_DELIVERIES) {
+		deliveries[deliveryCount].id = (uint32_t)(uintptr_t)context;
+		deliveries[deliveryCount].delivered = delivered;
+	}
+	deliveryCount++;
+}
+
+static bool Send(uint32_t id) {
+	static const char message[] = "{\"Temperature\":21.5}";
+	return SendMsgBuffer((const unsigned char*)message, strlen(message), "application/json", "utf-8", Delivered,
+		(void*)(uintptr_t)id);
+}
+
+/// <summary>
+///     Runs DoWork as the timer would and returns the interval it chose, checking the timer
+///     was given the same.
+/// </summary>
+static uint32_t DoWork(void) {
+	AzureDoWorkTimerEventHandler(&doWorkTimer.eventData);
+	uint32_t intervalMs = GetIoTHubStats()->pollIntervalMs;
+	uint32_t timerMs = (uint32_t)(doWorkTimer.period.tv_sec * 1000 + doWorkTimer.period.tv_nsec / 1000000);
+	CHECK(timerMs == intervalMs, "timer period %u ms, interval %u ms", timerMs, intervalMs);
+	return intervalMs;
+}
+
+/// <summary>
+///     Runs DoWork with nothing in flight until the interval reaches the cap, checking each step
+///     doubles the last from no less than the fast rate.
+/// </summary>
+static void Idle(const char* what) {
+	for (uint32_t step = 0; step < 32 && GetIoTHubStats()->pollIntervalMs != idleMaxMs; step++) {
+		uint32_t previousMs = GetIoTHubStats()->pollIntervalMs;
+		uint32_t expectedMs = previousMs * 2 < IOT_HUB_DOWORK_FAST_MS ? IOT_HUB_DOWORK_FAST_MS : previousMs * 2;
+		if (expectedMs > idleMaxMs) {
+			expectedMs = idleMaxMs;
+		}
+		uint32_t intervalMs = DoWork();
+		CHECK(intervalMs == expectedMs, "%s: idle interval %u ms after %u ms, expected %u ms", what, intervalMs, previousMs,
+			expectedMs);
+	}
+	CHECK(GetIoTHubStats()->pollIntervalMs == idleMaxMs, "%s: idle interval %u ms never reached the cap of %u ms", what,
+		GetIoTHubStats()->pollIntervalMs, idleMaxMs);
+}
+
+/// <summary>
+///     Runs the event loop until the timer wheel next runs DoWork, and returns how long that took.
+/// </summary>
+static uint32_t RunUntilDoWork(int epollFd) {
+	uint32_t startMs = NowMs();
+	uint32_t calls = stubClient.doWorkCalls;
+	while (stubClient.doWorkCalls == calls && NowMs() - startMs < idleMaxMs * 2) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			break;
+		}
+	}
+	return NowMs() - startMs;
+}
+
+static bool Connect(int epollFd) {
+	uint32_t startMs = NowMs();
+	while (!ConnectIoTHub() && NowMs() - startMs < CONNECT_TIMEOUT_MS) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			return false;
+		}
+	}
+	return iothubAuthenticated;
+}
+
+static void CheckIdleBackoff(void) {
+	Idle("after connecting");
+
+	// Stays at the cap
+	for (uint32_t i = 0; i < 3; i++) {
+		CHECK(DoWork() == idleMaxMs, "idle interval left the cap");
+	}
+}
+
+static void CheckSendKick(int epollFd) {
+	CHECK(Send(1), "send refused");
+	CHECK(GetIoTHubStats()->pollIntervalMs == 0, "send did not kick DoWork, interval %u ms",
+		GetIoTHubStats()->pollIntervalMs);
+	CHECK(GetIoTHubStats()->messagesInFlight == 1, "%u in flight after one send", GetIoTHubStats()->messagesInFlight);
+
+	uint32_t elapsedMs = RunUntilDoWork(epollFd);
+	CHECK(elapsedMs < KICK_LIMIT_MS, "DoWork ran %u ms after the send, the idle interval was %u ms", elapsedMs, idleMaxMs);
+	CHECK(GetIoTHubStats()->pollIntervalMs == IOT_HUB_DOWORK_FAST_MS, "interval %u ms after the kick with a send in flight",
+		GetIoTHubStats()->pollIntervalMs);
+}
+
+static void CheckFastWhileInFlight(void) {
+	// However long the confirmation takes
+	for (uint32_t i = 0; i < 20; i++) {
+		CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS, "interval %u ms with a send in flight", GetIoTHubStats()->pollIntervalMs);
+	}
+	CHECK(deliveryCount == 0, "send settled before it was confirmed");
+
+	// The DoWork that delivers the confirmation stays fast, then the interval doubles
+	Answer(IOTHUB_CLIENT_CONFIRMATION_OK);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS, "interval %u ms after the confirmation", GetIoTHubStats()->pollIntervalMs);
+	CHECK(deliveryCount == 1 && deliveries[0].id == 1 && deliveries[0].delivered, "confirmed send not reported delivered");
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after the confirmation", GetIoTHubStats()->messagesInFlight);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS * 2, "interval %u ms once idle", GetIoTHubStats()->pollIntervalMs);
+	Idle("after a confirmed send");
+}
+
+static void CheckReportKick(int epollFd) {
+	TwinReportState("relay1", true);
+	CHECK(GetIoTHubStats()->pollIntervalMs == 0, "report did not kick DoWork, interval %u ms",
+		GetIoTHubStats()->pollIntervalMs);
+
+	uint32_t elapsedMs = RunUntilDoWork(epollFd);
+	CHECK(elapsedMs < KICK_LIMIT_MS, "DoWork ran %u ms after the report, the idle interval was %u ms", elapsedMs, idleMaxMs);
+	CHECK(stubClient.reports == 1, "%u reports sent by the kicked DoWork", stubClient.reports);
+	CHECK(GetIoTHubStats()->messagesInFlight == 1, "%u in flight after the report", GetIoTHubStats()->messagesInFlight);
+	CHECK(GetIoTHubStats()->pollIntervalMs == IOT_HUB_DOWORK_FAST_MS, "interval %u ms with a report in flight",
+		GetIoTHubStats()->pollIntervalMs);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS, "interval %u ms with a report in flight", GetIoTHubStats()->pollIntervalMs);
+
+	Answer(204);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS, "interval %u ms after the report was accepted", GetIoTHubStats()->pollIntervalMs);
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after the report", GetIoTHubStats()->messagesInFlight);
+	Idle("after an accepted report");
+
+	// A value already reported is not sent again, so there is nothing to kick for
+	TwinReportState("relay1", true);
+	CHECK(GetIoTHubStats()->pollIntervalMs == idleMaxMs, "repeated report kicked DoWork, interval %u ms",
+		GetIoTHubStats()->pollIntervalMs);
+}
+
+static void CheckOnlyConfirmedDelivered(int epollFd) {
+	IoTHubStats before = *GetIoTHubStats();
+	deliveryCount = 0;
+
+	for (uint32_t id = 1; id <= 4; id++) {
+		CHECK(Send(id), "send %u refused", id);
+	}
+	CHECK(GetIoTHubStats()->messagesInFlight == 4, "%u in flight after four sends", GetIoTHubStats()->messagesInFlight);
+	Answer(IOTHUB_CLIENT_CONFIRMATION_OK);
+	Answer(IOTHUB_CLIENT_CONFIRMATION_ERROR);
+	Answer(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS, "interval %u ms with a send in flight", GetIoTHubStats()->pollIntervalMs);
+
+	CHECK(deliveryCount == 3, "%u sends settled, expected 3", deliveryCount);
+	CHECK(deliveryCount < 1 || (deliveries[0].id == 1 && deliveries[0].delivered), "confirmed send not reported delivered");
+	CHECK(deliveryCount < 2 || (deliveries[1].id == 2 && !deliveries[1].delivered), "errored send reported delivered");
+	CHECK(deliveryCount < 3 || (deliveries[2].id == 3 && !deliveries[2].delivered), "timed out send reported delivered");
+	CHECK(GetIoTHubStats()->messagesConfirmed == before.messagesConfirmed + 1, "%u confirmed, expected %u",
+		GetIoTHubStats()->messagesConfirmed, before.messagesConfirmed + 1);
+	CHECK(GetIoTHubStats()->messagesFailed == before.messagesFailed + 2, "%u failed, expected %u",
+		GetIoTHubStats()->messagesFailed, before.messagesFailed + 2);
+	CHECK(GetIoTHubStats()->messagesInFlight == 1, "%u in flight, expected 1", GetIoTHubStats()->messagesInFlight);
+
+	// A failure settles the send but is not hub activity, so DoWork slows down straight away
+	Answer(IOTHUB_CLIENT_CONFIRMATION_ERROR);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS * 2, "interval %u ms after only a failure", GetIoTHubStats()->pollIntervalMs);
+	CHECK(deliveryCount == 4 && !deliveries[3].delivered, "failed send reported delivered");
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after the failure", GetIoTHubStats()->messagesInFlight);
+	Idle("after a failed send");
+
+	// Nor is a rejected report
+	TwinReportState("relay1", false);
+	RunUntilDoWork(epollFd);
+	CHECK(stubClient.reports == 2, "%u reports sent, expected 2", stubClient.reports);
+	Answer(400);
+	CHECK(DoWork() == IOT_HUB_DOWORK_FAST_MS * 2, "interval %u ms after only a rejected report",
+		GetIoTHubStats()->pollIntervalMs);
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after the rejection", GetIoTHubStats()->messagesInFlight);
+	Idle("after a rejected report");
+
+	// A send the client refuses is not in flight, does not kick DoWork and is never settled
+	stubClient.refuseSends = true;
+	CHECK(!Send(5), "refused send reported as sent");
+	stubClient.refuseSends = false;
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after a refused send", GetIoTHubStats()->messagesInFlight);
+	CHECK(GetIoTHubStats()->pollIntervalMs == idleMaxMs, "refused send kicked DoWork, interval %u ms",
+		GetIoTHubStats()->pollIntervalMs);
+	CHECK(DoWork() == idleMaxMs && deliveryCount == 4, "refused send settled");
+
+	// Sends abandoned when the client is destroyed are not deliveries either
+	CHECK(Send(6), "send refused");
+	IoTHubStats beforeClose = *GetIoTHubStats();
+	CloseAzureClient();
+	CHECK(deliveryCount == 5 && deliveries[4].id == 6 && !deliveries[4].delivered, "abandoned send reported delivered");
+	CHECK(GetIoTHubStats()->messagesConfirmed == beforeClose.messagesConfirmed, "abandoned send counted as confirmed");
+	CHECK(GetIoTHubStats()->messagesFailed == beforeClose.messagesFailed + 1, "abandoned send not counted as failed");
+	CHECK(GetIoTHubStats()->messagesInFlight == 0, "%u in flight after the client was destroyed",
+		GetIoTHubStats()->messagesInFlight);
+}
+
+int main(void) {
+	int epollFd = CreateEpollFd();
+	if (epollFd < 0 || InitTimerWheel(epollFd, NULL) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	InitDeviceTwins(deviceTwins, NELEMS(deviceTwins));
+	if (InitAzureClient(epollFd, &doWorkTimer) != 0 || !Connect(epollFd)) {
+		fprintf(stderr, "FAIL: stub client not connected\n");
+		return EXIT_FAILURE;
+	}
+	// The idle cap is half the keepalive the client was given
+	idleMaxMs = (uint32_t)stubClient.keepaliveSeconds * 1000 / 2;
+	CHECK(idleMaxMs > IOT_HUB_DOWORK_FAST_MS * 4, "keepalive of %d s leaves no room to back off", stubClient.keepaliveSeconds);
+
+	CheckIdleBackoff();
+	CheckSendKick(epollFd);
+	CheckFastWhileInFlight();
+	CheckReportKick(epollFd);
+	CheckOnlyConfirmedDelivered(epollFd);
+
+	StopTimer(&doWorkTimer);
+	CloseTimerWheel();
+	close(epollFd);
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,5 @@
+/* Host stand-in for the Azure IoT C SDK client options, used by the host-sim build only. */
+
+#pragma once
+
+#define OPTION_KEEP_ALIVE "keepalive"
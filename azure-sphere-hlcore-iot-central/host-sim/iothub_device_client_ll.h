@@ -0,0 +1,83 @@
+/* Host stand-in for the Azure IoT C SDK device client (LL) and message API, used by the host-sim
+   build only. Declares the subset iot_hub.c calls; a test that builds iot_hub.c defines them. */
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HANDLE;
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
+
+typedef enum {
+	IOTHUB_CLIENT_OK,
+	IOTHUB_CLIENT_INVALID_ARG,
+	IOTHUB_CLIENT_ERROR,
+	IOTHUB_CLIENT_INVALID_SIZE,
+	IOTHUB_CLIENT_INDEFINITE_TIME
+} IOTHUB_CLIENT_RESULT;
+
+typedef enum {
+	IOTHUB_MESSAGE_OK,
+	IOTHUB_MESSAGE_INVALID_ARG,
+	IOTHUB_MESSAGE_INVALID_TYPE,
+	IOTHUB_MESSAGE_ERROR
+} IOTHUB_MESSAGE_RESULT;
+
+typedef enum {
+	IOTHUB_CLIENT_CONFIRMATION_OK,
+	IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,
+	IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,
+	IOTHUB_CLIENT_CONFIRMATION_ERROR
+} IOTHUB_CLIENT_CONFIRMATION_RESULT;
+
+typedef enum {
+	IOTHUB_CLIENT_CONNECTION_AUTHENTICATED,
+	IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED
+} IOTHUB_CLIENT_CONNECTION_STATUS;
+
+typedef enum {
+	IOTHUB_CLIENT_CONNECTION_EXPIRED_SAS_TOKEN,
+	IOTHUB_CLIENT_CONNECTION_DEVICE_DISABLED,
+	IOTHUB_CLIENT_CONNECTION_BAD_CREDENTIAL,
+	IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED,
+	IOTHUB_CLIENT_CONNECTION_NO_NETWORK,
+	IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR,
+	IOTHUB_CLIENT_CONNECTION_OK
+} IOTHUB_CLIENT_CONNECTION_STATUS_REASON;
+
+typedef enum {
+	DEVICE_TWIN_UPDATE_COMPLETE,
+	DEVICE_TWIN_UPDATE_PARTIAL
+} DEVICE_TWIN_UPDATE_STATE;
+
+typedef void (*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
+typedef void (*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
+typedef void (*IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad,
+	size_t size, void* userContextCallback);
+typedef int (*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(const char* method_name, const unsigned char* payload, size_t size,
+	unsigned char** response, size_t* response_size, void* userContextCallback);
+typedef void (*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(IOTHUB_CLIENT_CONNECTION_STATUS result,
+	IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback);
+
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetOption(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle, const char* optionName,
+	const void* value);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceTwinCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetDeviceMethodCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SetConnectionStatusCallback(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void* userContextCallback);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback,
+	void* userContextCallback);
+IOTHUB_CLIENT_RESULT IoTHubDeviceClient_LL_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle,
+	const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback,
+	void* userContextCallback);
+void IoTHubDeviceClient_LL_DoWork(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle);
+void IoTHubDeviceClient_LL_Destroy(IOTHUB_DEVICE_CLIENT_LL_HANDLE iotHubClientHandle);
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* contentType);
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle,
+	const char* contentEncoding);
+void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle);
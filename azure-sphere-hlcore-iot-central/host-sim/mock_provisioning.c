@@ -0,0 +1,56 @@
+#include "mock_provisioning.h"
+#include "../provisioning.h"
+#include <time.h>
+
+// The client handed back on success, only ever compared against NULL
+static int mockClient;
+
+static uint32_t failuresLeft = 0;
+static uint32_t callLatencyMs = 0;
+static uint32_t callCount = 0;
+static struct timespec configuredTime;
+static MockProvisioningCall calls[MOCK_PROVISIONING_MAX_CALLS];
+
+static uint32_t ElapsedMs(const struct timespec* since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000);
+}
+
+void MockProvisioning_Configure(uint32_t failures, uint32_t latencyMs) {
+	failuresLeft = failures;
+	callLatencyMs = latencyMs;
+	callCount = 0;
+	clock_gettime(CLOCK_MONOTONIC, &configuredTime);
+}
+
+void* MockProvisioning_Backend(const char* scopeId, unsigned int timeoutMs) {
+	// Runs on the provisioning worker thread, which starts after the stats are updated
+	// and is joined before they change again
+	const ProvisioningStats* stats = GetProvisioningStats();
+
+	if (callCount < MOCK_PROVISIONING_MAX_CALLS) {
+		MockProvisioningCall* call = &calls[callCount];
+		call->consecutiveFailures = stats->consecutiveFailures;
+		call->backoffMs = stats->lastBackoffMs;
+		call->startMs = ElapsedMs(&configuredTime);
+	}
+	callCount++;
+
+	struct timespec latency = { (time_t)(callLatencyMs / 1000), (long)(callLatencyMs % 1000) * 1000000 };
+	nanosleep(&latency, NULL);
+
+	if (failuresLeft > 0) {
+		failuresLeft--;
+		return NULL;
+	}
+	return &mockClient;
+}
+
+uint32_t MockProvisioning_GetCallCount(void) {
+	return callCount;
+}
+
+const MockProvisioningCall* MockProvisioning_GetCall(uint32_t index) {
+	return index < callCount && index < MOCK_PROVISIONING_MAX_CALLS ? &calls[index] : NULL;
+}
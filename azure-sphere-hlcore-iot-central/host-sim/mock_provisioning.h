@@ -0,0 +1,36 @@
+#ifndef mock_provisioning_h
+#define mock_provisioning_h
+
+#include <stdint.h>
+
+// Most attempts whose details are recorded
+#define MOCK_PROVISIONING_MAX_CALLS 32
+
+/// <summary>
+///     What the provisioning module had decided when an attempt started.
+/// </summary>
+typedef struct {
+	uint32_t consecutiveFailures; // failures before this attempt
+	uint32_t backoffMs;           // delay chosen after the most recent of them
+	uint32_t startMs;             // attempt start, relative to MockProvisioning_Configure
+} MockProvisioningCall;
+
+/// <summary>
+///     Scripts the next attempts: the first failures calls return NULL, the rest a client.
+///     Each call blocks for latencyMs, as the DPS call would. Clears the recorded calls.
+/// </summary>
+void MockProvisioning_Configure(uint32_t failures, uint32_t latencyMs);
+
+/// <summary>
+///     A ProvisioningBackend following the script.
+/// </summary>
+void* MockProvisioning_Backend(const char* scopeId, unsigned int timeoutMs);
+
+/// <summary>
+///     Number of backend calls since the last MockProvisioning_Configure.
+/// </summary>
+uint32_t MockProvisioning_GetCallCount(void);
+
+const MockProvisioningCall* MockProvisioning_GetCall(uint32_t index);
+
+#endif
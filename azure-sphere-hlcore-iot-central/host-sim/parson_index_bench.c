@@ -0,0 +1,81 @@
+// Member lookup time in parson objects of 4 to 1024 members, hits and misses, and building an
+// object from parsed JSON, which looks up each new name to refuse duplicates.
+
+#include "../parson.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOOKUPS 2000000
+#define NAME_BYTES 24
+#define MAX_MEMBERS 1024
+#define JSON_BYTES (MAX_MEMBERS * 48)
+
+static char names[MAX_MEMBERS][NAME_BYTES];
+static char missing[MAX_MEMBERS][NAME_BYTES];
+static char json[JSON_BYTES];
+
+// Keeps the compiler from discarding the lookups
+static volatile uintptr_t sink;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static double Lookups(const JSON_Object* object, char (*keys)[NAME_BYTES], size_t members) {
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < LOOKUPS; n++) {
+		sink += (uintptr_t)json_object_get_value(object, keys[(n * 7919u) % members]);
+	}
+	return (double)(NowNs() - startNs) / LOOKUPS;
+}
+
+/// <summary>
+///     Times json_parse_string of an object of members numbers, which is dominated by the
+///     duplicate name check once objects grow.
+/// </summary>
+static double Parse(size_t members) {
+	size_t length = 0;
+	json[length++] = '{';
+	for (size_t i = 0; i < members; i++) {
+		length += (size_t)snprintf(json + length, sizeof(json) - length, "%s\"%s\":%zu", i == 0 ? "" : ",", names[i], i);
+	}
+	snprintf(json + length, sizeof(json) - length, "}");
+
+	uint32_t parses = (uint32_t)(LOOKUPS / 8 / members) + 1;
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < parses; n++) {
+		JSON_Value* value = json_parse_string(json);
+		sink += (uintptr_t)value;
+		json_value_free(value);
+	}
+	return (double)(NowNs() - startNs) / parses / (double)members;
+}
+
+int main(void) {
+	static const size_t sizes[] = { 4, 8, 16, 32, 64, 256, 1024 };
+
+	for (size_t i = 0; i < MAX_MEMBERS; i++) {
+		snprintf(names[i], NAME_BYTES, "reported.sensor%zu", i);
+		snprintf(missing[i], NAME_BYTES, "reported.sensor%zux", i);
+	}
+
+	printf("members  hit ns  miss ns  parse ns/member\n");
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size_t members = sizes[s];
+		JSON_Value* value = json_value_init_object();
+		JSON_Object* object = json_value_get_object(value);
+		for (size_t i = 0; i < members; i++) {
+			json_object_set_number(object, names[i], (double)i);
+		}
+		double hit = Lookups(object, names, members);
+		double miss = Lookups(object, missing, members);
+		json_value_free(value);
+		printf("%7zu %7.1f %8.1f %16.1f\n", members, hit, miss, Parse(members));
+	}
+	return EXIT_SUCCESS;
+}
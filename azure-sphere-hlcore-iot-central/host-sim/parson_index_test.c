@@ -0,0 +1,230 @@
+// Runs random adds, replaces, removes and dotted lookups on parson objects that grow and shrink
+// across the hash index threshold, checking every lookup against a plain model of the members
+// and the index itself against the member arrays. Built with parson.c to see the index.
+
+#include "../parson.c"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POOL_NAMES 96
+#define NAME_BYTES 16
+#define STEPS 20000
+#define PHASE_STEPS 400
+#define CHILD "child"
+
+typedef struct {
+	bool present[POOL_NAMES];
+	double numbers[POOL_NAMES];
+} Model;
+
+static char pool[POOL_NAMES][NAME_BYTES];
+static uint32_t randomState = 0x6C078965;
+static size_t failAbove = (size_t)-1;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static uint32_t Random(void) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+/// <summary>
+///     malloc that fails allocations larger than failAbove, to refuse the index but not members.
+/// </summary>
+static void* LimitedMalloc(size_t size) {
+	return size > failAbove ? NULL : malloc(size);
+}
+
+/// <summary>
+///     Names with shared prefixes and lengths, so that probes compare near misses.
+/// </summary>
+static void BuildPool(void) {
+	for (size_t i = 0; i < POOL_NAMES; i++) {
+		snprintf(pool[i], NAME_BYTES, i % 3 == 0 ? "s%zu" : i % 3 == 1 ? "sensor%zu" : "sensor%zu_", i);
+	}
+}
+
+/// <summary>
+///     Checks the index holds each member exactly once and every member is found through it.
+/// </summary>
+static void CheckIndex(const JSON_Object* object, const char* what) {
+	if (object->cells == NULL) {
+		return;
+	}
+	size_t used = 0;
+	CHECK(object->cell_capacity >= object->count * 2, "%s: %zu cells for %zu members", what, object->cell_capacity, object->count);
+	for (size_t cell = 0; cell < object->cell_capacity; cell++) {
+		if (object->cells[cell] != 0) {
+			used++;
+			CHECK(object->cells[cell] - 1 < object->count, "%s: cell %zu points past the members", what, cell);
+		}
+	}
+	CHECK(used == object->count, "%s: %zu cells used for %zu members", what, used, object->count);
+	for (size_t i = 0; i < object->count; i++) {
+		CHECK(json_object_getn_index(object, object->names[i], strlen(object->names[i])) == i, "%s: %s not found at %zu",
+			what, object->names[i], i);
+	}
+}
+
+/// <summary>
+///     Checks the object against the model by name, by position, and with dotted names from root.
+///     extra names a member outside the pool the object also holds, or is NULL.
+/// </summary>
+static void CheckObject(const JSON_Object* root, const JSON_Object* object, const Model* model, const char* prefix,
+	const char* extra, const char* what) {
+	size_t count = extra != NULL;
+	for (size_t i = 0; i < POOL_NAMES; i++) {
+		JSON_Value* value = json_object_get_value(object, pool[i]);
+		count += model->present[i];
+		CHECK((value != NULL) == model->present[i], "%s: %s %s", what, pool[i], model->present[i] ? "missing" : "found");
+		CHECK(value == NULL || json_value_get_number(value) == model->numbers[i], "%s: %s is %g, expected %g", what,
+			pool[i], json_value_get_number(value), model->numbers[i]);
+
+		if (prefix != NULL) {
+			char dotted[NAME_BYTES * 2];
+			snprintf(dotted, sizeof(dotted), "%s.%s", prefix, pool[i]);
+			CHECK(json_object_dotget_value(root, dotted) == value, "%s: %s differs from %s", what, dotted, pool[i]);
+		}
+	}
+	CHECK(json_object_get_count(object) == count, "%s: %zu members, expected %zu", what, json_object_get_count(object), count);
+
+	// The members by position are exactly the model's, each once
+	bool seen[POOL_NAMES] = { false };
+	for (size_t i = 0; i < json_object_get_count(object); i++) {
+		const char* name = json_object_get_name(object, i);
+		if (extra != NULL && strcmp(name, extra) == 0) {
+			continue;
+		}
+		size_t n = 0;
+		while (n < POOL_NAMES && strcmp(pool[n], name) != 0) {
+			n++;
+		}
+		CHECK(n < POOL_NAMES && model->present[n] && !seen[n], "%s: unexpected member %s at %zu", what, name, i);
+		if (n < POOL_NAMES) {
+			seen[n] = true;
+			CHECK(json_object_get_value_at(object, i) == json_object_get_value(object, name), "%s: %s at %zu differs", what,
+				name, i);
+		}
+	}
+	CHECK(json_object_get_value(object, "sensor") == NULL && json_object_get_value(object, "") == NULL,
+		"%s: found a name not in the pool", what);
+	CheckIndex(object, what);
+}
+
+/// <summary>
+///     Applies one random operation to the object and the model, biased to grow or shrink.
+/// </summary>
+static void Step(JSON_Object* root, JSON_Object* object, Model* model, const char* prefix, bool grow) {
+	size_t n = Random() % POOL_NAMES;
+	uint32_t operation = Random() % 100;
+	double number = (double)(Random() % 100000);
+	char dotted[NAME_BYTES * 2];
+	snprintf(dotted, sizeof(dotted), "%s.%s", prefix != NULL ? prefix : "", pool[n]);
+	const char* name = prefix != NULL ? dotted : pool[n];
+
+	if (operation < (grow ? 65u : 10u)) {
+		JSON_Status status = prefix != NULL ? json_object_dotset_number(root, name, number)
+											: json_object_set_number(object, name, number);
+		CHECK(status == JSONSuccess, "set %s failed", name);
+		model->present[n] = true;
+		model->numbers[n] = number;
+	}
+	else if (operation < 99) {
+		JSON_Status status = prefix != NULL ? json_object_dotremove(root, name) : json_object_remove(object, name);
+		CHECK((status == JSONSuccess) == model->present[n], "remove %s %s", name, status == JSONSuccess ? "succeeded" : "failed");
+		model->present[n] = false;
+	}
+	else if (prefix == NULL) {
+		json_object_clear(object);
+		memset(model->present, 0, sizeof(model->present));
+	}
+}
+
+static void CheckRandomOperations(void) {
+	JSON_Value* rootValue = json_value_init_object();
+	JSON_Object* root = json_value_get_object(rootValue);
+	static Model rootModel;
+	static Model childModel;
+	bool crossedUp = false;
+	bool crossedDown = false;
+
+	json_object_set_value(root, CHILD, json_value_init_object());
+	for (uint32_t step = 0; step < STEPS; step++) {
+		bool grow = (step / PHASE_STEPS) % 2 == 0;
+		JSON_Object* child = json_object_get_object(root, CHILD);
+		size_t before = json_object_get_count(child);
+
+		Step(root, child, &childModel, CHILD, grow);
+		Step(root, root, &rootModel, NULL, grow);
+		if (json_object_get_object(root, CHILD) == NULL) { // the root was cleared
+			json_object_set_value(root, CHILD, json_value_init_object());
+			memset(childModel.present, 0, sizeof(childModel.present));
+		}
+
+		child = json_object_get_object(root, CHILD);
+		crossedUp |= before < OBJECT_INDEX_THRESHOLD && json_object_get_count(child) >= OBJECT_INDEX_THRESHOLD;
+		crossedDown |= before >= OBJECT_INDEX_THRESHOLD && json_object_get_count(child) < OBJECT_INDEX_THRESHOLD;
+
+		char what[32];
+		snprintf(what, sizeof(what), "step %u child", step);
+		CheckObject(root, child, &childModel, CHILD, NULL, what);
+		CHECK(json_object_get_count(child) < OBJECT_INDEX_THRESHOLD || child->cells != NULL, "%s: %zu members, no index", what,
+			json_object_get_count(child));
+
+		snprintf(what, sizeof(what), "step %u root", step);
+		CheckObject(root, root, &rootModel, NULL, CHILD, what);
+	}
+	CHECK(crossedUp && crossedDown, "child never crossed the index threshold both ways");
+	json_value_free(rootValue);
+}
+
+static void CheckIndexBuildFailure(void) {
+	JSON_Value* value = json_value_init_object();
+	JSON_Object* object = json_value_get_object(value);
+	static Model model;
+
+	memset(model.present, 0, sizeof(model.present));
+	for (size_t i = 0; i < OBJECT_INDEX_THRESHOLD; i++) {
+		json_object_set_number(object, pool[i], (double)i);
+		model.present[i] = true;
+		model.numbers[i] = (double)i;
+	}
+	CHECK(object->cells == NULL, "index built before the first lookup at the threshold");
+
+	// Without memory for the index, lookups scan
+	failAbove = 0;
+	json_set_allocation_functions(LimitedMalloc, free);
+	CheckObject(object, object, &model, NULL, NULL, "index refused");
+	CHECK(object->cells == NULL, "index built without memory");
+
+	failAbove = (size_t)-1;
+	CheckObject(object, object, &model, NULL, NULL, "index built");
+	CHECK(object->cells != NULL, "no index past the threshold");
+
+	// Growing the member arrays succeeds but growing the index does not, so it is dropped
+	failAbove = (OBJECT_INDEX_THRESHOLD * 2) * sizeof(size_t);
+	json_object_set_number(object, pool[OBJECT_INDEX_THRESHOLD], 1.5);
+	model.present[OBJECT_INDEX_THRESHOLD] = true;
+	model.numbers[OBJECT_INDEX_THRESHOLD] = 1.5;
+	failAbove = (size_t)-1;
+	CHECK(object->cells == NULL, "index kept without room for the new member");
+	CheckObject(object, object, &model, NULL, NULL, "index rebuilt");
+	CHECK(object->cells != NULL, "index not rebuilt");
+
+	json_set_allocation_functions(malloc, free);
+	json_value_free(value);
+}
+
+int main(void) {
+	BuildPool();
+	CheckRandomOperations();
+	CheckIndexBuildFailure();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
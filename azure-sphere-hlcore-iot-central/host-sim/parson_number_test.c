@@ -0,0 +1,286 @@
+// Serializes doubles with parson and parses them back, checking the shortest form returns the
+// same bits for random values, subnormals, signed zeros, integers and around the switches to
+// exponent form, and that the fixed decimal form rounds to the requested places.
+
+#include "../parson.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMBER_BYTES 64
+#define RANDOM_VALUES 300000
+#define RANDOM_SUBNORMALS 100000
+#define RANDOM_FIXED 100000
+
+typedef struct {
+	double value;
+	const char* json;
+} NumberCase;
+
+typedef struct {
+	double value;
+	int decimals;
+	const char* json;
+} FixedCase;
+
+static const NumberCase shortestCases[] = {
+	{ 0.0, "0" },
+	{ -0.0, "-0" },
+	{ 0.1, "0.1" },
+	{ -23.45, "-23.45" },
+	{ 1.0 / 3.0, "0.3333333333333333" },
+	{ 100.0, "100" },
+	{ 0.0001, "0.0001" },
+	{ 0.00001, "1e-05" },
+	{ 1e16, "10000000000000000" },
+	{ 1e17, "1e+17" },
+	{ 123456789012345680.0, "1.2345678901234568e+17" },
+	{ 1e21, "1e+21" },
+	{ 1e22, "1e+22" },
+	{ 9007199254740993.0, "9007199254740992" },
+	{ 5e-324, "5e-324" },
+	{ 2.2250738585072014e-308, "2.2250738585072014e-308" },
+	{ DBL_MAX, "1.7976931348623157e+308" }
+};
+
+static const FixedCase fixedCases[] = {
+	{ 23.45, 2, "23.45" },
+	{ 45.6, 1, "45.6" },
+	{ 2.5, 0, "3" },
+	{ -1.25, 1, "-1.3" },
+	{ 0.996, 2, "1.00" },
+	{ -0.004, 2, "0.00" }, // no "-0.00" for readings that round to zero
+	{ -0.0, 3, "0.000" },
+	{ 0.0, 0, "0" },
+	{ 7.0, 9, "7.000000000" },
+	{ 1e-10, 9, "0.000000000" },
+	{ -123456.789, 3, "-123456.789" },
+	{ 1e300, 2, "1e+300" }, // too large to scale exactly, written in full
+	{ 9007199254740993.0, 0, "9007199254740992" }
+};
+
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static uint64_t Random(void) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState;
+}
+
+static uint64_t Bits(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static double FromBits(uint64_t bits) {
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/// <summary>
+///     Serializes value into json and parses it back.
+/// </summary>
+/// <returns>Whether both succeeded</returns>
+static bool RoundTrip(double value, char* json, double* parsed) {
+	JSON_Value* number = json_value_init_number(value);
+	bool serialized = number != NULL && json_serialize_to_buffer(number, json, NUMBER_BYTES) == JSONSuccess;
+	json_value_free(number);
+	if (!serialized) {
+		return false;
+	}
+	JSON_Value* back = json_parse_string(json);
+	if (json_value_get_type(back) != JSONNumber) {
+		json_value_free(back);
+		return false;
+	}
+	*parsed = json_value_get_number(back);
+	json_value_free(back);
+	return true;
+}
+
+/// <summary>
+///     Counts the digits of a serialized number, less leading and trailing zeros.
+/// </summary>
+static int SignificantDigits(const char* json) {
+	char digits[NUMBER_BYTES];
+	size_t length = 0;
+	for (const char* c = json; *c != '\0' && *c != 'e'; c++) {
+		if (*c >= '0' && *c <= '9') {
+			digits[length++] = *c;
+		}
+	}
+	size_t first = 0;
+	while (first < length && digits[first] == '0') {
+		first++;
+	}
+	while (length > first && digits[length - 1] == '0') {
+		length--;
+	}
+	return (int)(length - first);
+}
+
+static void CheckSameBits(double value) {
+	char json[NUMBER_BYTES];
+	double parsed = 0;
+	bool ok = RoundTrip(value, json, &parsed);
+	CHECK(ok && Bits(parsed) == Bits(value), "%.17g (bits %016llx) serialized as %s, read back as %.17g", value,
+		(unsigned long long)Bits(value), ok ? json : "(failed)", parsed);
+}
+
+static void CheckShortestCases(void) {
+	for (size_t i = 0; i < sizeof(shortestCases) / sizeof(shortestCases[0]); i++) {
+		char json[NUMBER_BYTES];
+		double parsed = 0;
+		bool ok = RoundTrip(shortestCases[i].value, json, &parsed);
+		CHECK(ok && strcmp(json, shortestCases[i].json) == 0, "%.17g serialized as %s, expected %s", shortestCases[i].value,
+			ok ? json : "(failed)", shortestCases[i].json);
+		CheckSameBits(shortestCases[i].value);
+	}
+}
+
+static void CheckRandomValues(void) {
+	uint32_t longer = 0;
+
+	for (uint32_t i = 0; i < RANDOM_VALUES; i++) {
+		double value = FromBits(Random());
+		if (isnan(value) || isinf(value)) {
+			continue;
+		}
+		CheckSameBits(value);
+
+		// Grisu2 finds the shortest digits for all but a tiny fraction of values
+		char json[NUMBER_BYTES];
+		char shortest[NUMBER_BYTES];
+		double parsed = 0;
+		RoundTrip(value, json, &parsed);
+		// If any shorter form reads back, printf's nearest with one digit fewer does
+		int digits = SignificantDigits(json);
+		if (digits > 1) {
+			snprintf(shortest, sizeof(shortest), "%.*e", digits - 2, value);
+			longer += strtod(shortest, NULL) == value;
+		}
+	}
+	CHECK(longer < RANDOM_VALUES / 1000, "%u of %u random values not in their shortest form", longer, RANDOM_VALUES);
+	printf("%u of %u random values serialized longer than the shortest round trip form\n", longer, RANDOM_VALUES);
+}
+
+static void CheckSubnormalsAndZeros(void) {
+	CheckSameBits(0.0);
+	CheckSameBits(-0.0);
+	CheckSameBits(FromBits(1));                      // smallest subnormal
+	CheckSameBits(-FromBits(1));
+	CheckSameBits(FromBits(0x000FFFFFFFFFFFFFULL)); // largest subnormal
+	CheckSameBits(FromBits(0x0010000000000000ULL)); // smallest normal
+	for (uint32_t i = 0; i < RANDOM_SUBNORMALS; i++) {
+		CheckSameBits(FromBits(Random() & 0x800FFFFFFFFFFFFFULL));
+	}
+}
+
+static void CheckBoundaries(void) {
+	// Either side of the switches between fixed and exponent form, and of 1e21 where printf's %f
+	// style output and JavaScript switch
+	static const double boundaries[] = { 1e-5, 1e-4, 1e15, 1e16, 1e17, 1e21, 1e22, 9007199254740992.0 };
+
+	for (size_t i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++) {
+		double value = boundaries[i];
+		double below = value;
+		double above = value;
+		for (int step = 0; step < 64; step++) {
+			CheckSameBits(below);
+			CheckSameBits(above);
+			CheckSameBits(-below);
+			below = nextafter(below, 0);
+			above = nextafter(above, INFINITY);
+		}
+	}
+}
+
+static void CheckIntegers(void) {
+	for (int64_t n = -100000; n <= 100000; n++) {
+		char json[NUMBER_BYTES];
+		char expected[NUMBER_BYTES];
+		double parsed = 0;
+		snprintf(expected, sizeof(expected), "%lld", (long long)n);
+		bool ok = RoundTrip((double)n, json, &parsed);
+		CHECK(ok && strcmp(json, expected) == 0, "%lld serialized as %s", (long long)n, ok ? json : "(failed)");
+	}
+	for (int shift = 0; shift <= 63; shift++) {
+		double power = ldexp(1.0, shift);
+		CheckSameBits(power);
+		CheckSameBits(power - 1);
+		CheckSameBits(power + 1);
+		CheckSameBits(-power);
+	}
+	// Integers below 1e17 are written out in full, with no exponent or point
+	for (uint32_t i = 0; i < RANDOM_VALUES / 10; i++) {
+		char json[NUMBER_BYTES];
+		double parsed = 0;
+		double value = (double)(Random() % 100000000000000000ULL);
+		bool ok = RoundTrip(value, json, &parsed);
+		CHECK(ok && strpbrk(json, ".e") == NULL && Bits(parsed) == Bits(value), "%.17g serialized as %s", value,
+			ok ? json : "(failed)");
+	}
+}
+
+static void CheckFixedDecimals(void) {
+	for (size_t i = 0; i < sizeof(fixedCases) / sizeof(fixedCases[0]); i++) {
+		char json[NUMBER_BYTES];
+		double parsed = 0;
+		json_set_number_serialization_decimals(fixedCases[i].decimals);
+		bool ok = RoundTrip(fixedCases[i].value, json, &parsed);
+		CHECK(ok && strcmp(json, fixedCases[i].json) == 0, "%.17g at %d decimals serialized as %s, expected %s",
+			fixedCases[i].value, fixedCases[i].decimals, ok ? json : "(failed)", fixedCases[i].json);
+	}
+
+	// Readings round to within half a unit in the last place, with exactly that many places
+	for (int decimals = 0; decimals <= 9; decimals++) {
+		json_set_number_serialization_decimals(decimals);
+		for (uint32_t i = 0; i < RANDOM_FIXED; i++) {
+			char json[NUMBER_BYTES];
+			double parsed = 0;
+			double value = ((double)(Random() % 2000000001) - 1000000000.0) / pow(10.0, (double)(Random() % 10));
+			bool ok = RoundTrip(value, json, &parsed);
+			const char* point = strchr(json, '.');
+			size_t places = point == NULL ? 0 : strlen(point + 1);
+			double unit = pow(10.0, -decimals);
+			if (fabs(value) / unit >= 9007199254740992.0) {
+				// Too large to scale exactly, so written in the shortest form
+				CHECK(ok && Bits(parsed) == Bits(value), "%.17g at %d decimals serialized as %s", value, decimals,
+					ok ? json : "(failed)");
+				continue;
+			}
+			CHECK(ok && places == (size_t)decimals && fabs(parsed - value) <= unit / 2 + fabs(value) * DBL_EPSILON,
+				"%.17g at %d decimals serialized as %s", value, decimals, ok ? json : "(failed)");
+		}
+	}
+
+	// 9 is the most decimals, and a negative value returns to the shortest form
+	json_set_number_serialization_decimals(12);
+	char json[NUMBER_BYTES];
+	double parsed = 0;
+	CHECK(RoundTrip(0.5, json, &parsed) && strcmp(json, "0.500000000") == 0, "12 decimals serialized 0.5 as %s", json);
+	json_set_number_serialization_decimals(-1);
+	CHECK(RoundTrip(0.5, json, &parsed) && strcmp(json, "0.5") == 0, "shortest form serialized 0.5 as %s", json);
+}
+
+int main(void) {
+	CheckShortestCases();
+	CheckRandomValues();
+	CheckSubnormalsAndZeros();
+	CheckBoundaries();
+	CheckIntegers();
+	CheckFixedDecimals();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
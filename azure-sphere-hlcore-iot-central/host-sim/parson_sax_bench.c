@@ -0,0 +1,132 @@
+// Parse time and allocations of device twins read the way TwinCallback did before streaming,
+// with a DOM parse and lookups, against json_parse_sax with the twin handler's key rules.
+
+#include "../parson.h"
+#include "twin_document.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DOCUMENT_BYTES (128 * 1024)
+#define PARSE_BYTES (64 * 1024 * 1024)
+
+static const char* const registered[] = { "relay1", "led1", "setting3" };
+static char document[DOCUMENT_BYTES];
+static uint64_t allocations;
+static size_t liveBytes;
+static size_t peakBytes;
+
+// Keeps the compiler from discarding the properties found
+static volatile size_t sink;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/// <summary>
+///     malloc that counts allocations and the bytes live, keeping each block's size in front of it.
+/// </summary>
+static void* CountingMalloc(size_t size) {
+	max_align_t* block = malloc(sizeof(max_align_t) + size);
+	if (block == NULL) {
+		return NULL;
+	}
+	*(size_t*)block = size;
+	allocations++;
+	liveBytes += size;
+	if (liveBytes > peakBytes) {
+		peakBytes = liveBytes;
+	}
+	return block + 1;
+}
+
+static void CountingFree(void* pointer) {
+	if (pointer != NULL) {
+		max_align_t* block = (max_align_t*)pointer - 1;
+		liveBytes -= *(size_t*)block;
+		free(block);
+	}
+}
+
+static bool IsRegistered(const char* key, size_t keyLength) {
+	for (size_t i = 0; i < sizeof(registered) / sizeof(registered[0]); i++) {
+		if (strlen(registered[i]) == keyLength && strncmp(registered[i], key, keyLength) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void ParseDom(const char* json) {
+	JSON_Value* root = json_parse_string(json);
+	JSON_Object* object = json_value_get_object(root);
+	JSON_Object* desired = json_object_get_object(object, "desired");
+	if (desired != NULL) {
+		object = desired;
+	}
+	for (size_t i = 0; i < sizeof(registered) / sizeof(registered[0]); i++) {
+		sink += json_object_get_value(object, registered[i]) != NULL;
+	}
+	json_value_free(root);
+}
+
+// The rules of TwinKeyHandler in iot_hub.c
+static JSON_Sax_Result OnKey(void* context, const char* key, size_t keyLength, size_t depth) {
+	if (depth == 1 && keyLength == strlen("desired") && strncmp(key, "desired", keyLength) == 0) {
+		return JSONSaxContinue;
+	}
+	if (depth <= 2 && IsRegistered(key, keyLength)) {
+		return JSONSaxParseValue;
+	}
+	return JSONSaxSkip;
+}
+
+static JSON_Sax_Result OnValue(void* context, const char* key, size_t keyLength, JSON_Value* value) {
+	sink += json_value_get_type(value);
+	return JSONSaxContinue;
+}
+
+static const JSON_Sax_Handler twinHandler = { .on_key = OnKey, .on_value = OnValue };
+
+static void ParseSax(const char* json) {
+	json_parse_sax(json, &twinHandler, NULL);
+}
+
+static void Run(const char* name, void (*parse)(const char* json), size_t length, uint32_t parses) {
+	allocations = 0;
+	peakBytes = 0;
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < parses; n++) {
+		parse(document);
+	}
+	int64_t elapsedNs = NowNs() - startNs;
+
+	printf("  %-4s %9.2f us/parse %7.1f MB/s %8.1f allocations/parse %8zu peak bytes\n", name,
+		(double)elapsedNs / parses / 1000.0, (double)length * parses * 1000.0 / (double)elapsedNs,
+		(double)allocations / parses, peakBytes);
+}
+
+int main(void) {
+	static const size_t sizes[] = { 5, 40, 150 };
+
+	json_set_allocation_functions(CountingMalloc, CountingFree);
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (int full = 1; full >= 0; full--) {
+			size_t length = TwinDocument_Build(document, sizeof(document), sizes[i], full);
+			if (length == 0) {
+				fprintf(stderr, "%zu property twin does not fit %d bytes\n", sizes[i], DOCUMENT_BYTES);
+				return EXIT_FAILURE;
+			}
+			uint32_t parses = (uint32_t)(PARSE_BYTES / length);
+			printf("%s twin, %zu properties, %zu bytes\n", full ? "full" : "patch", sizes[i], length);
+			Run("dom", ParseDom, length, parses);
+			Run("sax", ParseSax, length, parses);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+// Streams device twin documents through json_parse_sax with the twin handler's key rules and
+// checks it agrees with a DOM parse: the same desired properties with the same values, and the
+// same verdict on documents made malformed inside the $metadata and reported blocks it skips.
+
+#include "../parson.h"
+#include "twin_document.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DOCUMENT_BYTES (128 * 1024)
+#define MAX_PROPERTIES 8
+#define PROPERTY_BYTES 128
+#define RANDOM_MUTATIONS 5000
+
+typedef struct {
+	size_t count;
+	char properties[MAX_PROPERTIES][PROPERTY_BYTES]; // "name=serialized value"
+} Properties;
+
+static const char* const registered[] = { "relay1", "led1", "setting3" };
+static char document[DOCUMENT_BYTES];
+static char mutated[DOCUMENT_BYTES];
+static uint32_t randomState = 0x2545F491;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static uint32_t Random(void) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static bool IsRegistered(const char* key, size_t keyLength) {
+	for (size_t i = 0; i < sizeof(registered) / sizeof(registered[0]); i++) {
+		if (strlen(registered[i]) == keyLength && strncmp(registered[i], key, keyLength) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void AddProperty(Properties* properties, const char* key, size_t keyLength, const JSON_Value* value) {
+	if (properties->count == MAX_PROPERTIES) {
+		return;
+	}
+	char* serialized = json_serialize_to_string(value);
+	snprintf(properties->properties[properties->count++], PROPERTY_BYTES, "%.*s=%s", (int)keyLength, key,
+		serialized != NULL ? serialized : "?");
+	json_free_serialized_string(serialized);
+}
+
+// The rules of TwinKeyHandler in iot_hub.c
+static JSON_Sax_Result OnKey(void* context, const char* key, size_t keyLength, size_t depth) {
+	if (depth == 1 && keyLength == strlen("desired") && strncmp(key, "desired", keyLength) == 0) {
+		return JSONSaxContinue;
+	}
+	if (depth <= 2 && IsRegistered(key, keyLength)) {
+		return JSONSaxParseValue;
+	}
+	return JSONSaxSkip;
+}
+
+static JSON_Sax_Result OnValue(void* context, const char* key, size_t keyLength, JSON_Value* value) {
+	AddProperty(context, key, keyLength, value);
+	return JSONSaxContinue;
+}
+
+static const JSON_Sax_Handler twinHandler = { .on_key = OnKey, .on_value = OnValue };
+
+static bool ParseSax(const char* json, Properties* properties) {
+	properties->count = 0;
+	return json_parse_sax_buffer(json, strlen(json), &twinHandler, properties) == JSONSuccess;
+}
+
+static void CollectDom(const JSON_Object* object, bool top, Properties* properties) {
+	for (size_t i = 0; i < json_object_get_count(object); i++) {
+		const char* name = json_object_get_name(object, i);
+		JSON_Value* value = json_object_get_value_at(object, i);
+
+		if (top && strcmp(name, "desired") == 0) {
+			if (json_value_get_type(value) == JSONObject) {
+				CollectDom(json_value_get_object(value), false, properties);
+			}
+		}
+		else if (IsRegistered(name, strlen(name))) {
+			AddProperty(properties, name, strlen(name), value);
+		}
+	}
+}
+
+static bool ParseDom(const char* json, Properties* properties) {
+	properties->count = 0;
+	JSON_Value* root = json_parse_string(json);
+	if (root == NULL) {
+		return false;
+	}
+	if (json_value_get_type(root) == JSONObject) {
+		CollectDom(json_value_get_object(root), true, properties);
+	}
+	json_value_free(root);
+	return true;
+}
+
+/// <summary>
+///     Parses json both ways and checks they agree. Returns whether the DOM parse succeeded.
+/// </summary>
+static bool Compare(const char* json, const char* what) {
+	Properties dom;
+	Properties sax;
+	bool domParsed = ParseDom(json, &dom);
+	bool saxParsed = ParseSax(json, &sax);
+
+	CHECK(domParsed == saxParsed, "%s: DOM %s, SAX %s", what, domParsed ? "parsed" : "rejected", saxParsed ? "parsed" : "rejected");
+	if (domParsed && saxParsed) {
+		CHECK(dom.count == sax.count, "%s: DOM found %zu properties, SAX %zu", what, dom.count, sax.count);
+		for (size_t i = 0; i < dom.count && i < sax.count; i++) {
+			CHECK(strcmp(dom.properties[i], sax.properties[i]) == 0, "%s: DOM %s, SAX %s", what, dom.properties[i],
+				sax.properties[i]);
+		}
+	}
+	return domParsed;
+}
+
+/// <summary>
+///     Copies document into mutated with the occurrence'th copy of find replaced.
+/// </summary>
+static bool Splice(const char* find, size_t occurrence, const char* replacement) {
+	const char* at = document;
+	for (size_t i = 0; at != NULL && i <= occurrence; i++) {
+		at = strstr(i == 0 ? at : at + 1, find);
+	}
+	if (at == NULL) {
+		return false;
+	}
+	size_t prefix = (size_t)(at - document);
+	snprintf(mutated, sizeof(mutated), "%.*s%s%s", (int)prefix, document, replacement, at + strlen(find));
+	return true;
+}
+
+static void CheckValidDocuments(void) {
+	static const size_t sizes[] = { 0, 1, 5, 40, 150 };
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (int full = 0; full <= 1; full++) {
+			char what[64];
+			snprintf(what, sizeof(what), "%s twin, %zu properties", full ? "full" : "patch", sizes[i]);
+			CHECK(TwinDocument_Build(document, sizeof(document), sizes[i], full) > 0, "%s does not fit", what);
+			CHECK(Compare(document, what), "%s rejected", what);
+
+			Properties sax;
+			ParseSax(document, &sax);
+			CHECK(sax.count >= 2 && strcmp(sax.properties[0], "relay1={\"value\":true}") == 0, "%s: relay1 not found", what);
+		}
+	}
+}
+
+static void CheckMalformedSkippedValues(void) {
+	// Each replaces a well formed value inside $metadata, which the twin handler skips
+	static const char* const malformed[] = {
+		"012", "1.", "-", "1e", "+1", ".5", "0x10", "tru", "nul", "falsey", "[1,]", "[,1]", "[1 2]", "[", "]",
+		"{\"a\"}", "{\"a\":1,}", "{,}", "{\"a\":1 \"b\":2}", "{\"a\":1,\"a\":2}", "{\"a\":1,\"\\u0061\":2}", "{1:2}", "\"\\q\"", "\"\\u12\"",
+		"\"\\uZZZZ\"", "\"\x01\"", "\"\xff\"", "\"\xc3\"", "\"\xed\xa0\x80\"", "\"\xf4\x90\x80\x80\"", "\"unterminated",
+		"[[[[[[[[[[[[[[[[", "{\"a\":[1,{\"b\":}]}", "\"a\" \"b\""
+	};
+	static const char* const wellFormed[] = {
+		"0", "-0.5e-3", "1E+2", "true", "null", "[]", "{}", "[[],{},[{}]]", "{\"a\":{\"b\":[1,\"]\"]}}", "\"\\u00e9\\n\\\"\"",
+		"\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\"", "{\"\":\"\"}"
+	};
+	const char* find = "[1,2.5e3,null,\"x\\\"y\"]";
+
+	TwinDocument_Build(document, sizeof(document), 5, true);
+	for (size_t occurrence = 0; occurrence < 10; occurrence += 9) {
+		for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+			char what[96];
+			snprintf(what, sizeof(what), "malformed %s in $metadata %zu", malformed[i], occurrence);
+			if (Splice(find, occurrence, malformed[i])) {
+				Compare(mutated, what);
+			}
+		}
+		for (size_t i = 0; i < sizeof(wellFormed) / sizeof(wellFormed[0]); i++) {
+			char what[96];
+			snprintf(what, sizeof(what), "%s in $metadata %zu", wellFormed[i], occurrence);
+			if (Splice(find, occurrence, wellFormed[i])) {
+				CHECK(Compare(mutated, what), "%s rejected", what);
+			}
+		}
+	}
+}
+
+static void CheckRandomMutations(void) {
+	static const char replacements[] = "{}[]:,\"\\ 0-.eEtfnu\x01\x80\xff";
+	uint32_t rejected = 0;
+
+	size_t length = TwinDocument_Build(document, sizeof(document), 5, true);
+	for (uint32_t i = 0; i < RANDOM_MUTATIONS; i++) {
+		memcpy(mutated, document, length + 1);
+		uint32_t edits = 1 + Random() % 3;
+		for (uint32_t e = 0; e < edits; e++) {
+			mutated[Random() % length] = replacements[Random() % (sizeof(replacements) - 1)];
+		}
+
+		char what[32];
+		snprintf(what, sizeof(what), "mutation %u", i);
+		rejected += !Compare(mutated, what);
+	}
+	printf("%u of %u randomly mutated twins rejected\n", rejected, RANDOM_MUTATIONS);
+}
+
+int main(void) {
+	CheckValidDocuments();
+	CheckMalformedSkippedValues();
+	CheckRandomMutations();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
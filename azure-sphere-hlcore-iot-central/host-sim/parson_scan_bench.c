@@ -0,0 +1,119 @@
+// Parse throughput of inputs the block scanners speed up: long strings, pretty printed indentation
+// and UTF-8 validation of mostly ASCII text. Built once per scanner variant to compare them.
+
+#include "../parson.h"
+#include "twin_document.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DOCUMENT_BYTES (256 * 1024)
+#define PARSE_BYTES (256 * 1024 * 1024)
+#define STRINGS 64
+#define STRING_BYTES 400
+
+static char strings[DOCUMENT_BYTES];
+static char text[DOCUMENT_BYTES];
+
+// Keeps the compiler from discarding the parsed values
+static volatile uintptr_t sink;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/// <summary>
+///     An array of long log lines, with an escape now and then.
+/// </summary>
+static size_t BuildStrings(void) {
+	size_t length = 0;
+	strings[length++] = '[';
+	for (size_t i = 0; i < STRINGS; i++) {
+		strings[length++] = i == 0 ? '\"' : ',';
+		if (i != 0) {
+			strings[length++] = '\"';
+		}
+		for (size_t c = 0; c < STRING_BYTES; c++) {
+			strings[length++] = c % 97 == 96 ? '\\' : (char)('a' + (c * 7 + i) % 26);
+			if (c % 97 == 96) {
+				strings[length++] = 'n';
+			}
+		}
+		strings[length++] = '\"';
+	}
+	strings[length++] = ']';
+	strings[length] = '\0';
+	return length;
+}
+
+/// <summary>
+///     Mostly ASCII text with an accented letter every 60 bytes, as a device name or message might be.
+/// </summary>
+static size_t BuildText(void) {
+	size_t length = 0;
+	while (length + 2 < DOCUMENT_BYTES / 4) {
+		if (length % 60 == 59) {
+			text[length++] = (char)0xC3;
+			text[length++] = (char)0xA9;
+		}
+		else {
+			text[length++] = (char)('A' + length % 26);
+		}
+	}
+	text[length] = '\0';
+	return length;
+}
+
+static void ParseString(const char* json) {
+	JSON_Value* value = json_parse_string(json);
+	sink += (uintptr_t)value;
+	json_value_free(value);
+}
+
+static void InitString(const char* string) {
+	JSON_Value* value = json_value_init_string(string);
+	sink += (uintptr_t)value;
+	json_value_free(value);
+}
+
+static void Run(const char* name, void (*parse)(const char* input), const char* input, size_t length) {
+	uint32_t runs = (uint32_t)(PARSE_BYTES / 16 / length) + 1;
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < runs; n++) {
+		parse(input);
+	}
+	int64_t elapsedNs = NowNs() - startNs;
+	printf("%-34s %7zu bytes %8.1f MB/s\n", name, length, (double)length * runs * 1000.0 / (double)elapsedNs);
+}
+
+int main(void) {
+	static char twin[DOCUMENT_BYTES];
+
+	TwinDocument_Build(twin, sizeof(twin), 40, true);
+	JSON_Value* twinValue = json_parse_string(twin);
+	char* pretty = json_serialize_to_string_pretty(twinValue);
+	json_value_free(twinValue);
+	if (pretty == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	size_t stringsLength = BuildStrings();
+	size_t textLength = BuildText();
+#if defined(PARSON_NO_SIMD)
+	printf("scalar scanners\n");
+#elif defined(__AVX2__)
+	printf("AVX2 scanners\n");
+#else
+	printf("default scanners for the target\n");
+#endif
+	Run("long strings", ParseString, strings, stringsLength);
+	Run("pretty printed twin", ParseString, pretty, strlen(pretty));
+	Run("compact twin", ParseString, twin, strlen(twin));
+	Run("UTF-8 check of mostly ASCII text", InitString, text, textLength);
+	json_free_serialized_string(pretty);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,349 @@
+// Checks parson's block scanners against byte by byte definitions of what each may skip, with
+// every stop byte at every position across block boundaries and the input ending at a guard page,
+// then parses strings, UTF-8 and whitespace runs that straddle blocks against expected results.
+// Built with parson.c to reach the scanners, once for each scanner variant the host can run.
+
+#include "../parson.c"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MAX_LENGTH (4 * SCAN_BLOCK + 3)
+#define STRING_LENGTH 80
+#define RANDOM_UTF8 50000
+#define SKIP_RETURN_CODE 77
+
+typedef struct {
+	const char* name;
+	size_t (*scan)(const char* s, size_t n);
+	bool (*skippable)(unsigned char c); // what the scanner may jump over
+	bool (*skipped)(unsigned char c);   // what it must jump over, up to the block holding a stop
+	bool exact;                         // returns the stop itself rather than its block
+} Kernel;
+
+static char* guardEnd; // the first byte of an inaccessible page
+static uint32_t randomState = 0x1B873593;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static uint32_t Random(void) {
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static bool IsSpace(unsigned char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static bool IsPlain(unsigned char c) {
+	return c != '\"' && c != '\\' && c >= 0x20;
+}
+
+static bool IsAscii(unsigned char c) {
+	return c < 0x80;
+}
+
+static bool IsBlank(unsigned char c) {
+	return c == ' ';
+}
+
+static const Kernel kernels[] = {
+#if SCAN_BLOCK == 8
+	// The scalar whitespace scanner only jumps over spaces, as indentation is made of
+	{ "scan_spaces", scan_spaces, IsSpace, IsBlank, false },
+	{ "scan_plain", scan_plain, IsPlain, IsPlain, false },
+	{ "scan_ascii", scan_ascii, IsAscii, IsAscii, false },
+#elif defined(__AVX2__) || defined(__SSE2__)
+	{ "scan_spaces", scan_spaces, IsSpace, IsSpace, true },
+	{ "scan_plain", scan_plain, IsPlain, IsPlain, true },
+	{ "scan_ascii", scan_ascii, IsAscii, IsAscii, true },
+#else
+	{ "scan_spaces", scan_spaces, IsSpace, IsSpace, false },
+	{ "scan_plain", scan_plain, IsPlain, IsPlain, false },
+	{ "scan_ascii", scan_ascii, IsAscii, IsAscii, false },
+#endif
+};
+
+/// <summary>
+///     Maps two pages and makes the second inaccessible, so that input copied to end at guardEnd
+///     faults on any read past its end.
+/// </summary>
+static bool MapGuardPage(void) {
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	char* pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED || mprotect(pages + page, page, PROT_NONE) != 0) {
+		return false;
+	}
+	guardEnd = pages + page;
+	return true;
+}
+
+static char* AtGuard(const char* data, size_t length) {
+	memcpy(guardEnd - length, data, length);
+	return guardEnd - length;
+}
+
+static unsigned char RandomSkippable(const Kernel* kernel) {
+	unsigned char c;
+	do {
+		c = (unsigned char)Random();
+	} while (!kernel->skipped(c));
+	return c;
+}
+
+/// <summary>
+///     Scans data ending at the guard page and at the given alignment in an ordinary buffer, and
+///     checks the result skips only skippable bytes and stops no earlier than it must.
+/// </summary>
+static void CheckScan(const Kernel* kernel, const char* data, size_t n, size_t stop, unsigned char stopByte,
+	size_t alignment) {
+	static char aligned[MAX_LENGTH + SCAN_BLOCK] __attribute__((aligned(64)));
+	size_t wholeBlocks = n / SCAN_BLOCK * SCAN_BLOCK;
+	size_t expected = stop < wholeBlocks ? (kernel->exact ? stop : stop / SCAN_BLOCK * SCAN_BLOCK) : wholeBlocks;
+
+	for (int guard = 0; guard <= 1; guard++) {
+		size_t offset = guard ? (size_t)((uintptr_t)(guardEnd - n) % 64) : alignment;
+		const char* s = guard ? AtGuard(data, n) : memcpy(aligned + alignment, data, n);
+		size_t k = kernel->scan(s, n);
+		bool skippable = k <= n;
+		for (size_t i = 0; skippable && i < k; i++) {
+			skippable = kernel->skippable((unsigned char)s[i]);
+		}
+		CHECK(skippable && k >= expected && (!kernel->exact || k == expected),
+			"%s: %zu bytes, 0x%02X at %zu, offset %zu: returned %zu, expected %zu", kernel->name, n, stopByte, stop,
+			offset, k, expected);
+	}
+}
+
+/// <summary>
+///     Whether to try every stop byte at this position rather than a few: at each end of the input
+///     and of each block.
+/// </summary>
+static bool IsEdge(size_t n, size_t stop) {
+	size_t inBlock = stop % SCAN_BLOCK;
+	return stop <= 1 || stop + 1 >= n || inBlock == 0 || inBlock == SCAN_BLOCK - 1;
+}
+
+static void CheckKernels(void) {
+	char data[MAX_LENGTH];
+	unsigned char stops[256];
+
+	for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		const Kernel* kernel = &kernels[k];
+		size_t stopCount = 0;
+		for (unsigned int byte = 0; byte < 256; byte++) {
+			if (!kernel->skipped((unsigned char)byte)) {
+				stops[stopCount++] = (unsigned char)byte;
+			}
+		}
+		for (size_t n = 0; n <= MAX_LENGTH; n++) {
+			// Nothing to stop at
+			for (size_t i = 0; i < n; i++) {
+				data[i] = (char)RandomSkippable(kernel);
+			}
+			CheckScan(kernel, data, n, n, 0, n % SCAN_BLOCK);
+
+			// Bytes that must stop the scan at each position, with anything after them; every such
+			// byte at the edges, a few elsewhere
+			for (size_t stop = 0; stop < n; stop++) {
+				size_t tries = IsEdge(n, stop) ? stopCount : 4;
+				for (size_t t = 0; t < tries; t++) {
+					unsigned char byte = tries == stopCount ? stops[t] : stops[Random() % stopCount];
+					for (size_t i = 0; i < n; i++) {
+						data[i] = (char)(i < stop ? RandomSkippable(kernel) : (unsigned char)Random());
+					}
+					data[stop] = (char)byte;
+					CheckScan(kernel, data, n, stop, byte, (n + stop + t) % SCAN_BLOCK);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+///     Decides UTF-8 validity the long way: shortest forms only, no surrogates, at most U+10FFFF.
+/// </summary>
+static bool IsValidUtf8(const unsigned char* s, size_t n) {
+	size_t i = 0;
+	while (i < n) {
+		unsigned char c = s[i];
+		size_t length = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+		if (length == 0 || i + length > n) {
+			return false;
+		}
+		uint32_t cp = length == 1 ? c : c & (0xFF >> (length + 1));
+		for (size_t j = 1; j < length; j++) {
+			if ((s[i + j] & 0xC0) != 0x80) {
+				return false;
+			}
+			cp = (cp << 6) | (s[i + j] & 0x3F);
+		}
+		static const uint32_t minimum[] = { 0, 0, 0x80, 0x800, 0x10000 };
+		if (cp < minimum[length] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+			return false;
+		}
+		i += length;
+	}
+	return true;
+}
+
+static void CheckUtf8(void) {
+	static const char* const sequences[] = {
+		"\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\x7f", "\x80", "\xbf", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf",
+		"\xed\xa0\x80", "\xed\x9f\xbf", "\xf4\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80", "\xff", "\xc3",
+		"\xe2\x82", "\xf0\x9f\x98"
+	};
+	char text[STRING_LENGTH + 8];
+
+	// Each sequence at each position of an ASCII run, ending the input at the guard page
+	for (size_t q = 0; q < sizeof(sequences) / sizeof(sequences[0]); q++) {
+		size_t sequenceLength = strlen(sequences[q]);
+		for (size_t length = sequenceLength; length <= STRING_LENGTH; length++) {
+			for (size_t at = 0; at + sequenceLength <= length; at++) {
+				memset(text, 'a' + (int)(at % 26), length);
+				memcpy(text + at, sequences[q], sequenceLength);
+				const char* s = AtGuard(text, length);
+				bool expected = IsValidUtf8((const unsigned char*)s, length);
+				CHECK(is_valid_utf8(s, length) == expected, "utf-8: sequence %zu at %zu of %zu %s", q, at, length,
+					expected ? "rejected" : "accepted");
+			}
+		}
+	}
+
+	// Random mixes of ASCII, valid sequences and stray bytes through the public API
+	for (uint32_t i = 0; i < RANDOM_UTF8; i++) {
+		size_t length = 0;
+		while (length < STRING_LENGTH) {
+			uint32_t choice = Random() % 16;
+			if (choice < 12) {
+				text[length++] = (char)(' ' + Random() % 95);
+			}
+			else if (choice < 15) {
+				const char* sequence = sequences[Random() % 4];
+				memcpy(text + length, sequence, strlen(sequence));
+				length += strlen(sequence);
+			}
+			else {
+				text[length++] = (char)(0x80 | Random());
+			}
+		}
+		text[length] = '\0';
+		JSON_Value* value = json_value_init_string(text);
+		CHECK((value != NULL) == IsValidUtf8((const unsigned char*)text, length), "utf-8: random string %u %s", i,
+			value != NULL ? "accepted" : "rejected");
+		json_value_free(value);
+	}
+}
+
+/// <summary>
+///     Parses a quoted string of length plain bytes with insert placed at, ending at the guard page.
+/// </summary>
+static void CheckString(size_t length, size_t at, const char* insert, const char* decoded) {
+	char json[STRING_LENGTH + 32];
+	char expected[STRING_LENGTH + 32];
+	size_t insertLength = strlen(insert);
+
+	json[0] = '\"';
+	for (size_t i = 0; i < length; i++) {
+		json[1 + i] = (char)('A' + (i * 7) % 26);
+	}
+	memcpy(expected, json + 1, at);
+	if (decoded != NULL) {
+		snprintf(expected + at, sizeof(expected) - at, "%s%.*s", decoded, (int)(length - at), json + 1 + at);
+	}
+	memmove(json + 1 + at + insertLength, json + 1 + at, length - at);
+	memcpy(json + 1 + at, insert, insertLength);
+	json[1 + length + insertLength] = '\"';
+	size_t jsonLength = length + insertLength + 2;
+
+	JSON_Value* value = json_parse_buffer(AtGuard(json, jsonLength), jsonLength);
+	const char* string = json_value_get_string(value);
+	if (decoded == NULL) {
+		CHECK(value == NULL, "string: %.*s accepted", (int)jsonLength, json);
+	}
+	else {
+		CHECK(string != NULL && strcmp(string, expected) == 0, "string: %.*s read as %s", (int)jsonLength, json,
+			string != NULL ? string : "(rejected)");
+	}
+	json_value_free(value);
+
+	// Unterminated, the scan must stop at the end of the input
+	value = json_parse_buffer(AtGuard(json, jsonLength - 1), jsonLength - 1);
+	CHECK(value == NULL, "string: unterminated %.*s accepted", (int)jsonLength - 1, json);
+	json_value_free(value);
+}
+
+static void CheckStrings(void) {
+	// What each insert decodes to, or NULL where the string must be rejected
+	static const char* const inserts[][2] = {
+		{ "", "" }, { "\\\"", "\"" }, { "\\\\", "\\" }, { "\\/\\b\\f\\n\\r\\t", "/\b\f\n\r\t" },
+		{ "\\u00e9", "\xc3\xa9" }, { "\\ud83d\\ude00", "\xf0\x9f\x98\x80" }, { "\xc3\xa9", "\xc3\xa9" },
+		{ "\x7f", "\x7f" }, { "\x01", NULL }, { "\x1f", NULL }, { "\t", NULL }, { "\\q", NULL }, { "\\u12", NULL },
+		{ "\\ude00", NULL }, { "\\ud83d", NULL }
+	};
+
+	for (size_t i = 0; i < sizeof(inserts) / sizeof(inserts[0]); i++) {
+		for (size_t length = 0; length <= STRING_LENGTH; length++) {
+			for (size_t at = 0; at <= length; at++) {
+				CheckString(length, at, inserts[i][0], inserts[i][1]);
+			}
+		}
+	}
+}
+
+static void CheckWhitespace(void) {
+	static const char* const runs[] = { " ", "\t", "\r\n", "\n    ", " \t", "\v\f" };
+	char json[2 * STRING_LENGTH + 3];
+
+	for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+		size_t runLength = strlen(runs[r]);
+		for (size_t length = 0; length <= STRING_LENGTH; length++) {
+			// [<run>1<run>] parses, and a stray character anywhere in the first run is refused
+			for (size_t stray = 0; stray <= length; stray++) {
+				size_t n = 0;
+				json[n++] = '[';
+				for (size_t i = 0; i < length; i++) {
+					json[n++] = i == stray ? 'x' : runs[r][i % runLength];
+				}
+				json[n++] = '1';
+				for (size_t i = 0; i < length; i++) {
+					json[n++] = runs[r][i % runLength];
+				}
+				json[n++] = ']';
+
+				JSON_Value* value = json_parse_buffer(AtGuard(json, n), n);
+				bool parsed = json_array_get_number(json_value_get_array(value), 0) == 1.0;
+				CHECK(parsed == (stray == length), "whitespace: run %zu of %zu with a stray at %zu %s", r, length, stray,
+					parsed ? "accepted" : "rejected");
+				json_value_free(value);
+			}
+		}
+	}
+}
+
+int main(void) {
+#if defined(__AVX2__) && defined(__GNUC__)
+	if (!__builtin_cpu_supports("avx2")) {
+		printf("SKIP: no AVX2\n");
+		return SKIP_RETURN_CODE;
+	}
+#endif
+	if (!MapGuardPage()) {
+		perror("guard page");
+		return EXIT_FAILURE;
+	}
+	printf("%d byte blocks\n", SCAN_BLOCK);
+	CheckKernels();
+	CheckUtf8();
+	CheckStrings();
+	CheckWhitespace();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+// Serialization time and size of telemetry shaped trees with the shortest round trip numbers,
+// with two fixed decimal places, and the time printf's %1.17g alone spent on their numbers.
+
+#include "../parson.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BATCH_READINGS 6
+#define SENSORS 8
+#define SERIALIZATIONS 200000
+#define BUFFER_BYTES 4096
+
+// Keeps the compiler from discarding the serialized trees
+static volatile size_t sink;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/// <summary>
+///     A batch of readings as the telemetry batcher sends them when the encoder is JSON.
+/// </summary>
+static JSON_Value* BuildBatch(void) {
+	JSON_Value* batch = json_value_init_array();
+	for (uint32_t n = 0; n < BATCH_READINGS; n++) {
+		JSON_Value* reading = json_value_init_object();
+		JSON_Object* object = json_value_get_object(reading);
+		json_object_set_number(object, "Temperature", 18.0 + (double)(n * 137 % 1500) / 100.0);
+		json_object_set_number(object, "Humidity", 30.0 + (double)(n * 71 % 400) / 10.0);
+		json_object_set_number(object, "Pressure", 1013.25 - (double)n * 0.37);
+		json_object_set_number(object, "MsgId", 41000 + n);
+		json_object_set_string(object, "Timestamp", "2026-10-17T09:30:00.000Z");
+		json_object_dotset_number(object, "Location.lat", 47.6396 + (double)n * 1e-5);
+		json_object_dotset_number(object, "Location.lon", -122.1281 - (double)n * 1e-5);
+		json_array_append_value(json_value_get_array(batch), reading);
+	}
+	return batch;
+}
+
+/// <summary>
+///     Reported properties with per sensor statistics, as a device reports them to its twin.
+/// </summary>
+static JSON_Value* BuildReported(void) {
+	JSON_Value* reported = json_value_init_object();
+	JSON_Object* object = json_value_get_object(reported);
+	json_object_set_string(object, "firmwareVersion", "1.4.2");
+	json_object_set_number(object, "uptimeSeconds", 1234567);
+	json_object_set_boolean(object, "relay1", 1);
+	JSON_Value* sensors = json_value_init_array();
+	for (uint32_t n = 0; n < SENSORS; n++) {
+		JSON_Value* sensor = json_value_init_object();
+		JSON_Object* statistics = json_value_get_object(sensor);
+		json_object_set_number(statistics, "id", n);
+		json_object_set_number(statistics, "min", -4.2 + n * 0.3);
+		json_object_set_number(statistics, "max", 36.9 + n * 0.7);
+		json_object_set_number(statistics, "mean", 21.0 / 3.0 + n);
+		json_object_set_number(statistics, "variance", 0.0123456789 * (n + 1));
+		json_array_append_value(json_value_get_array(sensors), sensor);
+	}
+	json_object_set_value(object, "sensors", sensors);
+	return reported;
+}
+
+static void CollectNumbers(const JSON_Value* value, double* numbers, size_t* count) {
+	switch (json_value_get_type(value)) {
+	case JSONNumber:
+		numbers[(*count)++] = json_value_get_number(value);
+		break;
+	case JSONObject:
+		for (size_t i = 0; i < json_object_get_count(json_value_get_object(value)); i++) {
+			CollectNumbers(json_object_get_value_at(json_value_get_object(value), i), numbers, count);
+		}
+		break;
+	case JSONArray:
+		for (size_t i = 0; i < json_array_get_count(json_value_get_array(value)); i++) {
+			CollectNumbers(json_array_get_value(json_value_get_array(value), i), numbers, count);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void RunSerialize(const char* name, const JSON_Value* tree, int decimals) {
+	static char buffer[BUFFER_BYTES];
+	json_set_number_serialization_decimals(decimals);
+	size_t size = json_serialization_size(tree) - 1;
+
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < SERIALIZATIONS; n++) {
+		json_serialize_to_buffer(tree, buffer, sizeof(buffer));
+		sink += (size_t)buffer[size - 1];
+	}
+	int64_t elapsedNs = NowNs() - startNs;
+	printf("  %-10s %7.2f us/tree %6zu bytes\n", name, (double)elapsedNs / SERIALIZATIONS / 1000.0, size);
+}
+
+/// <summary>
+///     Times formatting only the tree's numbers the way parson did before Grisu2.
+/// </summary>
+static void RunPrintf(const JSON_Value* tree) {
+	double numbers[BUFFER_BYTES / 8];
+	size_t count = 0;
+	char buffer[64];
+	CollectNumbers(tree, numbers, &count);
+
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < SERIALIZATIONS; n++) {
+		for (size_t i = 0; i < count; i++) {
+			sink += (size_t)snprintf(buffer, sizeof(buffer), "%1.17g", numbers[i]);
+		}
+	}
+	int64_t elapsedNs = NowNs() - startNs;
+	printf("  %-10s %7.2f us/tree for its %zu numbers alone\n", "%1.17g", (double)elapsedNs / SERIALIZATIONS / 1000.0,
+		count);
+}
+
+static void Run(const char* name, JSON_Value* tree) {
+	printf("%s\n", name);
+	RunSerialize("shortest", tree, -1);
+	RunSerialize("2 decimals", tree, 2);
+	RunPrintf(tree);
+	json_value_free(tree);
+}
+
+int main(void) {
+	Run("telemetry batch of 6 readings", BuildBatch());
+	Run("reported properties of 8 sensors", BuildReported());
+	return EXIT_SUCCESS;
+}
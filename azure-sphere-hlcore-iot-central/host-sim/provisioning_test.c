@@ -0,0 +1,136 @@
+// Drives the provisioning state machine from a real epoll loop and timer wheel against the
+// mock backend, and checks the retry count, the backoff and its jitter, and that the loop keeps
+// running while an attempt blocks.
+
+#include "../provisioning.h"
+#include "../timer_wheel.h"
+#include "mock_provisioning.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCRIPTED_FAILURES 5
+#define ATTEMPT_LATENCY_MS 40
+#define HEARTBEAT_MS 10
+#define TEST_TIMEOUT_MS 10000
+
+static void HeartbeatEventHandler(EventData* eventData);
+
+static Timer heartbeat = {
+	.eventData = {.eventHandler = &HeartbeatEventHandler },
+	.period = { 0, HEARTBEAT_MS * 1000 * 1000 },
+	.name = "Heartbeat"
+};
+
+static uint32_t heartbeats = 0;
+static uint32_t heartbeatsDuringAttempts = 0;
+static uint32_t completions = 0;
+static uint32_t rejectClients = 0;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static void HeartbeatEventHandler(EventData* eventData) {
+	heartbeats++;
+	if (GetProvisioningState() == ProvisioningState_Provisioning) {
+		heartbeatsDuringAttempts++;
+	}
+}
+
+static bool ClientProvisioned(void* clientHandle) {
+	completions++;
+	if (rejectClients > 0) {
+		rejectClients--;
+		return false;
+	}
+	return true;
+}
+
+/// <summary>
+///     Runs the event loop until provisioning connects or the test times out.
+/// </summary>
+static bool RunUntilConnected(int epollFd) {
+	for (uint32_t i = 0; i < TEST_TIMEOUT_MS / HEARTBEAT_MS; i++) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			return false;
+		}
+		if (GetProvisioningState() == ProvisioningState_Connected) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void CheckBackoff(void) {
+	bool jittered = false;
+
+	// The first attempt is immediate; attempt n follows n - 1 consecutive failures
+	for (uint32_t i = 1; i < MockProvisioning_GetCallCount(); i++) {
+		const MockProvisioningCall* call = MockProvisioning_GetCall(i);
+		const MockProvisioningCall* previous = MockProvisioning_GetCall(i - 1);
+		uint32_t shift = call->consecutiveFailures - 1;
+		uint32_t ceilingMs = PROVISIONING_BACKOFF_MIN_MS << shift;
+		if (ceilingMs > PROVISIONING_BACKOFF_MAX_MS) {
+			ceilingMs = PROVISIONING_BACKOFF_MAX_MS;
+		}
+
+		CHECK(call->consecutiveFailures == i, "attempt %u follows %u failures", i + 1, call->consecutiveFailures);
+		CHECK(call->backoffMs >= ceilingMs / 2 && call->backoffMs <= ceilingMs,
+			"backoff %u ms outside [%u, %u] ms", call->backoffMs, ceilingMs / 2, ceilingMs);
+		// Start times are truncated to whole milliseconds, allow for that on both ends
+		CHECK(call->startMs - previous->startMs + 2 >= ATTEMPT_LATENCY_MS + call->backoffMs,
+			"attempt %u started %u ms after the previous one, before its backoff", i + 1, call->startMs - previous->startMs);
+		jittered |= call->backoffMs != ceilingMs;
+
+		printf("attempt %u: %u failures, backoff %u ms (ceiling %u ms), started at %u ms\n", i + 1,
+			call->consecutiveFailures, call->backoffMs, ceilingMs, call->startMs);
+	}
+
+	CHECK(jittered, "every backoff was exactly its ceiling, no jitter");
+}
+
+int main(void) {
+	int epollFd = CreateEpollFd();
+	if (epollFd < 0 || InitTimerWheel(epollFd, NULL) != 0 ||
+		InitProvisioning(epollFd, "0ne00000000", MockProvisioning_Backend, ClientProvisioned) != 0) {
+		return EXIT_FAILURE;
+	}
+	StartTimer(&heartbeat);
+
+	// Scripted DPS failures are retried with growing, jittered backoff
+	MockProvisioning_Configure(SCRIPTED_FAILURES, ATTEMPT_LATENCY_MS);
+	RequestProvisioning();
+	CHECK(RunUntilConnected(epollFd), "not connected after scripted failures");
+
+	const ProvisioningStats* stats = GetProvisioningStats();
+	CHECK(MockProvisioning_GetCallCount() == SCRIPTED_FAILURES + 1, "%u backend calls", MockProvisioning_GetCallCount());
+	CHECK(stats->failures == SCRIPTED_FAILURES && stats->connects == 1, "%u failures, %u connects", stats->failures, stats->connects);
+	CHECK(stats->consecutiveFailures == 0, "consecutive failures not reset on connect");
+	CHECK(completions == 1, "%u completions", completions);
+	CheckBackoff();
+
+	// The loop ran while each blocking attempt was on the worker thread
+	CHECK(heartbeatsDuringAttempts >= SCRIPTED_FAILURES, "%u heartbeats during %u attempts", heartbeatsDuringAttempts,
+		SCRIPTED_FAILURES + 1);
+	printf("time to connect %u ms, %u heartbeats, %u during attempts\n", stats->lastTimeToConnectMs, heartbeats,
+		heartbeatsDuringAttempts);
+
+	// A client that cannot be set up counts as a failure and is retried after a backoff
+	ResetProvisioning();
+	MockProvisioning_Configure(0, ATTEMPT_LATENCY_MS);
+	rejectClients = 1;
+	RequestProvisioning();
+	CHECK(RunUntilConnected(epollFd), "not connected after a rejected client");
+	CHECK(MockProvisioning_GetCallCount() == 2, "%u backend calls after a rejected client", MockProvisioning_GetCallCount());
+	CHECK(MockProvisioning_GetCall(1) != NULL && MockProvisioning_GetCall(1)->backoffMs >= PROVISIONING_BACKOFF_MIN_MS / 2,
+		"no backoff after a rejected client");
+	CHECK(stats->failures == SCRIPTED_FAILURES + 1 && stats->connects == 2, "%u failures, %u connects", stats->failures,
+		stats->connects);
+
+	StopTimer(&heartbeat);
+	CloseProvisioning();
+	CloseTimerWheel();
+	CloseFdAndPrintError(epollFd, "Epoll");
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,255 @@
+// Drives the telemetry batcher against a stub IoT Hub send function and checks when batches
+// close, the bound on batches in flight, the tagged delivery results and the batching stats.
+
+#include "../telemetry_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SENDS 32
+#define MAX_RESULTS 32
+#define READING_BYTES 10 // "reading-00", so batch sizes are easy to predict
+
+typedef struct {
+	unsigned char payload[TELEMETRY_BATCH_MAX_BYTES];
+	size_t length;
+	const char* contentType;
+	TelemetryDeliveredCallback delivered;
+	void* context;
+	bool settled;
+} StubSend;
+
+typedef struct {
+	uint32_t firstTag;
+	uint32_t lastTag;
+	bool delivered;
+} BatchResult;
+
+static StubSend sends[MAX_SENDS];
+static uint32_t sendCount = 0;
+static bool refuseSends = false;
+static BatchResult results[MAX_RESULTS];
+static uint32_t resultCount = 0;
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+/// <summary>
+///     Stands in for SendMsgBuffer: records the payload and holds its delivery callback until
+///     the test settles it, as IoT Hub confirms a message some DoWork calls later.
+/// </summary>
+static bool StubSendBatch(const unsigned char* msg, size_t length, const char* contentType, const char* contentEncoding,
+	TelemetryDeliveredCallback delivered, void* context) {
+	if (refuseSends || sendCount == MAX_SENDS) {
+		return false;
+	}
+
+	StubSend* send = &sends[sendCount++];
+	memcpy(send->payload, msg, length);
+	send->length = length;
+	send->contentType = contentType;
+	send->delivered = delivered;
+	send->context = context;
+	send->settled = false;
+	return true;
+}
+
+static void Settle(uint32_t sendIndex, bool delivered) {
+	StubSend* send = &sends[sendIndex];
+	if (!send->settled) {
+		send->settled = true;
+		send->delivered(delivered, send->context);
+	}
+}
+
+static void SettleAll(bool delivered) {
+	for (uint32_t i = 0; i < sendCount; i++) {
+		Settle(i, delivered);
+	}
+}
+
+static void RecordResult(uint32_t firstTag, uint32_t lastTag, bool delivered) {
+	if (resultCount < MAX_RESULTS) {
+		results[resultCount++] = (BatchResult){ firstTag, lastTag, delivered };
+	}
+}
+
+/// <summary>
+///     Starts a case with nothing queued or in flight and fresh stats.
+/// </summary>
+static void Reset(size_t maxBytes, size_t maxMessages, long maxAgeMs) {
+	SettleAll(true);
+	TelemetryBatchPolicy policy = { .maxBytes = maxBytes, .maxMessages = maxMessages,
+		.maxAge = { maxAgeMs / 1000, (maxAgeMs % 1000) * 1000 * 1000 } };
+	InitTelemetryBatching(&JsonTelemetryEncoder, &policy, StubSendBatch, RecordResult);
+	sendCount = 0;
+	resultCount = 0;
+	refuseSends = false;
+}
+
+static bool AddReading(uint32_t number, uint32_t tag) {
+	char reading[READING_BYTES + 1];
+	snprintf(reading, sizeof(reading), "reading-%02u", number);
+	return AddTelemetryToBatch((const uint8_t*)reading, READING_BYTES, tag);
+}
+
+static bool PayloadIs(uint32_t sendIndex, const char* expected) {
+	return sendIndex < sendCount && sends[sendIndex].length == strlen(expected) &&
+		memcmp(sends[sendIndex].payload, expected, sends[sendIndex].length) == 0;
+}
+
+static void CheckByteBudget(void) {
+	// "[" + 5 readings + 4 separators + "]" is 56 bytes, a sixth reading would make it 67
+	Reset(64, 100, 60000);
+	for (uint32_t i = 0; i < 5; i++) {
+		CHECK(AddReading(i, TELEMETRY_NO_TAG), "reading %u refused", i);
+	}
+	CHECK(sendCount == 0, "%u sends before the byte budget was reached", sendCount);
+
+	AddReading(5, TELEMETRY_NO_TAG);
+	CHECK(sendCount == 1, "%u sends after the byte budget was reached", sendCount);
+	CHECK(PayloadIs(0, "[reading-00,reading-01,reading-02,reading-03,reading-04]"), "byte budget batch payload %.*s",
+		(int)sends[0].length, sends[0].payload);
+	CHECK(sends[0].contentType != NULL && strcmp(sends[0].contentType, "application/json") == 0, "content type not the encoder's");
+
+	// The message budget closes a batch as soon as it is full
+	Reset(1024, 3, 60000);
+	for (uint32_t i = 0; i < 3; i++) {
+		AddReading(i, TELEMETRY_NO_TAG);
+	}
+	CHECK(sendCount == 1 && PayloadIs(0, "[reading-00,reading-01,reading-02]"), "message budget did not close the batch");
+
+	// A reading that cannot fit in any batch goes on its own, unframed
+	Reset(11, 100, 60000);
+	AddReading(7, 70);
+	CHECK(sendCount == 1 && PayloadIs(0, "reading-07"), "oversized reading not sent on its own");
+	Settle(0, true);
+	CHECK(resultCount == 1 && results[0].firstTag == 70 && results[0].lastTag == 70 && results[0].delivered,
+		"oversized reading result missing");
+}
+
+static void CheckTimeBudget(void) {
+	Reset(1024, 100, 50);
+	AddReading(0, TELEMETRY_NO_TAG);
+	AddReading(1, TELEMETRY_NO_TAG);
+
+	FlushTelemetryBatchIfDue();
+	CHECK(sendCount == 0, "batch flushed before its maxAge");
+
+	const struct timespec wait = { 0, 60 * 1000 * 1000 };
+	nanosleep(&wait, NULL);
+	FlushTelemetryBatchIfDue();
+	CHECK(sendCount == 1 && PayloadIs(0, "[reading-00,reading-01]"), "batch not flushed after its maxAge");
+
+	// The age runs from the first reading of the next batch, not from the flush
+	AddReading(2, TELEMETRY_NO_TAG);
+	FlushTelemetryBatchIfDue();
+	CHECK(sendCount == 1, "new batch flushed before its maxAge");
+}
+
+static void CheckInFlightBound(void) {
+	// One reading per batch, nothing confirmed: only TELEMETRY_BATCH_IN_FLIGHT go out
+	Reset(1024, 1, 60000);
+	for (uint32_t i = 0; i < TELEMETRY_BATCH_IN_FLIGHT + 2; i++) {
+		CHECK(AddReading(i, i), "reading %u refused", i);
+	}
+	CHECK(sendCount == TELEMETRY_BATCH_IN_FLIGHT, "%u sends with none confirmed, bound is %u", sendCount,
+		TELEMETRY_BATCH_IN_FLIGHT);
+
+	// A confirmation frees a slot, the oldest queued batch goes out with the next flush, in order
+	Settle(0, true);
+	CHECK(FlushTelemetryBatch() == false, "queue reported empty with a batch still waiting");
+	CHECK(sendCount == TELEMETRY_BATCH_IN_FLIGHT + 1 && PayloadIs(TELEMETRY_BATCH_IN_FLIGHT, "[reading-04]"),
+		"queued batch not sent in order once a slot was free");
+
+	Settle(1, true);
+	CHECK(FlushTelemetryBatch(), "queue not drained");
+	CHECK(sendCount == TELEMETRY_BATCH_IN_FLIGHT + 2 && PayloadIs(TELEMETRY_BATCH_IN_FLIGHT + 1, "[reading-05]"),
+		"last queued batch not sent");
+
+	// With every slot taken the queue fills and the oldest waiting batch is dropped, and reported
+	Reset(1024, 1, 60000);
+	uint32_t added = TELEMETRY_BATCH_IN_FLIGHT + TELEMETRY_BATCH_QUEUE_LENGTH;
+	for (uint32_t i = 0; i < added; i++) {
+		AddReading(i, 100 + i);
+	}
+	const TelemetryBatchStats* stats = GetTelemetryBatchStats();
+	CHECK(stats->batchesDropped == 1 && stats->messagesDropped == 1, "%u batches dropped", stats->batchesDropped);
+	CHECK(resultCount == 1 && results[0].firstTag == 100 + TELEMETRY_BATCH_IN_FLIGHT && !results[0].delivered,
+		"dropped batch not reported as undelivered");
+}
+
+static void CheckResults(void) {
+	Reset(1024, 4, 60000);
+
+	// Untagged readings are carried but do not widen the tag range
+	AddReading(0, TELEMETRY_NO_TAG);
+	AddReading(1, 11);
+	AddReading(2, 12);
+	AddReading(3, TELEMETRY_NO_TAG);
+	// A batch with no tagged reading reports nothing
+	for (uint32_t i = 4; i < 8; i++) {
+		AddReading(i, TELEMETRY_NO_TAG);
+	}
+	AddReading(8, 20);
+	AddReading(9, 21);
+	FlushTelemetryBatch();
+	CHECK(sendCount == 3, "%u sends", sendCount);
+
+	Settle(1, true);
+	Settle(0, true);
+	Settle(2, false);
+	CHECK(resultCount == 2, "%u results for 3 batches, one untagged", resultCount);
+	CHECK(results[0].firstTag == 11 && results[0].lastTag == 12 && results[0].delivered,
+		"result %u..%u %d", results[0].firstTag, results[0].lastTag, results[0].delivered);
+	CHECK(results[1].firstTag == 20 && results[1].lastTag == 21 && !results[1].delivered,
+		"result %u..%u %d", results[1].firstTag, results[1].lastTag, results[1].delivered);
+
+	const TelemetryBatchStats* stats = GetTelemetryBatchStats();
+	CHECK(stats->batchesFailed == 1 && stats->messagesFailed == 2, "%u batches, %u readings failed", stats->batchesFailed,
+		stats->messagesFailed);
+
+	// A refused send is retried with the next reading, and no result is reported for it meanwhile
+	Reset(1024, 1, 60000);
+	refuseSends = true;
+	AddReading(0, 30);
+	CHECK(sendCount == 0 && resultCount == 0, "refused send reported");
+	refuseSends = false;
+	AddReading(1, 31);
+	CHECK(sendCount == 2 && PayloadIs(0, "[reading-00]"), "refused batch not retried first");
+	SettleAll(true);
+	CHECK(resultCount == 2 && results[0].firstTag == 30 && results[1].firstTag == 31, "retried results out of order");
+}
+
+static void CheckStats(void) {
+	Reset(1024, 6, 60000);
+	for (uint32_t i = 0; i < 12; i++) {
+		AddReading(i, TELEMETRY_NO_TAG);
+	}
+	AddReading(12, TELEMETRY_NO_TAG);
+	FlushTelemetryBatch();
+
+	const TelemetryBatchStats* stats = GetTelemetryBatchStats();
+	CHECK(stats->batchesSent == 3 && stats->messagesSent == 13, "%u batches, %u readings sent", stats->batchesSent,
+		stats->messagesSent);
+	CHECK(stats->lastBatchMessages == 1, "last batch held %u readings", stats->lastBatchMessages);
+	CHECK(stats->messagesSent / stats->batchesSent == 4, "%u readings per batch", stats->messagesSent / stats->batchesSent);
+
+	// Each batch of n saves n - 1 message overheads less its framing: "[", "]" and n - 1 commas
+	int64_t expected = 2 * (5 * TELEMETRY_MESSAGE_OVERHEAD_BYTES - (2 + 5)) + (0 - 2);
+	CHECK(stats->bytesSaved == expected, "%lld bytes saved, expected %lld", (long long)stats->bytesSaved, (long long)expected);
+	printf("%u readings in %u batches, %lld bytes saved\n", stats->messagesSent, stats->batchesSent,
+		(long long)stats->bytesSaved);
+}
+
+int main(void) {
+	CheckByteBudget();
+	CheckTimeBudget();
+	CheckInFlightBound();
+	CheckResults();
+	CheckStats();
+	SettleAll(true);
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,85 @@
+// Encode time and payload bytes of the JSON and CBOR telemetry encoders for the application's
+// reading, against the snprintf template they replaced, for single readings and for batches.
+
+#include "../telemetry.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define READINGS 1000000
+#define BATCH_READINGS 6
+#define BUFFER_BYTES 100
+
+static const TelemetryField telemetryFields[] = {
+	{.name = "Temperature", .type = TelemetryFieldType_Float, .precision = 2 },
+	{.name = "Humidity", .type = TelemetryFieldType_Float, .precision = 1 },
+	{.name = "MsgId", .type = TelemetryFieldType_Int }
+};
+static const TelemetrySchema telemetrySchema = { .fields = telemetryFields, .fieldCount = 3 };
+
+// Keeps the compiler from discarding the encoded messages
+static volatile uint32_t sink;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void Reading(uint32_t n, TelemetryValue values[]) {
+	values[0].f = 18.0f + (float)(n % 1500) / 100.0f;
+	values[1].f = 30.0f + (float)(n % 400) / 10.0f;
+	values[2].i = (int32_t)n;
+}
+
+/// <summary>
+///     The message main.c built before the schema driven encoders.
+/// </summary>
+static int EncodeSnprintf(const TelemetrySchema* schema, const TelemetryValue values[], uint8_t* buffer, size_t bufferSize) {
+	static const char* EventMsgTemplate = "{ \"Temperature\": \"%3.2f\", \"Humidity\": \"%3.1f\", \"MsgId\":%d }";
+	int length = snprintf((char*)buffer, bufferSize, EventMsgTemplate, values[0].f, values[1].f, values[2].i);
+	return length < (int)bufferSize ? length : -1;
+}
+
+static const TelemetryEncoder SnprintfEncoder = {
+	.name = "snprintf",
+	.encode = EncodeSnprintf,
+	.batchOpen = "[",
+	.batchSeparator = ",",
+	.batchClose = "]"
+};
+
+static void Run(const TelemetryEncoder* encoder) {
+	uint8_t buffer[BUFFER_BYTES];
+	TelemetryValue values[3];
+	uint64_t bytes = 0;
+
+	int64_t startNs = NowNs();
+	for (uint32_t n = 0; n < READINGS; n++) {
+		Reading(n, values);
+		int length = encoder->encode(&telemetrySchema, values, buffer, sizeof(buffer));
+		if (length < 0) {
+			fprintf(stderr, "%s: reading %u did not fit %d bytes\n", encoder->name, n, BUFFER_BYTES);
+			exit(EXIT_FAILURE);
+		}
+		bytes += (uint64_t)length;
+		sink += buffer[length - 1];
+	}
+	int64_t elapsedNs = NowNs() - startNs;
+
+	double perReading = (double)bytes / READINGS;
+	double batch = strlen(encoder->batchOpen) + strlen(encoder->batchClose) +
+		(BATCH_READINGS - 1) * strlen(encoder->batchSeparator) + BATCH_READINGS * perReading;
+	printf("%-9s %8.1f ns/reading  %6.1f bytes/reading  %6.1f bytes per batch of %d\n", encoder->name,
+		(double)elapsedNs / READINGS, perReading, batch, BATCH_READINGS);
+}
+
+int main(void) {
+	printf("%d readings of Temperature, Humidity and MsgId\n", READINGS);
+	Run(&SnprintfEncoder);
+	Run(&JsonTelemetryEncoder);
+	Run(&CborTelemetryEncoder);
+	return EXIT_SUCCESS;
+}
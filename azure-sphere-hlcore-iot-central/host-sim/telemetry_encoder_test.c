@@ -0,0 +1,147 @@
+// Checks the exact output of the JSON and CBOR telemetry encoders, and that each fills a buffer
+// of exactly the message size but refuses one a byte shorter without writing past it.
+
+#include "../telemetry.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_BYTES 128
+#define GUARD 0xA5
+
+static int failedChecks = 0;
+
+#define CHECK(condition, ...) do { if (!(condition)) { failedChecks++; fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+static const TelemetryField telemetryFields[] = {
+	{.name = "Temperature", .type = TelemetryFieldType_Float, .precision = 2 },
+	{.name = "Humidity", .type = TelemetryFieldType_Float, .precision = 1 },
+	{.name = "MsgId", .type = TelemetryFieldType_Int }
+};
+static const TelemetrySchema telemetrySchema = { .fields = telemetryFields, .fieldCount = 3 };
+
+static const TelemetryField intField[] = { {.name = "n", .type = TelemetryFieldType_Int } };
+static const TelemetrySchema intSchema = { .fields = intField, .fieldCount = 1 };
+
+typedef struct {
+	float temperature;
+	float humidity;
+	int32_t msgId;
+	const char* json;
+} JsonCase;
+
+static const JsonCase jsonCases[] = {
+	{ 23.45f, 45.6f, 12, "{\"Temperature\":23.45,\"Humidity\":45.6,\"MsgId\":12}" },
+	{ -1.5f, 0.05f, 0, "{\"Temperature\":-1.50,\"Humidity\":0.1,\"MsgId\":0}" },
+	// Rounds up into the integer part, and a negative that rounds to zero has no sign
+	{ 0.995f, -0.04f, -7, "{\"Temperature\":1.00,\"Humidity\":0.0,\"MsgId\":-7}" },
+	// NaN, as a sensor that stopped answering reports, and values too large for the fast path
+	{ NAN, 1e13f, INT32_MIN, "{\"Temperature\":null,\"Humidity\":null,\"MsgId\":-2147483648}" },
+	{ -999999.994f, 100.0f, INT32_MAX, "{\"Temperature\":-1000000.00,\"Humidity\":100.0,\"MsgId\":2147483647}" }
+};
+
+typedef struct {
+	int32_t value;
+	size_t length;
+	uint8_t cbor[8];
+} CborIntCase;
+
+// Map of one key "n" to an integer in its shortest form
+static const CborIntCase cborIntCases[] = {
+	{ 0, 4, { 0xA1, 0x61, 'n', 0x00 } },
+	{ 23, 4, { 0xA1, 0x61, 'n', 0x17 } },
+	{ 24, 5, { 0xA1, 0x61, 'n', 0x18, 0x18 } },
+	{ 255, 5, { 0xA1, 0x61, 'n', 0x18, 0xFF } },
+	{ 256, 6, { 0xA1, 0x61, 'n', 0x19, 0x01, 0x00 } },
+	{ 65536, 8, { 0xA1, 0x61, 'n', 0x1A, 0x00, 0x01, 0x00, 0x00 } },
+	{ -1, 4, { 0xA1, 0x61, 'n', 0x20 } },
+	{ -25, 5, { 0xA1, 0x61, 'n', 0x38, 0x18 } },
+	{ INT32_MIN, 8, { 0xA1, 0x61, 'n', 0x3A, 0x7F, 0xFF, 0xFF, 0xFF } }
+};
+
+static const uint8_t cborReading[] = {
+	0xA3,
+	0x6B, 'T', 'e', 'm', 'p', 'e', 'r', 'a', 't', 'u', 'r', 'e', 0xFA, 0x41, 0xBB, 0x99, 0x9A,
+	0x68, 'H', 'u', 'm', 'i', 'd', 'i', 't', 'y', 0xFA, 0x42, 0x36, 0x66, 0x66,
+	0x65, 'M', 's', 'g', 'I', 'd', 0x0C
+};
+
+/// <summary>
+///     Encodes into a buffer of exactly the message size and into one a byte shorter, each
+///     followed by guard bytes, and checks the first matches and the second is refused.
+/// </summary>
+static void CheckBufferEdge(const TelemetryEncoder* encoder, const TelemetrySchema* schema, const TelemetryValue values[],
+	const uint8_t* expected, size_t length) {
+	uint8_t buffer[BUFFER_BYTES + 4];
+
+	memset(buffer, GUARD, sizeof(buffer));
+	int written = encoder->encode(schema, values, buffer, length);
+	CHECK(written == (int)length && memcmp(buffer, expected, length) == 0, "%s: %zu byte buffer not filled exactly, got %d",
+		encoder->name, length, written);
+	CHECK(buffer[length] == GUARD, "%s: wrote past a %zu byte buffer", encoder->name, length);
+
+	memset(buffer, GUARD, sizeof(buffer));
+	written = encoder->encode(schema, values, buffer, length - 1);
+	CHECK(written == -1, "%s: %zu byte message fitted a %zu byte buffer, returned %d", encoder->name, length, length - 1, written);
+	CHECK(buffer[length - 1] == GUARD, "%s: wrote past a %zu byte buffer", encoder->name, length - 1);
+}
+
+static void CheckJson(void) {
+	for (size_t i = 0; i < sizeof(jsonCases) / sizeof(jsonCases[0]); i++) {
+		const JsonCase* test = &jsonCases[i];
+		TelemetryValue values[3] = { {.f = test->temperature }, {.f = test->humidity }, {.i = test->msgId } };
+		uint8_t buffer[BUFFER_BYTES];
+		size_t length = strlen(test->json);
+
+		int written = JsonTelemetryEncoder.encode(&telemetrySchema, values, buffer, sizeof(buffer));
+		CHECK(written == (int)length && memcmp(buffer, test->json, length) == 0, "json: expected %s, got %.*s", test->json,
+			written < 0 ? 0 : written, buffer);
+		CheckBufferEdge(&JsonTelemetryEncoder, &telemetrySchema, values, (const uint8_t*)test->json, length);
+	}
+
+	// precision is clamped to what the fixed point path supports
+	static const TelemetryField wideField[] = { {.name = "x", .type = TelemetryFieldType_Float, .precision = 9 } };
+	static const TelemetrySchema wideSchema = { .fields = wideField, .fieldCount = 1 };
+	TelemetryValue value = {.f = 0.5f };
+	uint8_t buffer[BUFFER_BYTES];
+	int written = JsonTelemetryEncoder.encode(&wideSchema, &value, buffer, sizeof(buffer));
+	CHECK(written == 14 && memcmp(buffer, "{\"x\":0.500000}", 14) == 0, "json: precision 9 gave %.*s", written < 0 ? 0 : written,
+		buffer);
+}
+
+static void CheckCbor(void) {
+	TelemetryValue values[3] = { {.f = 23.45f }, {.f = 45.6f }, {.i = 12 } };
+	uint8_t buffer[BUFFER_BYTES];
+
+	int written = CborTelemetryEncoder.encode(&telemetrySchema, values, buffer, sizeof(buffer));
+	CHECK(written == (int)sizeof(cborReading) && memcmp(buffer, cborReading, sizeof(cborReading)) == 0,
+		"cbor: reading encoded as %d bytes, expected %zu", written, sizeof(cborReading));
+	CheckBufferEdge(&CborTelemetryEncoder, &telemetrySchema, values, cborReading, sizeof(cborReading));
+
+	for (size_t i = 0; i < sizeof(cborIntCases) / sizeof(cborIntCases[0]); i++) {
+		const CborIntCase* test = &cborIntCases[i];
+		TelemetryValue value = {.i = test->value };
+
+		written = CborTelemetryEncoder.encode(&intSchema, &value, buffer, sizeof(buffer));
+		CHECK(written == (int)test->length && memcmp(buffer, test->cbor, test->length) == 0, "cbor: %d encoded wrong",
+			test->value);
+		CheckBufferEdge(&CborTelemetryEncoder, &intSchema, &value, test->cbor, test->length);
+	}
+
+	// Floats keep full precision and NaN stays NaN
+	TelemetryValue nan = {.f = NAN };
+	static const TelemetryField floatField[] = { {.name = "f", .type = TelemetryFieldType_Float, .precision = 0 } };
+	static const TelemetrySchema floatSchema = { .fields = floatField, .fieldCount = 1 };
+	written = CborTelemetryEncoder.encode(&floatSchema, &nan, buffer, sizeof(buffer));
+	CHECK(written == 8 && buffer[3] == 0xFA && (buffer[4] & 0x7F) == 0x7F && (buffer[5] & 0x80) != 0, "cbor: NaN encoded wrong");
+}
+
+int main(void) {
+	CheckJson();
+	CheckCbor();
+
+	printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+	return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
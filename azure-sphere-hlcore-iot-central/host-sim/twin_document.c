@@ -0,0 +1,62 @@
+#include "twin_document.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef struct {
+	char* next;
+	size_t left;
+	bool overflow;
+} Builder;
+
+static void Put(Builder* builder, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(builder->next, builder->left, format, args);
+	va_end(args);
+
+	if (length < 0 || (size_t)length >= builder->left) {
+		builder->overflow = true;
+		return;
+	}
+	builder->next += length;
+	builder->left -= length;
+}
+
+/// <summary>
+///     Properties, then their $metadata and the section's $version.
+/// </summary>
+static void PutSection(Builder* builder, size_t properties, unsigned version, bool desired) {
+	Put(builder, "{");
+	if (desired) {
+		Put(builder, "\"relay1\":{\"value\":true},\"led1\":{\"value\":false},");
+	}
+	for (size_t i = 0; i < properties; i++) {
+		Put(builder, "\"setting%zu\":{\"value\":%zu.5,\"unit\":\"\\u00b0C\",\"enabled\":%s},", i, i,
+			i % 2 ? "true" : "false");
+	}
+
+	Put(builder, "\"$metadata\":{\"$lastUpdated\":\"2026-10-17T10:00:00.0000000Z\",\"$lastUpdatedVersion\":%u", version);
+	for (size_t i = 0; i < properties; i++) {
+		Put(builder, ",\"setting%zu\":{\"$lastUpdated\":\"2026-10-17T10:%02zu:00.0000000Z\",\"$lastUpdatedVersion\":%u,"
+			"\"value\":{\"$lastUpdated\":\"2026-10-17T10:%02zu:00.0000000Z\"},\"tags\":[1,2.5e3,null,\"x\\\"y\"]}",
+			i, i % 60, version, i % 60);
+	}
+	Put(builder, "},\"$version\":%u}", version);
+}
+
+size_t TwinDocument_Build(char* buffer, size_t size, size_t properties, bool full) {
+	Builder builder = { .next = buffer, .left = size, .overflow = false };
+
+	if (full) {
+		Put(&builder, "{\n  \"desired\": ");
+		PutSection(&builder, properties, 12, true);
+		Put(&builder, ",\n  \"reported\": ");
+		PutSection(&builder, properties, 34, false);
+		Put(&builder, "\n}");
+	}
+	else {
+		PutSection(&builder, properties, 13, true);
+	}
+
+	return builder.overflow ? 0 : (size_t)(builder.next - buffer);
+}
@@ -0,0 +1,16 @@
+#ifndef twin_document_h
+#define twin_document_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// <summary>
+///     Writes a device twin document as IoT Hub sends it, NUL terminated. A full document holds
+///     "desired" and "reported", each with properties properties and a $metadata block recording
+///     when each was last updated, as grows over a device's life. A patch is the desired
+///     properties alone. relay1 and led1 are among the desired properties.
+/// </summary>
+/// <returns>The document length, or 0 if it did not fit</returns>
+size_t TwinDocument_Build(char* buffer, size_t size, size_t properties, bool full);
+
+#endif
@@ -1,9 +1,68 @@
 #include "inter_core.h"
+#include <fcntl.h>
 
 EventData socketEventData = { .eventHandler = &SocketEventHandler };
-void (*_interCoreCallback)(char*);
+InterCoreFrameHandler _interCoreCallback;
 int sockFd = -1;
 
+#define FRAME_HEADER_SIZE sizeof(uint16_t)
+
+// Reusable receive arena. The socket preserves datagram boundaries, so it holds one datagram.
+static uint8_t rxArena[INTER_CORE_MAX_DATAGRAM];
+
+// Bounded outbound queue, used when the inter-core ring is full and flushed on EPOLLOUT
+typedef struct {
+	size_t length;
+	char data[INTER_CORE_MAX_DATAGRAM];
+} OutboundMessage;
+
+static OutboundMessage txQueue[INTER_CORE_TX_QUEUE_LENGTH];
+static size_t txQueueHead = 0;
+static size_t txQueueCount = 0;
+static int _epollFd = -1;
+
+static InterCoreStats interCoreStats;
+
+static bool IsWouldBlock(int error)
+{
+	return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+}
+
+/// <summary>
+///     Adds or removes EPOLLOUT interest depending on whether messages are waiting to be sent.
+/// </summary>
+static int UpdateSocketEpollMask(void)
+{
+	uint32_t mask = txQueueCount > 0 ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	return RegisterEventHandlerToEpoll(_epollFd, sockFd, &socketEventData, mask);
+}
+
+/// <summary>
+///     Sends queued messages in order until the queue is empty or the ring is full again.
+/// </summary>
+/// <returns>false on a socket error other than the ring being full</returns>
+static bool FlushOutboundQueue(void)
+{
+	bool wasQueued = txQueueCount > 0;
+
+	while (txQueueCount > 0) {
+		OutboundMessage* message = &txQueue[txQueueHead];
+		if (send(sockFd, message->data, message->length, 0) == -1) {
+			if (IsWouldBlock(errno)) {
+				break;
+			}
+			Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+			return false;
+		}
+		txQueueHead = (txQueueHead + 1) % INTER_CORE_TX_QUEUE_LENGTH;
+		txQueueCount--;
+	}
+
+	if (wasQueued && txQueueCount == 0) {
+		return UpdateSocketEpollMask() == 0;
+	}
+	return true;
+}
 
 bool SendMessageToRTCore(const char * msg)
 {
@@ -13,17 +72,44 @@ bool SendMessageToRTCore(const char * msg)
 		return false;
 	}
 
-	int bytesSent = send(sockFd, msg, strlen(msg), 0);
-	if (bytesSent == -1) {
-		Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+	size_t length = strlen(msg);
+	if (length > INTER_CORE_MAX_DATAGRAM) {
+		Log_Debug("ERROR: Message of %zu bytes too large for inter-core socket\n", length);
 		return false;
 	}
 
+	// Only send directly if nothing is queued, so that messages stay in order
+	if (txQueueCount == 0) {
+		if (send(sockFd, msg, length, 0) != -1) {
+			return true;
+		}
+		if (!IsWouldBlock(errno)) {
+			Log_Debug("ERROR: Unable to send message: %d (%s)\n", errno, strerror(errno));
+			return false;
+		}
+	}
+
+	if (txQueueCount == INTER_CORE_TX_QUEUE_LENGTH) {
+		interCoreStats.messagesDropped++;
+		Log_Debug("WARNING: Inter-core outbound queue full, message dropped\n");
+		return false;
+	}
+
+	OutboundMessage* message = &txQueue[(txQueueHead + txQueueCount) % INTER_CORE_TX_QUEUE_LENGTH];
+	memcpy(message->data, msg, length);
+	message->length = length;
+	txQueueCount++;
+	interCoreStats.messagesQueued++;
+
+	if (txQueueCount == 1 && UpdateSocketEpollMask() != 0) {
+		return false;
+	}
 	return true;
 }
 
-int InitInterCoreComms(int epollFd, const char * rtAppComponentId, void (*interCoreCallback)(char*)) {
+int InitInterCoreComms(int epollFd, const char * rtAppComponentId, InterCoreFrameHandler interCoreCallback) {
 	_interCoreCallback = interCoreCallback;
+	_epollFd = epollFd;
 	// Open connection to real-time capable application.
 	sockFd = Application_Socket(rtAppComponentId);
 	if (sockFd == -1) {
@@ -31,11 +117,10 @@ int InitInterCoreComms(int epollFd, const char * rtAppComponentId, void (*interC
 		return -1;
 	}
 
-	// Set timeout, to handle case where real-time capable application does not respond.
-	static const struct timeval recvTimeout = { .tv_sec = 5, .tv_usec = 0 };
-	int result = setsockopt(sockFd, SOL_SOCKET, SO_RCVTIMEO, &recvTimeout, sizeof(recvTimeout));
-	if (result == -1) {
-		Log_Debug("ERROR: Unable to set socket timeout: %d (%s)\n", errno, strerror(errno));
+	// Non-blocking, so a stalled real-time capable application can never block the event loop.
+	int flags = fcntl(sockFd, F_GETFL, 0);
+	if (flags == -1 || fcntl(sockFd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		Log_Debug("ERROR: Unable to set socket non-blocking: %d (%s)\n", errno, strerror(errno));
 		return -1;
 	}
 
@@ -46,39 +131,99 @@ int InitInterCoreComms(int epollFd, const char * rtAppComponentId, void (*interC
 	return 0;
 }
 
+const InterCoreStats* GetInterCoreStats(void)
+{
+	return &interCoreStats;
+}
+
 /// <summary>
-///     Handle socket event by reading incoming data from real-time capable application.
+///     Handle socket event by reading all incoming data from real-time capable application
+///     and sending any queued outbound messages.
 /// </summary>
 void SocketEventHandler(EventData* eventData)
 {
-	if (!ProcessMsg()) {
+	if (!ProcessMsg() || !FlushOutboundQueue()) {
 		terminationRequired = true;
 	}
 }
 
+/// <summary>
+///     Logs a received frame, replacing non-printable bytes. The frame itself is left untouched.
+/// </summary>
+static void LogInterCoreFrame(const uint8_t* frame, size_t length)
+{
+	char printable[INTER_CORE_LOG_BYTES + 1];
+	size_t count = length < INTER_CORE_LOG_BYTES ? length : INTER_CORE_LOG_BYTES;
+
+	for (size_t i = 0; i < count; ++i) {
+		printable[i] = isprint(frame[i]) ? (char)frame[i] : '.';
+	}
+	printable[count] = 0;
+
+	Log_Debug("Inter-core frame (%zu bytes): %s%s\n", length, printable, count < length ? "..." : "");
+}
+
+/// <summary>
+///     Hands every complete frame in a datagram to the callback in place. Frames never span
+///     datagrams, so trailing bytes too short for a frame, such as an unframed message from an
+///     older real-time image, are dropped rather than being carried into the next datagram.
+/// </summary>
+static void DispatchFrames(size_t datagramLength)
+{
+	size_t offset = 0;
+	while (datagramLength - offset >= FRAME_HEADER_SIZE) {
+		size_t frameLength = (size_t)(rxArena[offset] | rxArena[offset + 1] << 8);
+		if (datagramLength - offset - FRAME_HEADER_SIZE < frameLength) {
+			break;
+		}
+
+		const uint8_t* frame = rxArena + offset + FRAME_HEADER_SIZE;
+		LogInterCoreFrame(frame, frameLength);
+		_interCoreCallback(frame, frameLength);
+
+		offset += FRAME_HEADER_SIZE + frameLength;
+	}
+
+	if (offset < datagramLength) {
+		interCoreStats.malformedDatagrams++;
+		Log_Debug("WARNING: Dropped %zu unframed bytes from inter-core datagram\n", datagramLength - offset);
+	}
+}
+
 /// <summary>
 ///     Handle socket event by reading incoming data from real-time capable application.
+///     Each datagram is received into the arena and its frames dispatched, until the socket
+///     reports there is nothing more to read.
 /// </summary>
 bool ProcessMsg()
 {
-	char rxBuf[32];
-	char msg[32];
-	memset(msg, 0, sizeof msg);
+	uint32_t messages = 0;
 
-	int bytesReceived = recv(sockFd, rxBuf, sizeof(rxBuf), 0);
+	while (true) {
+		ssize_t bytesReceived = recv(sockFd, rxArena, sizeof(rxArena), 0);
 
-	if (bytesReceived == -1) {
-		//Log_Debug("ERROR: Unable to receive message: %d (%s)\n", errno, strerror(errno));
-		return false;
+		if (bytesReceived == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			Log_Debug("ERROR: Unable to receive message: %d (%s)\n", errno, strerror(errno));
+			return false;
+		}
+
+		if (bytesReceived == 0) {
+			break;
+		}
+
+		messages++;
+		DispatchFrames((size_t)bytesReceived);
 	}
 
-	//Log_Debug("Received %d bytes: ", bytesReceived);
-	for (int i = 0; i < bytesReceived; ++i) {
-		msg[i] = isprint(rxBuf[i]) ? rxBuf[i] : '.';
+	interCoreStats.wakeups++;
+	interCoreStats.messagesReceived += messages;
+	interCoreStats.lastMessagesPerWakeup = messages;
+	if (messages > interCoreStats.maxMessagesPerWakeup) {
+		interCoreStats.maxMessagesPerWakeup = messages;
 	}
-	Log_Debug(msg);
-	
-	_interCoreCallback(msg);
 
 	return true;
 }
\ No newline at end of file
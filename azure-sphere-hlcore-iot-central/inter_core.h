@@ -8,14 +8,43 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 
+// Largest single message the inter-core socket delivers in one recv
+#define INTER_CORE_MAX_DATAGRAM 1024
+// Number of messages held for sending while the inter-core ring is full
+#define INTER_CORE_TX_QUEUE_LENGTH 8
+// Number of payload bytes shown when a received frame is logged
+#define INTER_CORE_LOG_BYTES 64
+
+/// <summary>
+///     Messages from the real-time core are framed as a 16 bit little endian payload length
+///     followed by the payload. A datagram may carry several frames, but a frame never spans
+///     datagrams; incomplete trailing bytes are dropped. The handler is given a pointer into the
+///     receive arena, valid only for the duration of the call, and the payload length. Payloads
+///     are binary and not NUL terminated.
+/// </summary>
+typedef void (*InterCoreFrameHandler)(const uint8_t* frame, size_t length);
+
+typedef struct {
+	uint32_t wakeups;               // socket events handled
+	uint32_t messagesReceived;      // datagrams received across all wakeups
+	uint32_t lastMessagesPerWakeup; // datagrams drained by the most recent wakeup
+	uint32_t maxMessagesPerWakeup;  // largest burst drained by a single wakeup
+	uint32_t messagesQueued;        // outbound messages deferred because the ring was full
+	uint32_t messagesDropped;       // outbound messages dropped because the queue was full
+	uint32_t malformedDatagrams;    // datagrams ending in a partial or unframed message
+} InterCoreStats;
+
+const InterCoreStats* GetInterCoreStats(void);
 bool ProcessMsg(void);
 bool SendMessageToRTCore(const char* msg);
-int InitInterCoreComms(int epollFd, const char* rtAppComponentId, void (*interCoreCallback)(char*));
+int InitInterCoreComms(int epollFd, const char* rtAppComponentId, InterCoreFrameHandler interCoreCallback);
 void SocketEventHandler(EventData* eventData);
 
 #endif
\ No newline at end of file
@@ -3,9 +3,83 @@
 IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle = NULL;
 DeviceTwinPeripheral** _deviceTwins = NULL;
 size_t _deviceTwinCount = 0;
+static DispatchTable twinTable;
+static DispatchTable methodTable;
+// Twin and direct method documents are parsed into this and released in one go when the
+// callback returns. Values from a callback's parse must not be kept past it.
+static JSON_Arena* parseArena = NULL;
 bool iothubAuthenticated = false;
 const int keepalivePeriodSeconds = 20;
 
+// DoWork scheduling: a kick after each send or report, IOT_HUB_DOWORK_FAST_MS while
+// anything is in flight or the hub has just been active, then doubling toward half the keepalive
+static Timer* _doWorkTimer = NULL;
+static uint32_t messagesInFlight = 0;
+static bool hubActivity = false;
+static struct timespec pollWindowStart;
+static uint32_t pollWindowCount = 0;
+static IoTHubStats iotHubStats = { .pollIntervalMs = IOT_HUB_DOWORK_FAST_MS };
+
+// Backoff after IoT Hub fails to accept reported properties, cleared by the next accepted report
+static uint32_t reportRetries = 0;
+static uint32_t reportRetryAtMs = 0;
+
+// Reported properties sent in one document, the context of its ReportStatusCallback
+typedef struct {
+	size_t count;
+	struct {
+		DeviceTwinPeripheral* twin;
+		bool value;
+	} entries[];
+} ReportedStateBatch;
+
+// Context of SendMessageCallback for each message handed to the client
+typedef struct {
+	uint32_t sentMs;
+	MessageDeliveredCallback delivered;
+	void* context;
+} SentMessage;
+
+static void FlushReportedState(void);
+
+static uint32_t NowMs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static void SetDoWorkInterval(uint32_t intervalMs) {
+	if (_doWorkTimer == NULL) {
+		return;
+	}
+	iotHubStats.pollIntervalMs = intervalMs;
+	_doWorkTimer->period.tv_sec = (time_t)(intervalMs / 1000);
+	_doWorkTimer->period.tv_nsec = (long)(intervalMs % 1000) * 1000000;
+	StartTimer(_doWorkTimer);
+}
+
+/// <summary>
+///     Runs DoWork on the next timer wheel tick, so several sends from one handler share it.
+/// </summary>
+static void ScheduleDoWork(void) {
+	hubActivity = true;
+	SetDoWorkInterval(0);
+}
+
+/// <summary>
+///     Accounts for a send or report that has completed. Only a successful one counts as hub
+///     activity that keeps DoWork at the fast rate.
+/// </summary>
+static void MessageSettled(bool delivered) {
+	if (messagesInFlight > 0) {
+		messagesInFlight--;
+	}
+	iotHubStats.messagesInFlight = messagesInFlight;
+	if (delivered) {
+		hubActivity = true;
+	}
+}
+
 
 /// <summary>
 ///     Callback confirming message delivered to IoT Hub.
@@ -14,26 +88,94 @@ const int keepalivePeriodSeconds = 20;
 /// <param name="context">User specified context</param>
 void SendMessageCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
 {
-	Log_Debug("INFO: Message received by IoT Hub. Result is: %d\n", result);
+	SentMessage* sentMessage = context;
+	uint32_t latencyMs = NowMs() - sentMessage->sentMs;
+	bool delivered = result == IOTHUB_CLIENT_CONFIRMATION_OK;
+
+	// Errors, timeouts and messages abandoned when the client is destroyed are not deliveries,
+	// they are left out of the latency figures
+	if (delivered) {
+		iotHubStats.messagesConfirmed++;
+		iotHubStats.lastSendLatencyMs = latencyMs;
+		iotHubStats.totalSendLatencyMs += latencyMs;
+		if (latencyMs > iotHubStats.maxSendLatencyMs) {
+			iotHubStats.maxSendLatencyMs = latencyMs;
+		}
+		Log_Debug("INFO: Message received by IoT Hub, latency %u ms\n", latencyMs);
+	}
+	else {
+		iotHubStats.messagesFailed++;
+		Log_Debug("WARNING: Message not delivered to IoT Hub. Result is: %d, after %u ms\n", result, latencyMs);
+	}
+	MessageSettled(delivered);
+
+	if (sentMessage->delivered != NULL) {
+		sentMessage->delivered(delivered, sentMessage->context);
+	}
+	free(sentMessage);
 }
 
 void AzureDoWorkTimerEventHandler(EventData* eventData) {
+	hubActivity = false;
 	if (iothubClientHandle != NULL) {
+		FlushReportedState();
 		IoTHubDeviceClient_LL_DoWork(iothubClientHandle);
 	}
+
+	iotHubStats.doWorkCalls++;
+	if (++pollWindowCount == 1) {
+		clock_gettime(CLOCK_MONOTONIC, &pollWindowStart);
+	}
+	else {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec - pollWindowStart.tv_sec >= 60) {
+			iotHubStats.pollsLastMinute = pollWindowCount;
+			pollWindowCount = 0;
+		}
+	}
+
+	// Callbacks run inside DoWork set hubActivity, so a method call or twin update keeps the
+	// fast rate for its response
+	uint32_t intervalMs;
+	if (messagesInFlight > 0 || hubActivity) {
+		intervalMs = IOT_HUB_DOWORK_FAST_MS;
+	}
+	else {
+		uint32_t idleMaxMs = (uint32_t)keepalivePeriodSeconds * 1000 / 2;
+
+		intervalMs = iotHubStats.pollIntervalMs * 2;
+		if (intervalMs < IOT_HUB_DOWORK_FAST_MS) {
+			intervalMs = IOT_HUB_DOWORK_FAST_MS;
+		}
+		if (intervalMs > idleMaxMs) {
+			intervalMs = idleMaxMs;
+		}
+	}
+
+	if (intervalMs != iotHubStats.pollIntervalMs) {
+		SetDoWorkInterval(intervalMs);
+	}
+}
+
+const IoTHubStats* GetIoTHubStats(void) {
+	return &iotHubStats;
 }
 
 bool SendMsg(const char* msg) {
-	if (strlen(msg) < 1) {
-		return true;
-	}
+	return SendMsgBuffer((const unsigned char*)msg, strlen(msg), "application/json", "utf-8", NULL, NULL);
+}
 
+/// <summary>
+///     Starts connecting to IoT Hub if the network is ready and the client is not already
+///     authenticated. Does not wait for the connection.
+/// </summary>
+/// <returns>true if the network is ready and the client is authenticated</returns>
+bool ConnectIoTHub(void) {
 	bool isNetworkReady = false;
 	if (Networking_IsNetworkingReady(&isNetworkReady) != -1) {
 		if (isNetworkReady && !iothubAuthenticated) {
-			if (!SetupAzureClient()) {
-				return false;
-			}
+			SetupAzureClient();
 		}
 	}
 	else {
@@ -41,27 +183,51 @@ bool SendMsg(const char* msg) {
 		return false;
 	}
 
-	if (iothubAuthenticated) {
+	return isNetworkReady && iothubAuthenticated;
+}
+
+bool SendMsgBuffer(const unsigned char* msg, size_t length, const char* contentType, const char* contentEncoding,
+	MessageDeliveredCallback delivered, void* context) {
+	if (length < 1) {
+		return false;
+	}
+
+	if (ConnectIoTHub()) {
 
-		IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromString(msg);
+		SentMessage* sentMessage = malloc(sizeof(SentMessage));
+		IOTHUB_MESSAGE_HANDLE messageHandle = sentMessage != NULL ? IoTHubMessage_CreateFromByteArray(msg, length) : NULL;
 
 		if (messageHandle == 0) {
 			Log_Debug("WARNING: unable to create a new IoTHubMessage\n");
+			free(sentMessage);
 			return false;
 		}
+		sentMessage->sentMs = NowMs();
+		sentMessage->delivered = delivered;
+		sentMessage->context = context;
 
-		if (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, SendMessageCallback,
-			/*&callback_param*/ 0) != IOTHUB_CLIENT_OK) {
+		if (contentType != NULL) {
+			IoTHubMessage_SetContentTypeSystemProperty(messageHandle, contentType);
+		}
+		if (contentEncoding != NULL) {
+			IoTHubMessage_SetContentEncodingSystemProperty(messageHandle, contentEncoding);
+		}
+
+		bool sent = IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, SendMessageCallback,
+			sentMessage) == IOTHUB_CLIENT_OK;
+		if (!sent) {
 			Log_Debug("WARNING: failed to hand over the message to IoTHubClient\n");
-			return false;
+			free(sentMessage);
 		}
 		else {
 			Log_Debug("INFO: IoTHubClient accepted the message for delivery\n");
+			iotHubStats.messagesInFlight = ++messagesInFlight;
+			ScheduleDoWork();
 		}
 
 		IoTHubMessage_Destroy(messageHandle);
 
-		return true;
+		return sent;
 	}
 	else {
 		return false;
@@ -70,36 +236,96 @@ bool SendMsg(const char* msg) {
 
 
 /// <summary>
-///     Sets up the Azure IoT Hub connection (creates the iothubClientHandle)
-///     When the SAS Token for a device expires the connection needs to be recreated
-///     which is why this is not simply a one time call.
+///     Provisioning backend, runs on the provisioning worker thread so the DPS timeout no
+///     longer stalls the event loop.
 /// </summary>
-bool SetupAzureClient()
+static void* ProvisionAzureClient(const char* scopeId, unsigned int timeoutMs)
 {
-	if (iothubClientHandle != NULL) {
-		IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
-	}
+	IOTHUB_DEVICE_CLIENT_LL_HANDLE clientHandle = NULL;
 
-	AZURE_SPHERE_PROV_RETURN_VALUE provResult = IoTHubDeviceClient_LL_CreateWithAzureSphereDeviceAuthProvisioning(scopeId, 10000, &iothubClientHandle);
+	AZURE_SPHERE_PROV_RETURN_VALUE provResult = IoTHubDeviceClient_LL_CreateWithAzureSphereDeviceAuthProvisioning(scopeId, timeoutMs, &clientHandle);
 	Log_Debug("IoTHubDeviceClient_LL_CreateWithAzureSphereDeviceAuthProvisioning returned '%s'.\n", getAzureSphereProvisioningResultString(provResult));
 
 	if (provResult.result != AZURE_SPHERE_PROV_RESULT_OK) {
-		Log_Debug("ERROR: failure to create IoTHub Handle.");
+		Log_Debug("ERROR: failure to create IoTHub Handle.\n");
+		return NULL;
+	}
+
+	return clientHandle;
+}
+
+/// <summary>
+///     Provisioning completion, back on the event loop thread with the new client. A client
+///     that cannot be set up is destroyed and provisioning retries after its backoff.
+/// </summary>
+static bool AzureClientProvisioned(void* clientHandle)
+{
+	IOTHUB_DEVICE_CLIENT_LL_HANDLE client = clientHandle;
+
+	if (IoTHubDeviceClient_LL_SetOption(client, OPTION_KEEP_ALIVE, &keepalivePeriodSeconds) != IOTHUB_CLIENT_OK ||
+		IoTHubDeviceClient_LL_SetDeviceTwinCallback(client, TwinCallback, NULL) != IOTHUB_CLIENT_OK ||
+		IoTHubDeviceClient_LL_SetDeviceMethodCallback(client, AzureDirectMethodHandler, NULL) != IOTHUB_CLIENT_OK ||
+		IoTHubDeviceClient_LL_SetConnectionStatusCallback(client, HubConnectionStatusCallback, NULL) != IOTHUB_CLIENT_OK) {
+		Log_Debug("ERROR: failure setting up the IoT Hub client\n");
+		IoTHubDeviceClient_LL_Destroy(client);
 		return false;
 	}
 
+	iothubClientHandle = client;
 	iothubAuthenticated = true;
+	ScheduleDoWork();
+	return true;
+}
 
-	if (IoTHubDeviceClient_LL_SetOption(iothubClientHandle, OPTION_KEEP_ALIVE, &keepalivePeriodSeconds) != IOTHUB_CLIENT_OK) {
-		Log_Debug("ERROR: failure setting option \"%s\"\n", OPTION_KEEP_ALIVE);
-		return false;
+int InitAzureClient(int epollFd, Timer* doWorkTimer)
+{
+	_doWorkTimer = doWorkTimer;
+
+	parseArena = json_arena_create(IOT_HUB_PARSE_ARENA_BYTES);
+	if (parseArena == NULL) {
+		Log_Debug("ERROR: Unable to allocate the JSON parse arena, parsing from the heap\n");
 	}
 
-	IoTHubDeviceClient_LL_SetDeviceTwinCallback(iothubClientHandle, TwinCallback, NULL);
-	IoTHubDeviceClient_LL_SetDeviceMethodCallback(iothubClientHandle, AzureDirectMethodHandler, NULL);
-	IoTHubDeviceClient_LL_SetConnectionStatusCallback(iothubClientHandle, HubConnectionStatusCallback, NULL);
+	return InitProvisioning(epollFd, scopeId, ProvisionAzureClient, AzureClientProvisioned);
+}
 
-	return true;
+void CloseAzureClient(void)
+{
+	CloseProvisioning();
+	FreeDispatchTable(&twinTable);
+	FreeDispatchTable(&methodTable);
+	json_arena_destroy(parseArena);
+	parseArena = NULL;
+
+	if (iothubClientHandle != NULL) {
+		IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
+		iothubClientHandle = NULL;
+	}
+}
+
+/// <summary>
+///     Sets up the Azure IoT Hub connection (recreates the iothubClientHandle)
+///     When the SAS Token for a device expires the connection needs to be recreated
+///     which is why this is not simply a one time call.
+///     Provisioning runs in the background; this returns without waiting and does nothing
+///     while an attempt is running or waiting to retry.
+/// </summary>
+void SetupAzureClient(void)
+{
+	ProvisioningState state = GetProvisioningState();
+	if (state == ProvisioningState_Provisioning || state == ProvisioningState_Backoff) {
+		return;
+	}
+
+	if (iothubClientHandle != NULL) {
+		IoTHubDeviceClient_LL_Destroy(iothubClientHandle);
+		iothubClientHandle = NULL;
+	}
+	// Confirmations for messages sent on the old client are not coming
+	messagesInFlight = iotHubStats.messagesInFlight = 0;
+
+	ResetProvisioning();
+	RequestProvisioning();
 }
 
 /// <summary>
@@ -174,90 +400,185 @@ const char* GetReasonString(IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason)
 void InitDeviceTwins(DeviceTwinPeripheral* deviceTwins[], size_t deviceTwinCount) {
 	_deviceTwins = deviceTwins;
 	_deviceTwinCount = deviceTwinCount;
+
+	if (InitDispatchTable(&twinTable, deviceTwinCount) != 0) {
+		Log_Debug("ERROR: Unable to allocate device twin table\n");
+		return;
+	}
+	for (size_t i = 0; i < deviceTwinCount; i++) {
+		if (!AddDispatchEntry(&twinTable, deviceTwins[i]->twinProperty, deviceTwins[i])) {
+			Log_Debug("ERROR: Device twin property '%s' registered twice\n", deviceTwins[i]->twinProperty);
+		}
+	}
+}
+
+
+/// <summary>
+///     Starts routing parson allocations to the parse arena. Pair with EndParse.
+/// </summary>
+static void BeginParse(void)
+{
+	if (parseArena != NULL) {
+		json_arena_begin(parseArena);
+	}
+}
+
+/// <summary>
+///     Releases everything parsed since BeginParse.
+/// </summary>
+static void EndParse(void)
+{
+	if (parseArena != NULL) {
+		json_arena_end(parseArena);
+	}
+}
+
+/// <summary>
+///     Streams a twin document, descending into "desired" and skipping "reported", $metadata,
+///     $version and unregistered properties without building them. Only the value of each
+///     registered twin property is built, for its handler.
+/// </summary>
+static JSON_Sax_Result TwinKeyHandler(void* context, const char* key, size_t keyLength, size_t depth)
+{
+	// A full twin document nests the desired properties one level down
+	if (depth == 1 && keyLength == strlen("desired") && strncmp(key, "desired", keyLength) == 0) {
+		return JSONSaxContinue;
+	}
+	if (depth <= 2 && FindDispatchEntryN(&twinTable, key, keyLength) != NULL) {
+		return JSONSaxParseValue;
+	}
+	return JSONSaxSkip;
 }
 
+static JSON_Sax_Result TwinValueHandler(void* context, const char* key, size_t keyLength, JSON_Value* value)
+{
+	DeviceTwinPeripheral* deviceTwinPeripheral = FindDispatchEntryN(&twinTable, key, keyLength);
+	JSON_Object* jsonObject = json_value_get_object(value);
+
+	if (deviceTwinPeripheral != NULL && jsonObject != NULL) {
+		SetDesiredState(jsonObject, deviceTwinPeripheral);
+	}
+	return JSONSaxContinue;
+}
+
+static const JSON_Sax_Handler twinSaxHandler = {
+	.on_key = TwinKeyHandler,
+	.on_value = TwinValueHandler
+};
 
 /// <summary>
 ///     Callback invoked when a Device Twin update is received from IoT Hub.
-///     Updates local state for 'showEvents' (bool).
 /// </summary>
 /// <param name="payload">contains the Device Twin JSON document (desired and reported)</param>
 /// <param name="payloadSize">size of the Device Twin JSON document</param>
 void TwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload,
 	size_t payloadSize, void* userContextCallback)
 {
-	JSON_Value* root_value = NULL;
-	JSON_Object* root_object = NULL;
+	hubActivity = true;
 
-	char* payLoadString = (char*)malloc(payloadSize + 1);
-	if (payLoadString == NULL) {
-		goto cleanup;
+	// Parsed straight from the SDK's buffer, which is not NUL terminated
+	BeginParse();
+	if (json_parse_sax_buffer((const char*)payload, payloadSize, &twinSaxHandler, NULL) != JSONSuccess) {
+		Log_Debug("ERROR: Invalid device twin document\n");
 	}
+	EndParse();
+}
 
-	memcpy(payLoadString, payload, payloadSize);
-	payLoadString[payloadSize] = 0; //null terminate string
+/// <summary>
+///     Acts upon the desired state of a device twin, jsonObject is the value of its twinProperty
+/// </summary>
+void SetDesiredState(JSON_Object* jsonObject, DeviceTwinPeripheral* deviceTwinPeripheral) {
+	deviceTwinPeripheral->handler(jsonObject, deviceTwinPeripheral);
+	TwinReportState(deviceTwinPeripheral->twinProperty, deviceTwinPeripheral->twinState);
+}
 
-	root_value = json_parse_string(payLoadString);
-	if (root_value == NULL) {
-		goto cleanup;
+/// <summary>
+///     Queues a reported property. Queued properties are merged into one document sent by the
+///     next DoWork, and a value matching the last one reported is not sent again.
+/// </summary>
+void TwinReportState(const char* propertyName, bool propertyValue)
+{
+	DeviceTwinPeripheral* twin = FindDispatchEntry(&twinTable, propertyName);
+	if (twin == NULL) {
+		Log_Debug("ERROR: '%s' is not a device twin property\n", propertyName);
+		return;
 	}
 
-	root_object = json_value_get_object(root_value);
-	if (root_object == NULL) {
-		goto cleanup;
+	twin->reportPending = !(twin->reportedValid && twin->reportedState == propertyValue);
+	twin->pendingState = propertyValue;
+
+	if (twin->reportPending) {
+		ScheduleDoWork();
 	}
+}
 
+/// <summary>
+///     Sends every queued reported property as a single document. The twins and values sent
+///     travel as the callback context so the cache can be corrected if IoT Hub rejects them.
+/// </summary>
+static void FlushReportedState(void)
+{
+	size_t pendingCount = 0;
+	for (size_t i = 0; i < _deviceTwinCount; i++) {
+		pendingCount += _deviceTwins[i]->reportPending ? 1 : 0;
+	}
 
-	JSON_Object* desiredProperties = json_object_dotget_object(root_object, "desired");
-	if (desiredProperties == NULL) {
-		desiredProperties = root_object;
+	if (pendingCount == 0 || iothubClientHandle == NULL) {
+		return;
 	}
 
-	for (int i = 0; i < _deviceTwinCount; i++) {
-		SetDesiredState(desiredProperties, _deviceTwins[i]);
+	// Wait out the backoff after a failed report, a later DoWork sends it
+	if (reportRetries > 0 && (int32_t)(NowMs() - reportRetryAtMs) < 0) {
+		return;
 	}
 
-cleanup:
-	// Release the allocated memory.
-	if (root_value != NULL) {
-		json_value_free(root_value);
+	ReportedStateBatch* batch = malloc(sizeof(ReportedStateBatch) + pendingCount * sizeof(batch->entries[0]));
+	JSON_Value* root_value = json_value_init_object();
+	JSON_Object* root_object = json_value_get_object(root_value);
+	char* reportedPropertiesString = NULL;
+
+	if (batch == NULL || root_object == NULL) {
+		goto cleanup;
 	}
-	free(payLoadString);
-}
 
-/// <summary>
-///     Checks to see if the device twin twinProperty(name) is found in the json object. If yes, then act upon the request
-/// </summary>
-void SetDesiredState(JSON_Object* desiredProperties, DeviceTwinPeripheral* deviceTwinPeripheral) {
-	JSON_Object* jsonObject = json_object_dotget_object(desiredProperties, deviceTwinPeripheral->twinProperty);
-	if (jsonObject != NULL) {
-		deviceTwinPeripheral->handler(jsonObject, deviceTwinPeripheral);
-		TwinReportState(deviceTwinPeripheral->twinProperty, deviceTwinPeripheral->twinState);
+	batch->count = 0;
+	for (size_t i = 0; i < _deviceTwinCount; i++) {
+		DeviceTwinPeripheral* twin = _deviceTwins[i];
+		if (twin->reportPending) {
+			json_object_set_boolean(root_object, twin->twinProperty, twin->pendingState);
+			batch->entries[batch->count].twin = twin;
+			batch->entries[batch->count].value = twin->pendingState;
+			batch->count++;
+		}
 	}
-}
 
-void TwinReportState(const char* propertyName, bool propertyValue)
-{
-	if (iothubClientHandle == NULL) {
-		Log_Debug("ERROR: client not initialized\n");
+	reportedPropertiesString = json_serialize_to_string(root_value);
+	if (reportedPropertiesString == NULL) {
+		goto cleanup;
 	}
-	else {
-		static char reportedPropertiesString[30] = { 0 };
-		int len = snprintf(reportedPropertiesString, 30, "{\"%s\":%s}", propertyName,
-			(propertyValue == true ? "true" : "false"));
-		if (len < 0)
-			return;
-
-		if (IoTHubDeviceClient_LL_SendReportedState(
-			iothubClientHandle, (unsigned char*)reportedPropertiesString,
-			strlen(reportedPropertiesString), ReportStatusCallback, 0) != IOTHUB_CLIENT_OK) {
-			Log_Debug("ERROR: failed to set reported state for '%s'.\n", propertyName);
-		}
-		else {
-			Log_Debug("INFO: Reported state for '%s' to value '%s'.\n", propertyName,
-				(propertyValue == true ? "true" : "false"));
-		}
+
+	if (IoTHubDeviceClient_LL_SendReportedState(
+		iothubClientHandle, (unsigned char*)reportedPropertiesString,
+		strlen(reportedPropertiesString), ReportStatusCallback, batch) != IOTHUB_CLIENT_OK) {
+		Log_Debug("ERROR: failed to set reported state '%s'.\n", reportedPropertiesString);
+		goto cleanup;
+	}
+
+	Log_Debug("INFO: Reported state %s\n", reportedPropertiesString);
+
+	// Treat the values as reported until IoT Hub says otherwise, so repeats are not resent
+	for (size_t i = 0; i < batch->count; i++) {
+		batch->entries[i].twin->reportedState = batch->entries[i].value;
+		batch->entries[i].twin->reportedValid = true;
+		batch->entries[i].twin->reportPending = false;
 	}
+	batch = NULL; // freed by ReportStatusCallback
+	iotHubStats.messagesInFlight = ++messagesInFlight;
+
+cleanup:
+	json_free_serialized_string(reportedPropertiesString);
+	json_value_free(root_value);
+	free(batch);
 }
 
 
@@ -266,7 +587,46 @@ void TwinReportState(const char* propertyName, bool propertyValue)
 /// </summary>
 void ReportStatusCallback(int result, void* context)
 {
+	ReportedStateBatch* batch = context;
+
 	Log_Debug("INFO: Device Twin reported properties update result: HTTP status code %d\n", result);
+	MessageSettled(result >= 200 && result < 300);
+
+	if (batch == NULL) {
+		return;
+	}
+
+	if (result >= 200 && result < 300) {
+		reportRetries = 0;
+	}
+	else {
+		// A client error other than throttling would be rejected again, so it is not resent
+		bool clientError = result >= 400 && result < 500 && result != 429;
+		bool retry = !clientError && reportRetries < IOT_HUB_REPORT_MAX_RETRIES;
+
+		if (retry) {
+			reportRetryAtMs = NowMs() + ((uint32_t)IOT_HUB_REPORT_RETRY_MS << reportRetries);
+			reportRetries++;
+		}
+		else {
+			Log_Debug("ERROR: Dropping reported properties after HTTP status code %d\n", result);
+			reportRetries = 0;
+		}
+
+		// Report again after the backoff unless a newer value has been queued or reported since
+		for (size_t i = 0; i < batch->count; i++) {
+			DeviceTwinPeripheral* twin = batch->entries[i].twin;
+			if (twin->reportedValid && twin->reportedState == batch->entries[i].value) {
+				twin->reportedValid = false;
+				if (retry && !twin->reportPending) {
+					twin->reportPending = true;
+					twin->pendingState = batch->entries[i].value;
+				}
+			}
+		}
+	}
+
+	free(batch);
 }
 
 #pragma endregion
@@ -274,6 +634,18 @@ void ReportStatusCallback(int result, void* context)
 
 #pragma region Direct Methods
 
+void InitDirectMethods(DirectMethodPeripheral* directMethods[], size_t directMethodCount) {
+	if (InitDispatchTable(&methodTable, directMethodCount) != 0) {
+		Log_Debug("ERROR: Unable to allocate direct method table\n");
+		return;
+	}
+	for (size_t i = 0; i < directMethodCount; i++) {
+		if (!AddDispatchEntry(&methodTable, directMethods[i]->methodName, directMethods[i])) {
+			Log_Debug("ERROR: Direct method '%s' registered twice\n", directMethods[i]->methodName);
+		}
+	}
+}
+
 int AzureDirectMethodHandler(const char* method_name, const unsigned char* payload, size_t payloadSize,
 	unsigned char** responsePayload, size_t* responsePayloadSize, void* userContextCallback) {
 
@@ -285,22 +657,16 @@ int AzureDirectMethodHandler(const char* method_name, const unsigned char* paylo
 	JSON_Value* root_value = NULL;
 	JSON_Object* root_object = NULL;
 
+	hubActivity = true;
+
 	// Prepare the payload for the response. This is a heap allocated null terminated string.
 	// The Azure IoT Hub SDK is responsible of freeing it.
 	*responsePayload = NULL;  // Response payload content.
 	*responsePayloadSize = 0; // Response payload content size.
 
-	char* payLoadString = (char*)malloc(payloadSize + 1);
-	if (payLoadString == NULL) {
-		responseMessage = "payload memory failed";
-		result = 500;
-		goto cleanup;
-	}
-
-	memcpy(payLoadString, payload, payloadSize);
-	payLoadString[payloadSize] = 0; //null terminate string
+	BeginParse();
 
-	root_value = json_parse_string(payLoadString);
+	root_value = json_parse_buffer((const char*)payload, payloadSize);
 	if (root_value == NULL) {
 		responseMessage = "Invalid JSON";
 		result = 500;
@@ -314,10 +680,10 @@ int AzureDirectMethodHandler(const char* method_name, const unsigned char* paylo
 		goto cleanup;
 	}
 
-	if (strcmp(method_name, "fanspeed") == 0)
+	DirectMethodPeripheral* directMethod = FindDispatchEntry(&methodTable, method_name);
+	if (directMethod != NULL)
 	{
-		int speed = (int)json_object_get_number(root_object, "speed");
-		Log_Debug("Set fan speed %d", speed);
+		directMethod->handler(root_object, &directMethod->peripheral);
 	}
 	else
 	{
@@ -336,7 +702,7 @@ cleanup:
 	if (root_value != NULL) {
 		json_value_free(root_value);
 	}
-	free(payLoadString);
+	EndParse();
 
 	return result;
 }
@@ -1,24 +1,77 @@
 #ifndef iot_hub_h
 #define iot_hub_h
 
+#include "dispatch_table.h"
 #include "globals.h"
 #include "parson.h"
+#include "provisioning.h"
+#include "timer_wheel.h"
 #include <applibs/log.h>
 #include <applibs/networking.h>
 #include <azure_sphere_provisioning.h>
 #include <errno.h>
 #include <iothub_client_options.h>
 #include <iothub_device_client_ll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #pragma region Azure IoT Hub/IoT Central
 
+// DoWork interval while messages are in flight or the hub has just been active. When idle the
+// interval doubles up to half the MQTT keepalive period.
+#ifndef IOT_HUB_DOWORK_FAST_MS
+#define IOT_HUB_DOWORK_FAST_MS 100
+#endif
+
+// Delay before resending reported properties IoT Hub failed to accept, doubling on each further
+// failure. Reports are dropped after IOT_HUB_REPORT_MAX_RETRIES resends, and a 4xx rejection
+// other than 429 (throttled) is not resent at all.
+#ifndef IOT_HUB_REPORT_RETRY_MS
+#define IOT_HUB_REPORT_RETRY_MS 1000
+#endif
+#ifndef IOT_HUB_REPORT_MAX_RETRIES
+#define IOT_HUB_REPORT_MAX_RETRIES 5
+#endif
+
+// Initial size of the arena the twin and direct method callbacks parse into. It grows to fit the
+// largest document seen, after which the callbacks make no heap allocations.
+#ifndef IOT_HUB_PARSE_ARENA_BYTES
+#define IOT_HUB_PARSE_ARENA_BYTES 4096
+#endif
+
+typedef struct {
+	uint32_t doWorkCalls;        // DoWork calls since start
+	uint32_t pollIntervalMs;     // current DoWork interval
+	uint32_t pollsLastMinute;    // DoWork calls in the last full minute, the effective poll rate
+	uint32_t messagesInFlight;   // sends and reported state updates awaiting confirmation
+	uint32_t messagesConfirmed;  // sends confirmed by IoT Hub
+	uint32_t messagesFailed;     // sends that errored, timed out or were abandoned with the client
+	uint32_t lastSendLatencyMs;  // hand over to the client until confirmation, most recent send
+	uint32_t maxSendLatencyMs;
+	uint64_t totalSendLatencyMs; // divide by messagesConfirmed for the mean
+} IoTHubStats;
+
+/// <summary>
+///     Told whether a message sent with SendMsgBuffer was confirmed by IoT Hub. Called exactly
+///     once, from DoWork or when the client is destroyed, for each message SendMsgBuffer accepted.
+/// </summary>
+typedef void (*MessageDeliveredCallback)(bool delivered, void* context);
+
+const IoTHubStats* GetIoTHubStats(void);
+extern bool iothubAuthenticated;
+
+bool ConnectIoTHub(void);
 bool SendMsg(const char* msg);
+bool SendMsgBuffer(const unsigned char* msg, size_t length, const char* contentType, const char* contentEncoding,
+	MessageDeliveredCallback delivered, void* context);
 const char* getAzureSphereProvisioningResultString(AZURE_SPHERE_PROV_RETURN_VALUE provisioningResult);
 const char* GetReasonString(IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason);
 void SendMessageCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT, void* );
-bool SetupAzureClient(void);
+void SetupAzureClient(void);
+int InitAzureClient(int epollFd, Timer* doWorkTimer);
+void CloseAzureClient(void);
 void HubConnectionStatusCallback(IOTHUB_CLIENT_CONNECTION_STATUS, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, void*);
 void AzureDoWorkTimerEventHandler(EventData*);
 
@@ -27,7 +80,7 @@ void AzureDoWorkTimerEventHandler(EventData*);
 #pragma region Device Twins
 
 void TwinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char* payload, size_t payloadSize, void* userContextCallback);
-void SetDesiredState(JSON_Object* desiredProperties, DeviceTwinPeripheral* deviceTwinPeripheral);
+void SetDesiredState(JSON_Object* jsonObject, DeviceTwinPeripheral* deviceTwinPeripheral);
 void TwinReportState(const char* propertyName, bool propertyValue);
 void ReportStatusCallback(int result, void* context);
 void InitDeviceTwins(DeviceTwinPeripheral* deviceTwins[], size_t deviceTwinCount);
@@ -36,6 +89,7 @@ void InitDeviceTwins(DeviceTwinPeripheral* deviceTwins[], size_t deviceTwinCount
 
 #pragma region Direct Methods
 
+void InitDirectMethods(DirectMethodPeripheral* directMethods[], size_t directMethodCount);
 int AzureDirectMethodHandler(const char* method_name, const unsigned char* payload, size_t payloadSize,
 	unsigned char** responsePayload, size_t* responsePayloadSize, void* userContextCallback);
 
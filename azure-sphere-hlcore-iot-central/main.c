@@ -3,8 +3,14 @@
 #include "globals.h"
 #include "inter_core.h"
 #include "iot_hub.h"
+#include "sensor_sampler.h"
+#include "telemetry.h"
+#include "telemetry_batch.h"
+#include "telemetry_store.h"
+#include "timer_wheel.h"
 #include <applibs/gpio.h>
 #include <applibs/log.h>
+#include <applibs/storage.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <time.h>
@@ -15,23 +21,38 @@
 #define RELAY_PIN 0
 #define FAN_PIN 4
 #define JSON_MESSAGE_BYTES 100  // Number of bytes to allocate for the JSON telemetry message for IoT Central
+#define TELEMETRY_STORE_BYTES (16 * 1024)  // Must not exceed MutableStorage SizeKB in app_manifest.json
+#define TELEMETRY_REPLAY_PER_TICK 3  // Stored readings sent per replay timer tick once reconnected
+#define TELEMETRY_BATCH_MESSAGES 6  // Readings per telemetry batch
+// Readings sent directly are kept until IoT Hub confirms them, to be stored if their batch fails.
+// Enough for every batch the batcher can hold, queued or in flight.
+#define LIVE_READINGS ((TELEMETRY_BATCH_QUEUE_LENGTH + TELEMETRY_BATCH_IN_FLIGHT) * TELEMETRY_BATCH_MESSAGES)
+// Set in the batch tag of a reading sent directly, whose tag is its sequence number. Other tags are
+// store record indexes.
+#define LIVE_TAG 0x80000000u
 
 static char msgBuffer[JSON_MESSAGE_BYTES] = { 0 };
 static char rtAppComponentId[RT_APP_COMPONENT_LENGTH];  //initialized from cmdline argument
 
 static int epollFd = -1;
+static int storeFd = -1;
 static int i2cFd;
 static void* sht31;
+static uint32_t msgId = 0;
 
 // Forward signatures
 static void TerminationHandler(int signalNumber);
 static int InitPeripheralsAndHandlers(void);
 static void ClosePeripheralsAndHandlers(void);
-static void InterCoreHandler(char* msg);
+static void InterCoreHandler(const uint8_t* frame, size_t length);
 static void SendTelemetryEventHandler(EventData* eventData);
+static void SensorSampleCompleteHandler(void* sensor);
+static bool ReplayTelemetry(uint32_t index, uint32_t sequence, const TelemetryValue values[], size_t valueCount);
+static void TelemetryBatchResult(uint32_t firstTag, uint32_t lastTag, bool delivered);
+static void TelemetryBatchFlushEventHandler(EventData* eventData);
+static void ReplayTelemetryEventHandler(EventData* eventData);
 static void RtCoreHeartBeat(EventData* eventData);
 static int OpenPeripheral(Peripheral* peripheral);
-static int StartTimer(Timer* timer);
 static void DeviceTwinHandler(JSON_Object* json, DeviceTwinPeripheral* deviceTwinPeripheral);
 static void SetFanSpeed(JSON_Object* json, Peripheral* peripheral);
 static int InitFanPWM(struct _peripheral* peripheral);
@@ -52,7 +73,7 @@ static DeviceTwinPeripheral light = {
 
 static DirectMethodPeripheral fan = {
 	.peripheral = {.fd = -1, .pin = FAN_PIN, .initialState = GPIO_Value_Low, .invertPin = false, .initialise = InitFanPWM, .name = "fan1" },
-	.methodName = "fan1",
+	.methodName = "fanspeed",
 	.handler = SetFanSpeed
 };
 
@@ -60,9 +81,19 @@ static ActuatorPeripheral sendStatus = {
 	.peripheral = {.fd = -1, .pin = SEND_STATUS_PIN, .initialState = GPIO_Value_High, .invertPin = true, .initialise = OpenPeripheral, .name = "SendStatus" }
 };
 
+// Conversion waits run on the event loop, the reading is sent from SensorSampleCompleteHandler
+static SensorSampler sht31Sampler = {
+	.eventData = {.fd = -1 },
+	.start = GroveTempHumiSHT31_StartRead,
+	.finish = GroveTempHumiSHT31_FinishRead,
+	.onComplete = SensorSampleCompleteHandler,
+	.name = "SHT31"
+};
+
+// Period adapted at run time by AzureDoWorkTimerEventHandler
 static Timer iotClientDoWork = {
 	.eventData = {.eventHandler = &AzureDoWorkTimerEventHandler },
-	.period = { 1, 0 },
+	.period = { 0, IOT_HUB_DOWORK_FAST_MS * 1000 * 1000 },
 	.name = "DoWork"
 };
 static Timer measureSensor = {
@@ -70,18 +101,57 @@ static Timer measureSensor = {
 	.period = { 10, 0 },
 	.name = "MeasureSensor"
 };
+static Timer telemetryBatchFlush = {
+	.eventData = {.eventHandler = &TelemetryBatchFlushEventHandler },
+	.period = { 5, 0 },
+	.name = "TelemetryBatchFlush"
+};
+static Timer replayTelemetry = {
+	.eventData = {.eventHandler = &ReplayTelemetryEventHandler },
+	.period = { 1, 0 },
+	.name = "ReplayTelemetry"
+};
 static Timer rtCoreHeatBeat = {
 	.eventData = {.eventHandler = &RtCoreHeartBeat },
 	.period = { 30, 0 },
 	.name = "rtCoreSend"
 };
 
+// Timers falling due within the same window share one wakeup, at the end of the window
+static const struct timespec timerSlack = { 0, 100 * 1000 * 1000 };
+
+// Telemetry fields, in the order ReadTelemetry supplies their values
+static const TelemetryField telemetryFields[] = {
+	{.name = "Temperature", .type = TelemetryFieldType_Float, .precision = 2 },
+	{.name = "Humidity", .type = TelemetryFieldType_Float, .precision = 1 },
+	{.name = "MsgId", .type = TelemetryFieldType_Int }
+};
+static const TelemetrySchema telemetrySchema = { .fields = telemetryFields, .fieldCount = NELEMS(telemetryFields) };
+
+typedef struct {
+	uint32_t sequence;
+	TelemetryValue values[NELEMS(telemetryFields)];
+} LiveReading;
+
+// Readings sent directly, in slot sequence % LIVE_READINGS until overwritten
+static LiveReading liveReadings[LIVE_READINGS];
+
+// IoT Central expects JSON; CborTelemetryEncoder can be used with a backend that decodes CBOR
+static const TelemetryEncoder* telemetryEncoder = &JsonTelemetryEncoder;
+
+// Readings are sent as one array per minute, or sooner if six readings or 1KB accumulate
+static const TelemetryBatchPolicy telemetryBatchPolicy = {
+	.maxBytes = 1024,
+	.maxMessages = TELEMETRY_BATCH_MESSAGES,
+	.maxAge = { 60, 0 }
+};
+
 #pragma region define sets for auto initialisation and close
 
 DeviceTwinPeripheral* deviceTwinDevices[] = { &relay, &light };
 DirectMethodPeripheral* directMethodDevices[] = { &fan };
 ActuatorPeripheral* actuatorDevices[] = { &sendStatus };
-Timer* timers[] = { &iotClientDoWork, &measureSensor, &rtCoreHeatBeat };
+Timer* timers[] = { &iotClientDoWork, &measureSensor, &telemetryBatchFlush, &replayTelemetry, &rtCoreHeatBeat };
 
 #pragma endregion
 
@@ -121,38 +191,133 @@ int main(int argc, char* argv[])
 }
 
 /// <summary>
-///     Reads telemetry and returns the data as a JSON object.
+///     Reads telemetry into values, in the order of telemetryFields.
 /// </summary>
-static int ReadTelemetry(char eventBuffer[], size_t len) {
-	static int msgId = 0;
-	GroveTempHumiSHT31_Read(sht31);
-	float temperature = GroveTempHumiSHT31_GetTemperature(sht31);
-	float humidity = GroveTempHumiSHT31_GetHumidity(sht31);
-
-	static const char* EventMsgTemplate = "{ \"Temperature\": \"%3.2f\", \"Humidity\": \"%3.1f\", \"MsgId\":%d }";
-	return snprintf(eventBuffer, len, EventMsgTemplate, temperature, humidity, msgId++);
+/// <returns>The sequence number of the reading, also sent as MsgId</returns>
+static uint32_t ReadTelemetry(TelemetryValue values[]) {
+	values[0].f = GroveTempHumiSHT31_GetTemperature(sht31);
+	values[1].f = GroveTempHumiSHT31_GetHumidity(sht31);
+	values[2].i = (int32_t)msgId;
+
+	return msgId++;
 }
 
 /// <summary>
-/// Azure timer event:  Check connection status and send telemetry
+///     Encodes a reading with the selected telemetry encoder and adds it to the telemetry batch.
+///     The batch tag of a stored reading is its store record index, so the store is told when
+///     IoT Hub confirms it, that of a reading sent directly is its sequence number with LIVE_TAG.
 /// </summary>
-static void SendTelemetryEventHandler(EventData* eventData)
-{
-	if (ConsumeTimerFdEvent(measureSensor.fd) != 0) {
-		terminationRequired = true;
+static bool SendTelemetry(const TelemetryValue values[], uint32_t tag) {
+	static bool liveBatch = false;
+
+	// The result of a batch goes either to the store or to liveReadings, never both
+	if (((tag & LIVE_TAG) != 0) != liveBatch) {
+		FlushTelemetryBatch();
+		liveBatch = !liveBatch;
+	}
+
+	int len = telemetryEncoder->encode(&telemetrySchema, values, (uint8_t*)msgBuffer, JSON_MESSAGE_BYTES);
+	return len > 0 && AddTelemetryToBatch((const uint8_t*)msgBuffer, (size_t)len, tag);
+}
+
+/// <summary>
+///     Sends a reading directly, keeping it in liveReadings so it can be stored if not delivered.
+/// </summary>
+static bool SendLiveTelemetry(uint32_t sequence, const TelemetryValue values[]) {
+	LiveReading* reading = &liveReadings[sequence % LIVE_READINGS];
+	reading->sequence = sequence;
+	memcpy(reading->values, values, sizeof(reading->values));
+
+	return SendTelemetry(values, (sequence & ~LIVE_TAG) | LIVE_TAG);
+}
+
+/// <summary>
+///     Telemetry batch result: confirms or rewinds stored readings, and stores readings sent
+///     directly that did not reach IoT Hub, so they are replayed once it is reachable again.
+/// </summary>
+static void TelemetryBatchResult(uint32_t firstTag, uint32_t lastTag, bool delivered) {
+	if ((firstTag & LIVE_TAG) == 0) {
+		AcknowledgeStoredTelemetry(firstTag, lastTag, delivered);
 		return;
 	}
+	if (delivered) {
+		return;
+	}
+
+	for (uint32_t tag = firstTag; tag <= lastTag; tag++) {
+		uint32_t sequence = tag & ~LIVE_TAG;
+		const LiveReading* reading = &liveReadings[sequence % LIVE_READINGS];
 
+		if ((reading->sequence & ~LIVE_TAG) != sequence || !StoreTelemetry(reading->sequence, reading->values, NELEMS(reading->values))) {
+			Log_Debug("WARNING: Undelivered reading %u could not be stored, it is lost\n", sequence);
+		}
+	}
+	SyncTelemetryStore();
+}
+
+/// <summary>
+/// Azure timer event:  Start a reading, it is sent by SensorSampleCompleteHandler once the sensor has converted
+/// </summary>
+static void SendTelemetryEventHandler(EventData* eventData)
+{
 	GPIO_ON(sendStatus.peripheral); // blink send status LED
 
-	if (ReadTelemetry(msgBuffer, JSON_MESSAGE_BYTES) > 0) {
-		SendMsg(msgBuffer);
+	if (!StartSensorSample(&sht31Sampler) && !sht31Sampler.pending) {
+		GPIO_OFF(sendStatus.peripheral);
+	}
+}
+
+/// <summary>
+///     Send the completed reading if connected, otherwise store it
+/// </summary>
+static void SensorSampleCompleteHandler(void* sensor)
+{
+	TelemetryValue values[NELEMS(telemetryFields)];
+
+	uint32_t sequence = ReadTelemetry(values);
+	bool connected = ConnectIoTHub();
+
+	// Readings go straight to IoT Hub while it is reachable, and are written to flash only when it
+	// is not or their batch fails. Stored readings stay in the store until IoT Hub confirms them,
+	// so a reboot cannot lose them, and later readings queue behind them to keep the order.
+	bool sent = connected && GetStoredTelemetryCount() == 0 && SendLiveTelemetry(sequence, values);
+
+	if (!sent) {
+		if (!StoreTelemetry(sequence, values, NELEMS(values)) || !SyncTelemetryStore()) {
+			Log_Debug("WARNING: Reading %u could not be sent or stored, it is lost\n", sequence);
+		}
+		else if (connected) {
+			ReplayStoredTelemetry(ReplayTelemetry, TELEMETRY_REPLAY_PER_TICK);
+		}
 	}
 
 	GPIO_OFF(sendStatus.peripheral);
 }
 
-static void InterCoreHandler(char* msg) {
+static bool ReplayTelemetry(uint32_t index, uint32_t sequence, const TelemetryValue values[], size_t valueCount) {
+	return SendTelemetry(values, index);
+}
+
+/// <summary>
+/// Timer event:  Send stored readings, including any to resend after a failed delivery, a few per tick so
+/// replay does not hog the event loop
+/// </summary>
+static void ReplayTelemetryEventHandler(EventData* eventData)
+{
+	if (iothubAuthenticated && GetStoredTelemetryCount() > 0) {
+		ReplayStoredTelemetry(ReplayTelemetry, TELEMETRY_REPLAY_PER_TICK);
+	}
+}
+
+/// <summary>
+/// Timer event:  Send the telemetry batch once its oldest reading is due
+/// </summary>
+static void TelemetryBatchFlushEventHandler(EventData* eventData)
+{
+	FlushTelemetryBatchIfDue();
+}
+
+static void InterCoreHandler(const uint8_t* frame, size_t length) {
 	static int buttonPressCount = 0;
 	const struct timespec sleepTime = { 0, 100000000L };
 
@@ -208,14 +373,37 @@ static int InitPeripheralsAndHandlers(void)
 	OPEN_PERIPHERAL_SET(directMethodDevices);
 
 	InitDeviceTwins(deviceTwinDevices, NELEMS(deviceTwinDevices));
+	InitDirectMethods(directMethodDevices, NELEMS(directMethodDevices));
+	if (InitAzureClient(epollFd, &iotClientDoWork) != 0) {
+		return -1;
+	}
+	SetTelemetryBatchLog(Log_Debug);
+	InitTelemetryBatching(telemetryEncoder, &telemetryBatchPolicy, SendMsgBuffer, TelemetryBatchResult);
+
+	// Readings are kept in mutable storage until delivered, continue numbering after them
+	storeFd = Storage_OpenMutableFile();
+	if (storeFd < 0 || InitTelemetryStore(storeFd, TELEMETRY_STORE_BYTES, NELEMS(telemetryFields), &msgId) != 0) {
+		Log_Debug("WARNING: Telemetry store unavailable, readings taken while offline will be lost\n");
+	}
 
 	// Initialize Grove Shield and Grove Temperature and Humidity Sensor
 	GroveShield_Initialize(&i2cFd, 115200);
 	sht31 = GroveTempHumiSHT31_Open(i2cFd);
+	// The sensor converts every 2 s by itself so a reading is one fetch, falls back to single shot if refused
+	if (!GroveTempHumiSHT31_StartPeriodic(sht31, GroveTempHumiSHT31_Periodic_0_5Mps)) {
+		Log_Debug("WARNING: SHT31 periodic mode unavailable, using single shot reads\n");
+	}
+	sht31Sampler.sensor = sht31;
+	if (InitSensorSampler(epollFd, &sht31Sampler) != 0) {
+		return -1;
+	}
 
 	InitInterCoreComms(epollFd, rtAppComponentId, InterCoreHandler);  // Initialize Inter Core Communications
 	SendMessageToRTCore("HeartBeat"); // Prime RT Core with Component ID Signature
 
+	if (InitTimerWheel(epollFd, &timerSlack) != 0) {
+		return -1;
+	}
 	START_TIMER_SET(timers);
 
 	return 0;
@@ -229,11 +417,15 @@ static void ClosePeripheralsAndHandlers(void)
 	Log_Debug("Closing file descriptors\n");
 
 	STOP_TIMER_SET(timers);
+	CloseAzureClient();
+	CloseTimerWheel();
+	CloseSensorSampler(&sht31Sampler);
 
 	CLOSE_PERIPHERAL_SET(actuatorDevices);
 	CLOSE_PERIPHERAL_SET(deviceTwinDevices);
 	CLOSE_PERIPHERAL_SET(directMethodDevices);
 
+	CloseFdAndPrintError(storeFd, "TelemetryStore");
 	CloseFdAndPrintError(epollFd, "Epoll");
 }
 
@@ -242,7 +434,8 @@ static int InitFanPWM(struct _peripheral* peripheral) {
 }
 
 static void SetFanSpeed(JSON_Object* json, Peripheral* peripheral) {
-
+	int speed = (int)json_object_get_number(json, "speed");
+	Log_Debug("Set fan speed %d\n", speed);
 }
 
 static int OpenPeripheral(Peripheral* peripheral) {
@@ -256,14 +449,6 @@ static int OpenPeripheral(Peripheral* peripheral) {
 	return 0;
 }
 
-static int StartTimer(Timer* timer) {
-	timer->fd = CreateTimerFdAndAddToEpoll(epollFd, &timer->period, &timer->eventData, EPOLLIN);
-	if (timer->fd < 0) {
-		return -1;
-	}
-	return 0;
-}
-
 
 static void TerminationHandler(int signalNumber)
 {
@@ -278,11 +463,6 @@ static void RtCoreHeartBeat(EventData* eventData)
 {
 	static int heartBeatCount = 0;
 
-	if (ConsumeTimerFdEvent(rtCoreHeatBeat.fd) != 0) {
-		terminationRequired = true;
-		return;
-	}
-
 	if (sprintf(msgBuffer, "HeartBeat-%d", heartBeatCount++) > 0) {
 		SendMessageToRTCore(msgBuffer);
 	}
@@ -41,6 +41,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <errno.h>
+#include <stdint.h>
 
 /* Apparently sscanf is not implemented in some "standard" libraries, so don't use it, if you
  * don't have to. */
@@ -49,15 +50,34 @@
 #define STARTING_CAPACITY 16
 #define MAX_NESTING 2048
 
-#define FLOAT_FORMAT "%1.17g" /* do not increase precision without incresing NUM_BUF_SIZE */
-/* double printed with "%1.17g" shouldn't be longer than 25 bytes so let's use 64 */
+/* a serialized double shouldn't be longer than 30 bytes so let's use 64 */
 #define NUM_BUF_SIZE 64
+/* strings up to this length are decoded on the stack by the SAX parser */
+#define SAX_SCRATCH_SIZE 128
+/* keys of the objects open in a skipped value kept on the stack before moving to the heap */
+#define SAX_SKIP_KEYS 32
+/* initial size of the buffer json_serialize_to_string grows */
+#define SERIALIZATION_STARTING_CAPACITY 256
+#define MAX_NUMBER_DECIMALS 9
+/* objects with at least this many members get a hash index on their first lookup */
+#ifndef OBJECT_INDEX_THRESHOLD
+#define OBJECT_INDEX_THRESHOLD 16
+#endif
+#define OBJECT_NOT_FOUND ((size_t)-1)
 
 #define SIZEOF_TOKEN(a) (sizeof(a) - 1)
 #define SKIP_CHAR(str) ((*str)++)
-#define SKIP_WHITESPACES(str)                 \
-    while (isspace((unsigned char)(**str))) { \
-        SKIP_CHAR(str);                       \
+/* Current character, or '\0' at the end of the input being parsed */
+#define PEEK_CHAR(str) (*(str) < parse_end ? **(str) : '\0')
+#define REMAINING(str) ((size_t)(parse_end - *(str)))
+/* A run of equal whitespace after the first character, indentation in a pretty printed document,
+   is handed to the block scanner. Shorter runs are cheaper to walk. */
+#define SKIP_WHITESPACES(str)                                                                  \
+    while (isspace((unsigned char)PEEK_CHAR(str))) {                                           \
+        SKIP_CHAR(str);                                                                        \
+        if (REMAINING(str) > 1 && **(str) == (*(str))[1] && isspace((unsigned char)**(str))) { \
+            *(str) += scan_spaces(*(str), REMAINING(str));                                     \
+        }                                                                                      \
     }
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
@@ -67,8 +87,262 @@
 static JSON_Malloc_Function parson_malloc = malloc;
 static JSON_Free_Function parson_free = free;
 
+/* End of the input being parsed. Set by the parse entry points, which save and restore it so a
+   callback may start another parse. When parse_terminated is set the input is also NUL terminated
+   and numbers are converted in place rather than copied. */
+static const char *parse_end = NULL;
+static int parse_terminated = 0;
+
+/* Decimal places numbers are serialized with, or -1 for the shortest round trip form */
+static int number_decimals = -1;
+
 #define IS_CONT(b) (((unsigned char)(b)&0xC0) == 0x80) /* is utf-8 continuation byte */
 
+/* Block scanners. Each returns how many leading bytes of s, at most n, hold nothing the caller
+   has to look at, so it can jump over them and finish with its byte by byte code, which then sees
+   exactly the input it would have seen without them. Only whole blocks are loaded, so a short
+   tail is always left to the caller. The vector versions are picked at compile time; define
+   PARSON_NO_SIMD to use the scalar ones. */
+#if !defined(PARSON_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_BLOCK 32
+
+/* index of the lowest set bit of a non zero movemask, the first byte that stopped the scan */
+#if defined(__GNUC__)
+#define FIRST_SET(mask) ((size_t)__builtin_ctz((unsigned int)(mask)))
+#else
+static size_t FIRST_SET(unsigned int mask)
+{
+    size_t i = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+}
+#endif
+
+/* whitespace as isspace sees it in the C locale: ' ' and '\t' to '\r' */
+static size_t scan_spaces(const char *s, size_t n)
+{
+    const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                  four = _mm256_set1_epi8(4), zero = _mm256_setzero_si256();
+    size_t i = 0;
+    unsigned int mask;
+    __m256i c, ws;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = _mm256_loadu_si256((const __m256i *)(s + i));
+        ws = _mm256_or_si256(_mm256_cmpeq_epi8(c, space),
+                             _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(c, tab), four), zero));
+        mask = ~(unsigned int)_mm256_movemask_epi8(ws);
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+
+/* no quote, backslash or control character */
+static size_t scan_plain(const char *s, size_t n)
+{
+    const __m256i quote = _mm256_set1_epi8('\"'), backslash = _mm256_set1_epi8('\\'),
+                  control = _mm256_set1_epi8(0x1F), zero = _mm256_setzero_si256();
+    size_t i = 0;
+    unsigned int mask;
+    __m256i c, special;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = _mm256_loadu_si256((const __m256i *)(s + i));
+        special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, backslash)),
+                                  _mm256_cmpeq_epi8(_mm256_subs_epu8(c, control), zero));
+        mask = (unsigned int)_mm256_movemask_epi8(special);
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+
+static size_t scan_ascii(const char *s, size_t n)
+{
+    size_t i = 0;
+    unsigned int mask;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+#elif !defined(PARSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || \
+                                   (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SCAN_BLOCK 16
+
+/* index of the lowest set bit of a non zero movemask, the first byte that stopped the scan */
+#if defined(__GNUC__)
+#define FIRST_SET(mask) ((size_t)__builtin_ctz((unsigned int)(mask)))
+#else
+static size_t FIRST_SET(unsigned int mask)
+{
+    size_t i = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+}
+#endif
+
+static size_t scan_spaces(const char *s, size_t n)
+{
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), four = _mm_set1_epi8(4),
+                  zero = _mm_setzero_si128();
+    size_t i = 0;
+    unsigned int mask;
+    __m128i c, ws;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = _mm_loadu_si128((const __m128i *)(s + i));
+        ws = _mm_or_si128(_mm_cmpeq_epi8(c, space),
+                          _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(c, tab), four), zero));
+        mask = ~(unsigned int)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+
+static size_t scan_plain(const char *s, size_t n)
+{
+    const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\'),
+                  control = _mm_set1_epi8(0x1F), zero = _mm_setzero_si128();
+    size_t i = 0;
+    unsigned int mask;
+    __m128i c, special;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = _mm_loadu_si128((const __m128i *)(s + i));
+        special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, backslash)),
+                               _mm_cmpeq_epi8(_mm_subs_epu8(c, control), zero));
+        mask = (unsigned int)_mm_movemask_epi8(special);
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+
+static size_t scan_ascii(const char *s, size_t n)
+{
+    size_t i = 0;
+    unsigned int mask;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        mask = (unsigned int)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+        if (mask != 0) {
+            return i + FIRST_SET(mask);
+        }
+    }
+    return i;
+}
+#elif !defined(PARSON_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SCAN_BLOCK 16
+
+/* ARMv7 has no horizontal max, fold the halves and test them as one 64 bit lane */
+static int neon_any(uint8x16_t v)
+{
+    uint8x8_t folded = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    return vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0;
+}
+
+static size_t scan_spaces(const char *s, size_t n)
+{
+    const uint8x16_t space = vdupq_n_u8(' '), tab = vdupq_n_u8('\t'), four = vdupq_n_u8(4);
+    size_t i = 0;
+    uint8x16_t c, ws;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = vld1q_u8((const uint8_t *)(s + i));
+        ws = vorrq_u8(vceqq_u8(c, space), vcleq_u8(vsubq_u8(c, tab), four));
+        if (neon_any(vmvnq_u8(ws))) {
+            break;
+        }
+    }
+    return i;
+}
+
+static size_t scan_plain(const char *s, size_t n)
+{
+    const uint8x16_t quote = vdupq_n_u8('\"'), backslash = vdupq_n_u8('\\'), control = vdupq_n_u8(0x1F);
+    size_t i = 0;
+    uint8x16_t c, special;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        c = vld1q_u8((const uint8_t *)(s + i));
+        special = vorrq_u8(vorrq_u8(vceqq_u8(c, quote), vceqq_u8(c, backslash)), vcleq_u8(c, control));
+        if (neon_any(special)) {
+            break;
+        }
+    }
+    return i;
+}
+
+static size_t scan_ascii(const char *s, size_t n)
+{
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    size_t i = 0;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        if (neon_any(vandq_u8(vld1q_u8((const uint8_t *)(s + i)), high))) {
+            break;
+        }
+    }
+    return i;
+}
+#else
+/* Scalar fallback, eight bytes at a time in a machine word */
+#define SCAN_BLOCK 8
+
+/* indentation is spaces, tabs are left to the caller */
+static size_t scan_spaces(const char *s, size_t n)
+{
+    size_t i = 0;
+    uint64_t w;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        memcpy(&w, s + i, sizeof(w));
+        if (w != 0x2020202020202020ULL) {
+            break;
+        }
+    }
+    return i;
+}
+
+static size_t scan_plain(const char *s, size_t n)
+{
+    const uint64_t ones = 0x0101010101010101ULL, highs = 0x8080808080808080ULL;
+    size_t i = 0;
+    uint64_t w;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        memcpy(&w, s + i, sizeof(w));
+        /* a byte below 0x20, or equal to a quote or backslash, sets its high bit here */
+        if ((((w - ones * 0x20) | ((w ^ (ones * '\"')) - ones) | ((w ^ (ones * '\\')) - ones)) & ~w & highs) != 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+static size_t scan_ascii(const char *s, size_t n)
+{
+    size_t i = 0;
+    uint64_t w;
+    for (; i + SCAN_BLOCK <= n; i += SCAN_BLOCK) {
+        memcpy(&w, s + i, sizeof(w));
+        if ((w & 0x8080808080808080ULL) != 0) {
+            break;
+        }
+    }
+    return i;
+}
+#endif
+
 /* Type definitions */
 typedef union json_value_value {
     char *string;
@@ -91,6 +365,8 @@ struct json_object_t {
     JSON_Value **values;
     size_t count;
     size_t capacity;
+    size_t *cells;        /* open addressed index of member positions + 1, 0 when empty, or NULL */
+    size_t cell_capacity; /* power of two, at least twice count */
 };
 
 struct json_array_t {
@@ -107,7 +383,7 @@ static char *parson_strdup(const char *string);
 static int hex_char_to_int(char c);
 static int parse_utf16_hex(const char *string, unsigned int *result);
 static int num_bytes_in_utf8_sequence(unsigned char c);
-static int verify_utf8_sequence(const unsigned char *string, int *len);
+static int verify_utf8_sequence(const unsigned char *string, size_t avail, int *len);
 static int is_valid_utf8(const char *string, size_t string_len);
 static int is_decimal(const char *string, size_t length);
 
@@ -119,6 +395,12 @@ static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_
 static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity);
 static JSON_Value *json_object_getn_value(const JSON_Object *object, const char *name,
                                           size_t name_len);
+static size_t json_object_getn_index(const JSON_Object *object, const char *name, size_t name_len);
+static unsigned long hash_string(const char *string, size_t n);
+static JSON_Status json_object_index_build(JSON_Object *object, size_t cell_capacity);
+static void json_object_index_insert(JSON_Object *object, size_t item);
+static void json_object_index_remove(JSON_Object *object, size_t item);
+static void json_object_index_free(JSON_Object *object);
 static JSON_Status json_object_remove_internal(JSON_Object *object, const char *name,
                                                int free_value);
 static JSON_Status json_object_dotremove_internal(JSON_Object *object, const char *name,
@@ -135,8 +417,11 @@ static void json_array_free(JSON_Array *array);
 static JSON_Value *json_value_init_string_no_copy(char *string);
 
 /* Parser */
-static JSON_Status skip_quotes(const char **string);
+static JSON_Status skip_quotes(const char **string, int *plain);
+static int match_token(const char **string, const char *token, size_t token_len);
+static JSON_Status parse_number(const char **string, double *number);
 static int parse_utf16(const char **unprocessed, char **processed);
+static char *process_string_to(const char *input, size_t len, char *output);
 static char *process_string(const char *input, size_t len);
 static char *get_quoted_string(const char **string);
 static JSON_Value *parse_object_value(const char **string, size_t nesting);
@@ -146,13 +431,54 @@ static JSON_Value *parse_boolean_value(const char **string);
 static JSON_Value *parse_number_value(const char **string);
 static JSON_Value *parse_null_value(const char **string);
 static JSON_Value *parse_value(const char **string, size_t nesting);
+static JSON_Value *parse_bounded(const char *string, size_t length, int terminated);
+
+/* SAX parser */
+typedef struct sax_parser_t {
+    const char *input;
+    const JSON_Sax_Handler *handler;
+    void *context;
+    char scratch[SAX_SCRATCH_SIZE];
+} SAX_Parser;
+
+/* A key of an object open in a skipped value, or a mark starting each object's keys */
+typedef struct sax_skip_key_t {
+    const char *name;   /* contents after the opening quote, NULL for a mark */
+    size_t len;         /* raw length, or for a mark the index of the enclosing object's mark */
+    unsigned long hash; /* of the raw contents */
+    int plain;          /* no escapes, so the raw contents are the name */
+} SAX_Skip_Key;
+
+typedef struct sax_skip_keys_t {
+    SAX_Skip_Key *keys;
+    size_t count;
+    size_t capacity;
+    size_t mark; /* index of the innermost object's mark */
+    SAX_Skip_Key stack_keys[SAX_SKIP_KEYS];
+} SAX_Skip_Keys;
+
+static JSON_Status sax_parse_value(SAX_Parser *parser, const char **string, size_t nesting);
+static JSON_Status sax_parse_object(SAX_Parser *parser, const char **string, size_t nesting);
+static JSON_Status sax_parse_array(SAX_Parser *parser, const char **string, size_t nesting);
+static JSON_Status sax_skip_value(const char **string, size_t nesting);
+static JSON_Status sax_skip_value_keys(const char **string, size_t nesting, SAX_Skip_Keys *keys);
+static JSON_Status sax_skip_string(const char **string, int *plain);
+static const char *sax_get_quoted_string(SAX_Parser *parser, const char **string, size_t *len);
+static void sax_free_string(SAX_Parser *parser, const char *string);
+static JSON_Status sax_parse_bounded(const char *string, size_t length, int terminated,
+                                     const JSON_Sax_Handler *handler, void *context);
 
 /* Serialization */
-static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int level, int is_pretty,
-                                      char *num_buf);
-static int json_serialize_string(const char *string, char *buf);
-static int append_indent(char *buf, int level);
-static int append_string(char *buf, const char *string);
+typedef struct json_writer_t JSON_Writer;
+static JSON_Status json_serialize_to_writer_r(const JSON_Value *value, JSON_Writer *writer, int level,
+                                              int is_pretty);
+static void json_serialize_string(const char *string, JSON_Writer *writer);
+static void json_serialize_number(double num, JSON_Writer *writer);
+static void append_indent(JSON_Writer *writer, int level);
+static size_t serialization_size(const JSON_Value *value, int is_pretty);
+static JSON_Status serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes,
+                                       int is_pretty);
+static char *serialize_to_string(const JSON_Value *value, int is_pretty);
 
 /* Various */
 static char *parson_strndup(const char *string, size_t n)
@@ -185,18 +511,18 @@ static int hex_char_to_int(char c)
 
 static int parse_utf16_hex(const char *s, unsigned int *result)
 {
-    int x1, x2, x3, x4;
-    if (s[0] == '\0' || s[1] == '\0' || s[2] == '\0' || s[3] == '\0') {
-        return 0;
-    }
-    x1 = hex_char_to_int(s[0]);
-    x2 = hex_char_to_int(s[1]);
-    x3 = hex_char_to_int(s[2]);
-    x4 = hex_char_to_int(s[3]);
-    if (x1 == -1 || x2 == -1 || x3 == -1 || x4 == -1) {
-        return 0;
+    /* Stops at the first non hex digit, at worst the closing quote, so it never reads past the
+       end of the quoted string */
+    int i, x;
+    unsigned int cp = 0;
+    for (i = 0; i < 4; i++) {
+        x = hex_char_to_int(s[i]);
+        if (x == -1) {
+            return 0;
+        }
+        cp = (cp << 4) | (unsigned int)x;
     }
-    *result = (unsigned int)((x1 << 12) | (x2 << 8) | (x3 << 4) | x4);
+    *result = cp;
     return 1;
 }
 
@@ -216,12 +542,15 @@ static int num_bytes_in_utf8_sequence(unsigned char c)
     return 0; /* won't happen */
 }
 
-static int verify_utf8_sequence(const unsigned char *string, int *len)
+/* Checks the sequence starting at string, of which avail bytes can be read */
+static int verify_utf8_sequence(const unsigned char *string, size_t avail, int *len)
 {
     unsigned int cp = 0;
     *len = num_bytes_in_utf8_sequence(string[0]);
 
-    if (*len == 1) {
+    if ((size_t)*len > avail) { /* truncated by the end of the input */
+        return 0;
+    } else if (*len == 1) {
         cp = string[0];
     } else if (*len == 2 && IS_CONT(string[1])) {
         cp = string[0] & 0x1F;
@@ -261,11 +590,15 @@ static int is_valid_utf8(const char *string, size_t string_len)
 {
     int len = 0;
     const char *string_end = string + string_len;
+    string += scan_ascii(string, string_len);
     while (string < string_end) {
-        if (!verify_utf8_sequence((const unsigned char *)string, &len)) {
+        if (!verify_utf8_sequence((const unsigned char *)string, (size_t)(string_end - string), &len)) {
             return 0;
         }
         string += len;
+        if (len > 1) {
+            string += scan_ascii(string, (size_t)(string_end - string));
+        }
     }
     return 1;
 }
@@ -334,6 +667,8 @@ static JSON_Object *json_object_init(JSON_Value *wrapping_value)
     new_obj->values = (JSON_Value **)NULL;
     new_obj->capacity = 0;
     new_obj->count = 0;
+    new_obj->cells = NULL;
+    new_obj->cell_capacity = 0;
     return new_obj;
 }
 
@@ -369,6 +704,13 @@ static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_
     value->parent = json_object_get_wrapping_value(object);
     object->values[index] = value;
     object->count++;
+    if (object->cells != NULL) {
+        if (object->count * 2 <= object->cell_capacity) {
+            json_object_index_insert(object, index);
+        } else if (json_object_index_build(object, object->cell_capacity * 2) == JSONFailure) {
+            json_object_index_free(object); /* out of memory, lookups go back to scanning */
+        }
+    }
     return JSONSuccess;
 }
 
@@ -405,42 +747,148 @@ static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
 static JSON_Value *json_object_getn_value(const JSON_Object *object, const char *name,
                                           size_t name_len)
 {
-    size_t i, name_length;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        name_length = strlen(object->names[i]);
-        if (name_length != name_len) {
-            continue;
+    size_t i = json_object_getn_index(object, name, name_len);
+    return i == OBJECT_NOT_FOUND ? NULL : object->values[i];
+}
+
+/* Returns the position of a member, or OBJECT_NOT_FOUND. Objects from OBJECT_INDEX_THRESHOLD
+   members up are looked up through a hash index, built here the first time it is needed. */
+static size_t json_object_getn_index(const JSON_Object *object, const char *name, size_t name_len)
+{
+    size_t i, cell, item;
+    if (object == NULL) {
+        return OBJECT_NOT_FOUND;
+    }
+    if (object->cells == NULL && object->count >= OBJECT_INDEX_THRESHOLD) {
+        /* the index is a cache, so building it does not change the object */
+        json_object_index_build((JSON_Object *)object, STARTING_CAPACITY * 2);
+    }
+    if (object->cells != NULL) {
+        for (cell = hash_string(name, name_len) & (object->cell_capacity - 1);
+             object->cells[cell] != 0; cell = (cell + 1) & (object->cell_capacity - 1)) {
+            item = object->cells[cell] - 1;
+            if (strncmp(object->names[item], name, name_len) == 0 &&
+                object->names[item][name_len] == '\0') {
+                return item;
+            }
         }
-        if (strncmp(object->names[i], name, name_len) == 0) {
-            return object->values[i];
+        return OBJECT_NOT_FOUND;
+    }
+    for (i = 0; i < object->count; i++) {
+        if (strncmp(object->names[i], name, name_len) == 0 && object->names[i][name_len] == '\0') {
+            return i;
         }
     }
-    return NULL;
+    return OBJECT_NOT_FOUND;
+}
+
+/* FNV-1a */
+static unsigned long hash_string(const char *string, size_t n)
+{
+    unsigned long hash = 2166136261UL;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        hash ^= (unsigned char)string[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/* Builds the index with at least cell_capacity cells, growing it to keep it at most half full */
+static JSON_Status json_object_index_build(JSON_Object *object, size_t cell_capacity)
+{
+    size_t *cells = NULL, i;
+    while (cell_capacity < object->count * 2) {
+        cell_capacity *= 2;
+    }
+    cells = (size_t *)parson_malloc(cell_capacity * sizeof(size_t));
+    if (cells == NULL) {
+        return JSONFailure;
+    }
+    memset(cells, 0, cell_capacity * sizeof(size_t));
+    parson_free(object->cells);
+    object->cells = cells;
+    object->cell_capacity = cell_capacity;
+    for (i = 0; i < object->count; i++) {
+        json_object_index_insert(object, i);
+    }
+    return JSONSuccess;
+}
+
+static void json_object_index_insert(JSON_Object *object, size_t item)
+{
+    size_t mask = object->cell_capacity - 1;
+    size_t cell = hash_string(object->names[item], strlen(object->names[item])) & mask;
+    while (object->cells[cell] != 0) {
+        cell = (cell + 1) & mask;
+    }
+    object->cells[cell] = item + 1;
+}
+
+/* Removes item from the index, shifting back any later members of its probe run so that
+   lookups never stop early at the emptied cell */
+static void json_object_index_remove(JSON_Object *object, size_t item)
+{
+    size_t mask = object->cell_capacity - 1;
+    size_t hole = hash_string(object->names[item], strlen(object->names[item])) & mask;
+    size_t cell = 0, home = 0, moved = 0;
+    while (object->cells[hole] != item + 1) {
+        hole = (hole + 1) & mask;
+    }
+    object->cells[hole] = 0;
+    for (cell = (hole + 1) & mask; object->cells[cell] != 0; cell = (cell + 1) & mask) {
+        moved = object->cells[cell] - 1;
+        home = hash_string(object->names[moved], strlen(object->names[moved])) & mask;
+        /* leave it if its home cell lies cyclically in (hole, cell] */
+        if (hole <= cell ? (home > hole && home <= cell) : (home > hole || home <= cell)) {
+            continue;
+        }
+        object->cells[hole] = object->cells[cell];
+        object->cells[cell] = 0;
+        hole = cell;
+    }
+}
+
+static void json_object_index_free(JSON_Object *object)
+{
+    parson_free(object->cells);
+    object->cells = NULL;
+    object->cell_capacity = 0;
 }
 
 static JSON_Status json_object_remove_internal(JSON_Object *object, const char *name,
                                                int free_value)
 {
-    size_t i = 0, last_item_index = 0;
-    if (object == NULL || json_object_get_value(object, name) == NULL) {
+    size_t i = 0, last_item_index = 0, cell = 0;
+    if (object == NULL || name == NULL) {
+        return JSONFailure;
+    }
+    i = json_object_getn_index(object, name, strlen(name));
+    if (i == OBJECT_NOT_FOUND) {
         return JSONFailure;
     }
     last_item_index = json_object_get_count(object) - 1;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        if (strcmp(object->names[i], name) == 0) {
-            parson_free(object->names[i]);
-            if (free_value) {
-                json_value_free(object->values[i]);
+    if (object->cells != NULL) {
+        json_object_index_remove(object, i);
+        if (i != last_item_index) { /* the last member is about to move to position i */
+            cell = hash_string(object->names[last_item_index], strlen(object->names[last_item_index])) &
+                   (object->cell_capacity - 1);
+            while (object->cells[cell] != last_item_index + 1) {
+                cell = (cell + 1) & (object->cell_capacity - 1);
             }
-            if (i != last_item_index) { /* Replace key value pair with one from the end */
-                object->names[i] = object->names[last_item_index];
-                object->values[i] = object->values[last_item_index];
-            }
-            object->count -= 1;
-            return JSONSuccess;
+            object->cells[cell] = i + 1;
         }
     }
-    return JSONFailure; /* No execution path should end here */
+    parson_free(object->names[i]);
+    if (free_value) {
+        json_value_free(object->values[i]);
+    }
+    if (i != last_item_index) { /* Replace key value pair with one from the end */
+        object->names[i] = object->names[last_item_index];
+        object->values[i] = object->values[last_item_index];
+    }
+    object->count -= 1;
+    return JSONSuccess;
 }
 
 static JSON_Status json_object_dotremove_internal(JSON_Object *object, const char *name,
@@ -469,6 +917,7 @@ static void json_object_free(JSON_Object *object)
     }
     parson_free(object->names);
     parson_free(object->values);
+    parson_free(object->cells);
     parson_free(object);
 }
 
@@ -543,24 +992,79 @@ static JSON_Value *json_value_init_string_no_copy(char *string)
 }
 
 /* Parser */
-static JSON_Status skip_quotes(const char **string)
+/* Skips passed a quoted string. If plain is not NULL it is set when the string has no escapes or
+   control characters, so its contents can be used as they are. */
+static JSON_Status skip_quotes(const char **string, int *plain)
 {
-    if (**string != '\"') {
+    int is_plain = 1;
+    char c;
+    if (PEEK_CHAR(string) != '\"') {
         return JSONFailure;
     }
     SKIP_CHAR(string);
-    while (**string != '\"') {
-        if (**string == '\0') {
+    *string += scan_plain(*string, REMAINING(string));
+    while ((c = PEEK_CHAR(string)) != '\"') {
+        if (c == '\0') {
             return JSONFailure;
-        } else if (**string == '\\') {
+        } else if (c == '\\') {
+            is_plain = 0;
             SKIP_CHAR(string);
-            if (**string == '\0') {
+            if (PEEK_CHAR(string) == '\0') {
                 return JSONFailure;
             }
+            SKIP_CHAR(string);
+            *string += scan_plain(*string, REMAINING(string));
+            continue;
+        } else if ((unsigned char)c < 0x20) {
+            is_plain = 0;
         }
         SKIP_CHAR(string);
     }
     SKIP_CHAR(string);
+    if (plain != NULL) {
+        *plain = is_plain;
+    }
+    return JSONSuccess;
+}
+
+/* Skips passed token if the input starts with it */
+static int match_token(const char **string, const char *token, size_t token_len)
+{
+    if (REMAINING(string) < token_len || strncmp(token, *string, token_len) != 0) {
+        return 0;
+    }
+    *string += token_len;
+    return 1;
+}
+
+static JSON_Status parse_number(const char **string, double *number)
+{
+    char buf[NUM_BUF_SIZE];
+    const char *start = *string, *end = NULL;
+    char *buf_end = NULL;
+    size_t len = 0;
+    errno = 0;
+    if (parse_terminated) {
+        *number = strtod(start, (char **)&end);
+    } else {
+        /* strtod needs a terminator, copy the number so it cannot run off the end of the input */
+        while (len < REMAINING(string) && start[len] != '\0' && strchr("+-.0123456789eE", start[len]) != NULL) {
+            len++;
+        }
+        if (len >= NUM_BUF_SIZE) {
+            return JSONFailure;
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        *number = strtod(buf, &buf_end);
+        end = start + (buf_end - buf);
+    }
+    /* strtod reports subnormal results as underflow too, but they are what the serializer writes
+       for the smallest doubles, so only overflow is an error */
+    if ((errno && fabs(*number) == HUGE_VAL) || end == start || !is_decimal(start, (size_t)(end - start))) {
+        return JSONFailure;
+    }
+    *string = end;
     return JSONSuccess;
 }
 
@@ -613,21 +1117,26 @@ static int parse_utf16(const char **unprocessed, char **processed)
     return JSONSuccess;
 }
 
-/* Copies and processes passed string up to supplied length.
-Example: "\u006Corem ipsum" -> lorem ipsum */
-static char *process_string(const char *input, size_t len)
+/* Processes passed string up to supplied length into output, which must hold len + 1 chars,
+   and returns a pointer to the terminating NUL or NULL on error. */
+static char *process_string_to(const char *input, size_t len, char *output)
 {
     const char *input_ptr = input;
-    size_t initial_size = (len + 1) * sizeof(char);
-    size_t final_size = 0;
-    char *output = NULL, *output_ptr = NULL, *resized_output = NULL;
-    output = (char *)parson_malloc(initial_size);
-    if (output == NULL) {
-        goto error;
-    }
-    output_ptr = output;
-    while ((*input_ptr != '\0') && (size_t)(input_ptr - input) < len) {
+    char *output_ptr = output;
+    size_t run = 0;
+    int run_start = 1; /* at the start or just after an escape */
+    while ((size_t)(input_ptr - input) < len && *input_ptr != '\0') {
+        if (run_start) {
+            /* copy plain characters up to the next escape a block at a time */
+            run = scan_plain(input_ptr, len - (size_t)(input_ptr - input));
+            memcpy(output_ptr, input_ptr, run);
+            input_ptr += run;
+            output_ptr += run;
+            run_start = 0;
+            continue;
+        }
         if (*input_ptr == '\\') {
+            run_start = 1;
             input_ptr++;
             switch (*input_ptr) {
             case '\"':
@@ -656,15 +1165,15 @@ static char *process_string(const char *input, size_t len)
                 break;
             case 'u':
                 if (parse_utf16(&input_ptr, &output_ptr) == JSONFailure) {
-                    goto error;
+                    return NULL;
                 }
                 break;
             default:
-                goto error;
+                return NULL;
             }
         } else if ((unsigned char)*input_ptr < 0x20) {
-            goto error; /* 0x00-0x19 are invalid characters for json string
-                           (http://www.ietf.org/rfc/rfc4627.txt) */
+            return NULL; /* 0x00-0x19 are invalid characters for json string
+                            (http://www.ietf.org/rfc/rfc4627.txt) */
         } else {
             *output_ptr = *input_ptr;
         }
@@ -672,6 +1181,24 @@ static char *process_string(const char *input, size_t len)
         input_ptr++;
     }
     *output_ptr = '\0';
+    return output_ptr;
+}
+
+/* Copies and processes passed string up to supplied length.
+Example: "\u006Corem ipsum" -> lorem ipsum */
+static char *process_string(const char *input, size_t len)
+{
+    size_t initial_size = (len + 1) * sizeof(char);
+    size_t final_size = 0;
+    char *output = NULL, *output_ptr = NULL, *resized_output = NULL;
+    output = (char *)parson_malloc(initial_size);
+    if (output == NULL) {
+        goto error;
+    }
+    output_ptr = process_string_to(input, len, output);
+    if (output_ptr == NULL) {
+        goto error;
+    }
     /* resize to new length */
     final_size = (size_t)(output_ptr - output) + 1;
     /* todo: don't resize if final_size == initial_size */
@@ -693,11 +1220,15 @@ static char *get_quoted_string(const char **string)
 {
     const char *string_start = *string;
     size_t string_len = 0;
-    JSON_Status status = skip_quotes(string);
+    int plain = 0;
+    JSON_Status status = skip_quotes(string, &plain);
     if (status != JSONSuccess) {
         return NULL;
     }
     string_len = (size_t)(*string - string_start - 2); /* length without quotes */
+    if (plain) {
+        return parson_strndup(string_start + 1, string_len); /* nothing to decode, copy once */
+    }
     return process_string(string_start + 1, string_len);
 }
 
@@ -707,7 +1238,7 @@ static JSON_Value *parse_value(const char **string, size_t nesting)
         return NULL;
     }
     SKIP_WHITESPACES(string);
-    switch (**string) {
+    switch (PEEK_CHAR(string)) {
     case '{':
         return parse_object_value(string, nesting + 1);
     case '[':
@@ -745,25 +1276,25 @@ static JSON_Value *parse_object_value(const char **string, size_t nesting)
     if (output_value == NULL) {
         return NULL;
     }
-    if (**string != '{') {
+    if (PEEK_CHAR(string) != '{') {
         json_value_free(output_value);
         return NULL;
     }
     output_object = json_value_get_object(output_value);
     SKIP_CHAR(string);
     SKIP_WHITESPACES(string);
-    if (**string == '}') { /* empty object */
+    if (PEEK_CHAR(string) == '}') { /* empty object */
         SKIP_CHAR(string);
         return output_value;
     }
-    while (**string != '\0') {
+    while (PEEK_CHAR(string) != '\0') {
         new_key = get_quoted_string(string);
         if (new_key == NULL) {
             json_value_free(output_value);
             return NULL;
         }
         SKIP_WHITESPACES(string);
-        if (**string != ':') {
+        if (PEEK_CHAR(string) != ':') {
             parson_free(new_key);
             json_value_free(output_value);
             return NULL;
@@ -783,14 +1314,14 @@ static JSON_Value *parse_object_value(const char **string, size_t nesting)
         }
         parson_free(new_key);
         SKIP_WHITESPACES(string);
-        if (**string != ',') {
+        if (PEEK_CHAR(string) != ',') {
             break;
         }
         SKIP_CHAR(string);
         SKIP_WHITESPACES(string);
     }
     SKIP_WHITESPACES(string);
-    if (**string != '}' || /* Trim object after parsing is over */
+    if (PEEK_CHAR(string) != '}' || /* Trim object after parsing is over */
         json_object_resize(output_object, json_object_get_count(output_object)) == JSONFailure) {
         json_value_free(output_value);
         return NULL;
@@ -799,430 +1330,1083 @@ static JSON_Value *parse_object_value(const char **string, size_t nesting)
     return output_value;
 }
 
-static JSON_Value *parse_array_value(const char **string, size_t nesting)
+static JSON_Value *parse_array_value(const char **string, size_t nesting)
+{
+    JSON_Value *output_value = NULL, *new_array_value = NULL;
+    JSON_Array *output_array = NULL;
+    output_value = json_value_init_array();
+    if (output_value == NULL) {
+        return NULL;
+    }
+    if (PEEK_CHAR(string) != '[') {
+        json_value_free(output_value);
+        return NULL;
+    }
+    output_array = json_value_get_array(output_value);
+    SKIP_CHAR(string);
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) == ']') { /* empty array */
+        SKIP_CHAR(string);
+        return output_value;
+    }
+    while (PEEK_CHAR(string) != '\0') {
+        new_array_value = parse_value(string, nesting);
+        if (new_array_value == NULL) {
+            json_value_free(output_value);
+            return NULL;
+        }
+        if (json_array_add(output_array, new_array_value) == JSONFailure) {
+            json_value_free(new_array_value);
+            json_value_free(output_value);
+            return NULL;
+        }
+        SKIP_WHITESPACES(string);
+        if (PEEK_CHAR(string) != ',') {
+            break;
+        }
+        SKIP_CHAR(string);
+        SKIP_WHITESPACES(string);
+    }
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) != ']' || /* Trim array after parsing is over */
+        json_array_resize(output_array, json_array_get_count(output_array)) == JSONFailure) {
+        json_value_free(output_value);
+        return NULL;
+    }
+    SKIP_CHAR(string);
+    return output_value;
+}
+
+static JSON_Value *parse_string_value(const char **string)
+{
+    JSON_Value *value = NULL;
+    char *new_string = get_quoted_string(string);
+    if (new_string == NULL) {
+        return NULL;
+    }
+    value = json_value_init_string_no_copy(new_string);
+    if (value == NULL) {
+        parson_free(new_string);
+        return NULL;
+    }
+    return value;
+}
+
+static JSON_Value *parse_boolean_value(const char **string)
+{
+    if (match_token(string, "true", SIZEOF_TOKEN("true"))) {
+        return json_value_init_boolean(1);
+    } else if (match_token(string, "false", SIZEOF_TOKEN("false"))) {
+        return json_value_init_boolean(0);
+    }
+    return NULL;
+}
+
+static JSON_Value *parse_number_value(const char **string)
+{
+    double number = 0;
+    if (parse_number(string, &number) != JSONSuccess) {
+        return NULL;
+    }
+    return json_value_init_number(number);
+}
+
+static JSON_Value *parse_null_value(const char **string)
+{
+    if (match_token(string, "null", SIZEOF_TOKEN("null"))) {
+        return json_value_init_null();
+    }
+    return NULL;
+}
+
+/* SAX parser */
+#define SAX_CALL(parser, callback, ...)                                              \
+    ((parser)->handler->callback == NULL ||                                         \
+             (parser)->handler->callback((parser)->context, __VA_ARGS__) != JSONSaxAbort \
+         ? JSONSuccess                                                              \
+         : JSONFailure)
+
+/* Returns the contents of a quoted string and skips passed it. A string with nothing to decode is
+   returned in place, others are decoded into the parser's scratch buffer, or a heap buffer if
+   too long. Either way the result is not NUL terminated. Free it with sax_free_string. */
+static const char *sax_get_quoted_string(SAX_Parser *parser, const char **string, size_t *len)
+{
+    const char *string_start = *string;
+    size_t string_len = 0;
+    char *output = parser->scratch, *output_end = NULL;
+    int plain = 0;
+    if (skip_quotes(string, &plain) != JSONSuccess) {
+        return NULL;
+    }
+    string_len = (size_t)(*string - string_start - 2); /* length without quotes */
+    if (plain) {
+        *len = string_len;
+        return string_start + 1;
+    }
+    if (string_len >= SAX_SCRATCH_SIZE) {
+        output = (char *)parson_malloc(string_len + 1);
+        if (output == NULL) {
+            return NULL;
+        }
+    }
+    output_end = process_string_to(string_start + 1, string_len, output);
+    if (output_end == NULL) {
+        if (output != parser->scratch) {
+            parson_free(output);
+        }
+        return NULL;
+    }
+    *len = (size_t)(output_end - output);
+    return output;
+}
+
+static void sax_free_string(SAX_Parser *parser, const char *string)
+{
+    /* Only decoded strings live outside the input */
+    if (string != parser->scratch && (string < parser->input || string >= parse_end)) {
+        parson_free((void *)string);
+    }
+}
+
+/* Checks the contents of a string with escapes the way process_string_to would decode them */
+static int is_valid_escaped(const char *input, size_t len)
+{
+    const char *input_end = input + len;
+    char utf8[4], *utf8_ptr = NULL;
+    while (input < input_end) {
+        input += scan_plain(input, (size_t)(input_end - input));
+        if (input == input_end) {
+            break;
+        }
+        if (*input != '\\') {
+            if ((unsigned char)*input < 0x20) {
+                return 0;
+            }
+            input++; /* the scan may stop short of the next escape */
+            continue;
+        }
+        input++;
+        if (*input == 'u') {
+            utf8_ptr = utf8;
+            if (parse_utf16(&input, &utf8_ptr) == JSONFailure) {
+                return 0;
+            }
+        } else if (*input == '\0' || strchr("\"\\/bfnrt", *input) == NULL) {
+            return 0;
+        }
+        input++;
+    }
+    return 1;
+}
+
+/* Skips a string without decoding it, rejecting it where decoding would fail */
+static JSON_Status sax_skip_string(const char **string, int *plain)
+{
+    const char *string_start = *string;
+    if (skip_quotes(string, plain) != JSONSuccess) {
+        return JSONFailure;
+    }
+    if (!*plain && !is_valid_escaped(string_start + 1, (size_t)(*string - string_start - 2))) {
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
+/* Skips a string, literal or number without decoding it */
+static JSON_Status sax_skip_scalar(const char **string)
+{
+    double number = 0;
+    int plain = 0;
+    switch (PEEK_CHAR(string)) {
+    case '\"':
+        return sax_skip_string(string, &plain);
+    case 'n':
+        return match_token(string, "null", SIZEOF_TOKEN("null")) ? JSONSuccess : JSONFailure;
+    case 't':
+        return match_token(string, "true", SIZEOF_TOKEN("true")) ? JSONSuccess : JSONFailure;
+    case 'f':
+        return match_token(string, "false", SIZEOF_TOKEN("false")) ? JSONSuccess : JSONFailure;
+    default:
+        if (PEEK_CHAR(string) != '-' && !isdigit((unsigned char)PEEK_CHAR(string))) {
+            return JSONFailure;
+        }
+        return parse_number(string, &number);
+    }
+}
+
+static JSON_Status sax_skip_keys_push(SAX_Skip_Keys *keys, const char *name, size_t len, int plain)
+{
+    SAX_Skip_Key *new_keys = NULL;
+    if (keys->count == keys->capacity) {
+        new_keys = (SAX_Skip_Key *)parson_malloc(keys->capacity * 2 * sizeof(SAX_Skip_Key));
+        if (new_keys == NULL) {
+            return JSONFailure;
+        }
+        memcpy(new_keys, keys->keys, keys->count * sizeof(SAX_Skip_Key));
+        if (keys->keys != keys->stack_keys) {
+            parson_free(keys->keys);
+        }
+        keys->keys = new_keys;
+        keys->capacity *= 2;
+    }
+    keys->keys[keys->count].name = name;
+    keys->keys[keys->count].len = len;
+    keys->keys[keys->count].hash = name != NULL && plain ? hash_string(name, len) : 0;
+    keys->keys[keys->count].plain = plain;
+    keys->count++;
+    return JSONSuccess;
+}
+
+/* Compares two keys as the names a parse would decode them to */
+static int sax_skip_keys_equal(const SAX_Skip_Key *a, const SAX_Skip_Key *b)
+{
+    char *a_name = NULL, *b_name = NULL;
+    int equal = 0;
+    if (a->plain && b->plain) {
+        return a->hash == b->hash && a->len == b->len && memcmp(a->name, b->name, a->len) == 0;
+    }
+    a_name = process_string(a->name, a->len);
+    b_name = process_string(b->name, b->len);
+    equal = a_name != NULL && b_name != NULL && strcmp(a_name, b_name) == 0;
+    parson_free(a_name);
+    parson_free(b_name);
+    return equal;
+}
+
+/* Skips a member's key and the colon after it, rejecting a key the object already has */
+static JSON_Status sax_skip_key(const char **string, SAX_Skip_Keys *keys)
+{
+    const char *name = NULL;
+    int plain = 0;
+    size_t i = 0;
+    SKIP_WHITESPACES(string);
+    name = *string + 1;
+    if (PEEK_CHAR(string) != '\"' || sax_skip_string(string, &plain) != JSONSuccess) {
+        return JSONFailure;
+    }
+    if (sax_skip_keys_push(keys, name, (size_t)(*string - name - 1), plain) != JSONSuccess) {
+        return JSONFailure;
+    }
+    for (i = keys->mark + 1; i + 1 < keys->count; i++) {
+        if (sax_skip_keys_equal(&keys->keys[i], &keys->keys[keys->count - 1])) {
+            return JSONFailure;
+        }
+    }
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) != ':') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    return JSONSuccess;
+}
+
+/* Skips a value without decoding it or calling back, rejecting anything a parse would */
+static JSON_Status sax_skip_value(const char **string, size_t nesting)
+{
+    SAX_Skip_Keys keys;
+    JSON_Status status = JSONFailure;
+    keys.keys = keys.stack_keys;
+    keys.count = 0;
+    keys.capacity = SAX_SKIP_KEYS;
+    keys.mark = 0;
+    status = sax_skip_value_keys(string, nesting, &keys);
+    if (keys.keys != keys.stack_keys) {
+        parson_free(keys.keys);
+    }
+    return status;
+}
+
+/* Each closing bracket must match its opener, which is kept one bit per level, keys, separators
+   and scalars are checked as they are passed, and each open object's keys are kept to find
+   duplicates. */
+static JSON_Status sax_skip_value_keys(const char **string, size_t nesting, SAX_Skip_Keys *keys)
+{
+    unsigned char in_object[(MAX_NESTING + 7) / 8]; /* bit set for each open '{' */
+    size_t depth = 0;
+    char c = 0;
+    int object = 0;
+    for (;;) {
+        SKIP_WHITESPACES(string);
+        c = PEEK_CHAR(string);
+        if (c == '{' || c == '[') {
+            if (nesting + depth + 1 > MAX_NESTING) {
+                return JSONFailure;
+            }
+            SKIP_CHAR(string);
+            SKIP_WHITESPACES(string);
+            if (PEEK_CHAR(string) == (c == '{' ? '}' : ']')) {
+                SKIP_CHAR(string); /* empty object or array */
+            } else {
+                if (c == '{') {
+                    in_object[depth / 8] |= (unsigned char)(1u << (depth % 8));
+                    if (sax_skip_keys_push(keys, NULL, keys->mark, 0) != JSONSuccess) {
+                        return JSONFailure;
+                    }
+                    keys->mark = keys->count - 1;
+                    if (sax_skip_key(string, keys) != JSONSuccess) {
+                        return JSONFailure;
+                    }
+                } else {
+                    in_object[depth / 8] &= (unsigned char)~(1u << (depth % 8));
+                }
+                depth++;
+                continue; /* first member or element */
+            }
+        } else if (sax_skip_scalar(string) != JSONSuccess) {
+            return JSONFailure;
+        }
+        /* After a value, close each finished object or array until a comma starts the next value */
+        for (;;) {
+            if (depth == 0) {
+                return JSONSuccess;
+            }
+            object = (in_object[(depth - 1) / 8] >> ((depth - 1) % 8)) & 1;
+            SKIP_WHITESPACES(string);
+            if (PEEK_CHAR(string) == ',') {
+                SKIP_CHAR(string);
+                if (object && sax_skip_key(string, keys) != JSONSuccess) {
+                    return JSONFailure;
+                }
+                break;
+            }
+            if (PEEK_CHAR(string) != (object ? '}' : ']')) {
+                return JSONFailure;
+            }
+            SKIP_CHAR(string);
+            if (object) { /* drop its keys */
+                keys->count = keys->mark;
+                keys->mark = keys->keys[keys->mark].len;
+            }
+            depth--;
+        }
+    }
+}
+
+static JSON_Status sax_parse_value(SAX_Parser *parser, const char **string, size_t nesting)
+{
+    const JSON_Sax_Handler *handler = parser->handler;
+    JSON_Status status = JSONFailure;
+    const char *new_string = NULL;
+    double number = 0;
+    size_t len = 0;
+    int plain = 0;
+    if (nesting > MAX_NESTING) {
+        return JSONFailure;
+    }
+    SKIP_WHITESPACES(string);
+    switch (PEEK_CHAR(string)) {
+    case '{':
+        return sax_parse_object(parser, string, nesting + 1);
+    case '[':
+        return sax_parse_array(parser, string, nesting + 1);
+    case '\"':
+        if (handler->on_string == NULL) {
+            return sax_skip_string(string, &plain);
+        }
+        new_string = sax_get_quoted_string(parser, string, &len);
+        if (new_string == NULL) {
+            return JSONFailure;
+        }
+        status = SAX_CALL(parser, on_string, new_string, len);
+        sax_free_string(parser, new_string);
+        return status;
+    case 'n':
+        if (!match_token(string, "null", SIZEOF_TOKEN("null"))) {
+            return JSONFailure;
+        }
+        return handler->on_null == NULL || handler->on_null(parser->context) != JSONSaxAbort
+                   ? JSONSuccess
+                   : JSONFailure;
+    case 't':
+        if (!match_token(string, "true", SIZEOF_TOKEN("true"))) {
+            return JSONFailure;
+        }
+        return SAX_CALL(parser, on_boolean, 1);
+    case 'f':
+        if (!match_token(string, "false", SIZEOF_TOKEN("false"))) {
+            return JSONFailure;
+        }
+        return SAX_CALL(parser, on_boolean, 0);
+    default:
+        if (PEEK_CHAR(string) != '-' && !isdigit((unsigned char)PEEK_CHAR(string))) {
+            return JSONFailure;
+        }
+        if (parse_number(string, &number) != JSONSuccess) {
+            return JSONFailure;
+        }
+        return SAX_CALL(parser, on_number, number);
+    }
+}
+
+static JSON_Status sax_parse_object(SAX_Parser *parser, const char **string, size_t nesting)
+{
+    const JSON_Sax_Handler *handler = parser->handler;
+    JSON_Value *new_value = NULL;
+    JSON_Sax_Result action = JSONSaxContinue;
+    JSON_Status status = JSONSuccess;
+    const char *new_key = NULL;
+    size_t key_len = 0;
+    if (SAX_CALL(parser, on_object_start, nesting) != JSONSuccess) {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) == '}') { /* empty object */
+        SKIP_CHAR(string);
+        return SAX_CALL(parser, on_object_end, nesting);
+    }
+    while (PEEK_CHAR(string) != '\0') {
+        new_key = sax_get_quoted_string(parser, string, &key_len);
+        if (new_key == NULL) {
+            return JSONFailure;
+        }
+        SKIP_WHITESPACES(string);
+        if (PEEK_CHAR(string) != ':') {
+            sax_free_string(parser, new_key);
+            return JSONFailure;
+        }
+        SKIP_CHAR(string);
+        action = handler->on_key == NULL ? JSONSaxContinue
+                                         : handler->on_key(parser->context, new_key, key_len, nesting);
+        if (action == JSONSaxSkip) {
+            status = sax_skip_value(string, nesting);
+        } else if (action == JSONSaxParseValue) {
+            new_value = parse_value(string, nesting);
+            status = new_value == NULL ? JSONFailure : SAX_CALL(parser, on_value, new_key, key_len, new_value);
+            json_value_free(new_value);
+        } else if (action == JSONSaxContinue) {
+            status = sax_parse_value(parser, string, nesting);
+        } else {
+            status = JSONFailure;
+        }
+        sax_free_string(parser, new_key);
+        if (status != JSONSuccess) {
+            return JSONFailure;
+        }
+        SKIP_WHITESPACES(string);
+        if (PEEK_CHAR(string) != ',') {
+            break;
+        }
+        SKIP_CHAR(string);
+        SKIP_WHITESPACES(string);
+    }
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) != '}') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    return SAX_CALL(parser, on_object_end, nesting);
+}
+
+static JSON_Status sax_parse_array(SAX_Parser *parser, const char **string, size_t nesting)
+{
+    if (SAX_CALL(parser, on_array_start, nesting) != JSONSuccess) {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) == ']') { /* empty array */
+        SKIP_CHAR(string);
+        return SAX_CALL(parser, on_array_end, nesting);
+    }
+    while (PEEK_CHAR(string) != '\0') {
+        if (sax_parse_value(parser, string, nesting) != JSONSuccess) {
+            return JSONFailure;
+        }
+        SKIP_WHITESPACES(string);
+        if (PEEK_CHAR(string) != ',') {
+            break;
+        }
+        SKIP_CHAR(string);
+        SKIP_WHITESPACES(string);
+    }
+    SKIP_WHITESPACES(string);
+    if (PEEK_CHAR(string) != ']') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    return SAX_CALL(parser, on_array_end, nesting);
+}
+
+#undef SAX_CALL
+
+/* Serialization */
+struct json_writer_t {
+    char *buf;
+    size_t len;      /* bytes written, not counting the terminating NUL */
+    size_t capacity; /* size of buf, the NUL included */
+    int growable;    /* buf is owned and replaced by a larger one when full */
+    int failed;
+};
+
+#define APPEND_LITERAL(writer, str) writer_append((writer), (str), SIZEOF_TOKEN(str))
+
+static int writer_grow(JSON_Writer *writer, size_t needed)
+{
+    size_t new_capacity = writer->capacity;
+    char *new_buf = NULL;
+    if (!writer->growable) {
+        return 0;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    new_buf = (char *)parson_malloc(new_capacity);
+    if (new_buf == NULL) {
+        return 0;
+    }
+    memcpy(new_buf, writer->buf, writer->len);
+    parson_free(writer->buf);
+    writer->buf = new_buf;
+    writer->capacity = new_capacity;
+    return 1;
+}
+
+static void writer_append(JSON_Writer *writer, const char *string, size_t len)
+{
+    if (writer->failed) {
+        return;
+    }
+    if (len >= writer->capacity - writer->len && !writer_grow(writer, writer->len + len + 1)) {
+        writer->failed = 1;
+        return;
+    }
+    if (writer->buf != NULL) { /* NULL when only measuring */
+        memcpy(writer->buf + writer->len, string, len);
+    }
+    writer->len += len;
+}
+
+/* Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers").
+   Finds the shortest digit string that reads back as the same double in all but a tiny fraction
+   of cases, and a correct if slightly longer one in the rest, using only 64 bit integer math. */
+typedef struct diy_fp_t {
+    uint64_t f;
+    int e;
+} Diy_Fp;
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_EXPONENT_BIAS (0x3FF + 52)
+
+/* 10^k for k = -348, -340, ..., 340 as normalized 64 bit significands and binary exponents */
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const short cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint64_t pow10_table[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static Diy_Fp diy_fp_multiply(Diy_Fp x, Diy_Fp y)
+{
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1ULL << 31); /* round */
+    Diy_Fp result;
+    result.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    result.e = x.e + y.e + 64;
+    return result;
+}
+
+static Diy_Fp diy_fp_normalize(Diy_Fp x)
+{
+    while ((x.f & (1ULL << 63)) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/* Cached power c = 10^-k such that w * c has a binary exponent in [-60, -32] */
+static Diy_Fp cached_power(int e, int *k)
 {
-    JSON_Value *output_value = NULL, *new_array_value = NULL;
-    JSON_Array *output_array = NULL;
-    output_value = json_value_init_array();
-    if (output_value == NULL) {
-        return NULL;
+    double dk = (-61 - e) * 0.30102999566398114 + 347; /* log10(2) */
+    int ik = (int)dk;
+    unsigned index = 0;
+    Diy_Fp result;
+    if (dk - ik > 0.0) {
+        ik++;
     }
-    if (**string != '[') {
-        json_value_free(output_value);
-        return NULL;
+    index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+    result.f = cached_powers_f[index];
+    result.e = cached_powers_e[index];
+    return result;
+}
+
+static void grisu_round(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa,
+                        uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
     }
-    output_array = json_value_get_array(output_value);
-    SKIP_CHAR(string);
-    SKIP_WHITESPACES(string);
-    if (**string == ']') { /* empty array */
-        SKIP_CHAR(string);
-        return output_value;
+}
+
+static int count_decimal_digits(uint32_t n)
+{
+    int digits = 1;
+    while (n >= 10) {
+        n /= 10;
+        digits++;
     }
-    while (**string != '\0') {
-        new_array_value = parse_value(string, nesting);
-        if (new_array_value == NULL) {
-            json_value_free(output_value);
-            return NULL;
-        }
-        if (json_array_add(output_array, new_array_value) == JSONFailure) {
-            json_value_free(new_array_value);
-            json_value_free(output_value);
-            return NULL;
+    return digits;
+}
+
+static void grisu_digit_gen(Diy_Fp w, Diy_Fp mp, uint64_t delta, char *buffer, int *len, int *k)
+{
+    Diy_Fp one;
+    uint64_t wp_w = mp.f - w.f, p2 = 0, tmp = 0;
+    uint32_t p1 = 0, d = 0;
+    int kappa = 0;
+    one.f = 1ULL << -mp.e;
+    one.e = mp.e;
+    p1 = (uint32_t)(mp.f >> -one.e);
+    p2 = mp.f & (one.f - 1);
+    kappa = count_decimal_digits(p1);
+    *len = 0;
+    while (kappa > 0) {
+        d = p1 / (uint32_t)pow10_table[kappa - 1];
+        p1 %= (uint32_t)pow10_table[kappa - 1];
+        if (d != 0 || *len != 0) {
+            buffer[(*len)++] = (char)('0' + d);
         }
-        SKIP_WHITESPACES(string);
-        if (**string != ',') {
-            break;
+        kappa--;
+        tmp = ((uint64_t)p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *k += kappa;
+            grisu_round(buffer, *len, delta, tmp, pow10_table[kappa] << -one.e, wp_w);
+            return;
         }
-        SKIP_CHAR(string);
-        SKIP_WHITESPACES(string);
     }
-    SKIP_WHITESPACES(string);
-    if (**string != ']' || /* Trim array after parsing is over */
-        json_array_resize(output_array, json_array_get_count(output_array)) == JSONFailure) {
-        json_value_free(output_value);
-        return NULL;
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        d = (uint32_t)(p2 >> -one.e);
+        if (d != 0 || *len != 0) {
+            buffer[(*len)++] = (char)('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            grisu_round(buffer, *len, delta, p2, one.f, -kappa < 20 ? wp_w * pow10_table[-kappa] : 0);
+            return;
+        }
     }
-    SKIP_CHAR(string);
-    return output_value;
 }
 
-static JSON_Value *parse_string_value(const char **string)
+/* Writes the digits of a positive finite number to buffer and returns their count. The value is
+   digits * 10^k. */
+static int grisu2(double value, char *buffer, int *k)
 {
-    JSON_Value *value = NULL;
-    char *new_string = get_quoted_string(string);
-    if (new_string == NULL) {
-        return NULL;
-    }
-    value = json_value_init_string_no_copy(new_string);
-    if (value == NULL) {
-        parson_free(new_string);
-        return NULL;
+    Diy_Fp v, w, pl, mi, c_mk, wp, wm;
+    uint64_t bits = 0;
+    int biased_e = 0, len = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    biased_e = (int)((bits & DP_EXPONENT_MASK) >> 52);
+    v.f = bits & DP_SIGNIFICAND_MASK;
+    if (biased_e != 0) {
+        v.f += DP_HIDDEN_BIT;
+        v.e = biased_e - DP_EXPONENT_BIAS;
+    } else {
+        v.e = 1 - DP_EXPONENT_BIAS;
+    }
+    /* boundaries m+ and m- halfway to the neighbouring doubles, with m+ normalized */
+    pl.f = (v.f << 1) + 1;
+    pl.e = v.e - 1;
+    pl = diy_fp_normalize(pl);
+    if (v.f == DP_HIDDEN_BIT) {
+        mi.f = (v.f << 2) - 1;
+        mi.e = v.e - 2;
+    } else {
+        mi.f = (v.f << 1) - 1;
+        mi.e = v.e - 1;
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+    c_mk = cached_power(pl.e, k);
+    w = diy_fp_multiply(diy_fp_normalize(v), c_mk);
+    wp = diy_fp_multiply(pl, c_mk);
+    wm = diy_fp_multiply(mi, c_mk);
+    wm.f++;
+    wp.f--;
+    grisu_digit_gen(w, wp, wp.f - wm.f, buffer, &len, k);
+    return len;
+}
+
+/* Writes a number in the shape printf's %g would, but with the shortest round trip digits */
+static int serialize_number_shortest(double num, char *out)
+{
+    char digits[20];
+    char *p = out;
+    int len = 0, k = 0, point = 0, exponent = 0, i = 0;
+    if (num < 0 || (num == 0 && 1 / num < 0)) {
+        *p++ = '-';
+        num = -num;
+    }
+    if (num == 0) {
+        *p++ = '0';
+        return (int)(p - out);
+    }
+    len = grisu2(num, digits, &k);
+    point = len + k; /* the value is 0.digits * 10^point */
+    exponent = point - 1;
+    if (exponent < -4 || exponent >= 17) {
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, (size_t)(len - 1));
+            p += len - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        exponent = exponent < 0 ? -exponent : exponent;
+        if (exponent >= 100) {
+            *p++ = (char)('0' + exponent / 100);
+        }
+        *p++ = (char)('0' + exponent / 10 % 10);
+        *p++ = (char)('0' + exponent % 10);
+    } else if (point >= len) {
+        memcpy(p, digits, (size_t)len);
+        p += len;
+        for (i = len; i < point; i++) {
+            *p++ = '0';
+        }
+    } else if (point > 0) {
+        memcpy(p, digits, (size_t)point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, (size_t)(len - point));
+        p += len - point;
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = point; i < 0; i++) {
+            *p++ = '0';
+        }
+        memcpy(p, digits, (size_t)len);
+        p += len;
     }
-    return value;
+    return (int)(p - out);
 }
 
-static JSON_Value *parse_boolean_value(const char **string)
+/* Writes a number rounded to a fixed number of decimal places, falling back to the shortest form
+   when it is too large to scale exactly */
+static int serialize_number_fixed(double num, int decimals, char *out)
 {
-    size_t true_token_size = SIZEOF_TOKEN("true");
-    size_t false_token_size = SIZEOF_TOKEN("false");
-    if (strncmp("true", *string, true_token_size) == 0) {
-        *string += true_token_size;
-        return json_value_init_boolean(1);
-    } else if (strncmp("false", *string, false_token_size) == 0) {
-        *string += false_token_size;
-        return json_value_init_boolean(0);
+    char digits[20];
+    char *p = out;
+    double scaled = fabs(num) * (double)pow10_table[decimals] + 0.5;
+    uint64_t n = 0;
+    int len = 0;
+    if (scaled >= 9007199254740992.0) { /* 2^53 */
+        return serialize_number_shortest(num, out);
+    }
+    n = (uint64_t)scaled;
+    if (num < 0 && n != 0) { /* no "-0.00" for readings that round to zero */
+        *p++ = '-';
+    }
+    do {
+        digits[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n != 0 || len <= decimals);
+    while (len > decimals) {
+        *p++ = digits[--len];
+    }
+    if (decimals > 0) {
+        *p++ = '.';
+        while (len > 0) {
+            *p++ = digits[--len];
+        }
     }
-    return NULL;
+    return (int)(p - out);
 }
 
-static JSON_Value *parse_number_value(const char **string)
+static void json_serialize_number(double num, JSON_Writer *writer)
 {
-    char *end;
-    double number = 0;
-    errno = 0;
-    number = strtod(*string, &end);
-    if (errno || !is_decimal(*string, (size_t)(end - *string))) {
-        return NULL;
-    }
-    *string = end;
-    return json_value_init_number(number);
+    char num_buf[NUM_BUF_SIZE];
+    int len = number_decimals < 0 ? serialize_number_shortest(num, num_buf)
+                                  : serialize_number_fixed(num, number_decimals, num_buf);
+    writer_append(writer, num_buf, (size_t)len);
 }
 
-static JSON_Value *parse_null_value(const char **string)
+static void append_indent(JSON_Writer *writer, int level)
 {
-    size_t token_size = SIZEOF_TOKEN("null");
-    if (strncmp("null", *string, token_size) == 0) {
-        *string += token_size;
-        return json_value_init_null();
+    int i;
+    for (i = 0; i < level; i++) {
+        APPEND_LITERAL(writer, "    ");
     }
-    return NULL;
 }
 
-/* Serialization */
-#define APPEND_STRING(str)                   \
-    do {                                     \
-        written = append_string(buf, (str)); \
-        if (written < 0) {                   \
-            return -1;                       \
-        }                                    \
-        if (buf != NULL) {                   \
-            buf += written;                  \
-        }                                    \
-        written_total += written;            \
-    } while (0)
-
-#define APPEND_INDENT(level)                   \
-    do {                                       \
-        written = append_indent(buf, (level)); \
-        if (written < 0) {                     \
-            return -1;                         \
-        }                                      \
-        if (buf != NULL) {                     \
-            buf += written;                    \
-        }                                      \
-        written_total += written;              \
-    } while (0)
-
-static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int level, int is_pretty,
-                                      char *num_buf)
-{
-    const char *key = NULL, *string = NULL;
-    JSON_Value *temp_value = NULL;
+static JSON_Status json_serialize_to_writer_r(const JSON_Value *value, JSON_Writer *writer, int level,
+                                              int is_pretty)
+{
+    const char *string = NULL;
     JSON_Array *array = NULL;
     JSON_Object *object = NULL;
     size_t i = 0, count = 0;
-    double num = 0.0;
-    int written = -1, written_total = 0;
 
     switch (json_value_get_type(value)) {
     case JSONArray:
         array = json_value_get_array(value);
         count = json_array_get_count(array);
-        APPEND_STRING("[");
+        APPEND_LITERAL(writer, "[");
         if (count > 0 && is_pretty) {
-            APPEND_STRING("\n");
+            APPEND_LITERAL(writer, "\n");
         }
         for (i = 0; i < count; i++) {
             if (is_pretty) {
-                APPEND_INDENT(level + 1);
-            }
-            temp_value = json_array_get_value(array, i);
-            written = json_serialize_to_buffer_r(temp_value, buf, level + 1, is_pretty, num_buf);
-            if (written < 0) {
-                return -1;
+                append_indent(writer, level + 1);
             }
-            if (buf != NULL) {
-                buf += written;
+            if (json_serialize_to_writer_r(array->items[i], writer, level + 1, is_pretty) != JSONSuccess) {
+                return JSONFailure;
             }
-            written_total += written;
             if (i < (count - 1)) {
-                APPEND_STRING(",");
+                APPEND_LITERAL(writer, ",");
             }
             if (is_pretty) {
-                APPEND_STRING("\n");
+                APPEND_LITERAL(writer, "\n");
             }
         }
         if (count > 0 && is_pretty) {
-            APPEND_INDENT(level);
+            append_indent(writer, level);
         }
-        APPEND_STRING("]");
-        return written_total;
+        APPEND_LITERAL(writer, "]");
+        break;
     case JSONObject:
         object = json_value_get_object(value);
         count = json_object_get_count(object);
-        APPEND_STRING("{");
+        APPEND_LITERAL(writer, "{");
         if (count > 0 && is_pretty) {
-            APPEND_STRING("\n");
+            APPEND_LITERAL(writer, "\n");
         }
         for (i = 0; i < count; i++) {
-            key = json_object_get_name(object, i);
-            if (key == NULL) {
-                return -1;
+            if (object->names[i] == NULL) {
+                return JSONFailure;
             }
             if (is_pretty) {
-                APPEND_INDENT(level + 1);
-            }
-            written = json_serialize_string(key, buf);
-            if (written < 0) {
-                return -1;
+                append_indent(writer, level + 1);
             }
-            if (buf != NULL) {
-                buf += written;
-            }
-            written_total += written;
-            APPEND_STRING(":");
+            json_serialize_string(object->names[i], writer);
+            APPEND_LITERAL(writer, ":");
             if (is_pretty) {
-                APPEND_STRING(" ");
-            }
-            temp_value = json_object_get_value(object, key);
-            written = json_serialize_to_buffer_r(temp_value, buf, level + 1, is_pretty, num_buf);
-            if (written < 0) {
-                return -1;
+                APPEND_LITERAL(writer, " ");
             }
-            if (buf != NULL) {
-                buf += written;
+            if (json_serialize_to_writer_r(object->values[i], writer, level + 1, is_pretty) != JSONSuccess) {
+                return JSONFailure;
             }
-            written_total += written;
             if (i < (count - 1)) {
-                APPEND_STRING(",");
+                APPEND_LITERAL(writer, ",");
             }
             if (is_pretty) {
-                APPEND_STRING("\n");
+                APPEND_LITERAL(writer, "\n");
             }
         }
         if (count > 0 && is_pretty) {
-            APPEND_INDENT(level);
+            append_indent(writer, level);
         }
-        APPEND_STRING("}");
-        return written_total;
+        APPEND_LITERAL(writer, "}");
+        break;
     case JSONString:
         string = json_value_get_string(value);
         if (string == NULL) {
-            return -1;
-        }
-        written = json_serialize_string(string, buf);
-        if (written < 0) {
-            return -1;
-        }
-        if (buf != NULL) {
-            buf += written;
+            return JSONFailure;
         }
-        written_total += written;
-        return written_total;
+        json_serialize_string(string, writer);
+        break;
     case JSONBoolean:
         if (json_value_get_boolean(value)) {
-            APPEND_STRING("true");
+            APPEND_LITERAL(writer, "true");
         } else {
-            APPEND_STRING("false");
+            APPEND_LITERAL(writer, "false");
         }
-        return written_total;
+        break;
     case JSONNumber:
-        num = json_value_get_number(value);
-        if (buf != NULL) {
-            num_buf = buf;
-        }
-        written = sprintf(num_buf, FLOAT_FORMAT, num);
-        if (written < 0) {
-            return -1;
-        }
-        if (buf != NULL) {
-            buf += written;
-        }
-        written_total += written;
-        return written_total;
+        json_serialize_number(json_value_get_number(value), writer);
+        break;
     case JSONNull:
-        APPEND_STRING("null");
-        return written_total;
+        APPEND_LITERAL(writer, "null");
+        break;
     case JSONError:
-        return -1;
+        return JSONFailure;
     default:
-        return -1;
+        return JSONFailure;
     }
+    return writer->failed ? JSONFailure : JSONSuccess;
 }
 
-static int json_serialize_string(const char *string, char *buf)
+/* Copies runs of characters that need no escaping in one go */
+static void json_serialize_string(const char *string, JSON_Writer *writer)
 {
-    size_t i = 0, len = strlen(string);
-    char c = '\0';
-    int written = -1, written_total = 0;
-    APPEND_STRING("\"");
-    for (i = 0; i < len; i++) {
-        c = string[i];
+    static const char hex[] = "0123456789abcdef";
+    const char *run = string;
+    char escape[7] = {'\\', 'u', '0', '0', '0', '0', '\0'};
+    unsigned char c = 0;
+    APPEND_LITERAL(writer, "\"");
+    for (;; string++) {
+        c = (unsigned char)*string;
+        if (c >= 0x20 && c != '\"' && c != '\\' && c != '/') {
+            continue;
+        }
+        writer_append(writer, run, (size_t)(string - run));
+        run = string + 1;
         switch (c) {
+        case '\0':
+            APPEND_LITERAL(writer, "\"");
+            return;
         case '\"':
-            APPEND_STRING("\\\"");
+            APPEND_LITERAL(writer, "\\\"");
             break;
         case '\\':
-            APPEND_STRING("\\\\");
+            APPEND_LITERAL(writer, "\\\\");
             break;
         case '/':
-            APPEND_STRING("\\/");
-            break; /* to make json embeddable in xml\/html */
+            APPEND_LITERAL(writer, "\\/");
+            break;
         case '\b':
-            APPEND_STRING("\\b");
+            APPEND_LITERAL(writer, "\\b");
             break;
         case '\f':
-            APPEND_STRING("\\f");
+            APPEND_LITERAL(writer, "\\f");
             break;
         case '\n':
-            APPEND_STRING("\\n");
+            APPEND_LITERAL(writer, "\\n");
             break;
         case '\r':
-            APPEND_STRING("\\r");
+            APPEND_LITERAL(writer, "\\r");
             break;
         case '\t':
-            APPEND_STRING("\\t");
-            break;
-        case '\x00':
-            APPEND_STRING("\\u0000");
-            break;
-        case '\x01':
-            APPEND_STRING("\\u0001");
-            break;
-        case '\x02':
-            APPEND_STRING("\\u0002");
-            break;
-        case '\x03':
-            APPEND_STRING("\\u0003");
-            break;
-        case '\x04':
-            APPEND_STRING("\\u0004");
-            break;
-        case '\x05':
-            APPEND_STRING("\\u0005");
-            break;
-        case '\x06':
-            APPEND_STRING("\\u0006");
-            break;
-        case '\x07':
-            APPEND_STRING("\\u0007");
-            break;
-        /* '\x08' duplicate: '\b' */
-        /* '\x09' duplicate: '\t' */
-        /* '\x0a' duplicate: '\n' */
-        case '\x0b':
-            APPEND_STRING("\\u000b");
-            break;
-        /* '\x0c' duplicate: '\f' */
-        /* '\x0d' duplicate: '\r' */
-        case '\x0e':
-            APPEND_STRING("\\u000e");
-            break;
-        case '\x0f':
-            APPEND_STRING("\\u000f");
-            break;
-        case '\x10':
-            APPEND_STRING("\\u0010");
-            break;
-        case '\x11':
-            APPEND_STRING("\\u0011");
-            break;
-        case '\x12':
-            APPEND_STRING("\\u0012");
-            break;
-        case '\x13':
-            APPEND_STRING("\\u0013");
-            break;
-        case '\x14':
-            APPEND_STRING("\\u0014");
-            break;
-        case '\x15':
-            APPEND_STRING("\\u0015");
-            break;
-        case '\x16':
-            APPEND_STRING("\\u0016");
-            break;
-        case '\x17':
-            APPEND_STRING("\\u0017");
-            break;
-        case '\x18':
-            APPEND_STRING("\\u0018");
-            break;
-        case '\x19':
-            APPEND_STRING("\\u0019");
-            break;
-        case '\x1a':
-            APPEND_STRING("\\u001a");
-            break;
-        case '\x1b':
-            APPEND_STRING("\\u001b");
-            break;
-        case '\x1c':
-            APPEND_STRING("\\u001c");
-            break;
-        case '\x1d':
-            APPEND_STRING("\\u001d");
-            break;
-        case '\x1e':
-            APPEND_STRING("\\u001e");
-            break;
-        case '\x1f':
-            APPEND_STRING("\\u001f");
+            APPEND_LITERAL(writer, "\\t");
             break;
         default:
-            if (buf != NULL) {
-                buf[0] = c;
-                buf += 1;
-            }
-            written_total += 1;
+            escape[4] = hex[c >> 4];
+            escape[5] = hex[c & 0x0F];
+            writer_append(writer, escape, 6);
             break;
         }
     }
-    APPEND_STRING("\"");
-    return written_total;
 }
 
-static int append_indent(char *buf, int level)
+#undef APPEND_LITERAL
+
+/* Parser API */
+static JSON_Value *parse_bounded(const char *string, size_t length, int terminated)
 {
-    int i;
-    int written = -1, written_total = 0;
-    for (i = 0; i < level; i++) {
-        APPEND_STRING("    ");
+    const char *saved_end = parse_end;
+    int saved_terminated = parse_terminated;
+    JSON_Value *result = NULL;
+    if (length >= 3 && string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
+        string = string + 3; /* Support for UTF-8 BOM */
+        length -= 3;
     }
-    return written_total;
+    parse_end = string + length;
+    parse_terminated = terminated;
+    result = parse_value(&string, 0);
+    parse_end = saved_end;
+    parse_terminated = saved_terminated;
+    return result;
 }
 
-static int append_string(char *buf, const char *string)
+static JSON_Status sax_parse_bounded(const char *string, size_t length, int terminated,
+                                     const JSON_Sax_Handler *handler, void *context)
 {
-    if (buf == NULL) {
-        return (int)strlen(string);
+    const char *saved_end = parse_end;
+    int saved_terminated = parse_terminated;
+    JSON_Status status = JSONFailure;
+    SAX_Parser parser;
+    if (length >= 3 && string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
+        string = string + 3; /* Support for UTF-8 BOM */
+        length -= 3;
     }
-    return sprintf(buf, "%s", string);
+    parse_end = string + length;
+    parse_terminated = terminated;
+    parser.input = string;
+    parser.handler = handler;
+    parser.context = context;
+    status = sax_parse_value(&parser, &string, 0);
+    parse_end = saved_end;
+    parse_terminated = saved_terminated;
+    return status;
 }
 
-#undef APPEND_STRING
-#undef APPEND_INDENT
-
-/* Parser API */
 JSON_Value *json_parse_string(const char *string)
 {
     if (string == NULL) {
         return NULL;
     }
-    if (string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
-        string = string + 3; /* Support for UTF-8 BOM */
+    return parse_bounded(string, strlen(string), 1);
+}
+
+JSON_Value *json_parse_buffer(const char *buffer, size_t length)
+{
+    if (buffer == NULL) {
+        return NULL;
+    }
+    return parse_bounded(buffer, length, 0);
+}
+
+JSON_Status json_parse_sax(const char *string, const JSON_Sax_Handler *handler, void *context)
+{
+    if (string == NULL || handler == NULL) {
+        return JSONFailure;
+    }
+    return sax_parse_bounded(string, strlen(string), 1, handler, context);
+}
+
+JSON_Status json_parse_sax_buffer(const char *buffer, size_t length, const JSON_Sax_Handler *handler,
+                                  void *context)
+{
+    if (buffer == NULL || handler == NULL) {
+        return JSONFailure;
     }
-    return parse_value((const char **)&string, 0);
+    return sax_parse_bounded(buffer, length, 0, handler, context);
 }
 
 JSON_Value *json_parse_string_with_comments(const char *string)
@@ -1236,7 +2420,7 @@ JSON_Value *json_parse_string_with_comments(const char *string)
     remove_comments(string_mutable_copy, "/*", "*/");
     remove_comments(string_mutable_copy, "//", "\n");
     string_mutable_copy_ptr = string_mutable_copy;
-    result = parse_value((const char **)&string_mutable_copy_ptr, 0);
+    result = parse_bounded(string_mutable_copy_ptr, strlen(string_mutable_copy_ptr), 1);
     parson_free(string_mutable_copy);
     return result;
 }
@@ -1633,89 +2817,81 @@ JSON_Value *json_value_deep_copy(const JSON_Value *value)
     }
 }
 
-size_t json_serialization_size(const JSON_Value *value)
+static size_t serialization_size(const JSON_Value *value, int is_pretty)
 {
-    char num_buf[NUM_BUF_SIZE]; /* recursively allocating buffer on stack is a bad idea, so let's do
-                                   it only once */
-    int res = json_serialize_to_buffer_r(value, NULL, 0, 0, num_buf);
-    return res < 0 ? 0 : (size_t)(res + 1);
+    JSON_Writer writer = {NULL, 0, (size_t)-1, 0, 0}; /* measures without writing */
+    if (json_serialize_to_writer_r(value, &writer, 0, is_pretty) != JSONSuccess) {
+        return 0;
+    }
+    return writer.len + 1;
 }
 
-JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes)
+static JSON_Status serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes,
+                                       int is_pretty)
 {
-    int written = -1;
-    size_t needed_size_in_bytes = json_serialization_size(value);
-    if (needed_size_in_bytes == 0 || buf_size_in_bytes < needed_size_in_bytes) {
+    JSON_Writer writer = {NULL, 0, 0, 0, 0};
+    if (buf == NULL) {
         return JSONFailure;
     }
-    written = json_serialize_to_buffer_r(value, buf, 0, 0, NULL);
-    if (written < 0) {
+    writer.buf = buf;
+    writer.capacity = buf_size_in_bytes;
+    if (json_serialize_to_writer_r(value, &writer, 0, is_pretty) != JSONSuccess) {
         return JSONFailure;
     }
+    buf[writer.len] = '\0';
     return JSONSuccess;
 }
 
-char *json_serialize_to_string(const JSON_Value *value)
+/* Serializes in one pass into a buffer that doubles as needed */
+static char *serialize_to_string(const JSON_Value *value, int is_pretty)
 {
-    JSON_Status serialization_result = JSONFailure;
-    size_t buf_size_bytes = json_serialization_size(value);
-    char *buf = NULL;
-    if (buf_size_bytes == 0) {
+    JSON_Writer writer = {NULL, 0, SERIALIZATION_STARTING_CAPACITY, 1, 0};
+    writer.buf = (char *)parson_malloc(writer.capacity);
+    if (writer.buf == NULL) {
         return NULL;
     }
-    buf = (char *)parson_malloc(buf_size_bytes);
-    if (buf == NULL) {
-        return NULL;
-    }
-    serialization_result = json_serialize_to_buffer(value, buf, buf_size_bytes);
-    if (serialization_result == JSONFailure) {
-        json_free_serialized_string(buf);
+    if (json_serialize_to_writer_r(value, &writer, 0, is_pretty) != JSONSuccess) {
+        parson_free(writer.buf);
         return NULL;
     }
-    return buf;
+    writer.buf[writer.len] = '\0';
+    return writer.buf;
+}
+
+size_t json_serialization_size(const JSON_Value *value)
+{
+    return serialization_size(value, 0);
+}
+
+JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes)
+{
+    return serialize_to_buffer(value, buf, buf_size_in_bytes, 0);
+}
+
+char *json_serialize_to_string(const JSON_Value *value)
+{
+    return serialize_to_string(value, 0);
 }
 
 size_t json_serialization_size_pretty(const JSON_Value *value)
 {
-    char num_buf[NUM_BUF_SIZE]; /* recursively allocating buffer on stack is a bad idea, so let's do
-                                   it only once */
-    int res = json_serialize_to_buffer_r(value, NULL, 0, 1, num_buf);
-    return res < 0 ? 0 : (size_t)(res + 1);
+    return serialization_size(value, 1);
 }
 
 JSON_Status json_serialize_to_buffer_pretty(const JSON_Value *value, char *buf,
                                             size_t buf_size_in_bytes)
 {
-    int written = -1;
-    size_t needed_size_in_bytes = json_serialization_size_pretty(value);
-    if (needed_size_in_bytes == 0 || buf_size_in_bytes < needed_size_in_bytes) {
-        return JSONFailure;
-    }
-    written = json_serialize_to_buffer_r(value, buf, 0, 1, NULL);
-    if (written < 0) {
-        return JSONFailure;
-    }
-    return JSONSuccess;
+    return serialize_to_buffer(value, buf, buf_size_in_bytes, 1);
 }
 
 char *json_serialize_to_string_pretty(const JSON_Value *value)
 {
-    JSON_Status serialization_result = JSONFailure;
-    size_t buf_size_bytes = json_serialization_size_pretty(value);
-    char *buf = NULL;
-    if (buf_size_bytes == 0) {
-        return NULL;
-    }
-    buf = (char *)parson_malloc(buf_size_bytes);
-    if (buf == NULL) {
-        return NULL;
-    }
-    serialization_result = json_serialize_to_buffer_pretty(value, buf, buf_size_bytes);
-    if (serialization_result == JSONFailure) {
-        json_free_serialized_string(buf);
-        return NULL;
-    }
-    return buf;
+    return serialize_to_string(value, 1);
+}
+
+void json_set_number_serialization_decimals(int decimals)
+{
+    number_decimals = decimals > MAX_NUMBER_DECIMALS ? MAX_NUMBER_DECIMALS : decimals;
 }
 
 void json_free_serialized_string(char *string)
@@ -1876,20 +3052,15 @@ JSON_Status json_array_append_null(JSON_Array *array)
 JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Value *value)
 {
     size_t i = 0;
-    JSON_Value *old_value;
     if (object == NULL || name == NULL || value == NULL || value->parent != NULL) {
         return JSONFailure;
     }
-    old_value = json_object_get_value(object, name);
-    if (old_value != NULL) { /* free and overwrite old value */
-        json_value_free(old_value);
-        for (i = 0; i < json_object_get_count(object); i++) {
-            if (strcmp(object->names[i], name) == 0) {
-                value->parent = json_object_get_wrapping_value(object);
-                object->values[i] = value;
-                return JSONSuccess;
-            }
-        }
+    i = json_object_getn_index(object, name, strlen(name));
+    if (i != OBJECT_NOT_FOUND) { /* free and overwrite old value */
+        json_value_free(object->values[i]);
+        value->parent = json_object_get_wrapping_value(object);
+        object->values[i] = value;
+        return JSONSuccess;
     }
     /* add new key value pair */
     return json_object_add(object, name, value);
@@ -2032,6 +3203,7 @@ JSON_Status json_object_clear(JSON_Object *object)
         json_value_free(object->values[i]);
     }
     object->count = 0;
+    json_object_index_free(object);
     return JSONSuccess;
 }
 
@@ -2200,3 +3372,158 @@ void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Fu
     parson_malloc = malloc_fun;
     parson_free = free_fun;
 }
+
+/* Arena allocation */
+#define ARENA_ALIGNMENT 8
+#define ARENA_ALIGN(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+typedef struct json_arena_block_t {
+    struct json_arena_block_t *next;
+    size_t size;
+    size_t used;
+} JSON_Arena_Block;
+
+struct json_arena_t {
+    JSON_Arena_Block *first;
+    JSON_Arena_Block *current;
+    size_t block_size;
+    void *last; /* most recent allocation, the only one a free can reclaim */
+    size_t block_allocations;
+    JSON_Malloc_Function backing_malloc;
+    JSON_Free_Function backing_free;
+    JSON_Malloc_Function saved_malloc;
+    JSON_Free_Function saved_free;
+};
+
+static JSON_Arena *active_arena = NULL;
+
+static unsigned char *arena_block_data(JSON_Arena_Block *block)
+{
+    return (unsigned char *)block + ARENA_ALIGN(sizeof(JSON_Arena_Block));
+}
+
+static JSON_Arena_Block *arena_new_block(JSON_Arena *arena, size_t size)
+{
+    JSON_Arena_Block *block =
+        (JSON_Arena_Block *)arena->backing_malloc(ARENA_ALIGN(sizeof(JSON_Arena_Block)) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->block_allocations++;
+    return block;
+}
+
+static void *arena_malloc(size_t size)
+{
+    return json_arena_alloc(active_arena, size);
+}
+
+static void arena_free(void *ptr)
+{
+    if (ptr != NULL && ptr == active_arena->last) {
+        active_arena->current->used = (size_t)((unsigned char *)ptr - arena_block_data(active_arena->current));
+        active_arena->last = NULL;
+    }
+}
+
+JSON_Arena *json_arena_create(size_t block_size)
+{
+    JSON_Arena *arena = (JSON_Arena *)parson_malloc(sizeof(JSON_Arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    memset(arena, 0, sizeof(JSON_Arena));
+    arena->block_size = ARENA_ALIGN(block_size > 0 ? block_size : 1);
+    arena->backing_malloc = parson_malloc;
+    arena->backing_free = parson_free;
+    arena->first = arena->current = arena_new_block(arena, arena->block_size);
+    if (arena->first == NULL) {
+        parson_free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void json_arena_destroy(JSON_Arena *arena)
+{
+    JSON_Arena_Block *block = NULL, *next = NULL;
+    if (arena == NULL) {
+        return;
+    }
+    if (active_arena == arena) {
+        json_arena_end(arena);
+    }
+    for (block = arena->first; block != NULL; block = next) {
+        next = block->next;
+        arena->backing_free(block);
+    }
+    arena->backing_free(arena);
+}
+
+void json_arena_begin(JSON_Arena *arena)
+{
+    arena->saved_malloc = parson_malloc;
+    arena->saved_free = parson_free;
+    active_arena = arena;
+    parson_malloc = arena_malloc;
+    parson_free = arena_free;
+}
+
+void json_arena_end(JSON_Arena *arena)
+{
+    JSON_Arena_Block *block = NULL, *next = NULL, *merged = NULL;
+    size_t total = 0;
+    parson_malloc = arena->saved_malloc;
+    parson_free = arena->saved_free;
+    active_arena = NULL;
+    arena->last = NULL;
+    if (arena->first->next != NULL) {
+        /* The scope overflowed the first block, replace the chain with one block big enough
+           for all of it so later scopes of the same size fit without growing */
+        for (block = arena->first; block != NULL; block = block->next) {
+            total += block->size;
+        }
+        merged = arena_new_block(arena, total);
+        if (merged != NULL) {
+            for (block = arena->first; block != NULL; block = next) {
+                next = block->next;
+                arena->backing_free(block);
+            }
+            arena->first = merged;
+        }
+    }
+    for (block = arena->first; block != NULL; block = block->next) {
+        block->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+void *json_arena_alloc(JSON_Arena *arena, size_t size)
+{
+    JSON_Arena_Block *block = arena->current;
+    void *ptr = NULL;
+    size = ARENA_ALIGN(size > 0 ? size : 1);
+    while (block->size - block->used < size) {
+        if (block->next == NULL) {
+            block->next = arena_new_block(arena, MAX(arena->block_size, size));
+            if (block->next == NULL) {
+                return NULL;
+            }
+        }
+        block = block->next;
+        block->used = 0;
+    }
+    ptr = arena_block_data(block) + block->used;
+    block->used += size;
+    arena->current = block;
+    arena->last = ptr;
+    return ptr;
+}
+
+size_t json_arena_block_allocations(const JSON_Arena *arena)
+{
+    return arena->block_allocations;
+}
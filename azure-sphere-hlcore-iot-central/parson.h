@@ -63,18 +63,77 @@ typedef void (*JSON_Free_Function)(void *);
    from stdlib will be used for all allocations */
 void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun);
 
+/* Arena allocation. Between json_arena_begin and json_arena_end every parson allocation is
+   bumped from the arena and frees only reclaim the most recent allocation. json_arena_end
+   releases everything at once and keeps the memory for the next scope, so after warmup a scope
+   makes no malloc calls. Values created in a scope must not be used after it ends. Scopes do not
+   nest and are not thread safe. */
+typedef struct json_arena_t JSON_Arena;
+
+JSON_Arena *json_arena_create(size_t block_size); /* blocks come from the current allocator */
+void json_arena_destroy(JSON_Arena *arena);
+void json_arena_begin(JSON_Arena *arena);
+void json_arena_end(JSON_Arena *arena);
+void *json_arena_alloc(JSON_Arena *arena, size_t size); /* caller data that lives for the scope */
+size_t json_arena_block_allocations(const JSON_Arena *arena); /* blocks malloc'd since creation */
+
 /*  Parses first JSON value in a string, returns NULL in case of error */
 JSON_Value *json_parse_string(const char *string);
 
+/*  Parses first JSON value in the first length bytes of buffer, which need not be NUL terminated
+    and is never read beyond length. Returns NULL in case of error */
+JSON_Value *json_parse_buffer(const char *buffer, size_t length);
+
 /*  Parses first JSON value in a string and ignores comments (/ * * / and //),
     returns NULL in case of error */
 JSON_Value *json_parse_string_with_comments(const char *string);
 
+/* Streaming (SAX style) parsing */
+enum json_sax_result_t {
+    JSONSaxContinue = 0,   /* keep going */
+    JSONSaxSkip = 1,       /* from on_key: skip the member's value, including whole subtrees */
+    JSONSaxParseValue = 2, /* from on_key: build the member's value and pass it to on_value */
+    JSONSaxAbort = -1      /* stop parsing, json_parse_sax returns JSONFailure */
+};
+typedef int JSON_Sax_Result;
+
+/* Any callback may be NULL. Strings and keys are not NUL terminated, use their lengths. Those with
+   no escapes point into the input, others are decoded into a temporary buffer; either way they
+   are only valid for the duration of the callback (for a key, until the on_value call that
+   follows it). depth is 1 for members of the outermost object or array. Values with no callback
+   are skipped without being decoded. */
+typedef struct json_sax_handler_t {
+    JSON_Sax_Result (*on_key)(void *context, const char *key, size_t key_len, size_t depth);
+    JSON_Sax_Result (*on_value)(void *context, const char *key, size_t key_len,
+                                JSON_Value *value); /* value is freed after the call */
+    JSON_Sax_Result (*on_object_start)(void *context, size_t depth);
+    JSON_Sax_Result (*on_object_end)(void *context, size_t depth);
+    JSON_Sax_Result (*on_array_start)(void *context, size_t depth);
+    JSON_Sax_Result (*on_array_end)(void *context, size_t depth);
+    JSON_Sax_Result (*on_string)(void *context, const char *string, size_t len);
+    JSON_Sax_Result (*on_number)(void *context, double number);
+    JSON_Sax_Result (*on_boolean)(void *context, int boolean);
+    JSON_Sax_Result (*on_null)(void *context);
+} JSON_Sax_Handler;
+
+/*  Parses first JSON value in a string, streaming it to handler without building JSON_Values
+    (except those requested with JSONSaxParseValue). Skipped values are not decoded, but are
+    rejected wherever a parse would reject them. */
+JSON_Status json_parse_sax(const char *string, const JSON_Sax_Handler *handler, void *context);
+JSON_Status json_parse_sax_buffer(const char *buffer, size_t length, const JSON_Sax_Handler *handler,
+                                  void *context);
+
 /* Serialization */
 size_t json_serialization_size(const JSON_Value *value); /* returns 0 on fail */
 JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes);
 char *json_serialize_to_string(const JSON_Value *value);
 
+/* Numbers are serialized with the fewest digits that read back as the same double. Sensor
+   readings usually want a fixed number of decimal places instead (0 to 9, rounded); pass a
+   negative value to return to the default. Numbers too large for the fixed form are written in
+   full. Applies to all serialization, like json_set_allocation_functions. */
+void json_set_number_serialization_decimals(int decimals);
+
 /* Pretty serialization */
 size_t json_serialization_size_pretty(const JSON_Value *value); /* returns 0 on fail */
 JSON_Status json_serialize_to_buffer_pretty(const JSON_Value *value, char *buf,
@@ -0,0 +1,176 @@
+#include "provisioning.h"
+#include "globals.h"
+#include "timer_wheel.h"
+#include <applibs/log.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static void CompletionEventHandler(EventData* eventData);
+static void RetryTimerEventHandler(EventData* eventData);
+
+static EventData completionEventData = { .eventHandler = &CompletionEventHandler };
+static Timer retryTimer = {
+	.eventData = {.eventHandler = &RetryTimerEventHandler },
+	.name = "ProvisioningRetry"
+};
+
+static int completionFd = -1;
+static const char* _scopeId = NULL;
+static ProvisioningBackend _backend = NULL;
+static ProvisioningCompleteHandler _onComplete = NULL;
+static ProvisioningState state = ProvisioningState_Idle;
+static ProvisioningStats provisioningStats;
+static struct timespec requestTime;
+static unsigned int jitterSeed;
+
+// Written by the worker thread, read on the event loop thread after pthread_join
+static pthread_t worker;
+static bool workerRunning = false;
+static void* workerResult = NULL;
+static uint32_t workerDurationMs = 0;
+
+static uint32_t ElapsedMs(const struct timespec* since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000);
+}
+
+static void* ProvisioningWorker(void* arg) {
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	workerResult = _backend(_scopeId, PROVISIONING_TIMEOUT_MS);
+	workerDurationMs = ElapsedMs(&start);
+
+	uint64_t signal = 1;
+	if (write(completionFd, &signal, sizeof(signal)) == -1) {
+		Log_Debug("ERROR: Unable to signal provisioning completion: %d (%s)\n", errno, strerror(errno));
+	}
+	return NULL;
+}
+
+/// <summary>
+///     Schedules the next attempt after an exponentially growing delay. The delay is picked at
+///     random from its upper half so that devices which lost connectivity together do not all
+///     retry together.
+/// </summary>
+static void ScheduleRetry(void) {
+	uint32_t shift = provisioningStats.consecutiveFailures - 1;
+	uint64_t delayMs = (uint64_t)PROVISIONING_BACKOFF_MIN_MS << (shift < 16 ? shift : 16);
+	if (delayMs > PROVISIONING_BACKOFF_MAX_MS) {
+		delayMs = PROVISIONING_BACKOFF_MAX_MS;
+	}
+	delayMs = delayMs / 2 + (uint64_t)rand_r(&jitterSeed) % (delayMs / 2 + 1);
+
+	provisioningStats.lastBackoffMs = (uint32_t)delayMs;
+	Log_Debug("INFO: Provisioning attempt %u failed, retrying in %u ms\n", provisioningStats.attempts, provisioningStats.lastBackoffMs);
+
+	state = ProvisioningState_Backoff;
+	retryTimer.period.tv_sec = (time_t)(delayMs / 1000);
+	retryTimer.period.tv_nsec = (long)(delayMs % 1000) * 1000000;
+	StartTimer(&retryTimer);
+}
+
+static void StartAttempt(void) {
+	state = ProvisioningState_Provisioning;
+	provisioningStats.attempts++;
+
+	workerResult = NULL;
+	if (pthread_create(&worker, NULL, ProvisioningWorker, NULL) != 0) {
+		Log_Debug("ERROR: Unable to start provisioning thread\n");
+		provisioningStats.failures++;
+		provisioningStats.consecutiveFailures++;
+		ScheduleRetry();
+		return;
+	}
+	workerRunning = true;
+}
+
+static void CompletionEventHandler(EventData* eventData) {
+	uint64_t signal;
+	if (read(completionFd, &signal, sizeof(signal)) == -1 || !workerRunning) {
+		return;
+	}
+
+	pthread_join(worker, NULL);
+	workerRunning = false;
+	provisioningStats.lastAttemptMs = workerDurationMs;
+
+	if (workerResult == NULL || !_onComplete(workerResult)) {
+		provisioningStats.failures++;
+		provisioningStats.consecutiveFailures++;
+		ScheduleRetry();
+		return;
+	}
+
+	state = ProvisioningState_Connected;
+	provisioningStats.connects++;
+	provisioningStats.lastTimeToConnectMs = ElapsedMs(&requestTime);
+	Log_Debug("INFO: Provisioned after %u attempts, %u ms\n", provisioningStats.consecutiveFailures + 1, provisioningStats.lastTimeToConnectMs);
+	provisioningStats.consecutiveFailures = 0;
+}
+
+static void RetryTimerEventHandler(EventData* eventData) {
+	// One shot, the next failure picks a new delay
+	StopTimer(&retryTimer);
+	StartAttempt();
+}
+
+int InitProvisioning(int epollFd, const char* scopeId, ProvisioningBackend backend, ProvisioningCompleteHandler onComplete) {
+	_scopeId = scopeId;
+	_backend = backend;
+	_onComplete = onComplete;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	jitterSeed = (unsigned int)(now.tv_sec ^ now.tv_nsec);
+
+	completionFd = eventfd(0, EFD_NONBLOCK);
+	if (completionFd < 0) {
+		Log_Debug("ERROR: Unable to create provisioning event: %d (%s)\n", errno, strerror(errno));
+		return -1;
+	}
+
+	return RegisterEventHandlerToEpoll(epollFd, completionFd, &completionEventData, EPOLLIN);
+}
+
+void RequestProvisioning(void) {
+	if (state != ProvisioningState_Idle || completionFd < 0) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &requestTime);
+	StartAttempt();
+}
+
+void ResetProvisioning(void) {
+	if (state == ProvisioningState_Connected) {
+		state = ProvisioningState_Idle;
+	}
+}
+
+ProvisioningState GetProvisioningState(void) {
+	return state;
+}
+
+const ProvisioningStats* GetProvisioningStats(void) {
+	return &provisioningStats;
+}
+
+void CloseProvisioning(void) {
+	StopTimer(&retryTimer);
+
+	if (workerRunning) {
+		pthread_join(worker, NULL);
+		workerRunning = false;
+	}
+
+	CloseFdAndPrintError(completionFd, "ProvisioningEvent");
+	completionFd = -1;
+	state = ProvisioningState_Idle;
+}
@@ -0,0 +1,79 @@
+#ifndef provisioning_h
+#define provisioning_h
+
+#include "epoll_timerfd_utilities.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Timeout handed to the provisioning backend, the call runs on a worker thread
+#ifndef PROVISIONING_TIMEOUT_MS
+#define PROVISIONING_TIMEOUT_MS 10000
+#endif
+// Delay after the first failed attempt, doubled after each further failure
+#ifndef PROVISIONING_BACKOFF_MIN_MS
+#define PROVISIONING_BACKOFF_MIN_MS 2000
+#endif
+// Longest delay between attempts
+#ifndef PROVISIONING_BACKOFF_MAX_MS
+#define PROVISIONING_BACKOFF_MAX_MS 300000
+#endif
+
+typedef enum {
+	ProvisioningState_Idle,         // not connected and no attempt scheduled
+	ProvisioningState_Provisioning, // backend running on the worker thread
+	ProvisioningState_Backoff,      // waiting to retry after a failed attempt
+	ProvisioningState_Connected     // backend returned a client
+} ProvisioningState;
+
+/// <summary>
+///     Provisions the device and creates an IoT Hub client, returning it as an opaque handle
+///     or NULL on failure. Runs on the worker thread and may block for up to timeoutMs. On the
+///     device this wraps the Azure Sphere DPS call; a host build can substitute a mock.
+/// </summary>
+typedef void* (*ProvisioningBackend)(const char* scopeId, unsigned int timeoutMs);
+
+/// <summary>
+///     Called on the event loop thread with the client created by a successful attempt. Returns
+///     false if the client could not be set up, after disposing of it, and the attempt then
+///     counts as failed and is retried after the backoff.
+/// </summary>
+typedef bool (*ProvisioningCompleteHandler)(void* clientHandle);
+
+typedef struct {
+	uint32_t attempts;            // backend calls started
+	uint32_t failures;            // backend calls that returned NULL, or a client that could not be set up
+	uint32_t connects;            // backend calls that returned a client
+	uint32_t consecutiveFailures; // failures since the last connect, drives the backoff
+	uint32_t lastBackoffMs;       // delay chosen after the most recent failure
+	uint32_t lastAttemptMs;       // duration of the most recent backend call
+	uint32_t lastTimeToConnectMs; // from request to connect, including retries and backoff
+} ProvisioningStats;
+
+/// <summary>
+///     Sets up the event used by the worker thread to report completion.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int InitProvisioning(int epollFd, const char* scopeId, ProvisioningBackend backend, ProvisioningCompleteHandler onComplete);
+
+/// <summary>
+///     Starts provisioning if none is running or scheduled. Never blocks; completion is reported
+///     through the ProvisioningCompleteHandler and failures are retried with exponential backoff
+///     and jitter.
+/// </summary>
+void RequestProvisioning(void);
+
+/// <summary>
+///     Returns to the idle state after the connection is lost, so the next request provisions
+///     again.
+/// </summary>
+void ResetProvisioning(void);
+
+ProvisioningState GetProvisioningState(void);
+const ProvisioningStats* GetProvisioningStats(void);
+
+/// <summary>
+///     Waits for any running attempt to finish and closes the completion event.
+/// </summary>
+void CloseProvisioning(void);
+
+#endif
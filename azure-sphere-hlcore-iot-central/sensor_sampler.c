@@ -0,0 +1,67 @@
+#include "sensor_sampler.h"
+#include <applibs/log.h>
+
+static bool ArmSampleTimer(SensorSampler* sampler, int waitMs) {
+	// A zero expiry would disarm the timer, so a result that is ready at once still waits 1 ns
+	struct timespec expiry = { waitMs / 1000, (waitMs % 1000) * 1000000L };
+	if (waitMs == 0) {
+		expiry.tv_nsec = 1;
+	}
+	return SetTimerFdToSingleExpiry(sampler->eventData.fd, &expiry) == 0;
+}
+
+static void SampleReadyEventHandler(EventData* eventData) {
+	SensorSampler* sampler = (SensorSampler*)eventData;
+
+	if (ConsumeTimerFdEvent(eventData->fd) != 0 || !sampler->pending) {
+		return;
+	}
+
+	// The bus is still busy, poll its status again from the timer rather than in the driver
+	int waitMs = sampler->finish(sampler->sensor);
+	if (waitMs > 0 && ArmSampleTimer(sampler, waitMs)) {
+		return;
+	}
+	if (waitMs > 0) {
+		Log_Debug("ERROR: Unable to wait for %s, abandoning the sample\n", sampler->name);
+	}
+
+	sampler->pending = false;
+	sampler->onComplete(sampler->sensor);
+}
+
+int InitSensorSampler(int epollFd, SensorSampler* sampler) {
+	static const struct timespec disarmed = { 0, 0 };
+
+	sampler->eventData.eventHandler = &SampleReadyEventHandler;
+	sampler->pending = false;
+
+	sampler->eventData.fd = CreateTimerFdAndAddToEpoll(epollFd, &disarmed, &sampler->eventData, EPOLLIN);
+	return sampler->eventData.fd < 0 ? -1 : 0;
+}
+
+bool StartSensorSample(SensorSampler* sampler) {
+	if (sampler->eventData.fd < 0 || sampler->pending) {
+		return false;
+	}
+
+	int waitMs = sampler->start(sampler->sensor);
+	if (waitMs < 0) {
+		Log_Debug("ERROR: Unable to start %s measurement\n", sampler->name);
+		sampler->onComplete(sampler->sensor);
+		return true;
+	}
+
+	if (!ArmSampleTimer(sampler, waitMs)) {
+		return false;
+	}
+
+	sampler->pending = true;
+	return true;
+}
+
+void CloseSensorSampler(SensorSampler* sampler) {
+	CloseFdAndPrintError(sampler->eventData.fd, sampler->name);
+	sampler->eventData.fd = -1;
+	sampler->pending = false;
+}
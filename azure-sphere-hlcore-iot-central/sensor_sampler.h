@@ -0,0 +1,57 @@
+#ifndef sensor_sampler_h
+#define sensor_sampler_h
+
+#include "epoll_timerfd_utilities.h"
+#include <stdbool.h>
+
+/// <summary>
+///     Begins a measurement without waiting for it.
+/// </summary>
+/// <returns>Milliseconds until the result can be collected, or -1 on failure</returns>
+typedef int (*SensorStart)(void* sensor);
+
+/// <summary>
+///     Collects the result of the measurement begun by SensorStart, without sleeping.
+/// </summary>
+/// <returns>0 once the sample is complete, or milliseconds until it should be called again,
+///     while the I2C bus is still busy</returns>
+typedef int (*SensorFinish)(void* sensor);
+
+/// <summary>
+///     Called on the event loop once a sample is complete, or straight away if the measurement
+///     could not be started. The sensor then reports no reading.
+/// </summary>
+typedef void (*SensorSampleHandler)(void* sensor);
+
+/// <summary>
+///     Samples a sensor through the Grove library's StartRead and FinishRead, waiting for the
+///     conversion and for any I2C status polls on a one shot timerfd, so the event loop keeps
+///     running and no driver sleeps on it. Each step still waits for the bridge to answer over
+///     the UART. The timerfd is the sampler's own rather than a timer wheel Timer, whose slack
+///     could fire it before the conversion is done.
+/// </summary>
+typedef struct {
+	EventData eventData; // must be first, owned by sensor_sampler.c
+	void* sensor;
+	SensorStart start;
+	SensorFinish finish;
+	SensorSampleHandler onComplete;
+	const char* name;
+	bool pending; // started and waiting for the timer, or polling the I2C status
+} SensorSampler;
+
+/// <summary>
+///     Creates the sampler's timerfd, disarmed, and adds it to the epoll instance.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int InitSensorSampler(int epollFd, SensorSampler* sampler);
+
+/// <summary>
+///     Starts a sample. Never blocks; the result is delivered to onComplete.
+/// </summary>
+/// <returns>false if the previous sample is still pending or the timer could not be armed</returns>
+bool StartSensorSample(SensorSampler* sampler);
+
+void CloseSensorSampler(SensorSampler* sampler);
+
+#endif
@@ -0,0 +1,209 @@
+#include "telemetry.h"
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Largest float magnitude written by the JSON encoder before falling back to null,
+// keeps the scaled value well inside an int64_t for any supported precision.
+#define JSON_MAX_MAGNITUDE 1e12
+#define JSON_MAX_PRECISION 6
+
+typedef struct {
+	uint8_t* next;
+	uint8_t* end;
+	bool overflow;
+} Writer;
+
+static const uint32_t powersOfTen[JSON_MAX_PRECISION + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+static void PutByte(Writer* writer, uint8_t value) {
+	if (writer->next < writer->end) {
+		*writer->next++ = value;
+	}
+	else {
+		writer->overflow = true;
+	}
+}
+
+static void PutBytes(Writer* writer, const void* data, size_t length) {
+	if ((size_t)(writer->end - writer->next) >= length) {
+		memcpy(writer->next, data, length);
+		writer->next += length;
+	}
+	else {
+		writer->overflow = true;
+	}
+}
+
+static int Finish(Writer* writer, uint8_t* buffer) {
+	return writer->overflow ? -1 : (int)(writer->next - buffer);
+}
+
+/// <summary>
+///     Writes the decimal digits of value, zero padded to at least minDigits.
+/// </summary>
+static void PutDecimal(Writer* writer, uint64_t value, int minDigits) {
+	char digits[20];
+	int count = 0;
+
+	do {
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0 || count < minDigits);
+
+	while (count > 0) {
+		PutByte(writer, (uint8_t)digits[--count]);
+	}
+}
+
+static void PutJsonInt(Writer* writer, int32_t value) {
+	if (value < 0) {
+		PutByte(writer, '-');
+		PutDecimal(writer, (uint64_t)(-(int64_t)value), 1);
+	}
+	else {
+		PutDecimal(writer, (uint64_t)value, 1);
+	}
+}
+
+static void PutJsonFixed(Writer* writer, float value, int precision) {
+	if (precision < 0) {
+		precision = 0;
+	}
+	if (precision > JSON_MAX_PRECISION) {
+		precision = JSON_MAX_PRECISION;
+	}
+
+	double magnitude = fabs((double)value);
+	if (isnan(value) || magnitude >= JSON_MAX_MAGNITUDE) {
+		PutBytes(writer, "null", 4);
+		return;
+	}
+
+	uint32_t scale = powersOfTen[precision];
+	uint64_t scaled = (uint64_t)(magnitude * scale + 0.5);
+
+	if (value < 0 && scaled != 0) {
+		PutByte(writer, '-');
+	}
+	PutDecimal(writer, scaled / scale, 1);
+	if (precision > 0) {
+		PutByte(writer, '.');
+		PutDecimal(writer, scaled % scale, precision);
+	}
+}
+
+static int EncodeJson(const TelemetrySchema* schema, const TelemetryValue values[], uint8_t* buffer, size_t bufferSize) {
+	Writer writer = { .next = buffer, .end = buffer + bufferSize, .overflow = false };
+
+	PutByte(&writer, '{');
+	for (size_t i = 0; i < schema->fieldCount; i++) {
+		const TelemetryField* field = &schema->fields[i];
+
+		if (i > 0) {
+			PutByte(&writer, ',');
+		}
+		PutByte(&writer, '"');
+		PutBytes(&writer, field->name, strlen(field->name));
+		PutBytes(&writer, "\":", 2);
+
+		if (field->type == TelemetryFieldType_Float) {
+			PutJsonFixed(&writer, values[i].f, field->precision);
+		}
+		else {
+			PutJsonInt(&writer, values[i].i);
+		}
+	}
+	PutByte(&writer, '}');
+
+	return Finish(&writer, buffer);
+}
+
+const TelemetryEncoder JsonTelemetryEncoder = {
+	.name = "json",
+	.contentType = "application/json",
+	.contentEncoding = "utf-8",
+	.encode = EncodeJson,
+	.batchOpen = "[",
+	.batchSeparator = ",",
+	.batchClose = "]"
+};
+
+#define CBOR_MAJOR_UNSIGNED 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_MAP 5
+#define CBOR_FLOAT32 0xFA
+
+/// <summary>
+///     Writes a CBOR initial byte and argument using the shortest form.
+/// </summary>
+static void PutCborHead(Writer* writer, uint8_t major, uint32_t argument) {
+	major = (uint8_t)(major << 5);
+
+	if (argument < 24) {
+		PutByte(writer, major | (uint8_t)argument);
+	}
+	else if (argument <= 0xFF) {
+		uint8_t head[] = { major | 24, (uint8_t)argument };
+		PutBytes(writer, head, sizeof(head));
+	}
+	else if (argument <= 0xFFFF) {
+		uint8_t head[] = { major | 25, (uint8_t)(argument >> 8), (uint8_t)argument };
+		PutBytes(writer, head, sizeof(head));
+	}
+	else {
+		uint8_t head[] = { major | 26, (uint8_t)(argument >> 24), (uint8_t)(argument >> 16),
+			(uint8_t)(argument >> 8), (uint8_t)argument };
+		PutBytes(writer, head, sizeof(head));
+	}
+}
+
+static void PutCborFloat(Writer* writer, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint8_t encoded[] = { CBOR_FLOAT32, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits };
+	PutBytes(writer, encoded, sizeof(encoded));
+}
+
+static void PutCborInt(Writer* writer, int32_t value) {
+	if (value < 0) {
+		PutCborHead(writer, CBOR_MAJOR_NEGATIVE, (uint32_t)(-1 - value));
+	}
+	else {
+		PutCborHead(writer, CBOR_MAJOR_UNSIGNED, (uint32_t)value);
+	}
+}
+
+static int EncodeCbor(const TelemetrySchema* schema, const TelemetryValue values[], uint8_t* buffer, size_t bufferSize) {
+	Writer writer = { .next = buffer, .end = buffer + bufferSize, .overflow = false };
+
+	PutCborHead(&writer, CBOR_MAJOR_MAP, (uint32_t)schema->fieldCount);
+	for (size_t i = 0; i < schema->fieldCount; i++) {
+		const TelemetryField* field = &schema->fields[i];
+		size_t nameLength = strlen(field->name);
+
+		PutCborHead(&writer, CBOR_MAJOR_TEXT, (uint32_t)nameLength);
+		PutBytes(&writer, field->name, nameLength);
+
+		if (field->type == TelemetryFieldType_Float) {
+			PutCborFloat(&writer, values[i].f);
+		}
+		else {
+			PutCborInt(&writer, values[i].i);
+		}
+	}
+
+	return Finish(&writer, buffer);
+}
+
+const TelemetryEncoder CborTelemetryEncoder = {
+	.name = "cbor",
+	.contentType = "application/cbor",
+	.contentEncoding = NULL,
+	.encode = EncodeCbor,
+	.batchOpen = "\x9f",
+	.batchSeparator = "",
+	.batchClose = "\xff"
+};
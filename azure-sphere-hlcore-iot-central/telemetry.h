@@ -0,0 +1,61 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+	TelemetryFieldType_Float,
+	TelemetryFieldType_Int
+} TelemetryFieldType;
+
+/// <summary>
+///     Describes one telemetry value. precision is the number of decimal places written for
+///     floats by text encoders; binary encoders keep full float precision.
+/// </summary>
+typedef struct {
+	const char* name;
+	TelemetryFieldType type;
+	int precision;
+} TelemetryField;
+
+typedef struct {
+	const TelemetryField* fields;
+	size_t fieldCount;
+} TelemetrySchema;
+
+typedef union {
+	float f;
+	int32_t i;
+} TelemetryValue;
+
+/// <summary>
+///     A telemetry encoder backend. encode writes one message holding values[i] for each field
+///     of the schema straight into buffer, and returns the number of bytes written or -1 if the
+///     buffer is too small. Messages are not NUL terminated. contentEncoding is NULL for binary
+///     formats. Several messages are combined into one payload as batchOpen, the messages
+///     separated by batchSeparator, then batchClose.
+/// </summary>
+typedef struct {
+	const char* name;
+	const char* contentType;
+	const char* contentEncoding;
+	int (*encode)(const TelemetrySchema* schema, const TelemetryValue values[], uint8_t* buffer, size_t bufferSize);
+	const char* batchOpen;
+	const char* batchSeparator;
+	const char* batchClose;
+} TelemetryEncoder;
+
+/// <summary>
+///     {"Temperature":23.45,"Humidity":45.6,"MsgId":12}. Numbers are written without printf,
+///     rounded to each field's precision. NaN and out of range floats are written as null.
+/// </summary>
+extern const TelemetryEncoder JsonTelemetryEncoder;
+
+/// <summary>
+///     RFC 7049 CBOR map of text keys to float32 or integer values. Batches are indefinite
+///     length arrays.
+/// </summary>
+extern const TelemetryEncoder CborTelemetryEncoder;
+
+#endif
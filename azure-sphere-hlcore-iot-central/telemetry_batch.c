@@ -0,0 +1,260 @@
+#include "telemetry_batch.h"
+#include <string.h>
+
+#define LOG(...) do { if (batchLog != NULL) { batchLog(__VA_ARGS__); } } while (0)
+
+// Batches live in a ring. Batches from head up to the open slot are closed and waiting to be
+// sent; the open slot is the one being filled and may be empty.
+typedef struct {
+	size_t length;
+	uint32_t messageCount;
+	uint32_t firstTag;
+	uint32_t lastTag;
+	struct timespec opened;
+	unsigned char data[TELEMETRY_BATCH_MAX_BYTES];
+} TelemetryBatch;
+
+// A batch handed to the send function, the context of its delivery callback
+typedef struct {
+	bool inUse;
+	uint32_t messageCount;
+	uint32_t firstTag;
+	uint32_t lastTag;
+} InFlightBatch;
+
+static TelemetryBatch batchQueue[TELEMETRY_BATCH_QUEUE_LENGTH];
+static size_t batchQueueHead = 0;
+static size_t closedBatchCount = 0;
+static InFlightBatch inFlightBatches[TELEMETRY_BATCH_IN_FLIGHT];
+
+static const TelemetryEncoder* batchEncoder = NULL;
+static TelemetryBatchPolicy batchPolicy;
+static TelemetrySendFunction sendBatch = NULL;
+static TelemetryBatchResultFunction batchResult = NULL;
+static TelemetryBatchLogFunction batchLog = NULL;
+static size_t openLength = 0;
+static size_t separatorLength = 0;
+static size_t closeLength = 0;
+
+static TelemetryBatchStats telemetryBatchStats;
+
+static TelemetryBatch* OpenBatch(void) {
+	return &batchQueue[(batchQueueHead + closedBatchCount) % TELEMETRY_BATCH_QUEUE_LENGTH];
+}
+
+static void ReportResult(uint32_t firstTag, uint32_t lastTag, bool delivered) {
+	if (batchResult != NULL && firstTag != TELEMETRY_NO_TAG) {
+		batchResult(firstTag, lastTag, delivered);
+	}
+}
+
+/// <summary>
+///     Delivery callback for a sent batch. Releases its in flight slot; closed batches waiting
+///     for a slot go out with the next reading or flush.
+/// </summary>
+static void BatchDelivered(bool delivered, void* context) {
+	InFlightBatch* inFlight = context;
+
+	if (!delivered) {
+		telemetryBatchStats.batchesFailed++;
+		telemetryBatchStats.messagesFailed += inFlight->messageCount;
+		LOG("WARNING: Telemetry batch of %u readings was not delivered\n", inFlight->messageCount);
+	}
+
+	inFlight->inUse = false;
+	ReportResult(inFlight->firstTag, inFlight->lastTag, delivered);
+}
+
+static InFlightBatch* AcquireInFlightBatch(uint32_t messageCount, uint32_t firstTag, uint32_t lastTag) {
+	for (size_t i = 0; i < TELEMETRY_BATCH_IN_FLIGHT; i++) {
+		InFlightBatch* inFlight = &inFlightBatches[i];
+		if (!inFlight->inUse) {
+			inFlight->inUse = true;
+			inFlight->messageCount = messageCount;
+			inFlight->firstTag = firstTag;
+			inFlight->lastTag = lastTag;
+			return inFlight;
+		}
+	}
+	return NULL;
+}
+
+/// <summary>
+///     Hands a payload to the send function, tracking it until its delivery is reported.
+/// </summary>
+/// <returns>false if no in flight slot is free or the send function refused the payload</returns>
+static bool SendTracked(const unsigned char* data, size_t length, uint32_t messageCount, uint32_t firstTag, uint32_t lastTag) {
+	InFlightBatch* inFlight = AcquireInFlightBatch(messageCount, firstTag, lastTag);
+	if (inFlight == NULL) {
+		return false;
+	}
+
+	if (!sendBatch(data, length, batchEncoder->contentType, batchEncoder->contentEncoding, BatchDelivered, inFlight)) {
+		inFlight->inUse = false;
+		return false;
+	}
+	return true;
+}
+
+static bool IsOlderThan(const struct timespec* since, const struct timespec* age) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t elapsedNs = (int64_t)(now.tv_sec - since->tv_sec) * 1000000000LL + (now.tv_nsec - since->tv_nsec);
+	return elapsedNs >= (int64_t)age->tv_sec * 1000000000LL + age->tv_nsec;
+}
+
+/// <summary>
+///     Terminates the open batch and queues it for sending. If the queue is full the oldest
+///     unsent batch is dropped to make room for the next open batch.
+/// </summary>
+static void CloseOpenBatch(void) {
+	TelemetryBatch* batch = OpenBatch();
+	if (batch->messageCount == 0) {
+		return;
+	}
+
+	// Room for the close was reserved as the batch was filled
+	memcpy(batch->data + batch->length, batchEncoder->batchClose, closeLength);
+	batch->length += closeLength;
+
+	if (++closedBatchCount == TELEMETRY_BATCH_QUEUE_LENGTH) {
+		TelemetryBatch* oldest = &batchQueue[batchQueueHead];
+
+		telemetryBatchStats.batchesDropped++;
+		telemetryBatchStats.messagesDropped += oldest->messageCount;
+		LOG("WARNING: Telemetry batch queue full, dropped %u readings\n", oldest->messageCount);
+
+		batchQueueHead = (batchQueueHead + 1) % TELEMETRY_BATCH_QUEUE_LENGTH;
+		closedBatchCount--;
+		ReportResult(oldest->firstTag, oldest->lastTag, false);
+	}
+
+	batch = OpenBatch();
+	batch->length = 0;
+	batch->messageCount = 0;
+}
+
+/// <summary>
+///     Sends closed batches oldest first, stopping at the first failure, or once
+///     TELEMETRY_BATCH_IN_FLIGHT batches await confirmation, so order is kept.
+/// </summary>
+static bool SendClosedBatches(void) {
+	while (closedBatchCount > 0) {
+		TelemetryBatch* batch = &batchQueue[batchQueueHead];
+
+		if (!SendTracked(batch->data, batch->length, batch->messageCount, batch->firstTag, batch->lastTag)) {
+			return false;
+		}
+
+		size_t framing = openLength + closeLength + (batch->messageCount - 1) * separatorLength;
+
+		telemetryBatchStats.batchesSent++;
+		telemetryBatchStats.messagesSent += batch->messageCount;
+		telemetryBatchStats.lastBatchMessages = batch->messageCount;
+		telemetryBatchStats.bytesSaved += (int64_t)(batch->messageCount - 1) * TELEMETRY_MESSAGE_OVERHEAD_BYTES - (int64_t)framing;
+
+		LOG("INFO: Sent telemetry batch of %u readings (%zu bytes), %u readings per batch on average, %lld bytes saved\n",
+			batch->messageCount, batch->length, telemetryBatchStats.messagesSent / telemetryBatchStats.batchesSent,
+			(long long)telemetryBatchStats.bytesSaved);
+
+		batchQueueHead = (batchQueueHead + 1) % TELEMETRY_BATCH_QUEUE_LENGTH;
+		closedBatchCount--;
+	}
+
+	return true;
+}
+
+void InitTelemetryBatching(const TelemetryEncoder* encoder, const TelemetryBatchPolicy* policy, TelemetrySendFunction send,
+	TelemetryBatchResultFunction result) {
+	batchEncoder = encoder;
+	batchPolicy = *policy;
+	sendBatch = send;
+	batchResult = result;
+
+	openLength = strlen(encoder->batchOpen);
+	separatorLength = strlen(encoder->batchSeparator);
+	closeLength = strlen(encoder->batchClose);
+
+	if (batchPolicy.maxBytes == 0 || batchPolicy.maxBytes > TELEMETRY_BATCH_MAX_BYTES) {
+		batchPolicy.maxBytes = TELEMETRY_BATCH_MAX_BYTES;
+	}
+	if (batchPolicy.maxMessages == 0) {
+		batchPolicy.maxMessages = 1;
+	}
+
+	batchQueueHead = 0;
+	closedBatchCount = 0;
+	batchQueue[0].length = 0;
+	batchQueue[0].messageCount = 0;
+	memset(&telemetryBatchStats, 0, sizeof(telemetryBatchStats));
+}
+
+void SetTelemetryBatchLog(TelemetryBatchLogFunction log) {
+	batchLog = log;
+}
+
+bool AddTelemetryToBatch(const uint8_t* msg, size_t length, uint32_t tag) {
+	if (length < 1) {
+		return false;
+	}
+
+	if (openLength + length + closeLength > batchPolicy.maxBytes) {
+		LOG("WARNING: %zu byte reading too large to batch, sending on its own\n", length);
+		return SendTracked(msg, length, 1, tag, tag);
+	}
+
+	TelemetryBatch* batch = OpenBatch();
+	if (batch->messageCount > 0 && batch->length + separatorLength + length + closeLength > batchPolicy.maxBytes) {
+		CloseOpenBatch();
+		batch = OpenBatch();
+	}
+
+	if (batch->messageCount == 0) {
+		memcpy(batch->data, batchEncoder->batchOpen, openLength);
+		batch->length = openLength;
+		batch->firstTag = batch->lastTag = TELEMETRY_NO_TAG;
+		clock_gettime(CLOCK_MONOTONIC, &batch->opened);
+	}
+	else {
+		memcpy(batch->data + batch->length, batchEncoder->batchSeparator, separatorLength);
+		batch->length += separatorLength;
+	}
+
+	memcpy(batch->data + batch->length, msg, length);
+	batch->length += length;
+	batch->messageCount++;
+	if (tag != TELEMETRY_NO_TAG) {
+		if (batch->firstTag == TELEMETRY_NO_TAG) {
+			batch->firstTag = tag;
+		}
+		batch->lastTag = tag;
+	}
+
+	if (batch->messageCount >= batchPolicy.maxMessages) {
+		CloseOpenBatch();
+	}
+
+	SendClosedBatches();
+	return true;
+}
+
+void FlushTelemetryBatchIfDue(void) {
+	TelemetryBatch* batch = OpenBatch();
+
+	// Batches that failed to send are retried as readings arrive rather than here, so an
+	// unreachable hub is not retried on every tick of the flush timer
+	if (batch->messageCount > 0 && IsOlderThan(&batch->opened, &batchPolicy.maxAge)) {
+		CloseOpenBatch();
+		SendClosedBatches();
+	}
+}
+
+bool FlushTelemetryBatch(void) {
+	CloseOpenBatch();
+	return SendClosedBatches();
+}
+
+const TelemetryBatchStats* GetTelemetryBatchStats(void) {
+	return &telemetryBatchStats;
+}
@@ -0,0 +1,117 @@
+#ifndef telemetry_batch_h
+#define telemetry_batch_h
+
+#include "telemetry.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Largest batch payload in bytes, the policy maxBytes is clamped to this
+#ifndef TELEMETRY_BATCH_MAX_BYTES
+#define TELEMETRY_BATCH_MAX_BYTES 1024
+#endif
+// Number of batches held, including the one being filled, while IoT Hub is unreachable
+#ifndef TELEMETRY_BATCH_QUEUE_LENGTH
+#define TELEMETRY_BATCH_QUEUE_LENGTH 4
+#endif
+// Number of batches handed to the send function whose delivery has not been confirmed yet.
+// Closed batches wait in the queue while this many are outstanding.
+#ifndef TELEMETRY_BATCH_IN_FLIGHT
+#define TELEMETRY_BATCH_IN_FLIGHT 4
+#endif
+// Estimated per message cost of an IoT Hub send (MQTT publish header, topic and properties),
+// used only to report the bytes saved by batching
+#ifndef TELEMETRY_MESSAGE_OVERHEAD_BYTES
+#define TELEMETRY_MESSAGE_OVERHEAD_BYTES 120
+#endif
+
+/// <summary>
+///     When a batch is closed and sent. A batch closes when the next reading would take it past
+///     maxBytes, when it holds maxMessages readings, or when its oldest reading is maxAge old.
+/// </summary>
+typedef struct {
+	size_t maxBytes;
+	size_t maxMessages;
+	struct timespec maxAge;
+} TelemetryBatchPolicy;
+
+// Tag for a reading that the caller does not need a delivery result for
+#define TELEMETRY_NO_TAG UINT32_MAX
+
+/// <summary>
+///     Called exactly once for each payload the send function accepted, once it is known
+///     whether the payload reached IoT Hub.
+/// </summary>
+typedef void (*TelemetryDeliveredCallback)(bool delivered, void* context);
+
+/// <summary>
+///     Hands a closed batch to IoT Hub. Returns false if it could not be sent, in which case the
+///     batch stays queued and is retried. Once it returns true, delivered must be called with
+///     context when the payload is confirmed or fails. SendMsgBuffer on the device, a stub on
+///     the host.
+/// </summary>
+typedef bool (*TelemetrySendFunction)(const unsigned char* msg, size_t length, const char* contentType, const char* contentEncoding,
+	TelemetryDeliveredCallback delivered, void* context);
+
+/// <summary>
+///     Reports the outcome of a batch holding tagged readings: firstTag and lastTag are the
+///     tags of its first and last tagged readings. delivered is false when IoT Hub did not
+///     confirm the batch, or when it was dropped because the queue was full.
+/// </summary>
+typedef void (*TelemetryBatchResultFunction)(uint32_t firstTag, uint32_t lastTag, bool delivered);
+
+/// <summary>
+///     Log_Debug on the device. The batcher logs nothing until one is set, so it builds on a host.
+/// </summary>
+typedef int (*TelemetryBatchLogFunction)(const char* format, ...);
+
+typedef struct {
+	uint32_t batchesSent;       // payloads accepted by the send function
+	uint32_t messagesSent;      // readings carried by those payloads
+	uint32_t lastBatchMessages; // readings in the most recent payload
+	uint32_t batchesDropped;    // oldest queued batches discarded because the queue was full
+	uint32_t messagesDropped;   // readings discarded with those batches
+	uint32_t batchesFailed;     // sent batches that IoT Hub did not confirm
+	uint32_t messagesFailed;    // readings carried by those batches
+	int64_t bytesSaved;         // estimated bytes saved against sending each reading on its own
+} TelemetryBatchStats;
+
+/// <summary>
+///     Sets the encoder whose batch framing is used, the flush policy, the send function and
+///     the function told whether each batch of tagged readings was delivered, which may be NULL.
+///     Any queued readings are discarded.
+/// </summary>
+void InitTelemetryBatching(const TelemetryEncoder* encoder, const TelemetryBatchPolicy* policy, TelemetrySendFunction send,
+	TelemetryBatchResultFunction result);
+
+/// <summary>
+///     Sets the function used for diagnostics, or NULL for none.
+/// </summary>
+void SetTelemetryBatchLog(TelemetryBatchLogFunction log);
+
+/// <summary>
+///     Adds one encoded reading to the open batch, closing and sending the batch if the policy
+///     says so. A reading too large to batch is sent on its own. Accepting a reading does not
+///     mean it will be delivered: the outcome of a tagged reading is reported through the result
+///     function, with tag as the reading's identity. Tags must increase from reading to reading.
+/// </summary>
+/// <param name="tag">Identifies the reading to the result function, or TELEMETRY_NO_TAG</param>
+/// <returns>false if the reading could not be queued or sent, in which case no result is reported</returns>
+bool AddTelemetryToBatch(const uint8_t* msg, size_t length, uint32_t tag);
+
+/// <summary>
+///     Closes and sends the open batch if its oldest reading has reached the policy maxAge.
+///     Call periodically from a timer; the timer period bounds how late a batch can be.
+/// </summary>
+void FlushTelemetryBatchIfDue(void);
+
+/// <summary>
+///     Closes the open batch regardless of its age and sends every queued batch.
+/// </summary>
+/// <returns>true if nothing is left queued</returns>
+bool FlushTelemetryBatch(void);
+
+const TelemetryBatchStats* GetTelemetryBatchStats(void);
+
+#endif
@@ -0,0 +1,281 @@
+#include "telemetry_store.h"
+#include <applibs/log.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STORE_MAGIC 0x31465354 // "TSF1"
+
+// The log is a header followed by a ring of record slots. Record n lives in slot
+// n % slotCount, so the newest records overwrite the oldest once the ring is full.
+typedef struct {
+	uint32_t magic;
+	uint32_t slotCount;
+	uint32_t deliveredIndex; // index of the first record IoT Hub has not confirmed
+	uint32_t crc;
+} StoreHeader;
+
+typedef struct {
+	uint32_t index;
+	uint32_t sequence;
+	uint32_t valueCount;
+	TelemetryValue values[TELEMETRY_STORE_MAX_FIELDS];
+	uint32_t crc;
+} StoreRecord;
+
+static int storeFd = -1;
+static uint32_t slotCount = 0;
+static uint32_t schemaValueCount = 0;
+static uint32_t nextIndex = 0;
+// Records before deliveredIndex are confirmed. Those from there up to replayIndex have been handed
+// on and await confirmation; replay rewinds to deliveredIndex if any of them fail.
+static uint32_t deliveredIndex = 0;
+static uint32_t replayIndex = 0;
+static uint32_t persistedIndex = 0;
+// Appended records not yet written, for the consecutive indexes from pendingIndex
+static StoreRecord pendingRecords[TELEMETRY_STORE_WRITE_BATCH];
+static uint32_t pendingIndex = 0;
+static uint32_t pendingCount = 0;
+
+static TelemetryStoreStats telemetryStoreStats;
+
+// CRC-32 (IEEE 802.3), four bits at a time to keep the table small
+static const uint32_t crcTable[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t Crc32(const void* data, size_t length) {
+	const uint8_t* bytes = data;
+	uint32_t crc = 0xFFFFFFFF;
+
+	while (length-- > 0) {
+		crc ^= *bytes++;
+		crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+		crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+static off_t SlotOffset(uint32_t index) {
+	return (off_t)sizeof(StoreHeader) + (off_t)(index % slotCount) * (off_t)sizeof(StoreRecord);
+}
+
+/// <summary>
+///     Reads the record for index. Fails for an empty or torn slot, one since reused, or one
+///     stored by a build with a different schema.
+/// </summary>
+static bool ReadRecord(uint32_t index, StoreRecord* record) {
+	if (pread(storeFd, record, sizeof(*record), SlotOffset(index)) != (ssize_t)sizeof(*record)) {
+		return false;
+	}
+
+	return record->crc == Crc32(record, offsetof(StoreRecord, crc)) && record->index == index &&
+		record->valueCount == schemaValueCount;
+}
+
+static void WriteHeader(void) {
+	StoreHeader header = { .magic = STORE_MAGIC, .slotCount = slotCount, .deliveredIndex = deliveredIndex };
+	header.crc = Crc32(&header, offsetof(StoreHeader, crc));
+
+	if (pwrite(storeFd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || fsync(storeFd) != 0) {
+		Log_Debug("ERROR: Unable to write telemetry store header: %d (%s)\n", errno, strerror(errno));
+		return;
+	}
+	persistedIndex = deliveredIndex;
+}
+
+/// <summary>
+///     Returns the first record from index on that is intact. Records that fail their CRC are
+///     never handed on, so they would otherwise never be confirmed.
+/// </summary>
+static uint32_t SkipCorruptRecords(uint32_t index) {
+	StoreRecord record;
+	while (index != replayIndex && !ReadRecord(index, &record)) {
+		index++;
+	}
+	return index;
+}
+
+/// <summary>
+///     Marks records before index as delivered, persisting the position once the log is drained
+///     or TELEMETRY_STORE_PERSIST_INTERVAL records have been confirmed since it was last written.
+/// </summary>
+static void AdvanceDeliveredIndex(uint32_t index) {
+	if (replayIndex < index) {
+		replayIndex = index;
+	}
+	index = SkipCorruptRecords(index);
+	telemetryStoreStats.recordsDelivered += index - deliveredIndex;
+	deliveredIndex = index;
+
+	if (deliveredIndex == nextIndex || deliveredIndex - persistedIndex >= TELEMETRY_STORE_PERSIST_INTERVAL) {
+		WriteHeader();
+	}
+}
+
+int InitTelemetryStore(int fd, size_t capacityBytes, size_t valueCount, uint32_t* nextSequence) {
+	*nextSequence = 0;
+	memset(&telemetryStoreStats, 0, sizeof(telemetryStoreStats));
+
+	if (valueCount > TELEMETRY_STORE_MAX_FIELDS) {
+		Log_Debug("ERROR: %zu values is too many for the telemetry store\n", valueCount);
+		return -1;
+	}
+	schemaValueCount = (uint32_t)valueCount;
+
+	if (capacityBytes < sizeof(StoreHeader) + sizeof(StoreRecord)) {
+		Log_Debug("ERROR: %zu bytes is too small for the telemetry store\n", capacityBytes);
+		return -1;
+	}
+
+	storeFd = fd;
+	slotCount = (uint32_t)((capacityBytes - sizeof(StoreHeader)) / sizeof(StoreRecord));
+
+	// A header from a log with a different slot count describes a different ring, ignore it
+	StoreHeader header;
+	bool headerValid = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+		header.magic == STORE_MAGIC && header.slotCount == slotCount &&
+		header.crc == Crc32(&header, offsetof(StoreHeader, crc));
+
+	bool found = false;
+	uint32_t newestIndex = 0;
+	StoreRecord record;
+
+	for (uint32_t slot = 0; slot < slotCount; slot++) {
+		if (pread(fd, &record, sizeof(record), SlotOffset(slot)) != (ssize_t)sizeof(record) ||
+			record.crc != Crc32(&record, offsetof(StoreRecord, crc)) || record.index % slotCount != slot) {
+			continue;
+		}
+		if (!found || record.index > newestIndex) {
+			newestIndex = record.index;
+			*nextSequence = record.sequence + 1;
+			found = true;
+		}
+	}
+
+	if (found) {
+		nextIndex = newestIndex + 1;
+		uint32_t oldestIndex = nextIndex > slotCount ? nextIndex - slotCount : 0;
+
+		deliveredIndex = headerValid ? header.deliveredIndex : oldestIndex;
+		if (deliveredIndex < oldestIndex) {
+			deliveredIndex = oldestIndex;
+		}
+		if (deliveredIndex > nextIndex) {
+			deliveredIndex = nextIndex;
+		}
+	}
+	else {
+		nextIndex = deliveredIndex = headerValid ? header.deliveredIndex : 0;
+	}
+	replayIndex = persistedIndex = deliveredIndex;
+	pendingCount = 0;
+
+	Log_Debug("INFO: Telemetry store holds %u records, %zu waiting to be sent\n", slotCount, GetStoredTelemetryCount());
+	return 0;
+}
+
+bool StoreTelemetry(uint32_t sequence, const TelemetryValue values[], size_t valueCount) {
+	if (storeFd < 0 || valueCount != schemaValueCount) {
+		return false;
+	}
+
+	// Held records are written with one pwrite, so they must fill consecutive slots
+	if (pendingCount == TELEMETRY_STORE_WRITE_BATCH || (pendingCount > 0 && nextIndex % slotCount == 0)) {
+		SyncTelemetryStore();
+	}
+	if (pendingCount == 0) {
+		pendingIndex = nextIndex;
+	}
+
+	StoreRecord* record = &pendingRecords[pendingCount++];
+	memset(record, 0, sizeof(*record));
+	record->index = nextIndex;
+	record->sequence = sequence;
+	record->valueCount = (uint32_t)valueCount;
+	memcpy(record->values, values, valueCount * sizeof(TelemetryValue));
+	record->crc = Crc32(record, offsetof(StoreRecord, crc));
+
+	if (nextIndex - deliveredIndex == slotCount) {
+		deliveredIndex++;
+		if (replayIndex < deliveredIndex) {
+			replayIndex = deliveredIndex;
+		}
+		telemetryStoreStats.recordsOverwritten++;
+	}
+	nextIndex++;
+	telemetryStoreStats.recordsStored++;
+
+	return true;
+}
+
+bool SyncTelemetryStore(void) {
+	if (pendingCount == 0) {
+		return true;
+	}
+
+	size_t length = pendingCount * sizeof(StoreRecord);
+	uint32_t count = pendingCount;
+	pendingCount = 0;
+
+	if (pwrite(storeFd, pendingRecords, length, SlotOffset(pendingIndex)) != (ssize_t)length || fsync(storeFd) != 0) {
+		Log_Debug("ERROR: Unable to store %u telemetry readings: %d (%s)\n", count, errno, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+size_t ReplayStoredTelemetry(TelemetryReplayHandler handler, size_t maxRecords) {
+	size_t replayed = 0;
+	bool corruptSeen = false;
+	StoreRecord record;
+
+	SyncTelemetryStore();
+
+	while (replayed < maxRecords && replayIndex != nextIndex) {
+		if (!ReadRecord(replayIndex, &record)) {
+			telemetryStoreStats.recordsCorrupt++;
+			corruptSeen = true;
+		}
+		else if (handler(replayIndex, record.sequence, record.values, record.valueCount)) {
+			telemetryStoreStats.recordsReplayed++;
+			replayed++;
+		}
+		else {
+			break;
+		}
+		replayIndex++;
+	}
+
+	if (corruptSeen && SkipCorruptRecords(deliveredIndex) != deliveredIndex) {
+		AdvanceDeliveredIndex(deliveredIndex);
+	}
+
+	return replayed;
+}
+
+void AcknowledgeStoredTelemetry(uint32_t firstIndex, uint32_t lastIndex, bool delivered) {
+	if (storeFd < 0 || lastIndex < deliveredIndex || lastIndex >= replayIndex) {
+		return; // already confirmed, or overwritten and handed on again since
+	}
+
+	if (delivered && firstIndex <= deliveredIndex) {
+		AdvanceDeliveredIndex(lastIndex + 1);
+	}
+	else {
+		// Either a failure, or a confirmation overtaking an earlier unconfirmed record. Send
+		// everything unconfirmed again: at worst IoT Hub sees a reading twice, never not at all.
+		telemetryStoreStats.recordsResent += replayIndex - deliveredIndex;
+		replayIndex = deliveredIndex;
+	}
+}
+
+size_t GetStoredTelemetryCount(void) {
+	return storeFd < 0 ? 0 : nextIndex - deliveredIndex;
+}
+
+const TelemetryStoreStats* GetTelemetryStoreStats(void) {
+	return &telemetryStoreStats;
+}
@@ -0,0 +1,89 @@
+#ifndef telemetry_store_h
+#define telemetry_store_h
+
+#include "telemetry.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most telemetry values held by one stored record
+#ifndef TELEMETRY_STORE_MAX_FIELDS
+#define TELEMETRY_STORE_MAX_FIELDS 8
+#endif
+
+// Confirmed records between writes of the delivery position. After a reboot up to this many
+// readings that IoT Hub already has may be sent again, with the same MsgId.
+#ifndef TELEMETRY_STORE_PERSIST_INTERVAL
+#define TELEMETRY_STORE_PERSIST_INTERVAL 16
+#endif
+
+// Most appended records held in RAM before they are written together with one write and sync
+#ifndef TELEMETRY_STORE_WRITE_BATCH
+#define TELEMETRY_STORE_WRITE_BATCH 8
+#endif
+
+/// <summary>
+///     Called in log order for each stored reading being replayed. Return true once the reading
+///     has been handed on, or false to stop and retry it on the next replay. The reading stays
+///     in the log until AcknowledgeStoredTelemetry confirms its index.
+/// </summary>
+typedef bool (*TelemetryReplayHandler)(uint32_t index, uint32_t sequence, const TelemetryValue values[], size_t valueCount);
+
+typedef struct {
+	uint32_t recordsStored;      // readings written to the log
+	uint32_t recordsReplayed;    // readings handed to the replay handler, including resends
+	uint32_t recordsDelivered;   // readings confirmed, and corrupt records stepped over
+	uint32_t recordsResent;      // readings handed on again after a delivery failure
+	uint32_t recordsOverwritten; // undelivered readings lost because the log was full
+	uint32_t recordsCorrupt;     // records skipped on replay for a bad CRC or a different schema
+} TelemetryStoreStats;
+
+/// <summary>
+///     Opens the store-and-forward log: a ring of fixed size, CRC protected records in the
+///     file fd, which is mutable storage on the device or any regular file on the host.
+///     Readings stored before a reboot and not yet confirmed are found again.
+/// </summary>
+/// <param name="fd">File descriptor of the log, owned by the caller</param>
+/// <param name="capacityBytes">Size the log may grow to</param>
+/// <param name="valueCount">Values in each reading; records with a different count are skipped</param>
+/// <param name="nextSequence">Set to one past the highest sequence number in the log, or 0</param>
+/// <returns>0 on success, or -1 if the log is too small to hold a record</returns>
+int InitTelemetryStore(int fd, size_t capacityBytes, size_t valueCount, uint32_t* nextSequence);
+
+/// <summary>
+///     Appends a reading to the log. When the log is full the oldest undelivered reading is
+///     overwritten. The record is held in RAM until SyncTelemetryStore, or until
+///     TELEMETRY_STORE_WRITE_BATCH records are held, so several readings cost one flash write.
+/// </summary>
+/// <returns>true if the reading was appended</returns>
+bool StoreTelemetry(uint32_t sequence, const TelemetryValue values[], size_t valueCount);
+
+/// <summary>
+///     Writes the records appended since the last write to the log and syncs it. Records that
+///     cannot be written are skipped on replay like corrupt ones.
+/// </summary>
+/// <returns>true if nothing is left unwritten</returns>
+bool SyncTelemetryStore(void);
+
+/// <summary>
+///     Replays at most maxRecords stored readings not yet handed on, oldest first. Bounding the
+///     records per call lets the caller rate limit replay from a timer.
+/// </summary>
+/// <returns>The number of readings replayed</returns>
+size_t ReplayStoredTelemetry(TelemetryReplayHandler handler, size_t maxRecords);
+
+/// <summary>
+///     Reports the outcome of sending the replayed readings firstIndex to lastIndex together.
+///     Delivered readings leave the log. If they were not delivered, replay starts again from
+///     the oldest unconfirmed reading.
+/// </summary>
+void AcknowledgeStoredTelemetry(uint32_t firstIndex, uint32_t lastIndex, bool delivered);
+
+/// <summary>
+///     Number of stored readings not yet confirmed, including those handed on and in flight.
+/// </summary>
+size_t GetStoredTelemetryCount(void);
+
+const TelemetryStoreStats* GetTelemetryStoreStats(void);
+
+#endif
@@ -0,0 +1,269 @@
+#include "timer_wheel.h"
+#include <applibs/log.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+
+// Four levels of 64 slots covers 2^24 ticks, ~46 hours at the default 10 ms tick.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+#define NS_PER_SECOND 1000000000LL
+#define NS_PER_TICK ((int64_t)TIMER_WHEEL_TICK_MS * 1000000)
+
+static void TimerWheelEventHandler(EventData* eventData);
+
+static EventData timerWheelEventData = { .eventHandler = &TimerWheelEventHandler };
+static int timerWheelFd = -1;
+static Timer* wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static size_t wheelCount[WHEEL_LEVELS];
+static uint64_t currentTick = 0;
+static uint64_t slackTicks = 0;
+static struct timespec startTime;
+static bool dispatching = false;
+
+static int64_t NowNs(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - startTime.tv_sec) * NS_PER_SECOND + (now.tv_nsec - startTime.tv_nsec);
+}
+
+static uint64_t PeriodToTicks(const struct timespec* period) {
+	// Round up so a timer never fires before its period has elapsed
+	int64_t ns = (int64_t)period->tv_sec * NS_PER_SECOND + period->tv_nsec;
+	uint64_t ticks = (uint64_t)((ns + NS_PER_TICK - 1) / NS_PER_TICK);
+	return ticks > 0 ? ticks : 1;
+}
+
+static size_t TotalTimerCount(void) {
+	size_t count = 0;
+	for (int level = 0; level < WHEEL_LEVELS; level++) {
+		count += wheelCount[level];
+	}
+	return count;
+}
+
+/// <summary>
+///     Places a timer in the slot of the lowest level whose range covers its expiry.
+/// </summary>
+static void LinkTimer(Timer* timer) {
+	if (timer->expiry < currentTick) {
+		timer->expiry = currentTick;
+	}
+	if (timer->expiry - currentTick >= WHEEL_SPAN) {
+		timer->expiry = currentTick + WHEEL_SPAN - 1;
+	}
+
+	uint64_t delta = timer->expiry - currentTick;
+	int level = 0;
+	while (delta >= ((uint64_t)1 << (WHEEL_BITS * (level + 1)))) {
+		level++;
+	}
+
+	Timer** slot = &wheel[level][(timer->expiry >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	timer->next = *slot;
+	if (timer->next != NULL) {
+		timer->next->pprev = &timer->next;
+	}
+	timer->pprev = slot;
+	*slot = timer;
+	timer->level = level;
+	wheelCount[level]++;
+}
+
+static void UnlinkTimer(Timer* timer) {
+	if (timer->pprev == NULL) {
+		return;
+	}
+	*timer->pprev = timer->next;
+	if (timer->next != NULL) {
+		timer->next->pprev = timer->pprev;
+	}
+	timer->next = NULL;
+	timer->pprev = NULL;
+	wheelCount[timer->level]--;
+}
+
+/// <summary>
+///     Moves a slot's list onto a local head so the timers can be unlinked one at a time,
+///     even if a handler stops another timer from the same slot.
+/// </summary>
+static Timer* DetachSlot(Timer** slot) {
+	Timer* pending = *slot;
+	*slot = NULL;
+	return pending;
+}
+
+static void CascadeTimers(int level) {
+	Timer* pending = DetachSlot(&wheel[level][(currentTick >> (WHEEL_BITS * level)) & WHEEL_MASK]);
+	if (pending != NULL) {
+		pending->pprev = &pending;
+	}
+	while (pending != NULL) {
+		Timer* timer = pending;
+		UnlinkTimer(timer);
+		LinkTimer(timer);
+	}
+}
+
+static void RunExpiredTimers(void) {
+	Timer* pending = DetachSlot(&wheel[0][currentTick & WHEEL_MASK]);
+	if (pending != NULL) {
+		pending->pprev = &pending;
+	}
+	while (pending != NULL) {
+		Timer* timer = pending;
+		UnlinkTimer(timer);
+
+		// Reschedule from the due time rather than now so periods do not drift,
+		// before calling the handler so that it may stop its own timer.
+		timer->expiry += PeriodToTicks(&timer->period);
+		if (timer->expiry <= currentTick) {
+			timer->expiry = currentTick + 1;
+		}
+		LinkTimer(timer);
+
+		timer->eventData.eventHandler(&timer->eventData);
+	}
+}
+
+static void AdvanceTimerWheel(uint64_t targetTick) {
+	while (currentTick < targetTick) {
+		// Skip straight to the next cascade boundary while the lower levels are empty
+		uint64_t nextTick = currentTick + 1;
+		for (int level = 0; level < WHEEL_LEVELS - 1 && wheelCount[level] == 0; level++) {
+			int shift = WHEEL_BITS * (level + 1);
+			nextTick = ((currentTick >> shift) + 1) << shift;
+		}
+		if (nextTick > targetTick) {
+			currentTick = targetTick;
+			break;
+		}
+		currentTick = nextTick;
+
+		for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+			if ((currentTick & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) == 0) {
+				CascadeTimers(level);
+			}
+		}
+		RunExpiredTimers();
+	}
+}
+
+/// <summary>
+///     Returns the tick of the earliest level 0 expiry or higher level cascade, or UINT64_MAX.
+/// </summary>
+static uint64_t NextWakeupTick(void) {
+	uint64_t next = UINT64_MAX;
+	for (int level = 0; level < WHEEL_LEVELS; level++) {
+		if (wheelCount[level] == 0) {
+			continue;
+		}
+		int shift = WHEEL_BITS * level;
+		uint64_t index = currentTick >> shift;
+		for (uint64_t offset = 1; offset <= WHEEL_SLOTS; offset++) {
+			if (wheel[level][(index + offset) & WHEEL_MASK] != NULL) {
+				uint64_t tick = (index + offset) << shift;
+				if (tick < next) {
+					next = tick;
+				}
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+static int ArmTimerWheel(void) {
+	struct timespec expiry = { 0, 0 }; // zero disarms the timerfd
+	uint64_t next = NextWakeupTick();
+
+	if (next != UINT64_MAX) {
+		// Coalesce by waking late, never early: round up to the slack grid so that timers due
+		// in the same slack window share the wakeup at its end. Periodic timers reschedule from
+		// their due time, so the lateness does not accumulate.
+		if (slackTicks > 1) {
+			next = (next + slackTicks - 1) / slackTicks * slackTicks;
+		}
+		int64_t delayNs = (int64_t)next * NS_PER_TICK - NowNs();
+		if (delayNs < 1) {
+			delayNs = 1;
+		}
+		expiry.tv_sec = delayNs / NS_PER_SECOND;
+		expiry.tv_nsec = delayNs % NS_PER_SECOND;
+	}
+
+	return SetTimerFdToSingleExpiry(timerWheelFd, &expiry);
+}
+
+static void TimerWheelEventHandler(EventData* eventData) {
+	uint64_t expirations = 0;
+
+	// EAGAIN is expected if the timerfd was re-armed after epoll reported it ready
+	if (read(timerWheelFd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+		Log_Debug("ERROR: Could not read timer wheel timerfd %s (%d).\n", strerror(errno), errno);
+		terminationRequired = true;
+		return;
+	}
+
+	dispatching = true;
+	AdvanceTimerWheel((uint64_t)(NowNs() / NS_PER_TICK));
+	dispatching = false;
+
+	if (ArmTimerWheel() != 0) {
+		terminationRequired = true;
+	}
+}
+
+int InitTimerWheel(int epollFd, const struct timespec* slack) {
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	currentTick = 0;
+	slackTicks = slack != NULL ? (uint64_t)((slack->tv_sec * NS_PER_SECOND + slack->tv_nsec) / NS_PER_TICK) : 0;
+
+	timerWheelFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (timerWheelFd < 0) {
+		Log_Debug("ERROR: Could not create timer wheel timerfd: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+
+	if (RegisterEventHandlerToEpoll(epollFd, timerWheelFd, &timerWheelEventData, EPOLLIN) != 0) {
+		CloseFdAndPrintError(timerWheelFd, "TimerWheel");
+		timerWheelFd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+int StartTimer(Timer* timer) {
+	if (timerWheelFd < 0) {
+		Log_Debug("ERROR: Timer wheel not initialized, cannot start timer %s\n", timer->name);
+		return -1;
+	}
+
+	UnlinkTimer(timer);
+
+	// An idle wheel has not been advanced, so bring it up to now before scheduling against it
+	uint64_t now = (uint64_t)(NowNs() / NS_PER_TICK);
+	if (TotalTimerCount() == 0 && now > currentTick) {
+		currentTick = now;
+	}
+
+	timer->expiry = (now > currentTick ? now : currentTick) + PeriodToTicks(&timer->period);
+	LinkTimer(timer);
+
+	// The wheel is re-armed once the current dispatch completes
+	return dispatching ? 0 : ArmTimerWheel();
+}
+
+void StopTimer(Timer* timer) {
+	UnlinkTimer(timer);
+}
+
+void CloseTimerWheel(void) {
+	CloseFdAndPrintError(timerWheelFd, "TimerWheel");
+	timerWheelFd = -1;
+}
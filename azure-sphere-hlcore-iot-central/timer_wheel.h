@@ -0,0 +1,42 @@
+#ifndef timer_wheel_h
+#define timer_wheel_h
+
+#include "epoll_timerfd_utilities.h"
+#include "globals.h"
+#include <time.h>
+
+/// <summary>
+///     Resolution of the timer wheel in milliseconds. Timer periods are rounded up to a whole
+///     number of ticks. Define before including this header to override.
+/// </summary>
+#ifndef TIMER_WHEEL_TICK_MS
+#define TIMER_WHEEL_TICK_MS 10
+#endif
+
+/// <summary>
+///     Creates the single timerfd that drives every Timer and adds it to the epoll instance.
+///     Wakeups are rounded up to a multiple of the slack, so timers that fall due within the
+///     same slack window are serviced together at its end. A timer never runs early.
+/// </summary>
+/// <param name="epollFd">Epoll file descriptor</param>
+/// <param name="slack">How late a timer may be run to coalesce wakeups, or NULL for none</param>
+/// <returns>0 on success, or -1 on failure</returns>
+int InitTimerWheel(int epollFd, const struct timespec* slack);
+
+/// <summary>
+///     Starts (or restarts) a periodic timer. The timer's eventHandler is called each period.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int StartTimer(Timer* timer);
+
+/// <summary>
+///     Stops a timer. Safe to call on a timer that is not running, including from a handler.
+/// </summary>
+void StopTimer(Timer* timer);
+
+/// <summary>
+///     Closes the timer wheel timerfd. Stop the timers first.
+/// </summary>
+void CloseTimerWheel(void);
+
+#endif
@@ -49,7 +49,7 @@ to be used without modification when the chip used includes the PMU CM001
 errata. */
 #define configUSE_PREEMPTION					1
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION	1
-#define configUSE_IDLE_HOOK						0
+#define configUSE_IDLE_HOOK						1
 #define configUSE_TICK_HOOK						0
 #define configCPU_CLOCK_HZ						( 197600000 )
 #define configTICK_RATE_HZ						( ( TickType_t ) 1000 )
@@ -0,0 +1,235 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+// Throughput and latency benchmark for the intercore ring protocol, run over the host simulation.
+// The real-time side runs on a second thread. For each message size, from 4 bytes up to the
+// largest block the ring can hold, it measures:
+//   - throughput: the real-time side streams messages as fast as the ring accepts them;
+//   - latency: one message in flight, echoed back by the high-level side, halved per round trip.
+//
+// Usage: intercore-bench [bufSize] [messages]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "intercore-sim.h"
+
+#define DEFAULT_BUF_SIZE 4096
+#define DEFAULT_MESSAGES 100000
+#define LATENCY_SAMPLES 10000
+#define WAIT_TIMEOUT_MS 5000
+
+typedef enum { BenchMode_Stream, BenchMode_PingPong } BenchMode;
+
+typedef struct {
+    IntercoreSimEndpoint endpoint;
+    BenchMode mode;
+    uint32_t messageSize;
+    uint32_t messageCount;
+    int failed;
+} Sender;
+
+static uint8_t *scratch;
+static uint32_t scratchSize;
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static int CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/// <summary>
+/// Sends one block, waiting for the peer to free space while the ring is full.
+/// </summary>
+static int SendBlocking(IntercoreSimEndpoint *endpoint, const void *data, uint32_t length)
+{
+    IntercoreIoVec fragment = {.base = data, .length = length};
+    while (IntercoreSim_Send(endpoint, &fragment, 1) == -1) {
+        if (IntercoreSim_WaitForSpace(endpoint, WAIT_TIMEOUT_MS) != 1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/// <summary>
+/// Receives at least one block, waiting for the peer to enqueue while the ring is empty.
+/// </summary>
+static int ReceiveBlocking(IntercoreSimEndpoint *endpoint, IntercoreIoVec *blocks,
+                           uint32_t maxBlocks)
+{
+    int count;
+    while ((count = IntercoreSim_Receive(endpoint, scratch, scratchSize, blocks, maxBlocks)) == 0) {
+        if (IntercoreSim_WaitForData(endpoint, WAIT_TIMEOUT_MS) != 1) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+static void *SenderThread(void *context)
+{
+    Sender *sender = context;
+    uint8_t *message = calloc(1, sender->messageSize);
+    uint8_t echo[1];
+    IntercoreIoVec block;
+
+    for (uint32_t i = 0; message != NULL && i < sender->messageCount; ++i) {
+        memcpy(message, &i, sizeof(i));
+        if (SendBlocking(&sender->endpoint, message, sender->messageSize) == -1) {
+            sender->failed = 1;
+            break;
+        }
+
+        if (sender->mode == BenchMode_PingPong) {
+            // Wait for the echo before sending the next message, so only one is in flight.
+            int count;
+            while ((count = IntercoreSim_Receive(&sender->endpoint, echo, sizeof(echo), &block,
+                                                 1)) == 0) {
+                if (IntercoreSim_WaitForData(&sender->endpoint, WAIT_TIMEOUT_MS) != 1) {
+                    break;
+                }
+            }
+            if (count != 1) {
+                sender->failed = 1;
+                break;
+            }
+        }
+    }
+
+    free(message);
+    return NULL;
+}
+
+static int RunSize(IntercoreSim *sim, uint32_t messageSize, uint32_t messageCount)
+{
+    IntercoreSimEndpoint highLevel;
+    IntercoreIoVec batch[64];
+    uint64_t *samples = calloc(LATENCY_SAMPLES, sizeof(uint64_t));
+    Sender sender = {.messageSize = messageSize};
+    pthread_t thread;
+    int result = -1;
+
+    IntercoreSim_GetEndpoint(sim, IntercoreSimSide_HighLevel, &highLevel);
+    IntercoreSim_GetEndpoint(sim, IntercoreSimSide_RealTime, &sender.endpoint);
+    if (samples == NULL) {
+        return -1;
+    }
+
+    // Throughput: stream every message, draining them in batches on this thread.
+    sender.mode = BenchMode_Stream;
+    sender.messageCount = messageCount;
+    uint64_t start = NowNs();
+    if (pthread_create(&thread, NULL, SenderThread, &sender) != 0) {
+        goto done;
+    }
+    uint32_t received = 0;
+    while (received < messageCount) {
+        int count = ReceiveBlocking(&highLevel, batch, sizeof(batch) / sizeof(batch[0]));
+        if (count == -1) {
+            break;
+        }
+        received += (uint32_t)count;
+    }
+    pthread_join(thread, NULL);
+    uint64_t elapsedNs = NowNs() - start;
+    if (sender.failed || received != messageCount) {
+        fprintf(stderr, "%u bytes: stream failed after %u messages\n", messageSize, received);
+        goto done;
+    }
+
+    // Latency: echo each message back to the sender.
+    sender.mode = BenchMode_PingPong;
+    sender.messageCount = LATENCY_SAMPLES;
+    uint8_t echo = 0;
+    if (pthread_create(&thread, NULL, SenderThread, &sender) != 0) {
+        goto done;
+    }
+    uint32_t samplesTaken = 0;
+    uint64_t roundTripStart = NowNs();
+    while (samplesTaken < LATENCY_SAMPLES) {
+        if (ReceiveBlocking(&highLevel, batch, 1) == -1 ||
+            SendBlocking(&highLevel, &echo, sizeof(echo)) == -1) {
+            break;
+        }
+        // The round trip is measured from this side's previous echo to this message arriving,
+        // which spans the sender's receive of the echo and its next send.
+        uint64_t now = NowNs();
+        samples[samplesTaken++] = now - roundTripStart;
+        roundTripStart = now;
+    }
+    pthread_join(thread, NULL);
+    if (sender.failed || samplesTaken != LATENCY_SAMPLES) {
+        fprintf(stderr, "%u bytes: ping-pong failed after %u samples\n", messageSize,
+                samplesTaken);
+        goto done;
+    }
+
+    // The first sample includes thread start up, so leave it out.
+    qsort(samples + 1, LATENCY_SAMPLES - 1, sizeof(uint64_t), CompareU64);
+    uint64_t p50 = samples[1 + (LATENCY_SAMPLES - 1) / 2] / 2;
+    uint64_t p99 = samples[1 + (LATENCY_SAMPLES - 1) * 99 / 100] / 2;
+    double seconds = (double)elapsedNs / 1e9;
+
+    printf("%8u %14.0f %12.1f %10.2f %10.2f\n", messageSize, messageCount / seconds,
+           (double)messageCount * messageSize / seconds / (1024 * 1024), p50 / 1000.0,
+           p99 / 1000.0);
+    result = 0;
+
+done:
+    free(samples);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t bufSize = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : DEFAULT_BUF_SIZE;
+    uint32_t messageCount = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : DEFAULT_MESSAGES;
+    IntercoreSim sim;
+
+    if (IntercoreSim_Create(&sim, bufSize) == -1) {
+        perror("IntercoreSim_Create");
+        return EXIT_FAILURE;
+    }
+
+    // The largest block leaves room for its size word and one alignment unit of free space.
+    uint32_t maxMessage = bufSize - sizeof(uint32_t) - RINGBUFFER_ALIGNMENT;
+    scratchSize = bufSize;
+    scratch = malloc(scratchSize);
+    if (scratch == NULL) {
+        IntercoreSim_Destroy(&sim);
+        return EXIT_FAILURE;
+    }
+
+    printf("ring %u bytes, %u messages per size\n", bufSize, messageCount);
+    printf("%8s %14s %12s %10s %10s\n", "bytes", "msgs/s", "MiB/s", "p50 us", "p99 us");
+
+    int status = EXIT_SUCCESS;
+    for (uint32_t size = 4;; size *= 4) {
+        if (size > maxMessage) {
+            size = maxMessage;
+        }
+        if (RunSize(&sim, size, messageCount) == -1) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        if (size == maxMessage) {
+            break;
+        }
+    }
+
+    free(scratch);
+    IntercoreSim_Destroy(&sim);
+    return status;
+}
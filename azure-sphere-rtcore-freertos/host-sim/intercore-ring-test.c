@@ -0,0 +1,274 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+// Unit test for the intercore ring protocol, run over the host simulation's shared buffers:
+//   - partial blocks are padded so that every block starts on RINGBUFFER_ALIGNMENT;
+//   - blocks, and their size words, wrap around the end of the ring intact;
+//   - a full ring refuses a block without corrupting it, and accepts it once drained;
+//   - gathered fragments equal one contiguous block;
+//   - IntercoreRing_ReadBatch returns the same blocks and read position as IntercoreRing_Read.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intercore-sim.h"
+
+#define BUF_SIZE 256
+#define MAX_BLOCK (BUF_SIZE - sizeof(uint32_t) - RINGBUFFER_ALIGNMENT)
+#define RANDOM_BLOCKS 20000
+
+static int failedChecks = 0;
+static uint32_t randomState = 0x12345678;
+
+#define CHECK(condition, ...)                                    \
+    do {                                                         \
+        if (!(condition)) {                                      \
+            failedChecks++;                                      \
+            fprintf(stderr, "FAIL: " __VA_ARGS__);               \
+            fputc('\n', stderr);                                 \
+        }                                                        \
+    } while (0)
+
+static uint32_t Random(void)
+{
+    // xorshift32, so a failure reproduces
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static void Fill(uint8_t *data, uint32_t length, uint32_t seed)
+{
+    for (uint32_t i = 0; i < length; ++i) {
+        data[i] = (uint8_t)(seed * 31 + i * 7);
+    }
+}
+
+static int Write(IntercoreSimEndpoint *endpoint, const void *data, uint32_t length)
+{
+    IntercoreIoVec fragment = {.base = data, .length = length};
+    return IntercoreRing_Write(endpoint->inbound, endpoint->outbound, endpoint->bufSize, &fragment,
+                               1);
+}
+
+static int Read(IntercoreSimEndpoint *endpoint, void *dest, uint32_t *length)
+{
+    return IntercoreRing_Read(endpoint->outbound, endpoint->inbound, endpoint->bufSize, dest,
+                              length);
+}
+
+static void TestPadding(IntercoreSimEndpoint *rt, IntercoreSimEndpoint *hl)
+{
+    // Each block takes its size word plus its data, rounded up to the alignment
+    static const uint32_t lengths[] = {0, 1, 5, 11, 12, 13, 28, 29, 60};
+    uint8_t data[64];
+    uint8_t dest[64];
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        uint32_t before = rt->outbound->writePosition;
+        uint32_t expected = before + ((uint32_t)sizeof(uint32_t) + lengths[i] +
+                                      RINGBUFFER_ALIGNMENT - 1) / RINGBUFFER_ALIGNMENT *
+                                         RINGBUFFER_ALIGNMENT;
+        expected %= BUF_SIZE;
+
+        Fill(data, lengths[i], (uint32_t)i);
+        CHECK(Write(rt, data, lengths[i]) == 0, "%u byte block refused", lengths[i]);
+        CHECK(rt->outbound->writePosition == expected, "%u byte block moved write position %u to %u, expected %u",
+              lengths[i], before, rt->outbound->writePosition, expected);
+        CHECK(rt->outbound->writePosition % RINGBUFFER_ALIGNMENT == 0, "write position %u unaligned",
+              rt->outbound->writePosition);
+
+        uint32_t length = sizeof(dest);
+        CHECK(Read(hl, dest, &length) == 0 && length == lengths[i] &&
+                  memcmp(dest, data, lengths[i]) == 0,
+              "%u byte block read back wrong", lengths[i]);
+        CHECK(hl->outbound->readPosition == expected, "read position %u, expected %u",
+              hl->outbound->readPosition, expected);
+    }
+}
+
+static void TestWraparound(IntercoreSimEndpoint *rt, IntercoreSimEndpoint *hl)
+{
+    uint8_t data[MAX_BLOCK];
+    uint8_t dest[MAX_BLOCK];
+    uint32_t wraps = 0;
+    uint32_t splitBlocks = 0;
+
+    // Keep one or two blocks in flight so positions visit every offset of the ring
+    for (uint32_t i = 0; i < RANDOM_BLOCKS; ++i) {
+        uint32_t length = Random() % (MAX_BLOCK / 2);
+        uint32_t position = rt->outbound->writePosition;
+
+        Fill(data, length, i);
+        if (Write(rt, data, length) != 0) {
+            CHECK(0, "block %u of %u bytes refused with space for it", i, length);
+            break;
+        }
+        wraps += rt->outbound->writePosition <= position;
+        splitBlocks += position + sizeof(uint32_t) + length > BUF_SIZE;
+
+        uint32_t readLength = sizeof(dest);
+        if (Read(hl, dest, &readLength) != 0 || readLength != length ||
+            memcmp(dest, data, length) != 0) {
+            CHECK(0, "block %u of %u bytes written at %u read back wrong", i, length, position);
+            break;
+        }
+    }
+
+    CHECK(wraps > 100 && splitBlocks > 100, "only %u wraps and %u split blocks", wraps, splitBlocks);
+    CHECK(rt->outbound->writePosition == hl->outbound->readPosition, "ring not empty after wraparound");
+}
+
+static void TestFullRing(IntercoreSimEndpoint *rt, IntercoreSimEndpoint *hl)
+{
+    uint8_t data[MAX_BLOCK + 1];
+    uint8_t dest[MAX_BLOCK + 1];
+    Fill(data, sizeof(data), 99);
+
+    // An empty ring holds one block of up to MAX_BLOCK bytes, one alignment unit is kept free
+    uint32_t errors = IntercoreSim_GetErrorCount();
+    CHECK(Write(rt, data, MAX_BLOCK + 1) == -1, "block larger than the ring accepted");
+    CHECK(IntercoreSim_GetErrorCount() == errors + 1, "refused block not reported");
+    CHECK(Write(rt, data, MAX_BLOCK) == 0, "largest block refused by an empty ring");
+
+    uint32_t position = rt->outbound->writePosition;
+    CHECK(Write(rt, data, 0) == -1, "empty block accepted by a full ring");
+    CHECK(rt->outbound->writePosition == position, "refused block moved the write position");
+
+    uint32_t length = sizeof(dest);
+    CHECK(Read(hl, dest, &length) == 0 && length == MAX_BLOCK && memcmp(dest, data, MAX_BLOCK) == 0,
+          "largest block read back wrong");
+    length = sizeof(dest);
+    CHECK(Read(hl, dest, &length) == -1, "read from an empty ring succeeded");
+
+    // Fill with small blocks until refused, then drain and check every one
+    uint32_t written = 0;
+    while (Write(rt, data + written, 20) == 0) {
+        ++written;
+    }
+    uint32_t expected = BUF_SIZE / 32 - 1;
+    CHECK(written == expected, "%u 20 byte blocks fit, expected %u", written, expected);
+    for (uint32_t i = 0; i < written; ++i) {
+        length = sizeof(dest);
+        CHECK(Read(hl, dest, &length) == 0 && length == 20 && memcmp(dest, data + i, 20) == 0,
+              "block %u of a full ring read back wrong", i);
+    }
+    CHECK(Write(rt, data, 20) == 0, "drained ring refused a block");
+    length = sizeof(dest);
+    Read(hl, dest, &length);
+}
+
+static void TestFragments(IntercoreSimEndpoint *rt, IntercoreSimEndpoint *hl)
+{
+    uint8_t data[100];
+    uint8_t dest[100];
+    Fill(data, sizeof(data), 7);
+
+    // Start near the end so the gathered fragments also wrap
+    while (rt->outbound->writePosition != BUF_SIZE - 2 * RINGBUFFER_ALIGNMENT) {
+        uint32_t length = sizeof(dest);
+        Write(rt, data, 0);
+        Read(hl, dest, &length);
+    }
+
+    IntercoreIoVec fragments[] = {{data, 3}, {data + 3, 0}, {data + 3, 40}, {data + 43, 57}};
+    CHECK(IntercoreRing_Write(rt->inbound, rt->outbound, BUF_SIZE, fragments, 4) == 0,
+          "fragments refused");
+    uint32_t length = sizeof(dest);
+    CHECK(Read(hl, dest, &length) == 0 && length == sizeof(data) && memcmp(dest, data, sizeof(data)) == 0,
+          "gathered fragments read back wrong");
+}
+
+static void TestBatchMatchesSingle(void)
+{
+    // Two channels get the same blocks; one is read a block at a time, the other in batches
+    IntercoreSim single;
+    IntercoreSim batch;
+    if (IntercoreSim_Create(&single, BUF_SIZE) != 0 || IntercoreSim_Create(&batch, BUF_SIZE) != 0) {
+        CHECK(0, "could not create the simulations");
+        return;
+    }
+
+    IntercoreSimEndpoint singleRt, singleHl, batchRt, batchHl;
+    IntercoreSim_GetEndpoint(&single, IntercoreSimSide_RealTime, &singleRt);
+    IntercoreSim_GetEndpoint(&single, IntercoreSimSide_HighLevel, &singleHl);
+    IntercoreSim_GetEndpoint(&batch, IntercoreSimSide_RealTime, &batchRt);
+    IntercoreSim_GetEndpoint(&batch, IntercoreSimSide_HighLevel, &batchHl);
+
+    uint8_t data[MAX_BLOCK];
+    uint8_t singleDest[MAX_BLOCK];
+    uint8_t batchDest[BUF_SIZE];
+    IntercoreIoVec blocks[8];
+    uint32_t seed = 0;
+
+    for (uint32_t round = 0; round < RANDOM_BLOCKS / 4; ++round) {
+        // Enqueue until full, with the same sizes on both channels
+        for (;;) {
+            uint32_t length = Random() % 48;
+            Fill(data, length, seed);
+            if (Write(&singleRt, data, length) != 0) {
+                CHECK(Write(&batchRt, data, length) != 0, "channels disagree on a full ring");
+                break;
+            }
+            CHECK(Write(&batchRt, data, length) == 0, "channels disagree on a full ring");
+            ++seed;
+        }
+
+        // Batches limited by block count or by destination size, both leaving blocks behind
+        uint32_t maxBlocks = 1 + Random() % 8;
+        uint32_t destSize = 48 + Random() % (sizeof(batchDest) - 48);
+        int count = IntercoreRing_ReadBatch(batchHl.outbound, batchHl.inbound, BUF_SIZE, batchDest,
+                                            destSize, blocks, maxBlocks);
+        CHECK(count > 0 && (uint32_t)count <= maxBlocks, "batch read returned %d", count);
+
+        for (int i = 0; i < count; ++i) {
+            uint32_t length = sizeof(singleDest);
+            CHECK(Read(&singleHl, singleDest, &length) == 0 && length == blocks[i].length &&
+                      memcmp(singleDest, blocks[i].base, length) == 0,
+                  "round %u block %d differs between batch and single reads", round, i);
+        }
+        CHECK(batchHl.outbound->readPosition == singleHl.outbound->readPosition,
+              "round %u: batch read position %u, single %u", round, batchHl.outbound->readPosition,
+              singleHl.outbound->readPosition);
+
+        // Drain both so the next round starts at a new offset
+        while (IntercoreRing_ReadBatch(batchHl.outbound, batchHl.inbound, BUF_SIZE, batchDest,
+                                       sizeof(batchDest), blocks, 8) > 0) {
+        }
+        uint32_t length = sizeof(singleDest);
+        while (Read(&singleHl, singleDest, &length) == 0) {
+            length = sizeof(singleDest);
+        }
+        CHECK(batchHl.outbound->readPosition == singleHl.outbound->readPosition,
+              "round %u: drained read positions differ", round);
+    }
+
+    IntercoreSim_Destroy(&single);
+    IntercoreSim_Destroy(&batch);
+}
+
+int main(void)
+{
+    IntercoreSim sim;
+    if (IntercoreSim_Create(&sim, BUF_SIZE) != 0) {
+        perror("IntercoreSim_Create");
+        return EXIT_FAILURE;
+    }
+
+    IntercoreSimEndpoint rt, hl;
+    IntercoreSim_GetEndpoint(&sim, IntercoreSimSide_RealTime, &rt);
+    IntercoreSim_GetEndpoint(&sim, IntercoreSimSide_HighLevel, &hl);
+
+    TestPadding(&rt, &hl);
+    TestWraparound(&rt, &hl);
+    TestFullRing(&rt, &hl);
+    TestFragments(&rt, &hl);
+    IntercoreSim_Destroy(&sim);
+
+    TestBatchMatchesSingle();
+
+    printf("%s\n", failedChecks == 0 ? "PASS" : "FAIL");
+    return failedChecks == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
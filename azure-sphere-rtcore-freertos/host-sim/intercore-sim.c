@@ -0,0 +1,163 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "intercore-sim.h"
+
+static uint32_t errorCount = 0;
+
+static void RingDoorbell(int doorbell);
+static int WaitDoorbell(int doorbell, int timeoutMs);
+
+void IntercoreRing_Error(const char *message)
+{
+    // A full ring is routine in a simulation, so only report errors when asked to.
+    __atomic_add_fetch(&errorCount, 1, __ATOMIC_RELAXED);
+    if (getenv("INTERCORE_SIM_VERBOSE") != NULL) {
+        fputs(message, stderr);
+    }
+}
+
+uint32_t IntercoreSim_GetErrorCount(void)
+{
+    return __atomic_load_n(&errorCount, __ATOMIC_RELAXED);
+}
+
+int IntercoreSim_Create(IntercoreSim *sim, uint32_t bufSize)
+{
+    if (bufSize == 0 || bufSize % RINGBUFFER_ALIGNMENT != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    sim->bufSize = bufSize;
+    sim->mappingSize = 2 * (sizeof(BufferHeader) + bufSize);
+    for (int i = 0; i < 2; ++i) {
+        sim->dataDoorbells[i] = -1;
+        sim->spaceDoorbells[i] = -1;
+    }
+
+    // Anonymous shared memory is zero filled, so both rings start empty.
+    sim->mapping =
+        mmap(NULL, sim->mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sim->mapping == MAP_FAILED) {
+        sim->mapping = NULL;
+        return -1;
+    }
+
+    sim->rings[0] = (BufferHeader *)sim->mapping;
+    sim->rings[1] = (BufferHeader *)((uint8_t *)sim->mapping + sizeof(BufferHeader) + bufSize);
+
+    for (int i = 0; i < 2; ++i) {
+        sim->dataDoorbells[i] = eventfd(0, EFD_NONBLOCK);
+        sim->spaceDoorbells[i] = eventfd(0, EFD_NONBLOCK);
+        if (sim->dataDoorbells[i] == -1 || sim->spaceDoorbells[i] == -1) {
+            IntercoreSim_Destroy(sim);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void IntercoreSim_Destroy(IntercoreSim *sim)
+{
+    for (int i = 0; i < 2; ++i) {
+        if (sim->dataDoorbells[i] >= 0) {
+            close(sim->dataDoorbells[i]);
+            sim->dataDoorbells[i] = -1;
+        }
+        if (sim->spaceDoorbells[i] >= 0) {
+            close(sim->spaceDoorbells[i]);
+            sim->spaceDoorbells[i] = -1;
+        }
+    }
+
+    if (sim->mapping != NULL) {
+        munmap(sim->mapping, sim->mappingSize);
+        sim->mapping = NULL;
+    }
+}
+
+void IntercoreSim_GetEndpoint(IntercoreSim *sim, IntercoreSimSide side,
+                              IntercoreSimEndpoint *endpoint)
+{
+    // Each side writes to its own ring and reads from the peer's, as on the device.
+    int peer = 1 - (int)side;
+
+    endpoint->outbound = sim->rings[side];
+    endpoint->inbound = sim->rings[peer];
+    endpoint->bufSize = sim->bufSize;
+    endpoint->dataDoorbell = sim->dataDoorbells[side];
+    endpoint->spaceDoorbell = sim->spaceDoorbells[side];
+    endpoint->peerDataDoorbell = sim->dataDoorbells[peer];
+    endpoint->peerSpaceDoorbell = sim->spaceDoorbells[peer];
+}
+
+static void RingDoorbell(int doorbell)
+{
+    uint64_t value = 1;
+    // EAGAIN only happens if the counter would overflow, when the peer is already signalled.
+    if (write(doorbell, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        IntercoreRing_Error("IntercoreSim: unable to ring doorbell\r\n");
+    }
+}
+
+int IntercoreSim_Send(IntercoreSimEndpoint *endpoint, const IntercoreIoVec *fragments,
+                      uint32_t fragmentCount)
+{
+    if (IntercoreRing_Write(endpoint->inbound, endpoint->outbound, endpoint->bufSize, fragments,
+                            fragmentCount) == -1) {
+        return -1;
+    }
+
+    RingDoorbell(endpoint->peerDataDoorbell);
+    return 0;
+}
+
+int IntercoreSim_Receive(IntercoreSimEndpoint *endpoint, void *dest, uint32_t destSize,
+                         IntercoreIoVec *blocks, uint32_t maxBlocks)
+{
+    int blockCount = IntercoreRing_ReadBatch(endpoint->outbound, endpoint->inbound,
+                                             endpoint->bufSize, dest, destSize, blocks, maxBlocks);
+
+    if (blockCount > 0) {
+        RingDoorbell(endpoint->peerSpaceDoorbell);
+    }
+
+    return blockCount;
+}
+
+static int WaitDoorbell(int doorbell, int timeoutMs)
+{
+    struct pollfd pfd = {.fd = doorbell, .events = POLLIN};
+
+    int result = poll(&pfd, 1, timeoutMs);
+    if (result <= 0) {
+        return (result == -1 && errno != EINTR) ? -1 : 0;
+    }
+
+    uint64_t value;
+    if (read(doorbell, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        return -1;
+    }
+
+    return 1;
+}
+
+int IntercoreSim_WaitForData(IntercoreSimEndpoint *endpoint, int timeoutMs)
+{
+    return WaitDoorbell(endpoint->dataDoorbell, timeoutMs);
+}
+
+int IntercoreSim_WaitForSpace(IntercoreSimEndpoint *endpoint, int timeoutMs)
+{
+    return WaitDoorbell(endpoint->spaceDoorbell, timeoutMs);
+}
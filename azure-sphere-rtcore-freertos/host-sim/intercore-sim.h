@@ -0,0 +1,104 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#ifndef INTERCORE_SIM_H
+#define INTERCORE_SIM_H
+
+#include <stdint.h>
+
+#include "intercore-ring.h"
+
+/// <summary>
+/// <para>Host simulation of the MT3620 shared buffers. Two rings, laid out exactly as on the
+/// device, live in a MAP_SHARED mapping so that they can be used from two threads, or from a
+/// parent and child process after fork(). Each side has two eventfds which stand in for the
+/// mailbox doorbells: the peer signals one after enqueuing a block, and the other after
+/// dequeuing blocks so that a writer waiting for space can retry. Keeping them separate means
+/// a side waiting for space is not woken by data arriving for it, and vice versa.</para>
+/// </summary>
+typedef struct {
+    void *mapping;
+    size_t mappingSize;
+    uint32_t bufSize;
+    BufferHeader *rings[2];
+    int dataDoorbells[2];
+    int spaceDoorbells[2];
+} IntercoreSim;
+
+/// <summary>Which end of the simulated channel an endpoint represents.</summary>
+typedef enum {
+    IntercoreSimSide_RealTime = 0,
+    IntercoreSimSide_HighLevel = 1
+} IntercoreSimSide;
+
+/// <summary>
+/// One side's view of the channel, equivalent to what <see cref="GetIntercoreBuffers" />
+/// returns on the device.
+/// </summary>
+typedef struct {
+    BufferHeader *outbound;
+    BufferHeader *inbound;
+    uint32_t bufSize;
+    /// <summary>Signalled by the peer when it has enqueued blocks for this side.</summary>
+    int dataDoorbell;
+    /// <summary>Signalled by the peer when it has dequeued blocks written by this side.</summary>
+    int spaceDoorbell;
+    int peerDataDoorbell;
+    int peerSpaceDoorbell;
+} IntercoreSimEndpoint;
+
+/// <summary>
+/// Creates the shared rings and doorbells.
+/// </summary>
+/// <param name="sim">The simulation to initialize.</param>
+/// <param name="bufSize">Size of each ring's data area in bytes. Must be a multiple of
+/// RINGBUFFER_ALIGNMENT.</param>
+/// <returns>0 on success, -1 on failure with errno set.</returns>
+int IntercoreSim_Create(IntercoreSim *sim, uint32_t bufSize);
+
+/// <summary>
+/// Unmaps the rings and closes the doorbells.
+/// </summary>
+void IntercoreSim_Destroy(IntercoreSim *sim);
+
+/// <summary>
+/// Gets the buffers and doorbells used by one side of the channel.
+/// </summary>
+void IntercoreSim_GetEndpoint(IntercoreSim *sim, IntercoreSimSide side,
+                              IntercoreSimEndpoint *endpoint);
+
+/// <summary>
+/// Enqueues one block, gathered from fragments, and rings the peer's data doorbell.
+/// </summary>
+/// <returns>0 on success, -1 if the ring is full or corrupt.</returns>
+int IntercoreSim_Send(IntercoreSimEndpoint *endpoint, const IntercoreIoVec *fragments,
+                      uint32_t fragmentCount);
+
+/// <summary>
+/// Dequeues every available block, then rings the peer's space doorbell once.
+/// </summary>
+/// <returns>The number of blocks dequeued, or -1 on error.</returns>
+int IntercoreSim_Receive(IntercoreSimEndpoint *endpoint, void *dest, uint32_t destSize,
+                         IntercoreIoVec *blocks, uint32_t maxBlocks);
+
+/// <summary>
+/// Waits for the peer to enqueue blocks for this side, and consumes the notification.
+/// </summary>
+/// <param name="timeoutMs">Maximum wait in milliseconds, or -1 to wait indefinitely.</param>
+/// <returns>1 if the doorbell rang, 0 on timeout, -1 on error.</returns>
+int IntercoreSim_WaitForData(IntercoreSimEndpoint *endpoint, int timeoutMs);
+
+/// <summary>
+/// Waits for the peer to dequeue blocks from this side's outbound ring, and consumes the
+/// notification. Used after <see cref="IntercoreSim_Send" /> finds the ring full.
+/// </summary>
+/// <param name="timeoutMs">Maximum wait in milliseconds, or -1 to wait indefinitely.</param>
+/// <returns>1 if the doorbell rang, 0 on timeout, -1 on error.</returns>
+int IntercoreSim_WaitForSpace(IntercoreSimEndpoint *endpoint, int timeoutMs);
+
+/// <summary>
+/// Returns the number of ring protocol errors reported, including writes to a full ring.
+/// </summary>
+uint32_t IntercoreSim_GetErrorCount(void);
+
+#endif // #ifndef INTERCORE_SIM_H
@@ -0,0 +1,284 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+// Shared buffer ring protocol. Has no hardware dependencies so that it can also be built and
+// exercised on a host.
+
+#include <stdbool.h>
+
+#include "intercore-ring.h"
+
+static uint8_t *DataAreaOffset8(BufferHeader *header, size_t offset);
+static uint32_t *DataAreaOffset32(BufferHeader *header, size_t offset);
+static uint32_t RoundUp(uint32_t value, uint32_t alignment);
+static uint32_t AdvancePosition(uint32_t position, uint32_t blockSize, uint32_t bufSize);
+static void CopyToRing(BufferHeader *header, uint32_t bufSize, uint32_t position,
+                       const uint8_t *src, uint32_t length);
+static void CopyFromRing(BufferHeader *header, uint32_t bufSize, uint32_t position, uint8_t *dest,
+                         uint32_t length);
+static int PeekBlock(BufferHeader *inbound, uint32_t bufSize, uint32_t localReadPosition,
+                     uint32_t availData, uint32_t *blockSize);
+
+static uint8_t *DataAreaOffset8(BufferHeader *header, size_t offset)
+{
+    // Data storage area following header in buffer.
+    uint8_t *dataStart = (uint8_t *)(header + 1);
+
+    // Offset within data storage area.
+    return dataStart + offset;
+}
+
+static uint32_t *DataAreaOffset32(BufferHeader *header, size_t offset)
+{
+    return (uint32_t *)DataAreaOffset8(header, offset);
+}
+
+static uint32_t RoundUp(uint32_t value, uint32_t alignment)
+{
+    // alignment must be a power of two.
+
+    return (value + (alignment - 1)) & ~(alignment - 1);
+}
+
+static uint32_t AdvancePosition(uint32_t position, uint32_t blockSize, uint32_t bufSize)
+{
+    // Round to next aligned block, and wraparound end of buffer if required.
+    position = RoundUp(position + sizeof(uint32_t) + blockSize, RINGBUFFER_ALIGNMENT);
+    if (position >= bufSize) {
+        position -= bufSize;
+    }
+    return position;
+}
+
+static void CopyToRing(BufferHeader *header, uint32_t bufSize, uint32_t position,
+                       const uint8_t *src, uint32_t length)
+{
+    if (position >= bufSize) {
+        position -= bufSize;
+    }
+
+    // Write up to end of buffer, then wrap the remainder around to the start.
+    uint32_t toEnd = bufSize - position;
+    if (length <= toEnd) {
+        __builtin_memcpy(DataAreaOffset8(header, position), src, length);
+    } else {
+        __builtin_memcpy(DataAreaOffset8(header, position), src, toEnd);
+        __builtin_memcpy(DataAreaOffset8(header, 0), src + toEnd, length - toEnd);
+    }
+}
+
+static void CopyFromRing(BufferHeader *header, uint32_t bufSize, uint32_t position, uint8_t *dest,
+                         uint32_t length)
+{
+    if (position >= bufSize) {
+        position -= bufSize;
+    }
+
+    // Read up to end of buffer, then read the remainder from the start.
+    uint32_t toEnd = bufSize - position;
+    if (length <= toEnd) {
+        __builtin_memcpy(dest, DataAreaOffset8(header, position), length);
+    } else {
+        __builtin_memcpy(dest, DataAreaOffset8(header, position), toEnd);
+        __builtin_memcpy(dest + toEnd, DataAreaOffset8(header, 0), length - toEnd);
+    }
+}
+
+/// <summary>
+/// Validates the block at localReadPosition and returns its size.
+/// </summary>
+/// <returns>1 if there is a valid block, 0 if there is no data, -1 if the ring is corrupt.</returns>
+static int PeekBlock(BufferHeader *inbound, uint32_t bufSize, uint32_t localReadPosition,
+                     uint32_t availData, uint32_t *blockSize)
+{
+    // There must be at least four contiguous bytes to hold the block size.
+    if (availData < sizeof(uint32_t)) {
+        if (availData > 0) {
+            IntercoreRing_Error("DequeueData: availData < 4 bytes\r\n");
+            return -1;
+        }
+
+        return 0;
+    }
+
+    uint32_t dataToEnd = bufSize - localReadPosition;
+    if (dataToEnd < sizeof(uint32_t)) {
+        IntercoreRing_Error("DequeueData: dataToEnd < 4 bytes\r\n");
+        return -1;
+    }
+
+    *blockSize = *DataAreaOffset32(inbound, localReadPosition);
+
+    // Ensure the block size is no greater than the available data.
+    if (*blockSize + sizeof(uint32_t) > availData) {
+        IntercoreRing_Error("DequeueData: message size greater than available data\r\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+int IntercoreRing_Write(BufferHeader *inbound, BufferHeader *outbound, uint32_t bufSize,
+                        const IntercoreIoVec *fragments, uint32_t fragmentCount)
+{
+    uint32_t remoteReadPosition = inbound->readPosition;
+    uint32_t localWritePosition = outbound->writePosition;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (remoteReadPosition >= bufSize) {
+        IntercoreRing_Error("EnqueueData: remoteReadPosition invalid\r\n");
+        return -1;
+    }
+
+    uint32_t dataSize = 0;
+    for (uint32_t i = 0; i < fragmentCount; ++i) {
+        dataSize += fragments[i].length;
+    }
+
+    // If the read pointer is behind the write pointer, then the free space wraps around.
+    uint32_t availSpace;
+    if (remoteReadPosition <= localWritePosition) {
+        availSpace = remoteReadPosition - localWritePosition + bufSize;
+    } else {
+        availSpace = remoteReadPosition - localWritePosition;
+    }
+
+    // If there isn't enough space to enqueue a block, then abort the operation.
+    if (availSpace < sizeof(uint32_t) + dataSize + RINGBUFFER_ALIGNMENT) {
+        IntercoreRing_Error("EnqueueData: not enough space to enqueue block\r\n");
+        return -1;
+    }
+
+    // There must be enough space between the write pointer and the end of the buffer to store the
+    // block size as a contiguous 4-byte value. The remainder of message can wrap around.
+    if (bufSize - localWritePosition < sizeof(uint32_t)) {
+        IntercoreRing_Error("EnqueueData: not enough space for block size\r\n");
+        return -1;
+    }
+
+    // Write block size to first word in block, then gather the fragments straight into the ring.
+    *DataAreaOffset32(outbound, localWritePosition) = dataSize;
+
+    uint32_t position = localWritePosition + sizeof(uint32_t);
+    for (uint32_t i = 0; i < fragmentCount; ++i) {
+        CopyToRing(outbound, bufSize, position, fragments[i].base, fragments[i].length);
+        position += fragments[i].length;
+    }
+
+    // Publish the data before the write position which makes it visible.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    outbound->writePosition = AdvancePosition(localWritePosition, dataSize, bufSize);
+
+    return 0;
+}
+
+int IntercoreRing_Read(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize, void *dest,
+                       uint32_t *dataSize)
+{
+    uint32_t remoteWritePosition = inbound->writePosition;
+    uint32_t localReadPosition = outbound->readPosition;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (remoteWritePosition >= bufSize) {
+        IntercoreRing_Error("DequeueData: remoteWritePosition invalid\r\n");
+        return -1;
+    }
+
+    uint32_t availData;
+    // If data is contiguous in buffer then difference between write and read positions...
+    if (remoteWritePosition >= localReadPosition) {
+        availData = remoteWritePosition - localReadPosition;
+    }
+    // ...else data wraps around end and resumes at start of buffer
+    else {
+        availData = remoteWritePosition - localReadPosition + bufSize;
+    }
+
+    uint32_t blockSize;
+    if (PeekBlock(inbound, bufSize, localReadPosition, availData, &blockSize) != 1) {
+        return -1;
+    }
+
+    // Abort if the caller-supplied buffer is not large enough to hold the message.
+    if (blockSize > *dataSize) {
+        IntercoreRing_Error("DequeueData: message too large for buffer\r\n");
+        *dataSize = blockSize;
+        return -1;
+    }
+
+    // Tell the caller the actual block size.
+    *dataSize = blockSize;
+
+    CopyFromRing(inbound, bufSize, localReadPosition + sizeof(uint32_t), dest, blockSize);
+
+    // Release the space only after the block has been copied out.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    outbound->readPosition = AdvancePosition(localReadPosition, blockSize, bufSize);
+
+    return 0;
+}
+
+int IntercoreRing_ReadBatch(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize,
+                            void *dest, uint32_t destSize, IntercoreIoVec *blocks,
+                            uint32_t maxBlocks)
+{
+    uint32_t remoteWritePosition = inbound->writePosition;
+    uint32_t localReadPosition = outbound->readPosition;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (remoteWritePosition >= bufSize) {
+        IntercoreRing_Error("DequeueData: remoteWritePosition invalid\r\n");
+        return -1;
+    }
+
+    uint8_t *dest8 = dest;
+    uint32_t destUsed = 0;
+    uint32_t blockCount = 0;
+
+    while (blockCount < maxBlocks) {
+        uint32_t availData;
+        if (remoteWritePosition >= localReadPosition) {
+            availData = remoteWritePosition - localReadPosition;
+        } else {
+            availData = remoteWritePosition - localReadPosition + bufSize;
+        }
+
+        uint32_t blockSize;
+        int result = PeekBlock(inbound, bufSize, localReadPosition, availData, &blockSize);
+        if (result == 0) {
+            break;
+        }
+        if (result < 0) {
+            // Keep what was read so far; the corrupt block is reported again on the next call.
+            if (blockCount > 0) {
+                break;
+            }
+            return -1;
+        }
+
+        // Leave the block in the ring if there is no room for it.
+        if (blockSize > destSize - destUsed) {
+            if (blockCount == 0) {
+                IntercoreRing_Error("DequeueData: message too large for buffer\r\n");
+                return -1;
+            }
+            break;
+        }
+
+        CopyFromRing(inbound, bufSize, localReadPosition + sizeof(uint32_t), dest8 + destUsed,
+                     blockSize);
+        blocks[blockCount].base = dest8 + destUsed;
+        blocks[blockCount].length = blockSize;
+        blockCount++;
+        destUsed += blockSize;
+
+        localReadPosition = AdvancePosition(localReadPosition, blockSize, bufSize);
+    }
+
+    if (blockCount > 0) {
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        outbound->readPosition = localReadPosition;
+    }
+
+    return (int)blockCount;
+}
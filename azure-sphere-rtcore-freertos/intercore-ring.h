@@ -0,0 +1,95 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#ifndef INTERCORE_RING_H
+#define INTERCORE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// <summary>
+/// There are two buffers, inbound and outbound, which are used to track
+/// how much data has been written to, and read from, each shared buffer.
+/// </summary>
+typedef struct {
+    /// <summary>
+    /// <para>Enqueue function uses this value to store the last position written to
+    /// by the real-time capable application.</para>
+    /// <para>Dequeue function uses this value to find the last position written to by
+    /// the high-level application.</summary>
+    uint32_t writePosition;
+    /// <summary>
+    /// <para>Enqueue function uses this value to find the last position read from by the
+    /// high-level applicaton.</para>
+    /// <para>Dequeue function uses this value to store the last position read from by
+    /// the real-time application.</para>
+    uint32_t readPosition;
+    /// <summary>Reserved for alignment.</summary>
+    uint32_t reserved[14];
+} BufferHeader;
+
+/// <summary>Blocks inside the shared buffer have this alignment.</summary>
+#define RINGBUFFER_ALIGNMENT 16
+
+/// <summary>
+/// A fragment of a block to enqueue, or a block which has been dequeued.
+/// </summary>
+typedef struct {
+    /// <summary>Start of the data.</summary>
+    const void *base;
+    /// <summary>Length of the data in bytes.</summary>
+    uint32_t length;
+} IntercoreIoVec;
+
+/// <summary>
+/// <para>Reports a ring buffer protocol error. Supplied by the platform: the real-time
+/// application writes it to the debug UART.</para>
+/// </summary>
+/// <param name="message">Description of the error.</param>
+void IntercoreRing_Error(const char *message);
+
+/// <summary>
+/// <para>Writes one block, gathered from a list of fragments, to the outbound ring. Does not
+/// notify the other core.</para>
+/// </summary>
+/// <param name="inbound">The inbound buffer header, used to find the remote read position.</param>
+/// <param name="outbound">The outbound buffer, which the block is written to.</param>
+/// <param name="bufSize">Size of each buffer's data area in bytes.</param>
+/// <param name="fragments">Fragments which are concatenated to form the block.</param>
+/// <param name="fragmentCount">Number of fragments.</param>
+/// <returns>0 if able to write the block, -1 otherwise.</returns>
+int IntercoreRing_Write(BufferHeader *inbound, BufferHeader *outbound, uint32_t bufSize,
+                        const IntercoreIoVec *fragments, uint32_t fragmentCount);
+
+/// <summary>
+/// <para>Reads one block from the inbound ring. Does not notify the other core.</para>
+/// </summary>
+/// <param name="outbound">The outbound buffer header, which stores the local read position.</param>
+/// <param name="inbound">The inbound buffer, which the block is read from.</param>
+/// <param name="bufSize">Size of each buffer's data area in bytes.</param>
+/// <param name="dest">Data from the shared buffer is copied into this buffer.</param>
+/// <param name="dataSize">On entry, contains maximum size of destination buffer in bytes.
+/// On exit, contains the actual number of bytes which were written to the destination buffer,
+/// or the size of the block if it did not fit.</param>
+/// <returns>0 if able to read a block, -1 otherwise.</returns>
+int IntercoreRing_Read(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize, void *dest,
+                       uint32_t *dataSize);
+
+/// <summary>
+/// <para>Reads every available block from the inbound ring in one pass, packing them into dest
+/// and describing each with an entry in blocks. The read position is published once. Stops
+/// early when dest or blocks is full; the remaining blocks stay in the ring.</para>
+/// </summary>
+/// <param name="outbound">The outbound buffer header, which stores the local read position.</param>
+/// <param name="inbound">The inbound buffer, which the blocks are read from.</param>
+/// <param name="bufSize">Size of each buffer's data area in bytes.</param>
+/// <param name="dest">Buffer the blocks are copied into, back to back.</param>
+/// <param name="destSize">Size of dest in bytes.</param>
+/// <param name="blocks">On exit, each entry points at a block within dest.</param>
+/// <param name="maxBlocks">Number of entries in blocks.</param>
+/// <returns>The number of blocks read, or -1 if the ring is corrupt.</returns>
+int IntercoreRing_ReadBatch(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize,
+                            void *dest, uint32_t destSize, IntercoreIoVec *blocks,
+                            uint32_t maxBlocks);
+
+#endif // #ifndef INTERCORE_RING_H
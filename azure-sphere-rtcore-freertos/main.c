@@ -41,8 +41,11 @@ static BufferHeader* outbound, * inbound;
 static uint32_t sharedBufSize = 0;
 static const size_t payloadStart = 20;
 static uint8_t buf[256];
-static uint32_t dataSize;
+static IntercoreIoVec receivedBlocks[8];
+// Component ID and reserved word from the high-level app (payloadStart bytes), echoed on replies
+static uint8_t hlAppHeader[20];
 static bool buttonPressed = false;
+static TaskHandle_t rtCoreMsgTaskHandle = NULL;
 
 static void ISU0_ISR(void);
 static _Noreturn void DefaultExceptionHandler(void);
@@ -76,7 +79,9 @@ __attribute__((used)) = {
 	[12] = (uintptr_t)DefaultExceptionHandler,	// Debug monitor
 	[14] = (uintptr_t)PendSV_Handler,			// PendSV
 	[15] = (uintptr_t)SysTick_Handler,			// SysTick
-	[INT_TO_EXC(0)... INT_TO_EXC(46)] = (uintptr_t)DefaultExceptionHandler,
+	[INT_TO_EXC(0)... INT_TO_EXC(INTERCORE_MAILBOX_IRQ - 1)] = (uintptr_t)DefaultExceptionHandler,
+	[INT_TO_EXC(INTERCORE_MAILBOX_IRQ)] = (uintptr_t)IntercoreMailbox_ISR,
+	[INT_TO_EXC(INTERCORE_MAILBOX_IRQ + 1)... INT_TO_EXC(46)] = (uintptr_t)DefaultExceptionHandler,
 	[INT_TO_EXC(47)] = (uintptr_t)ISU0_ISR,
 	[INT_TO_EXC(48)... INT_TO_EXC(INTERRUPT_COUNT - 1)] = (uintptr_t)DefaultExceptionHandler
 };
@@ -101,6 +106,19 @@ static void ISU0_ISR(void)
 	}
 }
 
+/// <summary>
+/// Called from the mailbox interrupt when the high-level app has enqueued a message.
+/// </summary>
+static void IntercoreMessageReceived(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	if (rtCoreMsgTaskHandle != NULL) {
+		vTaskNotifyGiveFromISR(rtCoreMsgTaskHandle, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+}
+
 static void DebugUARTInit(void)
 {
 	// Configure UART to use 115200-8-N-1.
@@ -171,6 +189,9 @@ static void ButtonTask(void* pParameters)
 			if (pressed) {
 				blinkIntervalIndex = (blinkIntervalIndex + 1) % numBlinkIntervals;
 				buttonPressed = true;
+				if (rtCoreMsgTaskHandle != NULL) {
+					xTaskNotifyGive(rtCoreMsgTaskHandle);
+				}
 			}
 
 			prevState = newState;
@@ -192,23 +213,39 @@ static void RTCoreMsgTask(void* pParameters)
 {
 	bool HLAppReady = false;
 
-	while (1) {
-		dataSize = sizeof(buf);
-		int r = DequeueData(outbound, inbound, sharedBufSize, buf, &dataSize);
+	EnableIntercoreMessageInterrupt(IntercoreMessageReceived, 3);
 
-		//if (!(r == -1 || dataSize < payloadStart)) {
-		if (r == 0 && dataSize > payloadStart){
-			HLAppReady = true;
+	while (1) {
+		// Drain every message the high-level app has enqueued, a batch at a time. The first
+		// pass also picks up anything enqueued before the interrupt was enabled.
+		int blockCount;
+		while ((blockCount = DequeueDataBatch(outbound, inbound, sharedBufSize, buf, sizeof buf,
+			receivedBlocks, sizeof receivedBlocks / sizeof receivedBlocks[0])) > 0) {
+			for (int i = 0; i < blockCount; i++) {
+				if (receivedBlocks[i].length > payloadStart) {
+					memcpy(hlAppHeader, receivedBlocks[i].base, payloadStart);
+					HLAppReady = true;
+				}
+			}
 		}
 
 		if (buttonPressed && HLAppReady) {
-			const char msg[] = "ButtonPressed";
-			strncpy((char*)buf + payloadStart, msg, sizeof buf - payloadStart);
-			dataSize = payloadStart + sizeof msg - 1;
-
-			EnqueueData(inbound, outbound, sharedBufSize, buf, dataSize);
+			// Frame the message for the high-level app: 16 bit little endian length, then payload.
+			// The pieces are gathered straight into the shared buffer.
+			static const char msg[] = "ButtonPressed";
+			static const uint8_t frameHeader[] = { (sizeof msg - 1) & 0xFF, (sizeof msg - 1) >> 8 };
+			const IntercoreIoVec fragments[] = {
+				{.base = hlAppHeader, .length = payloadStart },
+				{.base = frameHeader, .length = sizeof frameHeader },
+				{.base = msg, .length = sizeof msg - 1 }
+			};
+
+			EnqueueDataV(inbound, outbound, sharedBufSize, fragments, sizeof fragments / sizeof fragments[0]);
 			buttonPressed = false;
 		}
+
+		// Sleep until the mailbox interrupt or the button task has something for us.
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 	}
 }
 
@@ -220,7 +257,7 @@ static void TaskInit(void* pParameters)
 	xTaskCreate(LedTask, "LED Task", APP_STACK_SIZE_BYTES, NULL, 5, NULL);
 	xTaskCreate(ButtonTask, "Button Task", APP_STACK_SIZE_BYTES, NULL, 4, NULL);
 	xTaskCreate(UARTTask, "UART Task", APP_STACK_SIZE_BYTES, NULL, 3, NULL);
-	xTaskCreate(RTCoreMsgTask, "RTCore Msg Task", APP_STACK_SIZE_BYTES, NULL, 2, NULL);
+	xTaskCreate(RTCoreMsgTask, "RTCore Msg Task", APP_STACK_SIZE_BYTES, NULL, 2, &rtCoreMsgTaskHandle);
 
 	vTaskSuspend(NULL);
 }
@@ -266,6 +303,12 @@ static _Noreturn void RTCoreMain(void)
 
 // application hooks
 
+void vApplicationIdleHook(void)
+{
+	// Nothing is runnable, so sleep the core until the next interrupt (tick, mailbox or UART).
+	__asm__ volatile("wfi");
+}
+
 void vApplicationStackOverflowHook(TaskHandle_t xTask, char* pcTaskName)
 {
 	;
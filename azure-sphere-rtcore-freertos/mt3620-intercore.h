@@ -6,29 +6,10 @@
 
 #include <stdint.h>
 
-/// <summary>
-/// There are two buffers, inbound and outbound, which are used to track
-/// how much data has been written to, and read from, each shared buffer.
-/// </summary>
-typedef struct {
-    /// <summary>
-    /// <para>Enqueue function uses this value to store the last position written to
-    /// by the real-time capable application.</para>
-    /// <para>Dequeue function uses this value to find the last position written to by
-    /// the high-level application.</summary>
-    uint32_t writePosition;
-    /// <summary>
-    /// <para>Enqueue function uses this value to find the last position read from by the
-    /// high-level applicaton.</para>
-    /// <para>Dequeue function uses this value to store the last position read from by
-    /// the real-time application.</para>
-    uint32_t readPosition;
-    /// <summary>Reserved for alignment.</summary>
-    uint32_t reserved[14];
-} BufferHeader;
+#include "intercore-ring.h"
 
-/// <summary>Blocks inside the shared buffer have this alignment.</summary>
-#define RINGBUFFER_ALIGNMENT 16
+/// <summary>NVIC interrupt raised when the high-level application writes SW_RX_INT.</summary>
+#define INTERCORE_MAILBOX_IRQ 11
 
 /// <summary>
 /// <para>Gets the inbound and outbound buffers used to communicate with the high-level
@@ -76,4 +57,54 @@ int EnqueueData(BufferHeader *inbound, BufferHeader *outbound, uint32_t bufSize,
 int DequeueData(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize, void *dest,
                 uint32_t *dataSize);
 
+/// <summary>
+/// Add a block gathered from a list of fragments, such as a header and a payload, to the shared
+/// buffer without staging them in a contiguous buffer first.
+/// </summary>
+/// <param name="outbound">The outbound buffer, as obtained from <see cref="GetIntercoreBuffers" />.
+/// </param>
+/// <param name="inbound">The inbound buffer, as obtained from <see cref="GetIntercoreBuffers" />.
+/// </param>
+/// <param name="bufSize">
+/// The total buffer size, as obtained from <see cref="GetIntercoreBuffers" />.
+/// </param>
+/// <param name="fragments">Fragments which are concatenated to form the block.</param>
+/// <param name="fragmentCount">Number of fragments.</param>
+/// <returns>0 if able to enqueue the data, -1 otherwise.</returns>
+int EnqueueDataV(BufferHeader *inbound, BufferHeader *outbound, uint32_t bufSize,
+                 const IntercoreIoVec *fragments, uint32_t fragmentCount);
+
+/// <summary>
+/// Remove every available block from the shared buffer in one pass. The high-level application
+/// is notified once for the whole batch.
+/// </summary>
+/// <param name="outbound">The outbound buffer, as obtained from <see cref="GetIntercoreBuffers" />.
+/// </param>
+/// <param name="inbound">The inbound buffer, as obtained from <see cref="GetIntercoreBuffers" />.
+/// </param>
+/// <param name="bufSize">Total size of shared buffer in bytes.</param>
+/// <param name="dest">The blocks are copied into this buffer, back to back.</param>
+/// <param name="destSize">Size of dest in bytes.</param>
+/// <param name="blocks">On exit, each entry points at a block within dest.</param>
+/// <param name="maxBlocks">Number of entries in blocks.</param>
+/// <returns>The number of blocks dequeued, or -1 on error.</returns>
+int DequeueDataBatch(BufferHeader *outbound, BufferHeader *inbound, uint32_t bufSize, void *dest,
+                     uint32_t destSize, IntercoreIoVec *blocks, uint32_t maxBlocks);
+
+/// <summary>
+/// <para>Enables the mailbox software interrupt which the high-level application raises after
+/// it has enqueued a message, and registers a callback to run from that interrupt.</para>
+/// <para><see cref="IntercoreMailbox_ISR" /> must be installed in the vector table at
+/// <see cref="INTERCORE_MAILBOX_IRQ" />.</para>
+/// </summary>
+/// <param name="callback">Called in interrupt context when a message has been received.</param>
+/// <param name="priority">NVIC priority for the mailbox interrupt.</param>
+void EnableIntercoreMessageInterrupt(void (*callback)(void), uint8_t priority);
+
+/// <summary>
+/// Mailbox software interrupt handler. Acknowledges the interrupt and invokes the callback
+/// supplied to <see cref="EnableIntercoreMessageInterrupt" />.
+/// </summary>
+void IntercoreMailbox_ISR(void);
+
 #endif // #ifndef MT3620_INTERCORE_H